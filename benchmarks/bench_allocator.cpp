@@ -0,0 +1,66 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/allocator.hpp>
+#include <vector>
+
+namespace
+{
+// Fills a private allocator with `count` live 16-byte blocks.
+auto make_live_set(const std::shared_ptr<VeilHook::Allocator>& allocator,
+                   std::size_t count) -> std::vector<VeilHook::Allocation>
+{
+  std::vector<VeilHook::Allocation> live;
+  live.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    if (auto allocation = allocator->Allocate(16))
+    {
+      live.push_back(std::move(*allocation));
+    }
+  }
+  return live;
+}
+}  // namespace
+
+VH_BENCHMARK_EX("Allocator/AllocateFree", 0, 1, 10, 100, 1'000, 10'000,
+                100'000)
+{
+  auto allocator = std::make_shared<VeilHook::Allocator>();
+  const auto live =
+      make_live_set(allocator, static_cast<std::size_t>(state.arg()));
+  for (auto _ : state)
+  {
+    auto allocation = allocator->Allocate(32);
+    VeilHook::Bench::do_not_optimize(allocation);
+  }
+  state.counters["live"] = static_cast<double>(live.size());
+}
+
+VH_BENCHMARK_EX("Allocator/AllocateFreeNear", 0, 1, 10, 100, 1'000, 10'000,
+                100'000)
+{
+  auto allocator = std::make_shared<VeilHook::Allocator>();
+  const auto live =
+      make_live_set(allocator, static_cast<std::size_t>(state.arg()));
+  const std::vector<std::uintptr_t> desired{
+      VeilHook::detail::address_cast(&make_live_set)};
+  for (auto _ : state)
+  {
+    auto allocation = allocator->Allocate(desired, 32);
+    VeilHook::Bench::do_not_optimize(allocation);
+  }
+  state.counters["live"] = static_cast<double>(live.size());
+}
+
+// Cost of growing the live set itself, reported per allocation.
+VH_BENCHMARK_EX("Allocator/Fill", 1, 1'000, 10'000, 100'000)
+{
+  auto allocator = std::make_shared<VeilHook::Allocator>();
+  const auto count = static_cast<std::size_t>(state.arg());
+  std::vector<VeilHook::Allocation> live;
+  for (auto _ : state) { live = make_live_set(allocator, count); }
+  state.counters["ns_per_allocation"] =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count() /
+      static_cast<double>(count);
+}
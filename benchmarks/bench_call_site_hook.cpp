@@ -0,0 +1,105 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/call_site_hook.hpp>
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/utility.hpp>
+
+namespace
+{
+using VeilHook::detail::address_cast;
+
+// One target per mode so their patches do not meet.
+VH_NOINLINE auto plain_target(int x) -> int { return (x * 3) + 1; }
+VH_NOINLINE auto inline_target(int x) -> int { return (x * 5) + 2; }
+VH_NOINLINE auto call_site_target(int x) -> int { return (x * 7) + 3; }
+
+// Both detours reach the original through a pointer: the trampoline of the
+// patched callee, or the untouched target for CallSiteHook.
+int (*volatile g_inline_original)(int) = nullptr;
+int (*volatile g_call_site_original)(int) = &call_site_target;
+
+VH_NOINLINE auto inline_detour(int x) -> int
+{
+  return g_inline_original(x) - 1;
+}
+VH_NOINLINE auto call_site_detour(int x) -> int
+{
+  return g_call_site_original(x) - 1;
+}
+
+auto module_of(std::uintptr_t address) -> std::uintptr_t
+{
+  const auto module = VeilHook::Impl::module_query(address);
+  return module ? module->base : 0;
+}
+
+void report_per_call(VeilHook::Bench::State& state)
+{
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["ns_per_call"] = ns / static_cast<double>(state.iterations());
+}
+}  // namespace
+
+//==============================================================================
+// Per-call cost: unhooked, patched callee, patched callers
+//==============================================================================
+VH_BENCHMARK_EX("CallSiteHook/CallUnhooked", 10'000'000)
+{
+  int sum = 0;
+  for (auto _ : state) { sum += plain_target(sum); }
+  VeilHook::Bench::do_not_optimize(sum);
+  report_per_call(state);
+}
+
+// The E9 patch and trampoline InlineHook emits; the registry hands out the
+// trampoline address the detour calls.
+VH_BENCHMARK_EX("CallSiteHook/CallInlineHook", 10'000'000)
+{
+  static VeilHook::HookRegistry registry{1};
+  static const auto handle =
+      registry.Add(address_cast<std::uintptr_t>(&inline_target),
+                   address_cast<std::uintptr_t>(&inline_detour));
+  if (not handle || not registry.Enable(*handle)) { return; }
+  g_inline_original =
+      address_cast<int (*)(int)>(registry.trampoline(*handle));
+  int sum = 0;
+  for (auto _ : state) { sum += inline_target(sum); }
+  VeilHook::Bench::do_not_optimize(sum);
+  report_per_call(state);
+}
+
+// The loop's own call is one of the sites.
+VH_BENCHMARK_EX("CallSiteHook/CallCallSiteHook", 10'000'000)
+{
+  const auto target = address_cast<std::uintptr_t>(&call_site_target);
+  static auto hook = VeilHook::CallSiteHook::Create(
+      module_of(target), target,
+      address_cast<std::uintptr_t>(&call_site_detour));
+  if (not hook || not (*hook)->Enable()) { return; }
+  int sum = 0;
+  for (auto _ : state) { sum += call_site_target(sum); }
+  VeilHook::Bench::do_not_optimize(sum);
+  report_per_call(state);
+  state.counters["sites"] = static_cast<double>((*hook)->sites().size());
+}
+
+//==============================================================================
+// Install: sweep of this executable's code
+//==============================================================================
+VH_BENCHMARK_EX("CallSiteHook/Create", 20)
+{
+  const auto target = address_cast<std::uintptr_t>(&plain_target);
+  const auto module = module_of(target);
+  std::size_t sites = 0;
+  for (auto _ : state)
+  {
+    if (auto hook = VeilHook::CallSiteHook::Create(
+            module, target, address_cast<std::uintptr_t>(&call_site_detour)))
+    {
+      sites = (*hook)->sites().size();
+    }
+  }
+  state.counters["sites"] = static_cast<double>(sites);
+}
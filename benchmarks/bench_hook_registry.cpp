@@ -0,0 +1,112 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+#include "synthetic.hpp"
+
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <vector>
+
+namespace
+{
+using VeilHook::HookRegistry;
+using VeilHook::HookTarget;
+using VeilHook::InlineHook;
+using VeilHook::Bench::SyntheticFunctions;
+
+constexpr std::size_t kHooks = 100'000;
+
+VH_NOINLINE auto detour() -> int { return -1; }
+
+auto hook_targets(const SyntheticFunctions& functions)
+    -> std::vector<HookTarget>
+{
+  std::vector<HookTarget> targets(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i)
+  {
+    targets[i] = {.target = functions[i],
+                  .destination = VeilHook::detail::address_cast(&detour)};
+  }
+  return targets;
+}
+
+void report_per_toggle(VeilHook::Bench::State& state, std::size_t toggles)
+{
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["toggles"] = static_cast<double>(toggles);
+  state.counters["ns_per_toggle"] = ns / static_cast<double>(toggles);
+}
+}  // namespace
+
+//==============================================================================
+// Footprint
+//==============================================================================
+// Bytes held per hook outside the trampolines, which both designs share.
+// Heap block headers are not counted, so the InlineHook figure (the object
+// plus its separately allocated Allocation) is a lower bound.
+VH_BENCHMARK_EX("HookRegistry/Memory", 1)
+{
+  const SyntheticFunctions functions{kHooks};
+  const auto targets = hook_targets(functions);
+  HookRegistry registry{kHooks};
+  for (auto _ : state) { (void)registry.AddMany(targets); }
+
+  const auto memory = registry.memory();
+  const auto hooks = static_cast<double>(memory.hooks);
+  state.counters["hooks"] = hooks;
+  state.counters["inline_hook_bytes_per_hook"] =
+      static_cast<double>(sizeof(InlineHook) + sizeof(VeilHook::Allocation));
+  state.counters["registry_bytes_per_hook"] =
+      static_cast<double>(memory.slots + memory.bytes) / hooks;
+  state.counters["trampoline_bytes_per_hook"] =
+      static_cast<double>(memory.trampolines) / hooks;
+}
+
+//==============================================================================
+// Install and toggle
+//==============================================================================
+VH_BENCHMARK_EX("HookRegistry/AddMany", 1)
+{
+  const SyntheticFunctions functions{kHooks};
+  const auto targets = hook_targets(functions);
+  HookRegistry registry{kHooks};
+  for (auto _ : state) { (void)registry.AddMany(targets); }
+  state.counters["hooks"] = static_cast<double>(registry.size());
+  state.counters["ns_per_hook"] =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count() /
+      static_cast<double>(kHooks);
+}
+
+VH_BENCHMARK_EX("HookRegistry/EnableDisable", 10)
+{
+  const SyntheticFunctions functions{kHooks};
+  HookRegistry registry{kHooks};
+  std::vector<VeilHook::HookHandle> handles;
+  for (const auto& handle : registry.AddMany(hook_targets(functions)))
+  {
+    if (handle) { handles.push_back(*handle); }
+  }
+  for (auto _ : state)
+  {
+    for (const auto handle : handles) { (void)registry.Enable(handle); }
+    for (const auto handle : handles) { (void)registry.Disable(handle); }
+  }
+  report_per_toggle(state, 2 * handles.size() * state.iterations());
+}
+
+VH_BENCHMARK_EX("InlineHook/EnableDisable", 10)
+{
+  const SyntheticFunctions functions{kHooks};
+  std::vector<InlineHook> hooks;
+  hooks.reserve(kHooks);
+  for (auto& hook : InlineHook::CreateMany(hook_targets(functions)))
+  {
+    if (hook) { hooks.push_back(std::move(*hook)); }
+  }
+  for (auto _ : state)
+  {
+    for (auto& hook : hooks) { (void)hook.Enable(); }
+    for (auto& hook : hooks) { (void)hook.Disable(); }
+  }
+  report_per_toggle(state, 2 * hooks.size() * state.iterations());
+}
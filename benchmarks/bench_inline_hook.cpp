@@ -0,0 +1,371 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+#include "synthetic.hpp"
+
+#include <VeilHook/inline_hook.hpp>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace
+{
+using VeilHook::InlineHook;
+using VeilHook::Bench::SyntheticFunctions;
+
+VH_NOINLINE auto detour() -> int { return -1; }
+
+// What a detour does by hand without HookOptions::guarded.
+thread_local bool t_inside = false;
+VH_NOINLINE auto thread_local_detour() -> int
+{
+  if (t_inside) { return -2; }
+  t_inside = true;
+  const auto result = detour();
+  t_inside = false;
+  return result;
+}
+
+// Eight cases dense enough for a jump table.
+VH_NOINLINE auto dispatch(int x) -> int
+{
+  switch (x)
+  {
+    case 0: return x * 7 + 1;
+    case 1: return x ^ 0x55;
+    case 2: return x << 3;
+    case 3: return x / 3 + 9;
+    case 4: return x - 100;
+    case 5: return ~x;
+    case 6: return x * x;
+    case 7: return x | 0x1000;
+    default: return -x;
+  }
+}
+
+auto destination() -> std::uintptr_t
+{
+  return VeilHook::detail::address_cast(&detour);
+}
+
+auto create_hooks(const SyntheticFunctions& functions)
+    -> std::vector<InlineHook>
+{
+  std::vector<InlineHook> hooks;
+  hooks.reserve(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i)
+  {
+    if (auto hook = InlineHook::Create(functions[i], destination()))
+    {
+      hooks.push_back(std::move(*hook));
+    }
+  }
+  return hooks;
+}
+
+// `jmp [literal]` to `target`, the shape of an import thunk.
+auto make_thunk(std::uintptr_t target) -> std::optional<VeilHook::Allocation>
+{
+  auto thunk = VeilHook::Allocator::Get()->Allocate({target}, 16);
+  if (not thunk) { return thunk; }
+  const auto base = thunk->address();
+  VeilHook::detail::store<std::uint16_t>(base, 0x25FF);
+#if defined(VH_ARCH_X86_64)
+  VeilHook::detail::store<std::int32_t>(base + 2, 2);
+#else
+  VeilHook::detail::store(base + 2, static_cast<std::uint32_t>(base + 8));
+#endif
+  VeilHook::detail::store(base + 8, target);
+  return thunk;
+}
+
+void report_per_hook(VeilHook::Bench::State& state, std::size_t hooks)
+{
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["hooks"] = static_cast<double>(hooks);
+  state.counters["ns_per_hook"] = ns / static_cast<double>(hooks);
+  state.counters["hooks_per_sec"] = static_cast<double>(hooks) * 1e9 / ns;
+}
+}  // namespace
+
+//==============================================================================
+// Install latency
+//==============================================================================
+VH_BENCHMARK_EX("InlineHook/Create", 1'000)
+{
+  const SyntheticFunctions functions{state.iterations()};
+  std::vector<InlineHook> hooks;
+  hooks.reserve(functions.size());
+  std::size_t i = 0;
+  for (auto _ : state)
+  {
+    if (auto hook = InlineHook::Create(functions[i++], destination()))
+    {
+      hooks.push_back(std::move(*hook));
+    }
+  }
+  state.counters["created"] = static_cast<double>(hooks.size());
+}
+
+VH_BENCHMARK_EX("InlineHook/Enable", 1'000)
+{
+  const SyntheticFunctions functions{state.iterations()};
+  auto hooks = create_hooks(functions);
+  std::size_t i = 0;
+  for (auto _ : state)
+  {
+    if (i < hooks.size()) { (void)hooks[i++].Enable(); }
+  }
+}
+
+VH_BENCHMARK_EX("InlineHook/Disable", 1'000)
+{
+  const SyntheticFunctions functions{state.iterations()};
+  auto hooks = create_hooks(functions);
+  for (auto& hook : hooks) { (void)hook.Enable(); }
+  std::size_t i = 0;
+  for (auto _ : state)
+  {
+    if (i < hooks.size()) { (void)hooks[i++].Disable(); }
+  }
+}
+
+//==============================================================================
+// Per-call cost
+//==============================================================================
+VH_BENCHMARK("Call/Direct")
+{
+  const SyntheticFunctions functions{1};
+  volatile SyntheticFunctions::Function function = functions.function(0);
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/DetourDirect")
+{
+  volatile SyntheticFunctions::Function function = &detour;
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/ThroughDetour")
+{
+  const SyntheticFunctions functions{1};
+  auto hook = InlineHook::Create(functions[0], destination());
+  if (not hook or not hook->Enable()) { return; }
+  volatile SyntheticFunctions::Function function = functions.function(0);
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/ThroughThreadLocalGuard")
+{
+  const SyntheticFunctions functions{1};
+  auto hook = InlineHook::Create(
+      functions[0], VeilHook::detail::address_cast(&thread_local_detour));
+  if (not hook or not hook->Enable()) { return; }
+  volatile SyntheticFunctions::Function function = functions.function(0);
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/ThroughGuard")
+{
+  const SyntheticFunctions functions{1};
+  auto hook =
+      InlineHook::Create(functions[0], destination(), {.guarded = true});
+  if (not hook or not hook->Enable()) { return; }
+  volatile SyntheticFunctions::Function function = functions.function(0);
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/GuardBypassed")
+{
+  const SyntheticFunctions functions{1};
+  auto hook =
+      InlineHook::Create(functions[0], destination(), {.guarded = true});
+  if (not hook or not hook->Enable()) { return; }
+  volatile SyntheticFunctions::Function function = functions.function(0);
+  const VeilHook::ScopedBypass bypass;
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+}
+
+VH_BENCHMARK("Call/Trampoline")
+{
+  const SyntheticFunctions functions{1};
+  auto hook = InlineHook::Create(functions[0], destination());
+  if (not hook or not hook->Enable()) { return; }
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(hook->Call<int>());
+  }
+}
+
+// Calls to the original through the trampoline (0) or a clone of the whole
+// function (1): a relocated prologue and a jump back into the patched code
+// against a straight copy.
+VH_BENCHMARK_EX("Call/Original", 10'000'000, 0, 1)
+{
+  const SyntheticFunctions functions{1};
+  const bool clone = state.arg() != 0;
+  auto hook = InlineHook::Create(functions[0], destination(), {.clone = clone});
+  if (not hook or not hook->Enable()) { return; }
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(hook->Call<int>());
+  }
+  state.counters["cloned"] = hook->cloned() ? 1 : 0;
+}
+
+// The same for a function that dispatches through a jump table, which the
+// clone carries its own copy of.
+VH_BENCHMARK_EX("Call/OriginalSwitch", 10'000'000, 0, 1)
+{
+  const bool clone = state.arg() != 0;
+  auto hook = InlineHook::Create(VeilHook::detail::address_cast(&dispatch),
+                                 destination(),
+                                 {.follow_jumps = true, .clone = clone});
+  if (not hook or not hook->Enable()) { return; }
+  int x = 0;
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(hook->Call<int>(x));
+    x = (x + 1) & 7;
+  }
+  state.counters["cloned"] = hook->cloned() ? 1 : 0;
+}
+
+// Callers go through an import thunk; the hook sits on the thunk itself or,
+// with follow_jumps, on the body behind it.
+VH_BENCHMARK_EX("Call/ThunkHooked", 10'000'000, 0, 1)
+{
+  const SyntheticFunctions functions{1};
+  const auto thunk = make_thunk(functions[0]);
+  if (not thunk) { return; }
+  const bool follow = state.arg() != 0;
+  auto hook = InlineHook::Create(thunk->address(), destination(),
+                                 {.follow_jumps = follow});
+  if (not hook or not hook->Enable()) { return; }
+  volatile SyntheticFunctions::Function function =
+      thunk->data<SyntheticFunctions::Function>();
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(function()); }
+  state.counters["follow_jumps"] = follow ? 1 : 0;
+}
+
+VH_BENCHMARK_EX("Call/ThunkTrampoline", 10'000'000, 0, 1)
+{
+  const SyntheticFunctions functions{1};
+  const auto thunk = make_thunk(functions[0]);
+  if (not thunk) { return; }
+  const bool follow = state.arg() != 0;
+  auto hook = InlineHook::Create(thunk->address(), destination(),
+                                 {.follow_jumps = follow});
+  if (not hook or not hook->Enable()) { return; }
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(hook->Call<int>());
+  }
+  state.counters["follow_jumps"] = follow ? 1 : 0;
+}
+
+//==============================================================================
+// Scaling
+//==============================================================================
+VH_BENCHMARK_EX("InlineHook/CreateEnableMany", 1, 100, 1'000, 10'000)
+{
+  const auto count = static_cast<std::size_t>(state.arg());
+  const SyntheticFunctions functions{count};
+  std::vector<InlineHook> hooks;
+  hooks.reserve(count);
+  for (auto _ : state)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      if (auto hook = InlineHook::Create(functions[i], destination()))
+      {
+        (void)hook->Enable();
+        hooks.push_back(std::move(*hook));
+      }
+    }
+  }
+  report_per_hook(state, hooks.size());
+}
+
+// Every thread installs 1,000 hooks on its own page-aligned functions.
+VH_BENCHMARK_EX("InlineHook/ParallelInstall", 1, 1, 2, 4, 8)
+{
+  constexpr std::size_t kPerThread = 1'000;
+  const auto threads = static_cast<std::size_t>(state.arg());
+  std::vector<std::unique_ptr<SyntheticFunctions>> functions;
+  std::vector<std::vector<InlineHook>> hooks(threads);
+  for (std::size_t t = 0; t < threads; ++t)
+  {
+    functions.push_back(std::make_unique<SyntheticFunctions>(kPerThread));
+    hooks[t].reserve(kPerThread);
+  }
+
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t t)
+  {
+    for (std::size_t i = 0; i < kPerThread; ++i)
+    {
+      if (auto hook = InlineHook::Create((*functions[t])[i], destination()))
+      {
+        (void)hook->Enable();
+        hooks[t].push_back(std::move(*hook));
+      }
+    }
+  });
+
+  std::size_t installed = 0;
+  for (const auto& per_thread : hooks) { installed += per_thread.size(); }
+  report_per_hook(state, installed);
+  state.counters["threads"] = static_cast<double>(threads);
+}
+
+//==============================================================================
+// Startup: serial Create loop against CreateMany
+//==============================================================================
+namespace
+{
+constexpr std::size_t kStartupHooks = 30'000;
+
+auto startup_targets(const SyntheticFunctions& functions)
+    -> std::vector<VeilHook::HookTarget>
+{
+  std::vector<VeilHook::HookTarget> targets;
+  targets.reserve(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i)
+  {
+    targets.push_back({.target = functions[i], .destination = destination()});
+  }
+  return targets;
+}
+}  // namespace
+
+VH_BENCHMARK_EX("Startup/SerialCreate", 1, kStartupHooks)
+{
+  const SyntheticFunctions functions{static_cast<std::size_t>(state.arg())};
+  std::vector<InlineHook> hooks;
+  hooks.reserve(functions.size());
+  for (auto _ : state) { hooks = create_hooks(functions); }
+  report_per_hook(state, hooks.size());
+}
+
+VH_BENCHMARK_EX("Startup/CreateMany", 1, kStartupHooks)
+{
+  const SyntheticFunctions functions{static_cast<std::size_t>(state.arg())};
+  const auto targets = startup_targets(functions);
+  std::vector<std::expected<InlineHook, VeilHook::Error>> hooks;
+  for (auto _ : state) { hooks = InlineHook::CreateMany(targets); }
+  report_per_hook(state, static_cast<std::size_t>(std::ranges::count_if(
+                             hooks, [](const auto& hook)
+                             { return hook.has_value(); })));
+}
+
+VH_BENCHMARK_EX("Startup/CreateManyLazy", 1, kStartupHooks)
+{
+  const SyntheticFunctions functions{static_cast<std::size_t>(state.arg())};
+  const auto targets = startup_targets(functions);
+  std::vector<std::expected<InlineHook, VeilHook::Error>> hooks;
+  for (auto _ : state) { hooks = InlineHook::CreateMany(targets, {.lazy = true}); }
+  report_per_hook(state, static_cast<std::size_t>(std::ranges::count_if(
+                             hooks, [](const auto& hook)
+                             { return hook.has_value(); })));
+}
@@ -0,0 +1,98 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/length_decoder.hpp>
+#include <VeilHook/utility.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace
+{
+using VeilHook::Impl::decode_length;
+using VeilHook::Impl::decode_length_fast;
+using VeilHook::Impl::decode_length_full;
+
+// Start of every instruction Zydis finds in a linear sweep of ntdll and
+// kernelbase, so each decoder sees the same real instruction mix.
+auto instructions() -> const std::vector<std::span<const std::uint8_t>>&
+{
+  static const auto result = []
+  {
+    std::vector<std::span<const std::uint8_t>> starts;
+    for (const auto* module : {"ntdll.dll", "kernelbase.dll"})
+    {
+      const auto base = VeilHook::Impl::module_find(module);
+      if (not base) { continue; }
+      const auto sections = VeilHook::Impl::module_sections(*base);
+      if (not sections) { continue; }
+      for (const auto& section : *sections)
+      {
+        if (not section.executable) { continue; }
+        const std::span code{
+            VeilHook::detail::address_cast<const std::uint8_t*>(
+                section.address),
+            section.size};
+        for (std::size_t offset = 0; offset < code.size();)
+        {
+          const auto rest = code.subspan(offset);
+          const auto ix = decode_length_full(rest);
+          if (not ix)
+          {
+            ++offset;
+            continue;
+          }
+          starts.push_back(rest);
+          offset += ix->length;
+        }
+      }
+    }
+    return starts;
+  }();
+  return result;
+}
+
+template <typename Decode>
+void run(VeilHook::Bench::State& state, Decode decode)
+{
+  const auto& all = instructions();
+  for (auto _ : state)
+  {
+    for (const auto code : all)
+    {
+      VeilHook::Bench::do_not_optimize(decode(code));
+    }
+  }
+  const auto seconds =
+      std::chrono::duration<double>(state.elapsed()).count();
+  const auto decoded = static_cast<double>(all.size() * state.iterations());
+  state.counters["instructions"] = static_cast<double>(all.size());
+  state.counters["instructions_per_sec"] = decoded / seconds;
+}
+}  // namespace
+
+VH_BENCHMARK_EX("LengthDecoder/Zydis", 5)
+{
+  run(state, [](auto code) { return decode_length_full(code); });
+}
+
+// Table path alone; declined instructions cost only the prefix scan.
+VH_BENCHMARK_EX("LengthDecoder/Fast", 5)
+{
+  std::size_t declined = 0;
+  run(state, [&](auto code)
+  {
+    const auto result = decode_length_fast(code);
+    declined += result ? 0 : 1;
+    return result;
+  });
+  state.counters["fast_ratio"] =
+      1.0 - (static_cast<double>(declined) /
+             static_cast<double>(instructions().size() * state.iterations()));
+}
+
+// What plan_hook uses.
+VH_BENCHMARK_EX("LengthDecoder/Combined", 5)
+{
+  run(state, [](auto code) { return decode_length(code); });
+}
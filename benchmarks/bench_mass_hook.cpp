@@ -0,0 +1,106 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+#include "synthetic.hpp"
+
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/mass_hook.hpp>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace
+{
+using VeilHook::MassHook;
+using VeilHook::Bench::SyntheticFunctions;
+
+std::atomic<std::uint64_t> g_entered{0};
+
+void on_enter(std::uint32_t /*id*/, MassHook::Registers& /*regs*/)
+{
+  g_entered.fetch_add(1, std::memory_order_relaxed);
+}
+
+VH_NOINLINE auto detour() -> int { return -1; }
+
+auto addresses(const SyntheticFunctions& functions)
+    -> std::vector<std::uintptr_t>
+{
+  std::vector<std::uintptr_t> result(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i)
+  {
+    result[i] = functions[i];
+  }
+  return result;
+}
+
+void report(VeilHook::Bench::State& state, const VeilHook::HookMemory& memory)
+{
+  const auto hooks = static_cast<double>(memory.hooks);
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["hooks"] = hooks;
+  state.counters["install_ms"] = ns / 1e6;
+  state.counters["ns_per_hook"] = ns / hooks;
+  state.counters["bytes_per_hook"] = memory.per_hook();
+  state.counters["code_bytes_per_hook"] =
+      static_cast<double>(memory.trampolines) / hooks;
+}
+}  // namespace
+
+//==============================================================================
+// Install time and footprint: Create plus Enable of every target
+//==============================================================================
+VH_BENCHMARK_EX("MassHook/Install", 1, 5'000, 50'000)
+{
+  const SyntheticFunctions functions{static_cast<std::size_t>(state.arg())};
+  const auto targets = addresses(functions);
+  std::unique_ptr<MassHook> hook;
+  for (auto _ : state)
+  {
+    if (auto created = MassHook::Create(targets, &on_enter))
+    {
+      hook = std::move(*created);
+      (void)hook->Enable();
+    }
+  }
+  if (hook) { report(state, hook->memory()); }
+}
+
+// The same targets with an E9 trampoline and a detour each.
+VH_BENCHMARK_EX("MassHook/InstallRegistry", 1, 5'000, 50'000)
+{
+  const SyntheticFunctions functions{static_cast<std::size_t>(state.arg())};
+  std::vector<VeilHook::HookTarget> targets(functions.size());
+  for (std::size_t i = 0; i < functions.size(); ++i)
+  {
+    targets[i] = {.target = functions[i],
+                  .destination = VeilHook::detail::address_cast(&detour)};
+  }
+  VeilHook::HookRegistry registry{functions.size()};
+  for (auto _ : state)
+  {
+    for (const auto& handle : registry.AddMany(targets))
+    {
+      if (handle) { (void)registry.Enable(*handle); }
+    }
+  }
+  report(state, registry.memory());
+}
+
+//==============================================================================
+// Per-call cost through stub, dispatcher and relocated prologue
+//==============================================================================
+VH_BENCHMARK_EX("MassHook/Call", 1'000'000)
+{
+  const SyntheticFunctions functions{64};
+  const auto targets = addresses(functions);
+  auto hook = MassHook::Create(targets, &on_enter);
+  if (not hook || not (*hook)->Enable()) { return; }
+  int sum = 0;
+  std::size_t i = 0;
+  for (auto _ : state) { sum += functions.function(i++ % 64)(); }
+  VeilHook::Bench::do_not_optimize(sum);
+  state.counters["ns_per_call"] =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count() /
+      static_cast<double>(state.iterations());
+}
@@ -0,0 +1,80 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/memoize_hook.hpp>
+#include <cstdint>
+
+// Hit-path cost of MemoizeHook against running the function, on 1 to 32
+// threads calling with a working set of kKeys arguments that all fit the
+// cache.
+namespace
+{
+constexpr std::uint32_t kKeys = 1024;
+
+// A pure function worth caching: a few hundred cycles of dependent mixing.
+VH_NOINLINE auto work(std::uint32_t x) -> std::uint32_t
+{
+  for (int i = 0; i < 64; ++i) { x = (x ^ (x >> 15)) * 0x2C1B3C6DU; }
+  return x;
+}
+
+auto work_key(const std::uint32_t& x) -> std::uint64_t { return x; }
+
+using WorkHook = VeilHook::MemoizeHook<std::uint32_t(std::uint32_t)>;
+
+auto call_loop(std::size_t iterations, std::uint32_t seed) -> std::uint32_t
+{
+  std::uint32_t sum = 0;
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    sum += work((seed + static_cast<std::uint32_t>(i)) % kKeys);
+  }
+  return sum;
+}
+
+void report_rate(VeilHook::Bench::State& state, std::size_t threads)
+{
+  const auto calls = static_cast<double>(state.iterations() * threads);
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["threads"] = static_cast<double>(threads);
+  state.counters["ns_per_call"] =
+      ns / static_cast<double>(state.iterations());
+  state.counters["calls_per_sec"] = calls * 1e9 / ns;
+}
+
+void run(VeilHook::Bench::State& state)
+{
+  const auto threads = static_cast<std::size_t>(state.arg());
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t t)
+  {
+    VeilHook::Bench::do_not_optimize(
+        call_loop(state.iterations(), static_cast<std::uint32_t>(t * 97)));
+  });
+  report_rate(state, threads);
+}
+}  // namespace
+
+//==============================================================================
+// Unhooked: every call runs the function
+//==============================================================================
+VH_BENCHMARK_EX("Memoize/Direct", 0, 1, 2, 4, 8, 16, 32)
+{
+  run(state);
+}
+
+//==============================================================================
+// Hooked, every call a hit after one warm-up pass over the keys
+//==============================================================================
+VH_BENCHMARK_EX("Memoize/Hit", 0, 1, 2, 4, 8, 16, 32)
+{
+  auto memoize = WorkHook::Create(VeilHook::detail::address_cast(&work),
+                                  &work_key, {.capacity = 4 * kKeys});
+  if (not memoize or not (*memoize)->Enable()) { return; }
+  VeilHook::Bench::do_not_optimize(call_loop(kKeys, 0));
+  run(state);
+  const auto stats = (*memoize)->stats();
+  state.counters["hit_rate"] =
+      static_cast<double>(stats.hits) /
+      static_cast<double>(stats.hits + stats.misses);
+}
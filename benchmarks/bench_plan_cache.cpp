@@ -0,0 +1,129 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/plan_cache.hpp>
+#include <array>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using VeilHook::InlineHook;
+using VeilHook::PlanCache;
+
+// Plans are keyed by module, so unlike SyntheticFunctions these have to live
+// in the benchmark image itself: 20,000 distinct `mov eax, N; ret` bodies.
+constexpr std::size_t kChunk = 5'000;
+constexpr std::size_t kChunks = 4;
+constexpr std::size_t kHooks = kChunk * kChunks;
+
+template <std::size_t N>
+VH_NOINLINE auto image_function() -> int
+{
+  return static_cast<int>(N);
+}
+
+template <std::size_t Base, std::size_t... I>
+auto chunk(std::index_sequence<I...> /*indices*/)
+    -> std::array<std::uintptr_t, sizeof...(I)>
+{
+  return {VeilHook::detail::address_cast(&image_function<Base + I>)...};
+}
+
+auto image_functions() -> const std::vector<std::uintptr_t>&
+{
+  static const auto functions = []
+  {
+    std::vector<std::uintptr_t> result;
+    result.reserve(kHooks);
+    const auto append = [&](const auto& addresses)
+    {
+      result.insert(result.end(), addresses.begin(), addresses.end());
+    };
+    append(chunk<0 * kChunk>(std::make_index_sequence<kChunk>{}));
+    append(chunk<1 * kChunk>(std::make_index_sequence<kChunk>{}));
+    append(chunk<2 * kChunk>(std::make_index_sequence<kChunk>{}));
+    append(chunk<3 * kChunk>(std::make_index_sequence<kChunk>{}));
+    return result;
+  }();
+  return functions;
+}
+
+VH_NOINLINE auto detour() -> int { return -1; }
+
+auto cache_path() -> std::filesystem::path
+{
+  return std::filesystem::temp_directory_path() / "veilhook_bench.plans";
+}
+
+auto create_hooks(PlanCache* cache) -> std::vector<InlineHook>
+{
+  const auto destination = VeilHook::detail::address_cast(&detour);
+  std::vector<InlineHook> hooks;
+  hooks.reserve(kHooks);
+  for (const auto target : image_functions())
+  {
+    if (auto hook = InlineHook::Create(target, destination, {.cache = cache}))
+    {
+      hooks.push_back(std::move(*hook));
+    }
+  }
+  return hooks;
+}
+
+void report(VeilHook::Bench::State& state, std::size_t hooks,
+            std::size_t cached)
+{
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["hooks"] = static_cast<double>(hooks);
+  state.counters["cached_plans"] = static_cast<double>(cached);
+  state.counters["ns_per_hook"] = ns / static_cast<double>(hooks);
+}
+}  // namespace
+
+// Baseline: every prologue decoded, nothing persisted.
+VH_BENCHMARK_EX("PlanCache/Uncached", 1)
+{
+  std::vector<InlineHook> hooks;
+  for (auto _ : state) { hooks = create_hooks(nullptr); }
+  report(state, hooks.size(), 0);
+}
+
+// First run: empty cache, every plan decoded, recorded and saved.
+VH_BENCHMARK_EX("PlanCache/ColdStart", 1)
+{
+  std::filesystem::remove(cache_path());
+  std::vector<InlineHook> hooks;
+  std::size_t cached = 0;
+  for (auto _ : state)
+  {
+    PlanCache cache{cache_path()};
+    hooks = create_hooks(&cache);
+    (void)cache.Save();
+    cached = cache.size();
+  }
+  report(state, hooks.size(), cached);
+}
+
+// Restart: the file is mapped and every plan is validated against live bytes
+// instead of decoded.
+VH_BENCHMARK_EX("PlanCache/WarmStart", 1)
+{
+  {
+    PlanCache cache{cache_path()};
+    (void)create_hooks(&cache);
+    (void)cache.Save();
+  }
+  std::vector<InlineHook> hooks;
+  std::size_t cached = 0;
+  for (auto _ : state)
+  {
+    PlanCache cache{cache_path()};
+    hooks = create_hooks(&cache);
+    cached = cache.size();
+  }
+  report(state, hooks.size(), cached);
+}
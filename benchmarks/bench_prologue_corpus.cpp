@@ -0,0 +1,157 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/hook_plan.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/trace.hpp>
+#include <VeilHook/utility.hpp>
+#include <Psapi.h>
+#include <algorithm>
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <vector>
+
+// Prologue coverage on real code: InlineHook::Create, never enabled, on every
+// exported function of the C and C++ runtimes and the core system DLLs. Per
+// module it counts the hooks that got each patch, why the FF ones could not
+// get an E9 and why the rest failed, along with functions created per second
+// and the memory the hooks hold. Compare the --json output of two builds to
+// judge a relocation or allocator change.
+namespace
+{
+using VeilHook::detail::address_cast;
+
+VH_NOINLINE void detour() {}
+
+// Export addresses inside an executable section, aliases once: data exports
+// are skipped, as are forwarders, which are counted in the module they lead
+// to. Loads the module if the process has not.
+auto exported_functions(const char* module) -> std::vector<std::uintptr_t>
+{
+  std::vector<std::uintptr_t> functions;
+  if (not VeilHook::Impl::module_find(module)) { LoadLibraryA(module); }
+  const auto base = VeilHook::Impl::module_find(module);
+  if (not base) { return functions; }
+  const auto sections = VeilHook::Impl::module_sections(*base);
+  const auto exports = VeilHook::Impl::module_exports(*base);
+  if (not sections || not exports) { return functions; }
+  for (const auto& symbol : *exports)
+  {
+    const auto code = std::ranges::any_of(*sections, [&](const auto& section)
+    {
+      return section.executable && symbol.address >= section.address &&
+             symbol.address < section.address + section.size;
+    });
+    if (code) { functions.push_back(symbol.address); }
+  }
+  std::ranges::sort(functions);
+  const auto [first, last] = std::ranges::unique(functions);
+  functions.erase(first, last);
+  return functions;
+}
+
+struct Memory
+{
+  double commit_mb;
+  double peak_working_set_mb;
+};
+
+auto memory() -> Memory
+{
+  constexpr double kMb = 1024.0 * 1024.0;
+  PROCESS_MEMORY_COUNTERS counters{};
+  counters.cb = sizeof(counters);
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return {.commit_mb = static_cast<double>(counters.PagefileUsage) / kMb,
+          .peak_working_set_mb =
+              static_cast<double>(counters.PeakWorkingSetSize) / kMb};
+}
+
+// Arg 0 creates plain hooks, 1 adds HookOptions::clone.
+void run(VeilHook::Bench::State& state, const char* module)
+{
+  const auto functions = exported_functions(module);
+  state.counters["functions"] = static_cast<double>(functions.size());
+  if (functions.empty()) { return; }
+
+  const VeilHook::HookOptions options{.clone = state.arg() != 0};
+  std::vector<std::expected<VeilHook::InlineHook, VeilHook::Error>> hooks;
+  hooks.reserve(functions.size());
+  const auto before = memory();
+  for (auto _ : state)
+  {
+    for (const auto function : functions)
+    {
+      hooks.push_back(VeilHook::InlineHook::Create(
+          function, address_cast(&detour), options));
+    }
+  }
+  const auto after = memory();
+
+  // Counts first, so every module reports the same keys.
+  for (const auto* key : {"e9", "ff", "failed", "cloned"})
+  {
+    state.counters[key] = 0;
+  }
+  for (const auto& hook : hooks)
+  {
+    if (not hook)
+    {
+      ++state.counters["failed"];
+      ++state.counters[std::string{"error."} +
+                       VeilHook::to_string(hook.error())];
+      continue;
+    }
+    if (hook->cloned()) { ++state.counters["cloned"]; }
+    if (hook->type() == VeilHook::Impl::HookType::E9)
+    {
+      ++state.counters["e9"];
+      continue;
+    }
+    ++state.counters["ff"];
+    // If the E9 plan works, the fallback was for want of memory in reach.
+    const auto e9 = VeilHook::Impl::plan_hook(hook->target(),
+                                              VeilHook::Impl::HookType::E9);
+    ++state.counters[std::string{"fallback."} +
+                     VeilHook::to_string(e9 ? VeilHook::Error::BadAllocation
+                                            : e9.error())];
+  }
+
+  const auto count = static_cast<double>(hooks.size());
+  state.counters["e9_rate"] = state.counters["e9"] / count;
+  state.counters["ff_rate"] = state.counters["ff"] / count;
+  state.counters["failure_rate"] = state.counters["failed"] / count;
+  state.counters["functions_per_sec"] =
+      count / std::chrono::duration<double>(state.elapsed()).count();
+  state.counters["commit_mb"] = after.commit_mb - before.commit_mb;
+  // The process's peak so far, earlier runs in this executable included.
+  state.counters["peak_working_set_mb"] = after.peak_working_set_mb;
+}
+}  // namespace
+
+// Each run creates one hook per function, so iterations stay at 1.
+
+// The C runtime, math library included.
+VH_BENCHMARK_EX("Corpus/ucrtbase.dll", 1, 0, 1)
+{
+  run(state, "ucrtbase.dll");
+}
+
+// The C++ standard library; skipped where the redistributable is missing.
+VH_BENCHMARK_EX("Corpus/msvcp140.dll", 1, 0, 1)
+{
+  run(state, "msvcp140.dll");
+}
+
+// Win32 API bodies.
+VH_BENCHMARK_EX("Corpus/kernelbase.dll", 1, 0, 1)
+{
+  run(state, "kernelbase.dll");
+}
+
+// Native API: syscall stubs and the loader, heap and runtime library.
+VH_BENCHMARK_EX("Corpus/ntdll.dll", 1, 0, 1)
+{
+  run(state, "ntdll.dll");
+}
@@ -0,0 +1,101 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/remote_process.hpp>
+#include <VeilHook/symbol_index.hpp>
+#include <VeilHook/utility.hpp>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Installing a batch of hooks into a child that is stopped at creation, the
+// way a launcher instruments a process before it runs. Targets are ntdll
+// exports, mapped at the same address in the child.
+namespace
+{
+class Child final
+{
+ public:
+  Child()
+  {
+    std::array<WCHAR, MAX_PATH> path{};
+    GetModuleFileNameW(nullptr, path.data(), MAX_PATH);
+    STARTUPINFOW startup{};
+    startup.cb = sizeof(startup);
+    if (CreateProcessW(path.data(), nullptr, nullptr, nullptr, FALSE,
+                       CREATE_SUSPENDED, nullptr, nullptr, &startup,
+                       &info_) == FALSE)
+    {
+      info_ = {};
+    }
+  }
+  ~Child()
+  {
+    if (info_.hProcess == nullptr) { return; }
+    TerminateProcess(info_.hProcess, 0);
+    CloseHandle(info_.hThread);
+    CloseHandle(info_.hProcess);
+  }
+  Child(const Child&) = delete;
+  auto operator=(const Child&) -> Child& = delete;
+
+  [[nodiscard]] auto pid() const -> std::uint32_t
+  {
+    return info_.dwProcessId;
+  }
+
+ private:
+  PROCESS_INFORMATION info_{};
+};
+
+// Distinct ntdll functions, Nt stubs first, then the Rtl library.
+auto targets(std::size_t count) -> std::vector<VeilHook::HookTarget>
+{
+  VeilHook::SymbolIndex index;
+  (void)index.AddModule("ntdll.dll");
+  std::vector<std::uintptr_t> addresses;
+  for (const auto* prefix : {"Nt", "Rtl"})
+  {
+    for (const auto& symbol : index.FindPrefix("ntdll", prefix))
+    {
+      addresses.push_back(symbol.address);
+    }
+  }
+  std::ranges::sort(addresses);
+  const auto [first, last] = std::ranges::unique(addresses);
+  addresses.erase(first, last);
+  addresses.resize(std::min(addresses.size(), count));
+
+  const auto destination = VeilHook::detail::address_cast(
+      GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtYieldExecution"));
+  std::vector<VeilHook::HookTarget> result;
+  for (const auto address : addresses)
+  {
+    result.push_back({.target = address, .destination = destination});
+  }
+  return result;
+}
+}  // namespace
+
+//==============================================================================
+// Install time: snapshot, plan, trampolines, thread fix-up and patches
+//==============================================================================
+VH_BENCHMARK_EX("RemoteProcess/Install", 1, 100, 1'000)
+{
+  const auto batch = targets(static_cast<std::size_t>(state.arg()));
+  const Child child;
+  auto process = VeilHook::RemoteProcess::Open(child.pid());
+  if (not process) { return; }
+  std::size_t installed = 0;
+  for (auto _ : state)
+  {
+    const auto hooks = (*process)->Install(batch);
+    installed = static_cast<std::size_t>(std::ranges::count_if(
+        hooks, [](const auto& hook) { return hook.has_value(); }));
+  }
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["hooks"] = static_cast<double>(installed);
+  state.counters["install_ms"] = ns / 1e6;
+  state.counters["ns_per_hook"] = ns / static_cast<double>(installed);
+}
@@ -0,0 +1,160 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/scanner.hpp>
+#include <VeilHook/utility.hpp>
+#include <array>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+using VeilHook::Scanner;
+
+constexpr std::size_t kBlobSize = 500 * 1024 * 1024;
+
+// Signatures that never match random data, so every byte is scanned.
+auto patterns(std::size_t count) -> std::vector<VeilHook::Pattern>
+{
+  constexpr std::array<const char*, 8> kSignatures{
+      "48 89 5C 24 ?? 57 48 83 EC ?? 13 37",
+      "E8 ?? ?? ?? ?? 84 C0 74 ?? 13 37",
+      "40 53 48 83 EC 20 8B D9 13 37",
+      "FF 15 ?? ?? ?? ?? 85 C0 0F 88 13 37",
+      "4C 8B DC 49 89 5B ?? 13 37",
+      "0F B6 ?? ?? 3C ?? 75 ?? 13 37",
+      "48 8D 0D ?? ?? ?? ?? E9 ?? ?? 13 37",
+      "33 C0 C3 CC CC CC 13 37"};
+  std::vector<VeilHook::Pattern> result;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    result.push_back(
+        *VeilHook::Pattern::Parse(kSignatures[i % kSignatures.size()]));
+  }
+  return result;
+}
+
+auto blob() -> std::span<const std::uint8_t>
+{
+  static const auto memory = []
+  {
+    std::vector<std::uint8_t> bytes(kBlobSize);
+    std::minstd_rand rng{1};
+    for (auto& byte : bytes) { byte = static_cast<std::uint8_t>(rng()); }
+    return bytes;
+  }();
+  return memory;
+}
+
+auto crt_text() -> std::vector<std::span<const std::uint8_t>>
+{
+  std::vector<std::span<const std::uint8_t>> text;
+  const auto base = VeilHook::Impl::module_find("ucrtbase.dll");
+  if (not base) { return text; }
+  const auto sections = VeilHook::Impl::module_sections(*base);
+  if (not sections) { return text; }
+  for (const auto& section : *sections)
+  {
+    if (section.executable)
+    {
+      text.push_back({VeilHook::detail::address_cast<const std::uint8_t*>(
+                          section.address),
+                      section.size});
+    }
+  }
+  return text;
+}
+
+void report(VeilHook::Bench::State& state, std::size_t bytes,
+            const Scanner& scanner)
+{
+  const auto seconds = std::chrono::duration<double>(state.elapsed()).count();
+  state.counters["bytes"] = static_cast<double>(bytes);
+  state.counters["patterns"] = static_cast<double>(scanner.patterns().size());
+  state.counters["kernel"] = static_cast<double>(scanner.kernel());
+  state.counters["gb_per_sec"] =
+      static_cast<double>(bytes * state.iterations()) / seconds / 1e9;
+}
+
+auto make_scanner(std::int64_t kernel, std::size_t count, std::size_t threads)
+    -> Scanner
+{
+  Scanner scanner{patterns(count)};
+  scanner.set_kernel(static_cast<Scanner::Kernel>(kernel));
+  scanner.set_concurrency(threads);
+  return scanner;
+}
+}  // namespace
+
+// Argument: Scanner::Kernel (0 scalar, 1 SSE2, 2 AVX2), single thread.
+VH_BENCHMARK_EX("Scanner/Blob500MB/OneThread", 1, 0, 1, 2)
+{
+  const auto memory = blob();
+  const auto scanner = make_scanner(state.arg(), 1, 1);
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(scanner.Scan(memory));
+  }
+  report(state, memory.size(), scanner);
+}
+
+VH_BENCHMARK_EX("Scanner/Blob500MB/AllThreads", 1, 0, 1, 2)
+{
+  const auto memory = blob();
+  const auto scanner = make_scanner(state.arg(), 1, 0);
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(scanner.Scan(memory));
+  }
+  report(state, memory.size(), scanner);
+}
+
+// Eight patterns in one pass against eight separate passes.
+VH_BENCHMARK_EX("Scanner/Blob500MB/EightPatterns", 1, 2)
+{
+  const auto memory = blob();
+  const auto scanner = make_scanner(state.arg(), 8, 0);
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(scanner.Scan(memory));
+  }
+  report(state, memory.size(), scanner);
+}
+
+VH_BENCHMARK_EX("Scanner/Blob500MB/EightPasses", 1, 2)
+{
+  const auto memory = blob();
+  std::vector<Scanner> scanners;
+  for (const auto& pattern : patterns(8))
+  {
+    scanners.emplace_back(std::vector{pattern});
+    scanners.back().set_kernel(static_cast<Scanner::Kernel>(state.arg()));
+  }
+  for (auto _ : state)
+  {
+    for (const auto& scanner : scanners)
+    {
+      VeilHook::Bench::do_not_optimize(scanner.Scan(memory));
+    }
+  }
+  report(state, memory.size(), scanners.front());
+}
+
+// The C runtime's code, resident in every process.
+VH_BENCHMARK_EX("Scanner/UcrtbaseText", 200, 0, 1, 2)
+{
+  const auto text = crt_text();
+  if (text.empty()) { return; }
+  std::size_t bytes = 0;
+  for (const auto& section : text) { bytes += section.size(); }
+  const auto scanner = make_scanner(state.arg(), 8, 1);
+  for (auto _ : state)
+  {
+    for (const auto& section : text)
+    {
+      VeilHook::Bench::do_not_optimize(scanner.Scan(section));
+    }
+  }
+  report(state, bytes, scanner);
+}
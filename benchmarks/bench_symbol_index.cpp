@@ -0,0 +1,117 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/symbol_index.hpp>
+#include <VeilHook/utility.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+using VeilHook::SymbolIndex;
+
+// A realistic spread of exports on top of what the benchmark links.
+void load_modules()
+{
+  for (const auto* name : {"user32.dll", "gdi32.dll", "advapi32.dll",
+                           "ole32.dll", "combase.dll", "shell32.dll"})
+  {
+    LoadLibraryA(name);
+  }
+}
+
+struct Query
+{
+  std::string module;
+  std::string name;
+};
+
+// Every export of a few large modules, shuffled so lookups do not walk the
+// index in order.
+auto queries() -> const std::vector<Query>&
+{
+  static const auto result = []
+  {
+    load_modules();
+    std::vector<Query> all;
+    for (const auto* module : {"kernel32.dll", "ntdll.dll", "user32.dll"})
+    {
+      for (const auto& symbol : SymbolIndex::Get().FindPrefix(module, ""))
+      {
+        all.push_back({std::string{symbol.module}, std::string{symbol.name}});
+      }
+    }
+    std::ranges::shuffle(all, std::minstd_rand{1});
+    return all;
+  }();
+  return result;
+}
+
+void report_lookups(VeilHook::Bench::State& state, std::size_t lookups)
+{
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["lookups"] = static_cast<double>(lookups);
+  state.counters["ns_per_lookup"] = ns / static_cast<double>(lookups);
+}
+}  // namespace
+
+VH_BENCHMARK_EX("SymbolIndex/Build", 10)
+{
+  load_modules();
+  std::size_t symbols = 0;
+  for (auto _ : state)
+  {
+    SymbolIndex index;
+    index.AddLoadedModules();
+    symbols = index.size();
+  }
+  state.counters["modules"] =
+      static_cast<double>(VeilHook::Impl::module_list().size());
+  state.counters["symbols"] = static_cast<double>(symbols);
+}
+
+VH_BENCHMARK_EX("SymbolIndex/Find", 10)
+{
+  const auto& all = queries();
+  const auto& index = SymbolIndex::Get();
+  for (auto _ : state)
+  {
+    for (const auto& query : all)
+    {
+      VeilHook::Bench::do_not_optimize(index.Find(query.module, query.name));
+    }
+  }
+  report_lookups(state, all.size() * state.iterations());
+}
+
+VH_BENCHMARK_EX("SymbolIndex/FindAnyModule", 10)
+{
+  const auto& all = queries();
+  const auto& index = SymbolIndex::Get();
+  for (auto _ : state)
+  {
+    for (const auto& query : all)
+    {
+      VeilHook::Bench::do_not_optimize(index.Find("", query.name));
+    }
+  }
+  report_lookups(state, all.size() * state.iterations());
+}
+
+// The loader's own lookup, the dlsym equivalent.
+VH_BENCHMARK_EX("SymbolIndex/GetProcAddress", 10)
+{
+  const auto& all = queries();
+  for (auto _ : state)
+  {
+    for (const auto& query : all)
+    {
+      VeilHook::Bench::do_not_optimize(GetProcAddress(
+          GetModuleHandleA(query.module.c_str()), query.name.c_str()));
+    }
+  }
+  report_lookups(state, all.size() * state.iterations());
+}
@@ -0,0 +1,191 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/syscall_hook.hpp>
+#include <VeilHook/utility.hpp>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+
+// System call throughput unhooked, through SyscallHook with pass-through
+// slots, through SyscallHook with an auditing handler, and through an
+// int3 trap resolved by the VEH before resuming at the stub; the last is
+// the in-process analogue of a seccomp trap.
+namespace
+{
+enum Mode : std::int64_t
+{
+  kUnhooked,
+  kPassThrough,
+  kHandler,
+  kTrap,
+};
+
+struct IoStatusBlock
+{
+  LONG_PTR status;
+  ULONG_PTR information;
+};
+
+using NtGetCurrentProcessorNumber_t = ULONG(VH_STDCALL*)();
+using NtReadFile_t = LONG(VH_STDCALL*)(HANDLE, HANDLE, void*, void*,
+                                       IoStatusBlock*, void*, ULONG,
+                                       LARGE_INTEGER*, ULONG*);
+
+VeilHook::SyscallHook* g_hook = nullptr;
+std::uint32_t g_number = 0;
+std::atomic<std::size_t> g_audited{0};
+
+auto VH_STDCALL audit_processor_number() -> ULONG
+{
+  g_audited.fetch_add(1, std::memory_order_relaxed);
+  return g_hook->Call<ULONG>(g_number);
+}
+
+auto VH_STDCALL audit_read(HANDLE file, HANDLE event, void* routine,
+                           void* context, IoStatusBlock* status, void* buffer,
+                           ULONG length, LARGE_INTEGER* offset, ULONG* key)
+    -> LONG
+{
+  g_audited.fetch_add(1, std::memory_order_relaxed);
+  return g_hook->Call<LONG>(g_number, file, event, routine, context, status,
+                            buffer, length, offset, key);
+}
+
+auto ntdll_export(const char* name) -> std::uintptr_t
+{
+  return VeilHook::detail::address_cast(
+      GetProcAddress(GetModuleHandleA("ntdll.dll"), name));
+}
+
+auto set_ip(CONTEXT& context, std::uintptr_t ip)
+{
+#if defined(VH_ARCH_X86_64)
+  context.Rip = ip;
+#else
+  context.Eip = static_cast<DWORD>(ip);
+#endif
+}
+
+// Sets up one mode for the duration of a benchmark run and yields the
+// address to call.
+class Route final
+{
+ public:
+  Route(Mode mode, const char* name, std::uintptr_t handler)
+      : stub_(ntdll_export(name)), entry_(stub_)
+  {
+    if (mode == kPassThrough || mode == kHandler)
+    {
+      auto hook = VeilHook::SyscallHook::Create();
+      if (not hook) { return; }
+      hook_ = std::move(*hook);
+      g_hook = hook_.get();
+      g_number = hook_->Number(name).value_or(0);
+      if (mode == kHandler) { (void)hook_->SetHandler(g_number, handler); }
+    }
+    else if (mode == kTrap)
+    {
+      auto trap = VeilHook::Allocator::Get()->Allocate(16);
+      if (not trap) { return; }
+      trap_ = std::make_unique<VeilHook::Allocation>(std::move(*trap));
+      VeilHook::detail::store<std::uint8_t>(trap_->address(), 0xCC);
+      (void)VeilHook::Impl::VehManager::instance().Register(
+          trap_->address(),
+          [](PEXCEPTION_POINTERS info,
+             const VeilHook::Impl::VehEntry& entry) -> LONG
+          {
+            g_audited.fetch_add(1, std::memory_order_relaxed);
+            set_ip(*info->ContextRecord, entry.context);
+            return EXCEPTION_CONTINUE_EXECUTION;
+          },
+          stub_);
+      entry_ = trap_->address();
+    }
+  }
+  ~Route()
+  {
+    if (trap_)
+    {
+      VeilHook::Impl::VehManager::instance().Unregister(trap_->address());
+    }
+    hook_.reset();
+    g_hook = nullptr;
+  }
+  Route(const Route&) = delete;
+  auto operator=(const Route&) -> Route& = delete;
+
+  template <typename T>
+  [[nodiscard]] auto entry() const -> T
+  {
+    return VeilHook::detail::address_cast<T>(entry_);
+  }
+
+ private:
+  std::uintptr_t stub_;
+  std::uintptr_t entry_;
+  std::unique_ptr<VeilHook::SyscallHook> hook_;
+  std::unique_ptr<VeilHook::Allocation> trap_;
+};
+
+auto read_file() -> HANDLE
+{
+  static const auto file = []
+  {
+    const auto path =
+        std::filesystem::temp_directory_path() / "veilhook_bench_read.bin";
+    auto* handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                               FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    std::array<char, 4096> page{};
+    DWORD written{};
+    WriteFile(handle, page.data(), static_cast<DWORD>(page.size()), &written,
+              nullptr);
+    return handle;
+  }();
+  return file;
+}
+
+void report_rate(VeilHook::Bench::State& state)
+{
+  const auto seconds =
+      std::chrono::duration<double>(state.elapsed()).count();
+  state.counters["calls_per_sec"] =
+      static_cast<double>(state.iterations()) / seconds;
+  state.counters["audited"] = static_cast<double>(g_audited.exchange(0));
+}
+}  // namespace
+
+// getpid() analogue: a system call that does next to no kernel work.
+VH_BENCHMARK_EX("SyscallHook/NtGetCurrentProcessorNumber", 0, kUnhooked,
+                kPassThrough, kHandler, kTrap)
+{
+  const Route route{static_cast<Mode>(state.arg()),
+                    "NtGetCurrentProcessorNumber",
+                    VeilHook::detail::address_cast(&audit_processor_number)};
+  auto* call = route.entry<NtGetCurrentProcessorNumber_t>();
+  for (auto _ : state) { VeilHook::Bench::do_not_optimize(call()); }
+  report_rate(state);
+}
+
+// read() analogue: 64 bytes at offset 0 of a cached file.
+VH_BENCHMARK_EX("SyscallHook/NtReadFile", 0, kUnhooked, kPassThrough,
+                kHandler, kTrap)
+{
+  auto* file = read_file();
+  const Route route{static_cast<Mode>(state.arg()), "NtReadFile",
+                    VeilHook::detail::address_cast(&audit_read)};
+  auto* call = route.entry<NtReadFile_t>();
+  std::array<char, 64> buffer{};
+  IoStatusBlock status{};
+  LARGE_INTEGER offset{};
+  for (auto _ : state)
+  {
+    VeilHook::Bench::do_not_optimize(
+        call(file, nullptr, nullptr, nullptr, &status, buffer.data(),
+             static_cast<ULONG>(buffer.size()), &offset, nullptr));
+  }
+  report_rate(state);
+}
@@ -0,0 +1,126 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/hook_plan.hpp>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <optional>
+#include <thread>
+
+namespace
+{
+using VeilHook::detail::address_cast;
+
+VH_NOINLINE auto original(int x) -> int { return (x * 3) + 1; }
+VH_NOINLINE auto detour(int x) -> int { return x - 1; }
+
+// A trampoline for `original` that nothing patches; callers enter it where
+// the patch would send them.
+struct Trampoline
+{
+  VeilHook::Allocation code;
+  std::uintptr_t entry;
+  std::uintptr_t literal;
+};
+
+auto make_trampoline() -> std::optional<Trampoline>
+{
+  using namespace VeilHook::Impl;
+  const auto target = address_cast<std::uintptr_t>(&original);
+  const auto destination = address_cast<std::uintptr_t>(&detour);
+  auto plan = plan_hook(target, HookType::E9);
+  if (not plan) { return std::nullopt; }
+  auto code = VeilHook::Allocator::Get()->Allocate(plan->reach(),
+                                                   plan->trampoline_size);
+  if (not code) { return std::nullopt; }
+  std::array<std::uint8_t, HookPlan::kMaxPrologue> patch{};
+  if (not emit_trampoline(*plan, {code->data<std::uint8_t*>(), code->size()},
+                          code->address(), destination) ||
+      not emit_patch(*plan, patch, code->address(), destination))
+  {
+    return std::nullopt;
+  }
+  std::int32_t rel = 0;
+  std::memcpy(&rel, patch.data() + 1, sizeof(rel));
+  const auto entry = target + 5 + static_cast<std::uintptr_t>(rel);
+  const auto literal = destination_literal(*plan, code->address());
+  return Trampoline{std::move(*code), entry, literal};
+}
+
+enum class Store : std::uint8_t
+{
+  None,
+  Literal,   // the destination literal, on its own cache line
+  CodeLine,  // int3 padding on the entry's line, where the literal used to be
+};
+
+// Calls through the trampoline on `state.arg()` threads while another thread
+// stores the same value over and over. QueryThreadCycleTime charges each
+// caller the cycles it spent, machine clears included.
+void run(VeilHook::Bench::State& state, Store store)
+{
+  static auto trampoline = make_trampoline();
+  if (not trampoline || trampoline->literal == 0) { return; }
+  const auto threads = static_cast<std::size_t>(state.arg());
+  auto* address = address_cast<std::uint64_t*>(
+      store == Store::Literal ? trampoline->literal : trampoline->entry + 8);
+  const auto value = *address;
+
+  std::atomic<bool> done{false};
+  std::thread writer;
+  if (store != Store::None)
+  {
+    writer = std::thread([&]
+    {
+      const std::atomic_ref<std::uint64_t> target{*address};
+      while (not done.load(std::memory_order_relaxed))
+      {
+        target.store(value, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  std::atomic<std::uint64_t> cycles{0};
+  const auto call = address_cast<int (*)(int)>(trampoline->entry);
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t t)
+  {
+    ULONG64 start = 0;
+    ULONG64 end = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &start);
+    auto sum = static_cast<int>(t);
+    for (std::size_t i = 0; i < state.iterations(); ++i) { sum += call(sum); }
+    QueryThreadCycleTime(GetCurrentThread(), &end);
+    VeilHook::Bench::do_not_optimize(sum);
+    cycles += end - start;
+  });
+  done = true;
+  if (writer.joinable()) { writer.join(); }
+
+  const auto calls = static_cast<double>(state.iterations() * threads);
+  const auto ns =
+      std::chrono::duration<double, std::nano>(state.elapsed()).count();
+  state.counters["threads"] = static_cast<double>(threads);
+  state.counters["cycles_per_call"] = static_cast<double>(cycles) / calls;
+  state.counters["calls_per_sec"] = calls * 1e9 / ns;
+}
+}  // namespace
+
+//==============================================================================
+// Calls through `jmp [literal]` under concurrent stores
+//==============================================================================
+VH_BENCHMARK_EX("Trampoline/Call", 0, 1, 4)
+{
+  run(state, Store::None);
+}
+
+VH_BENCHMARK_EX("Trampoline/CallWhileStoringLiteral", 0, 1, 4)
+{
+  run(state, Store::Literal);
+}
+
+VH_BENCHMARK_EX("Trampoline/CallWhileStoringCodeLine", 0, 1, 4)
+{
+  run(state, Store::CodeLine);
+}
@@ -0,0 +1,155 @@
+#define VH_BENCHMARK_IMPLEMENTATION
+#include "benchmark.hpp"
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/utility.hpp>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using VeilHook::Impl::VehEntry;
+using VeilHook::Impl::VehManager;
+
+constexpr std::size_t kRanges = 50'000;
+constexpr std::uintptr_t kStride = 0x20;
+#if defined(VH_ARCH_X86_64)
+constexpr std::uintptr_t kBase = 0x7000'0000'0000;
+#else
+constexpr std::uintptr_t kBase = 0x7000'0000;
+#endif
+
+auto continue_execution(PEXCEPTION_POINTERS /*info*/,
+                        const VehEntry& /*entry*/) -> LONG
+{
+  return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+void set_ip(CONTEXT& context, std::uintptr_t ip)
+{
+#if defined(VH_ARCH_X86_64)
+  context.Rip = ip;
+#else
+  context.Eip = static_cast<DWORD>(ip);
+#endif
+}
+
+// Synthetic, never-executed ranges that only exercise the lookup.
+void register_ranges()
+{
+  static std::once_flag once;
+  std::call_once(once, []
+  {
+    std::vector<VehEntry> entries;
+    entries.reserve(kRanges);
+    for (std::size_t i = 0; i < kRanges; ++i)
+    {
+      const auto start = kBase + (i * kStride);
+      entries.push_back({.start_address = start,
+                         .end_address = start + 0xF,
+                         .callback = continue_execution});
+    }
+    (void)VehManager::instance().Register(entries);
+  });
+}
+
+auto dispatch_loop(std::size_t iterations, std::uint32_t seed) -> std::size_t
+{
+  std::minstd_rand rng{seed};
+  EXCEPTION_RECORD record{};
+  record.ExceptionCode = static_cast<DWORD>(EXCEPTION_BREAKPOINT);
+  CONTEXT context{};
+  EXCEPTION_POINTERS info{.ExceptionRecord = &record, .ContextRecord = &context};
+
+  std::size_t handled = 0;
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    set_ip(context, kBase + ((rng() % kRanges) * kStride) + 4);
+    handled += VehManager::Dispatch(&info) == EXCEPTION_CONTINUE_EXECUTION;
+  }
+  return handled;
+}
+
+void report_rate(VeilHook::Bench::State& state, std::size_t threads)
+{
+  const auto seconds =
+      std::chrono::duration<double>(state.elapsed()).count();
+  state.counters["ranges"] = kRanges;
+  state.counters["threads"] = static_cast<double>(threads);
+  state.counters["traps_per_sec"] =
+      static_cast<double>(state.iterations() * threads) / seconds;
+}
+}  // namespace
+
+VH_BENCHMARK_EX("VehManager/Dispatch", 0, 1, 2, 4, 8, 16)
+{
+  register_ranges();
+  const auto threads = static_cast<std::size_t>(state.arg());
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t t)
+  {
+    VeilHook::Bench::do_not_optimize(
+        dispatch_loop(state.iterations(), static_cast<std::uint32_t>(t + 1)));
+  });
+  report_rate(state, threads);
+}
+
+VH_BENCHMARK_EX("VehManager/DispatchWhileRegistering", 0, 1, 4, 16)
+{
+  register_ranges();
+  const auto threads = static_cast<std::size_t>(state.arg());
+  std::atomic<bool> done{false};
+  std::thread writer([&]
+  {
+    const auto address = kBase - kStride;
+    while (not done.load())
+    {
+      (void)VehManager::instance().Register(address, address + 0xF,
+                                            continue_execution);
+      VehManager::instance().Unregister(address);
+    }
+  });
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t t)
+  {
+    VeilHook::Bench::do_not_optimize(
+        dispatch_loop(state.iterations(), static_cast<std::uint32_t>(t + 1)));
+  });
+  done = true;
+  writer.join();
+  report_rate(state, threads);
+}
+
+// Real breakpoint traps (`int3; ret`) resolved among the synthetic ranges.
+VH_BENCHMARK_EX("VehManager/Int3Trap", 0, 1, 4, 16)
+{
+  register_ranges();
+  static auto code = VeilHook::Allocator::Get()->Allocate(16);
+  if (not code) { return; }
+  static std::once_flag once;
+  std::call_once(once, []
+  {
+    VeilHook::detail::store<std::uint8_t>(code->address(), 0xCC);
+    VeilHook::detail::store<std::uint8_t>(code->address() + 1, 0xC3);
+    (void)VehManager::instance().Register(
+        code->address(),
+        [](PEXCEPTION_POINTERS info, const VehEntry& /*entry*/) -> LONG
+        {
+#if defined(VH_ARCH_X86_64)
+          info->ContextRecord->Rip += 1;
+#else
+          info->ContextRecord->Eip += 1;
+#endif
+          return EXCEPTION_CONTINUE_EXECUTION;
+        });
+  });
+
+  const auto threads = static_cast<std::size_t>(state.arg());
+  auto* trap = code->data<void (*)()>();
+  VeilHook::Bench::run_threads(state, threads, [&](std::size_t /*t*/)
+  {
+    for (std::size_t i = 0; i < state.iterations(); ++i) { trap(); }
+  });
+  report_rate(state, threads);
+}
@@ -0,0 +1,297 @@
+#ifndef VH_BENCHMARK_HPP
+#define VH_BENCHMARK_HPP
+
+// Minimal in-tree benchmark harness. Define VH_BENCHMARK_IMPLEMENTATION in
+// exactly one translation unit per executable to get `main`.
+//
+// Options: --filter <substring>, --min-time-ms <ms>, --json <path>.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace VeilHook::Bench
+{
+using Clock = std::chrono::steady_clock;
+
+class State final
+{
+ public:
+  // Loop variable type; `for (auto _ : state)` must not warn as unused.
+  struct [[maybe_unused]] Value
+  {
+  };
+
+  class Iterator
+  {
+   public:
+    Iterator(State* state, std::size_t remaining)
+        : state_(state), remaining_(remaining)
+    {
+    }
+    auto operator*() const -> Value { return {}; }
+    auto operator++() -> Iterator&
+    {
+      --remaining_;
+      return *this;
+    }
+    auto operator!=(const Iterator&) -> bool
+    {
+      if (remaining_ != 0) { return true; }
+      state_->stop();
+      return false;
+    }
+
+   private:
+    State* state_;
+    std::size_t remaining_;
+  };
+
+  State(std::size_t iterations, std::int64_t arg)
+      : iterations_(iterations), arg_(arg)
+  {
+  }
+
+  // Times the loop body only; setup before the loop is excluded.
+  auto begin() -> Iterator
+  {
+    start();
+    return {this, iterations_};
+  }
+  auto end() -> Iterator { return {this, 0}; }
+
+  void start() { start_ = Clock::now(); }
+  void stop() { elapsed_ += Clock::now() - start_; }
+
+  [[nodiscard]] auto iterations() const { return iterations_; }
+  [[nodiscard]] auto arg() const { return arg_; }
+  [[nodiscard]] auto elapsed() const { return elapsed_; }
+
+  std::map<std::string, double> counters;
+
+ private:
+  std::size_t iterations_;
+  std::int64_t arg_;
+  Clock::time_point start_{};
+  Clock::duration elapsed_{};
+};
+
+struct Benchmark
+{
+  std::string name;
+  std::function<void(State&)> function;
+  std::size_t iterations;  // 0 = scale until the minimum run time is reached
+  std::vector<std::int64_t> args;
+};
+
+inline auto registry() -> std::vector<Benchmark>&
+{
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+inline auto add(std::string name, std::size_t iterations,
+                std::initializer_list<std::int64_t> args,
+                void (*function)(State&)) -> bool
+{
+  registry().push_back({.name = std::move(name),
+                        .function = function,
+                        .iterations = iterations,
+                        .args = args});
+  return true;
+}
+
+// Runs `body(thread_index)` on `threads` threads (the caller is thread 0) and
+// times them from a common start until the last one finishes.
+template <typename Body>
+void run_threads(State& state, std::size_t threads, Body&& body)
+{
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (std::size_t t = 1; t < threads; ++t)
+  {
+    workers.emplace_back([&, t]
+    {
+      while (not go.load()) { std::this_thread::yield(); }
+      body(t);
+    });
+  }
+  state.start();
+  go = true;
+  body(0);
+  for (auto& worker : workers) { worker.join(); }
+  state.stop();
+}
+
+inline const void* volatile g_sink = nullptr;
+
+// Keeps `value` alive without letting the compiler fold the computation.
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+  g_sink = &value;
+}
+}  // namespace VeilHook::Bench
+
+#define VH_BENCH_CONCAT_(a, b) a##b
+#define VH_BENCH_CONCAT(a, b) VH_BENCH_CONCAT_(a, b)
+
+// VH_BENCHMARK_EX("name", iterations, args...) runs the body once per arg
+// (reported as "name/arg"); iterations == 0 scales the count automatically.
+#define VH_BENCHMARK_EX(name, iterations, ...)                               \
+  static void VH_BENCH_CONCAT(vh_benchmark_, __LINE__)(                      \
+      ::VeilHook::Bench::State&);                                            \
+  static const bool VH_BENCH_CONCAT(vh_benchmark_registered_, __LINE__) =    \
+      ::VeilHook::Bench::add(name, iterations, {__VA_ARGS__},                \
+                             &VH_BENCH_CONCAT(vh_benchmark_, __LINE__));     \
+  static void VH_BENCH_CONCAT(vh_benchmark_, __LINE__)(                      \
+      [[maybe_unused]] ::VeilHook::Bench::State & state)
+
+#define VH_BENCHMARK(name) VH_BENCHMARK_EX(name, 0)
+
+#if defined(VH_BENCHMARK_IMPLEMENTATION)
+#include <VeilHook/version.hpp>
+
+namespace VeilHook::Bench
+{
+namespace
+{
+struct Result
+{
+  std::string name;
+  std::size_t iterations;
+  double ns_per_iteration;
+  std::map<std::string, double> counters;
+};
+
+auto json_escape(std::string_view text) -> std::string
+{
+  std::string escaped;
+  for (const auto c : text)
+  {
+    if (c == '"' || c == '\\') { escaped += '\\'; }
+    escaped += c;
+  }
+  return escaped;
+}
+
+// One object per run, stable across versions so results can be diffed.
+void write_json(const std::string& path, const std::vector<Result>& results)
+{
+  std::ofstream out{path};
+  out.precision(12);
+  out << "{\n  \"context\": {\"version\": \"" << VH_VERSION_MAJOR << '.'
+      << VH_VERSION_MINOR << '.' << VH_VERSION_PATCH
+      << "\", \"hardware_concurrency\": "
+      << std::thread::hardware_concurrency() << "},\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i)
+  {
+    const auto& result = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+        << json_escape(result.name)
+        << "\", \"iterations\": " << result.iterations
+        << ", \"ns_per_iteration\": " << result.ns_per_iteration
+        << ", \"counters\": {";
+    bool first = true;
+    for (const auto& [key, value] : result.counters)
+    {
+      out << (first ? "" : ", ") << '"' << json_escape(key) << "\": " << value;
+      first = false;
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+auto run(const Benchmark& benchmark, std::int64_t arg,
+         std::chrono::nanoseconds min_time) -> State
+{
+  auto iterations = benchmark.iterations != 0 ? benchmark.iterations : 1;
+  for (;;)
+  {
+    State state{iterations, arg};
+    benchmark.function(state);
+    if (benchmark.iterations != 0 || state.elapsed() >= min_time ||
+        iterations >= 1'000'000'000)
+    {
+      return state;
+    }
+    const auto elapsed = std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(state.elapsed())
+            .count(),
+        1);
+    const auto scale = std::clamp<double>(
+        1.4 * static_cast<double>(min_time.count()) /
+            static_cast<double>(elapsed),
+        2.0, 100.0);
+    iterations = static_cast<std::size_t>(static_cast<double>(iterations) *
+                                          scale);
+  }
+}
+}  // namespace
+}  // namespace VeilHook::Bench
+
+auto main(int argc, char** argv) -> int
+{
+  using namespace VeilHook::Bench;
+  std::string_view filter;
+  std::string json_path;
+  auto min_time = std::chrono::nanoseconds{std::chrono::milliseconds{200}};
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    const std::string_view option{argv[i]};
+    if (option == "--filter") { filter = argv[i + 1]; }
+    else if (option == "--json") { json_path = argv[i + 1]; }
+    else if (option == "--min-time-ms")
+    {
+      min_time = std::chrono::milliseconds{std::stoll(argv[i + 1])};
+    }
+  }
+
+  std::vector<Result> results;
+  for (const auto& benchmark : registry())
+  {
+    auto args = benchmark.args;
+    if (args.empty()) { args.push_back(0); }
+    for (const auto arg : args)
+    {
+      auto name = benchmark.name;
+      if (not benchmark.args.empty()) { name += "/" + std::to_string(arg); }
+      if (name.find(filter) == std::string::npos) { continue; }
+
+      const auto state = run(benchmark, arg, min_time);
+      const auto ns =
+          std::chrono::duration<double, std::nano>(state.elapsed()).count() /
+          static_cast<double>(state.iterations());
+      std::printf("%-56s %12zu %14.2f ns", name.c_str(), state.iterations(),
+                  ns);
+      for (const auto& [key, value] : state.counters)
+      {
+        std::printf("  %s=%g", key.c_str(), value);
+      }
+      std::printf("\n");
+      std::fflush(stdout);
+      results.push_back({.name = name,
+                         .iterations = state.iterations(),
+                         .ns_per_iteration = ns,
+                         .counters = state.counters});
+    }
+  }
+
+  if (not json_path.empty()) { write_json(json_path, results); }
+  return 0;
+}
+#endif  // VH_BENCHMARK_IMPLEMENTATION
+
+#endif  // VH_BENCHMARK_HPP
@@ -0,0 +1,61 @@
+#ifndef VH_BENCHMARK_SYNTHETIC_HPP
+#define VH_BENCHMARK_SYNTHETIC_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/utility.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace VeilHook::Bench
+{
+
+// Page-aligned block of `count` tiny hookable functions, 16 bytes apart.
+// Function i is `mov eax, i; ret`, so its prologue relocates without fixups.
+class SyntheticFunctions final : detail::NoCopy, detail::NoMove
+{
+ public:
+  using Function = int (*)();
+  static constexpr std::size_t kStride = 0x10;
+
+  explicit SyntheticFunctions(std::size_t count) : count_(count)
+  {
+    const auto si = Impl::get_system_info();
+    const auto size = detail::align_up(count * kStride, si.page_size);
+    if (auto result = Impl::vm_alloc(0, size, Impl::VM_ACCESS_RWX))
+    {
+      address_ = result.value();
+      detail::fill<std::uint8_t>(address_, size, 0xCC);
+      for (std::size_t i = 0; i < count_; ++i)
+      {
+        const auto function = (*this)[i];
+        detail::store<std::uint8_t>(function, 0xB8);
+        detail::store<std::uint32_t>(function + 1,
+                                     static_cast<std::uint32_t>(i));
+        detail::store<std::uint8_t>(function + 5, 0xC3);
+      }
+    }
+  }
+  ~SyntheticFunctions()
+  {
+    if (address_ != 0) { Impl::vm_free(address_); }
+  }
+
+  [[nodiscard]] auto operator[](std::size_t index) const -> std::uintptr_t
+  {
+    return address_ + (index * kStride);
+  }
+  [[nodiscard]] auto function(std::size_t index) const -> Function
+  {
+    return detail::address_cast<Function>((*this)[index]);
+  }
+  [[nodiscard]] auto size() const { return count_; }
+  explicit operator bool() const { return address_ != 0; }
+
+ private:
+  std::uintptr_t address_{0};
+  std::size_t count_{0};
+};
+
+}  // namespace VeilHook::Bench
+
+#endif  // VH_BENCHMARK_SYNTHETIC_HPP
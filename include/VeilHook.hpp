@@ -2,8 +2,24 @@
 #define VEIL_HOOK_HPP
 
 #include <VeilHook/allocator.hpp>
+#include <VeilHook/call_site_hook.hpp>
+#include <VeilHook/code_map.hpp>
 #include <VeilHook/common.hpp>
+#include <VeilHook/function_clone.hpp>
+#include <VeilHook/guard.hpp>
+#include <VeilHook/hook_manager.hpp>
+#include <VeilHook/hook_registry.hpp>
 #include <VeilHook/inline_hook.hpp>
+#include <VeilHook/mass_hook.hpp>
+#include <VeilHook/memoize_hook.hpp>
+#include <VeilHook/plan_cache.hpp>
+#include <VeilHook/reclaimer.hpp>
+#include <VeilHook/remote_process.hpp>
+#include <VeilHook/scanner.hpp>
+#include <VeilHook/static_hooks.hpp>
+#include <VeilHook/symbol_index.hpp>
+#include <VeilHook/syscall_hook.hpp>
+#include <VeilHook/trace.hpp>
 #include <VeilHook/version.hpp>
 
 
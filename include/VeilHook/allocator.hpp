@@ -3,10 +3,12 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <initializer_list>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include "VeilHook/common.hpp"
@@ -33,6 +35,9 @@ class VH_API Allocation final : detail::NoCopy
   [[nodiscard]] auto address() const noexcept { return address_; }
   [[nodiscard]] auto size() const noexcept { return size_; }
   void free() noexcept;
+  // Gives up the block without freeing it; hand it back with
+  // Allocator::Free.
+  [[nodiscard]] auto release() noexcept -> std::uintptr_t;
   explicit operator bool() const noexcept
   {
     return address_ != 0 && size_ != 0;
@@ -55,8 +60,8 @@ class VH_API Allocation final : detail::NoCopy
 class VH_API Allocator final : detail::NoCopy, detail::NoMove, public std::enable_shared_from_this<Allocator>
 {
  public:
-  Allocator() = default;
-  ~Allocator() = default;
+  Allocator();
+  ~Allocator();
 
   static auto Get() -> std::shared_ptr<Allocator>;
 
@@ -65,14 +70,50 @@ class VH_API Allocator final : detail::NoCopy, detail::NoMove, public std::enabl
     return Allocate({}, size, std::numeric_limits<std::size_t>::max());
   }
 
-  [[nodiscard]] auto Allocate(
-      const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
-      std::size_t max_distance = 0x7FFF'FFFF) -> std::optional<Allocation>
+  // `desired_addresses` is any contiguous run, e.g. HookPlan::reach(), so
+  // callers need not build a vector. Allocating from memory already mapped
+  // does not touch the heap.
+  [[nodiscard]] auto Allocate(std::span<const std::uintptr_t> desired_addresses,
+                              std::size_t size,
+                              std::size_t max_distance = 0x7FFF'FFFF)
+      -> std::optional<Allocation>
   {
     if (size == 0) { return std::nullopt; }
     std::scoped_lock lock{mutex_};
     return _allocate(desired_addresses, size, max_distance);
   }
+  [[nodiscard]] auto Allocate(
+      std::initializer_list<std::uintptr_t> desired_addresses, std::size_t size,
+      std::size_t max_distance = 0x7FFF'FFFF) -> std::optional<Allocation>
+  {
+    return Allocate(std::span{desired_addresses.begin(),
+                              desired_addresses.size()},
+                    size, max_distance);
+  }
+
+  // Allocates one block per entry of `sizes` under a single lock, carved
+  // back to back from one free run when possible. Returns every block or
+  // none of them.
+  [[nodiscard]] auto AllocateMany(
+      std::span<const std::uintptr_t> desired_addresses,
+      std::span<const std::size_t> sizes,
+      std::size_t max_distance = 0x7FFF'FFFF) -> std::vector<Allocation>;
+  [[nodiscard]] auto AllocateMany(
+      std::initializer_list<std::uintptr_t> desired_addresses,
+      std::span<const std::size_t> sizes,
+      std::size_t max_distance = 0x7FFF'FFFF) -> std::vector<Allocation>
+  {
+    return AllocateMany(std::span{desired_addresses.begin(),
+                                  desired_addresses.size()},
+                        sizes, max_distance);
+  }
+
+  // Frees a block taken out of its Allocation with release().
+  void Free(std::uintptr_t address)
+  {
+    std::scoped_lock lock{mutex_};
+    _deallocate(address);
+  }
 
  private:
   friend class Allocation;
@@ -80,24 +121,33 @@ class VH_API Allocator final : detail::NoCopy, detail::NoMove, public std::enabl
   struct Memory;
   [[nodiscard]] auto _in_range(
       std::uintptr_t address,
-      const std::vector<std::uintptr_t>& desired_addresses,
+      std::span<const std::uintptr_t> desired_addresses,
       std::size_t max_distance) -> bool;
   [[nodiscard]] auto _make_memory(std::uintptr_t address, std::size_t size,
                                   Impl::VMAccess protect)
       -> std::unique_ptr<Memory>;
   [[nodiscard]] auto _allocate(
-      const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
+      std::span<const std::uintptr_t> desired_addresses, std::size_t size,
       std::size_t max_distance) -> std::optional<Allocation>;
+  [[nodiscard]] auto _carve(
+      std::span<const std::uintptr_t> desired_addresses,
+      std::size_t aligned_size, std::size_t max_distance) -> MemoryBlock*;
   [[nodiscard]] auto _allocate_from_heap(
-      const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
+      std::span<const std::uintptr_t> desired_addresses, std::size_t size,
       std::size_t max_distance) -> std::optional<Allocation>;
-   void _deallocate(std::uintptr_t address);
+  void _deallocate(std::uintptr_t address);
   [[nodiscard]] auto _allocate_memory(
-      const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
+      std::span<const std::uintptr_t> desired_addresses, std::size_t size,
       std::size_t max_distance) -> std::unique_ptr<Memory>;
+  // Block list nodes are recycled through `spare_` rather than freed, and
+  // topped up whenever a heap is mapped, so splitting a free block does not
+  // allocate.
+  [[nodiscard]] auto _node() -> std::unique_ptr<MemoryBlock>;
+  void _recycle(std::unique_ptr<MemoryBlock> node);
 
   std::mutex mutex_;
   std::vector<std::unique_ptr<Memory>> memory_;
+  std::unique_ptr<MemoryBlock> spare_;
 };
 
 }  // namespace VeilHook
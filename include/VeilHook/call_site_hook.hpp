@@ -0,0 +1,105 @@
+#ifndef VH_CALL_SITE_HOOK_HPP
+#define VH_CALL_SITE_HOOK_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace VeilHook
+{
+namespace Impl
+{
+// Every `call rel32` in `code`, which runs at `address`, that lands on
+// `target`. Found by a linear sweep with the length decoder that moves one
+// byte on past anything it cannot decode; data the sweep mistakes for code
+// would also have to decode to a call of exactly `target`.
+[[nodiscard]] auto find_call_sites(std::span<const std::uint8_t> code,
+                                   std::uintptr_t address,
+                                   std::uintptr_t target)
+    -> std::vector<std::uintptr_t>;
+}  // namespace Impl
+
+// Redirects the direct callers of a function instead of patching it.
+//
+// Every `call rel32` to the target in a module's executable sections is
+// pointed at the destination, or at a near relay when the destination is out
+// of rel32 reach. The target stays untouched: a detour calls it directly and
+// pays neither the jump to the detour nor the trampoline. Callers in other
+// modules, indirect calls (imports, vtables) and tail calls (`jmp rel32`)
+// still reach the target; use InlineHook when every call has to be seen.
+//
+// A detour living in the scanned module must call the target through a
+// pointer, or its own call site is redirected too.
+//
+// Each operand is replaced atomically. One inside an aligned qword is
+// swapped with a compare-exchange; one straddling two is written while an
+// int3 sits on its opcode, and a thread that meets the int3 is sent on to
+// the target as if the call had not been patched yet.
+class VH_API CallSiteHook final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // Fails with NotFound when the module never calls `target` directly.
+  static auto Create(const std::shared_ptr<Allocator>& allocator,
+                     std::uintptr_t module, std::uintptr_t target,
+                     std::uintptr_t destination)
+      -> std::expected<std::unique_ptr<CallSiteHook>, Error>;
+  static auto Create(std::uintptr_t module, std::uintptr_t target,
+                     std::uintptr_t destination)
+      -> std::expected<std::unique_ptr<CallSiteHook>, Error>
+  {
+    return Create(Allocator::Get(), module, target, destination);
+  }
+  // By module name, e.g. "kernelbase.dll"; an empty name is the executable.
+  static auto Create(std::string_view module, std::uintptr_t target,
+                     std::uintptr_t destination)
+      -> std::expected<std::unique_ptr<CallSiteHook>, Error>;
+  // Restores every call site.
+  ~CallSiteHook();
+
+  auto Enable() -> std::expected<void, Error>;
+  // Restores every call site in one pass.
+  auto Disable() -> std::expected<void, Error>;
+
+  // Addresses of the rewritten call instructions, ascending.
+  [[nodiscard]] auto sites() const -> std::span<const std::uintptr_t>
+  {
+    return sites_;
+  }
+  [[nodiscard]] auto target() const -> std::uintptr_t { return target_; }
+  [[nodiscard]] auto destination() const -> std::uintptr_t
+  {
+    return destination_;
+  }
+
+ private:
+  // `jmp [literal]` plus the literal, padded with int3.
+  static constexpr std::size_t kRelaySize = 16;
+
+  CallSiteHook() = default;
+
+  // Points every site at `destination_` (or the relay) or back at the target.
+  void _write(bool enable);
+  [[nodiscard]] auto _callee(std::uintptr_t site, bool enable) const
+      -> std::uintptr_t;
+
+  std::uintptr_t target_{0};
+  std::uintptr_t destination_{0};
+  std::vector<std::uintptr_t> sites_;
+  // Sites whose operand straddles two qwords, guarded by the VEH while the
+  // hook lives.
+  std::vector<std::uintptr_t> straddling_;
+  std::unique_ptr<Allocation> relay_;  // only for sites out of reach
+  bool enabled_{false};
+  std::mutex mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_CALL_SITE_HOOK_HPP
@@ -0,0 +1,142 @@
+#ifndef VH_CODE_MAP_HPP
+#define VH_CODE_MAP_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/function_clone.hpp>
+#include <VeilHook/hook_plan.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VeilHook
+{
+namespace Impl
+{
+// x64 UNWIND_INFO for a copy of a function's code, and how many bytes from
+// the start of the copy it describes. Empty when the copy needs none (the
+// function has no prologue codes, so unwinding it as a leaf is right) or
+// cannot get any.
+struct CopiedUnwind
+{
+  std::vector<std::uint8_t> info;
+  std::size_t size{};
+};
+
+// The prologue codes a trampoline at `trampoline` has executed by the time
+// it jumps back, for targets at the start of a function. The original's
+// exception handler is left out: nothing the trampoline runs can throw.
+[[nodiscard]] auto trampoline_unwind(const HookPlan& plan,
+                                     std::uintptr_t trampoline)
+    -> CopiedUnwind;
+// The whole function's prologue codes for its clone at `clone`. Functions
+// with an exception handler, or whose code spans more than their primary
+// function entry, get none.
+[[nodiscard]] auto clone_unwind(const ClonePlan& plan, std::uintptr_t clone)
+    -> CopiedUnwind;
+}  // namespace Impl
+
+struct CodeMapOptions
+{
+  // Where `<start> <size> <name>` lines (hex, no prefix) go, the perf map
+  // format Linux perf, samply and other sampling profilers read JIT symbols
+  // from. Empty for perf-<pid>.map in the temporary directory.
+  std::filesystem::path perf_map{};
+  bool write_perf_map{true};
+  // Register unwind data for trampolines and relocated prologues, so stack
+  // walks that sample a thread inside one continue into its caller.
+  bool unwind{true};
+};
+
+// Describes the code hooks generate to profilers and the unwinder. While
+// enabled, trampolines, clones, guard stubs and the stubs of the other hook
+// types are named `veilhook:<module>!<export>` after their target
+// (`veilhook:<module>+0x<rva>` when it is not exported), with the kind of
+// stub in brackets behind it, and x64 trampolines get function table
+// entries. Clones always get theirs, enabled or not, so exceptions unwind
+// through them.
+//
+// Describing code allocates, so enable it before the hooks of interest are
+// created; code generated while disabled stays anonymous. Entries go away
+// when the Reclaimer releases their code.
+class VH_API CodeMap final : detail::NoCopy, detail::NoMove
+{
+ public:
+  static auto Get() -> CodeMap&;
+
+  // Opens the perf map, truncating it. Fails with Io if it cannot be
+  // written.
+  auto Enable(CodeMapOptions options = {}) -> std::expected<void, Error>;
+  // Stops describing new code; the perf map is closed.
+  void Disable();
+  [[nodiscard]] auto enabled() const -> bool
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  // Whether trampolines get unwind data right now.
+  [[nodiscard]] auto unwind() const -> bool
+  {
+    return unwind_.load(std::memory_order_relaxed);
+  }
+
+  // Names [address, address + size) after `target` (just `kind` for code
+  // that serves no single target), `kind` in brackets if not empty, and
+  // registers `unwind` for its first `unwind.size` bytes with a function
+  // table entry allocated near it. Naming is skipped while disabled.
+  void Add(std::uintptr_t address, std::size_t size, std::uintptr_t target,
+           std::string_view kind = {}, const Impl::CopiedUnwind& unwind = {});
+  // Drops every entry that starts in `range`.
+  void Remove(MemoryRange range);
+
+  // Name of the described code containing `address`; empty if there is
+  // none.
+  [[nodiscard]] auto Find(std::uintptr_t address) const -> std::string;
+  [[nodiscard]] auto size() const -> std::size_t;
+
+ private:
+  struct Entry
+  {
+    std::size_t size;
+    std::string name;
+    // The RUNTIME_FUNCTION, then the UNWIND_INFO it points to.
+    std::optional<Allocation> unwind;
+  };
+  // A module's exports by address, valid for one build of it.
+  struct Exports
+  {
+    std::uint64_t build_id{};
+    std::string module;
+    std::vector<std::pair<std::uintptr_t, std::string>> symbols;
+  };
+
+  CodeMap() = default;
+  ~CodeMap() = default;
+
+  [[nodiscard]] auto _name(std::uintptr_t target, std::string_view kind)
+      -> std::string;
+  [[nodiscard]] static auto _register(std::uintptr_t address,
+                                      const Impl::CopiedUnwind& unwind)
+      -> std::optional<Allocation>;
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<bool> unwind_{false};
+  std::atomic<std::size_t> count_{0};
+  mutable std::mutex mutex_;
+  std::map<std::uintptr_t, Entry> entries_;
+  std::map<std::uintptr_t, Exports> exports_;  // by module base
+  std::ofstream perf_map_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_CODE_MAP_HPP
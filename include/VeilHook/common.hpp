@@ -67,6 +67,14 @@
 #define VH_NOINLINE __attribute__((noinline))
 #endif
 
+// Lets one translation unit carry kernels for several instruction sets.
+// MSVC accepts any intrinsic without it.
+#if defined(VH_COMPILER_MSVC)
+#define VH_TARGET(isa)
+#elif defined(VH_COMPILER_GCC) || defined(VH_COMPILER_CLANG)
+#define VH_TARGET(isa) __attribute__((target(isa)))
+#endif
+
 #if defined(VH_COMPILER_MSVC)
 #define VH_DLLEXPORT __declspec(dllexport)
 #define VH_DLLIMPORT __declspec(dllimport)
@@ -15,7 +15,11 @@ enum class Error : std::uint8_t
   FailedDecodeInstruction,
   UnsupportedInstruction,
   NotEnoughSpace,
-  IpRelativeInstructionOutOfRange
+  IpRelativeInstructionOutOfRange,
+  Io,
+  NotFound,
+  InvalidPattern,
+  InvalidArgument
 };
 }
 
@@ -0,0 +1,100 @@
+#ifndef VH_FUNCTION_CLONE_HPP
+#define VH_FUNCTION_CLONE_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <vector>
+
+namespace VeilHook::Impl
+{
+// How far past its entry a function's code is followed.
+inline constexpr std::size_t kMaxCloneExtent = 0x10000;
+
+// A whole function as recursive descent from its entry finds it, laid out
+// for a copy that runs on its own: branches between its instructions and
+// its jump tables point into the copy, everything else (calls, tail calls,
+// RIP-relative data) still at the original addresses.
+//
+// Descent follows both edges of conditional branches and the targets of
+// jumps and recognized jump tables that stay within kMaxCloneExtent of the
+// entry, and stops at returns, traps and indirect jumps. A jump target right
+// behind int3 padding counts as another function, i.e. a tail call, unless
+// it lies within the first kMaxPrologue bytes, which a hook overwrites.
+// Indirect jumps that are not a recognized table still run their original
+// targets.
+//
+// Jump tables are the MSVC x64 form (`mov r32, [base+index*4+rva]` with the
+// image base, `add`, `jmp`), the Clang/GCC x64 form (`lea base, [rip+table]`,
+// `movsxd`, `add`, `jmp`) and the x86 form (`jmp [index*4+table]`), each
+// bounded by a `cmp index, imm` and `ja` in front of it.
+struct ClonePlan
+{
+  struct Instruction
+  {
+    enum class Kind : std::uint8_t
+    {
+      Copy,      // position independent, or a table displacement
+      Rel32,     // rel32 branch/call or RIP-relative disp32, re-pointed
+      ShortJcc,  // jcc rel8, widened to jcc rel32
+      ShortJmp,  // jmp rel8, widened to jmp rel32
+      Loop,      // loop/jrcxz rel8, through a jmp rel32 next to it
+    };
+
+    std::uint32_t offset{};        // from the entry
+    std::uint32_t clone_offset{};  // where it lands in the clone
+    std::uint8_t length{};
+    std::uint8_t operand_offset{};  // of the rel32/rel8 or table displacement
+    Kind kind{Kind::Copy};
+    bool internal{false};   // a branch to another cloned instruction
+    std::int16_t table{-1};  // the jump table its operand refers to
+  };
+
+  struct JumpTable
+  {
+    // What its 32-bit entries are relative to.
+    enum class Base : std::uint8_t
+    {
+      Absolute,  // nothing: entries are addresses (x86)
+      Image,     // the image base, also kept by the clone
+      Table,     // the table itself, the clone's copy for the clone
+    };
+
+    std::uintptr_t address{};
+    std::uintptr_t image_base{};
+    std::uint32_t clone_offset{};
+    Base base{Base::Absolute};
+    std::vector<std::uintptr_t> targets;
+  };
+
+  std::uintptr_t entry{};
+  std::vector<Instruction> instructions;  // by offset
+  std::vector<JumpTable> tables;
+  std::vector<std::uint8_t> bytes;  // the original code from the entry on
+  std::size_t size{};                // of the clone: code, then tables
+
+  [[nodiscard]] auto branch_target(const Instruction& instruction) const
+      -> std::uintptr_t;
+  // Addresses the clone has to reach with a rel32 or an image-relative
+  // table entry.
+  [[nodiscard]] auto reach() const -> std::vector<std::uintptr_t>;
+};
+
+// Decodes the live function at `entry` in this process.
+[[nodiscard]] auto plan_clone(std::uintptr_t entry)
+    -> std::expected<ClonePlan, Error>;
+// Writes the clone into `out` as if it was located at `clone`.
+[[nodiscard]] auto emit_clone(const ClonePlan& plan,
+                              std::span<std::uint8_t> out,
+                              std::uintptr_t clone)
+    -> std::expected<void, Error>;
+// Where the instruction at `address` runs in a clone emitted at `clone`; 0
+// if no cloned instruction starts there.
+[[nodiscard]] auto cloned_address(const ClonePlan& plan, std::uintptr_t clone,
+                                  std::uintptr_t address) -> std::uintptr_t;
+}  // namespace VeilHook::Impl
+
+#endif  // VH_FUNCTION_CLONE_HPP
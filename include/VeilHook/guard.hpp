@@ -0,0 +1,115 @@
+#ifndef VH_GUARD_HPP
+#define VH_GUARD_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <cstdint>
+#include <expected>
+#include <memory>
+
+#include <intrin.h>
+
+namespace VeilHook
+{
+namespace Impl
+{
+// TEB TlsSlots are read straight off the segment register: one load, no
+// TlsGetValue call. Only the first TLS_MINIMUM_AVAILABLE indices live there.
+inline constexpr std::uint32_t kTlsSlots = 64;
+inline constexpr std::uint32_t kNoTlsSlot = 0xFFFF'FFFF;
+#if defined(VH_ARCH_X86_64)
+inline constexpr std::uint32_t kTebTlsSlots = 0x1480;
+#else
+inline constexpr std::uint32_t kTebTlsSlots = 0xE10;
+#endif
+
+[[nodiscard]] inline auto tls_offset(std::uint32_t slot) -> std::uint32_t
+{
+  return kTebTlsSlots + (slot * static_cast<std::uint32_t>(sizeof(void*)));
+}
+
+[[nodiscard]] inline auto tls_read(std::uint32_t slot) -> std::uintptr_t
+{
+#if defined(VH_ARCH_X86_64)
+  return __readgsqword(tls_offset(slot));
+#else
+  return __readfsdword(tls_offset(slot));
+#endif
+}
+
+inline void tls_write(std::uint32_t slot, std::uintptr_t value)
+{
+#if defined(VH_ARCH_X86_64)
+  __writegsqword(tls_offset(slot), value);
+#else
+  __writefsdword(tls_offset(slot), static_cast<unsigned long>(value));
+#endif
+}
+
+// Process-wide slot that is nonzero while a ScopedBypass is alive on the
+// thread; kNoTlsSlot if every TEB slot was taken.
+VH_API auto bypass_slot() -> std::uint32_t;
+
+// Sits between a hook and its detour: calls from a thread already inside
+// the detour, or inside a ScopedBypass, go straight to the trampoline. The
+// per-thread flag is a TEB TLS slot of the stub's own which, while set,
+// holds the caller's return address the stub swapped for its own landing.
+//
+// A detour behind a guard must return normally: exceptions or longjmps out
+// of it skip the landing and leave the flag set.
+class VH_API GuardStub final : detail::NoCopy, detail::NoMove
+{
+ public:
+  static constexpr std::size_t kSize = 0x68;
+
+  // Fails with NotEnoughSpace once the TEB slots run out.
+  static auto Create(Allocator& allocator, std::uintptr_t detour,
+                     std::uintptr_t trampoline)
+      -> std::expected<std::unique_ptr<GuardStub>, Error>;
+  ~GuardStub();
+
+  // Sends callers that get past the flag to `detour` from now on.
+  void Retarget(std::uintptr_t detour);
+
+  [[nodiscard]] auto address() const -> std::uintptr_t
+  {
+    return code_.address();
+  }
+  // Whether the calling thread is inside the detour.
+  [[nodiscard]] auto active() const -> bool { return tls_read(slot_) != 0; }
+
+ private:
+  GuardStub(std::uint32_t slot, Allocation code)
+      : slot_(slot), code_(std::move(code))
+  {
+  }
+
+  std::uint32_t slot_;
+  Allocation code_;
+};
+}  // namespace Impl
+
+// Lets the constructing thread bypass every guarded hook (HookOptions::
+// guarded) until it is destroyed, e.g. around a detour's own logging. Nests.
+class ScopedBypass final : detail::NoCopy, detail::NoMove
+{
+ public:
+  ScopedBypass() : slot_(Impl::bypass_slot())
+  {
+    if (slot_ == Impl::kNoTlsSlot) { return; }
+    previous_ = Impl::tls_read(slot_);
+    Impl::tls_write(slot_, 1);
+  }
+  ~ScopedBypass()
+  {
+    if (slot_ != Impl::kNoTlsSlot) { Impl::tls_write(slot_, previous_); }
+  }
+
+ private:
+  std::uint32_t slot_;
+  std::uintptr_t previous_{0};
+};
+}  // namespace VeilHook
+
+#endif  // VH_GUARD_HPP
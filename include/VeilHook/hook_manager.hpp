@@ -0,0 +1,85 @@
+#ifndef VH_HOOK_MANAGER_HPP
+#define VH_HOOK_MANAGER_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/utility.hpp>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace VeilHook
+{
+// A hook on a module that may not be loaded yet.
+struct HookSpec
+{
+  std::string module{};     // file name, e.g. "plugin.dll" or "plugin"
+  std::string symbol{};     // export, raw or undecorated C++ name
+  std::string signature{};  // IDA-style pattern, used when `symbol` is empty
+  std::uintptr_t destination{0};
+  // Run right after the hook is enabled and right before it is torn down.
+  // When a load or unload triggers them they run under the loader lock.
+  std::function<void(InlineHook&)> on_armed{};
+  std::function<void()> on_disarmed{};
+};
+
+// Arms specs as their modules are mapped and disarms them before the modules
+// go away, driven by the loader's own notifications instead of polling.
+// Specs for one module are armed in a single CreateMany batch, before the
+// module's entry point runs.
+class VH_API HookManager final : detail::NoCopy, detail::NoMove
+{
+ public:
+  using Id = std::uint32_t;
+
+  static auto Get() -> HookManager&;
+
+  // Arms right away if the module is already loaded.
+  auto Add(HookSpec spec) -> std::expected<Id, Error>;
+  // Disarms the hook if needed and forgets the spec.
+  void Remove(Id id);
+
+  [[nodiscard]] auto armed(Id id) const -> bool;
+  [[nodiscard]] auto pending() const -> std::size_t;
+
+ private:
+  HookManager();
+  ~HookManager();
+
+  enum class State : std::uint8_t
+  {
+    Pending,
+    Arming,
+    Armed
+  };
+  struct Entry
+  {
+    HookSpec spec{};
+    std::string module{};  // lower case
+    State state{State::Pending};
+    std::uintptr_t base{0};
+    // Set when the module unloads while the entry is Arming.
+    bool unloaded{false};
+    std::unique_ptr<InlineHook> hook{};
+  };
+
+  static void _notify(Impl::ModuleEvent event, std::uintptr_t base,
+                      std::string_view name, void* context);
+  void _arm(std::uintptr_t base, std::string_view name);
+  void _disarm(std::uintptr_t base);
+
+  // Never held across calls into the loader: its callbacks take it while
+  // the loader lock is held.
+  mutable std::mutex mutex_;
+  std::unordered_map<Id, Entry> entries_;
+  Id next_{1};
+  void* watch_{nullptr};
+};
+}  // namespace VeilHook
+
+#endif  // VH_HOOK_MANAGER_HPP
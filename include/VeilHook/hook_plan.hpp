@@ -0,0 +1,142 @@
+#ifndef VH_HOOK_PLAN_HPP
+#define VH_HOOK_PLAN_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+
+namespace VeilHook::Impl
+{
+inline constexpr std::size_t kCacheLine = 64;
+
+enum class HookType : std::uint8_t
+{
+  None,
+  E9,
+  FF
+};
+
+// One decoded prologue instruction and how it moves into the trampoline.
+struct PlannedInstruction
+{
+  enum class Kind : std::uint8_t
+  {
+    Copy,      // position independent, copied verbatim
+    Rel32,     // rel32 branch/call or RIP-relative disp32, re-pointed
+    ShortJcc,  // jcc rel8, widened to jcc rel32
+    ShortJmp,  // jmp rel8, widened to jmp rel32
+  };
+
+  std::uint8_t offset{};          // within the original prologue
+  std::uint8_t length{};
+  std::uint8_t operand_offset{};  // of the displacement inside the instruction
+  Kind kind{Kind::Copy};
+};
+
+// Result of decoding a target once: everything needed to emit its trampoline
+// and patch later, without touching the decoder again.
+struct HookPlan
+{
+  static constexpr std::size_t kMaxPrologue = 0x40;
+  static constexpr std::size_t kMaxInstructions = 16;
+
+  std::uintptr_t target{};
+  HookType type{HookType::None};
+  std::uint8_t prologue_size{};
+  std::uint8_t instruction_count{};
+  std::uint16_t trampoline_size{};
+  std::array<std::uint8_t, kMaxPrologue> original_bytes{};
+  std::array<PlannedInstruction, kMaxInstructions> instructions{};
+
+  // Up to one address per instruction plus the target, held inline so
+  // planning and allocating a trampoline never touch the heap.
+  struct Reach
+  {
+    std::array<std::uintptr_t, kMaxInstructions + 1> addresses{};
+    std::size_t count{};
+
+    [[nodiscard]] auto data() const -> const std::uintptr_t*
+    {
+      return addresses.data();
+    }
+    [[nodiscard]] auto size() const -> std::size_t { return count; }
+    [[nodiscard]] auto begin() const -> const std::uintptr_t*
+    {
+      return addresses.data();
+    }
+    [[nodiscard]] auto end() const -> const std::uintptr_t*
+    {
+      return addresses.data() + count;
+    }
+  };
+
+  [[nodiscard]] auto branch_target(const PlannedInstruction& instruction) const
+      -> std::uintptr_t;
+  // Addresses the trampoline has to reach with a rel32: the target itself
+  // and the destination of every relocated operand.
+  [[nodiscard]] auto reach() const -> Reach;
+};
+
+// Decodes `code`, the bytes found at runtime address `address`.
+[[nodiscard]] auto plan_hook(std::span<const std::uint8_t> code,
+                             std::uintptr_t address, HookType type)
+    -> std::expected<HookPlan, Error>;
+// Decodes the live bytes at `address` in this process.
+[[nodiscard]] auto plan_hook(std::uintptr_t address, HookType type)
+    -> std::expected<HookPlan, Error>;
+
+// Bytes emit_trampoline writes, from the plan's type and instructions.
+[[nodiscard]] auto trampoline_size(const HookPlan& plan) -> std::size_t;
+// Writes the trampoline into `out` as if it was located at `trampoline`.
+[[nodiscard]] auto emit_trampoline(const HookPlan& plan,
+                                   std::span<std::uint8_t> out,
+                                   std::uintptr_t trampoline,
+                                   std::uintptr_t destination)
+    -> std::expected<void, Error>;
+// Bytes emit_relocated writes: the relocated prologue and a `jmp rel32`
+// back behind it, without the destination jump.
+[[nodiscard]] auto relocated_size(const HookPlan& plan) -> std::size_t;
+// Writes the bare relocated prologue of an E9 plan into `out` as if it was
+// located at `address`, which has to be in rel32 reach of the target.
+[[nodiscard]] auto emit_relocated(const HookPlan& plan,
+                                  std::span<std::uint8_t> out,
+                                  std::uintptr_t address)
+    -> std::expected<void, Error>;
+// Where the prologue instruction starting at `address` runs in a trampoline
+// or relocated prologue emitted at `trampoline`, the end of the prologue
+// mapping to the jump back; 0 if no instruction of the prologue starts there.
+[[nodiscard]] auto relocated_address(const HookPlan& plan,
+                                     std::uintptr_t trampoline,
+                                     std::uintptr_t address) -> std::uintptr_t;
+// The pointer-sized literal an E9 trampoline at `trampoline` jumps to the
+// destination through, on a cache line of its own; 0 if there is none.
+[[nodiscard]] auto destination_literal(const HookPlan& plan,
+                                       std::uintptr_t trampoline)
+    -> std::uintptr_t;
+// Sends an emitted E9 trampoline's destination jump to `destination` with a
+// single aligned store to its literal; other plans fail with
+// UnsupportedInstruction.
+[[nodiscard]] auto retarget_trampoline(const HookPlan& plan,
+                                       std::uintptr_t trampoline,
+                                       std::uintptr_t destination)
+    -> std::expected<void, Error>;
+// Writes the `prologue_size` bytes that replace the original prologue.
+[[nodiscard]] auto emit_patch(const HookPlan& plan, std::span<std::uint8_t> out,
+                              std::uintptr_t trampoline,
+                              std::uintptr_t destination)
+    -> std::expected<void, Error>;
+
+// Hops `resolve_jumps` follows at most, so a loop of thunks still ends.
+inline constexpr std::size_t kMaxJumps = 8;
+// Follows the unconditional jumps at `address` - `jmp rel32`, `jmp rel8`
+// and `jmp [rip+disp32]` (`jmp [disp32]` on x86) import thunks - to the
+// first instruction that is not one. Stops early at memory it cannot read.
+[[nodiscard]] auto resolve_jumps(std::uintptr_t address) -> std::uintptr_t;
+
+}  // namespace VeilHook::Impl
+
+#endif  // VH_HOOK_PLAN_HPP
@@ -0,0 +1,157 @@
+#ifndef VH_HOOK_REGISTRY_HPP
+#define VH_HOOK_REGISTRY_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace VeilHook
+{
+// Slot index plus the generation the slot had when it was handed out, so a
+// handle to a removed hook is rejected instead of reaching its successor.
+struct HookHandle
+{
+  static constexpr std::uint32_t kIndexBits = 20;
+  static constexpr std::uint32_t kIndexMask = (1U << kIndexBits) - 1;
+
+  std::uint32_t value{0};
+
+  [[nodiscard]] auto index() const -> std::uint32_t
+  {
+    return value & kIndexMask;
+  }
+  [[nodiscard]] auto generation() const -> std::uint32_t
+  {
+    return value >> kIndexBits;
+  }
+  explicit operator bool() const { return value != 0; }
+  auto operator==(const HookHandle&) const -> bool = default;
+};
+
+// Bytes held on behalf of the live hooks.
+struct HookMemory
+{
+  std::size_t hooks;
+  std::size_t slots;        // per-hook arrays
+  std::size_t bytes;        // original and patch bytes in the pool
+  std::size_t trampolines;  // executable memory
+  [[nodiscard]] auto per_hook() const -> double
+  {
+    return hooks == 0 ? 0.0
+                      : static_cast<double>(slots + bytes + trampolines) /
+                            static_cast<double>(hooks);
+  }
+};
+
+// Many hooks in flat arrays rather than one InlineHook object each. A hook
+// costs a few parallel array slots, its prologue bytes in a shared pool and
+// its trampoline; no per-hook heap objects or mutexes other than the guard
+// stubs of guarded hooks. Enable and Disable only claim the hook's atomic
+// state word, so different hooks never contend.
+//
+// Trampolines are emitted when hooks are added.
+class VH_API HookRegistry final : detail::NoCopy, detail::NoMove
+{
+ public:
+  static constexpr std::size_t kMaxCapacity = std::size_t{1}
+                                              << HookHandle::kIndexBits;
+
+  // Storage for `capacity` hooks is reserved up front, so the arrays never
+  // move under concurrent Enable/Disable calls.
+  explicit HookRegistry(
+      std::size_t capacity,
+      std::shared_ptr<Allocator> allocator = Allocator::Get());
+  // Disables and frees every remaining hook.
+  ~HookRegistry();
+
+  auto Add(std::uintptr_t target, std::uintptr_t destination,
+           HookOptions options = {}) -> std::expected<HookHandle, Error>;
+  // Batched like InlineHook::CreateMany; results in input order.
+  auto AddMany(std::span<const HookTarget> targets, HookOptions options = {})
+      -> std::vector<std::expected<HookHandle, Error>>;
+  // Stale handles fail with Error::NotFound.
+  auto Remove(HookHandle handle) -> std::expected<void, Error>;
+  auto Enable(HookHandle handle) -> std::expected<void, Error>;
+  auto Disable(HookHandle handle) -> std::expected<void, Error>;
+
+  [[nodiscard]] auto valid(HookHandle handle) const -> bool;
+  [[nodiscard]] auto enabled(HookHandle handle) const -> bool;
+  [[nodiscard]] auto target(HookHandle handle) const -> std::uintptr_t;
+  // What Call runs: the clone of hooks added with HookOptions::clone, else
+  // the trampoline. 0 for stale handles.
+  [[nodiscard]] auto trampoline(HookHandle handle) const -> std::uintptr_t;
+
+  template <typename Ret, class... Args>
+  Ret Call(HookHandle handle, Args&&... args) const
+  {
+    return detail::address_cast<Ret (*)(Args...)>(trampoline(handle))(
+        std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t;
+  [[nodiscard]] auto capacity() const -> std::size_t { return capacity_; }
+  [[nodiscard]] auto memory() const -> HookMemory;
+
+ private:
+  // State word: generation above the flags.
+  static constexpr std::uint32_t kLive = 1U << 0;
+  static constexpr std::uint32_t kEnabled = 1U << 1;
+  static constexpr std::uint32_t kBusy = 1U << 2;
+  static constexpr std::uint32_t kGenerationShift = 4;
+  // Original then patch bytes of each hook live in 64 KiB chunks; a run
+  // never straddles two.
+  static constexpr std::uint32_t kChunkBits = 16;
+  static constexpr std::uint32_t kChunkSize = 1U << kChunkBits;
+
+  auto _adopt(InlineHook& hook) -> std::expected<HookHandle, Error>;
+  // Sets kBusy on a live slot matching `handle`; returns the word it
+  // replaced.
+  auto _claim(HookHandle handle) -> std::expected<std::uint32_t, Error>;
+  // False, with nothing written, if the patch's guard cannot be registered.
+  auto _write(std::uint32_t index, bool patch) -> bool;
+  // Hands the slot's trampoline, guard and clone to the Reclaimer.
+  void _retire(std::uint32_t index);
+  auto _pool_allocate(std::size_t size) -> std::expected<std::uint32_t, Error>;
+  [[nodiscard]] auto _pool(std::uint32_t offset) const -> std::uint8_t*;
+  [[nodiscard]] auto _live(HookHandle handle) const -> bool;
+
+  std::shared_ptr<Allocator> allocator_;
+  std::size_t capacity_;
+
+  // One entry per slot.
+  std::unique_ptr<std::atomic<std::uint32_t>[]> states_;
+  std::unique_ptr<std::uintptr_t[]> targets_;
+  std::unique_ptr<std::uintptr_t[]> trampolines_;
+  std::unique_ptr<std::unique_ptr<Impl::GuardStub>[]> guards_;  // if guarded
+  std::unique_ptr<std::optional<Allocation>[]> clones_;  // if cloned
+  std::unique_ptr<std::uint32_t[]> offsets_;  // into the byte pool
+  std::unique_ptr<std::uint16_t[]> trampoline_sizes_;
+  std::unique_ptr<std::uint8_t[]> prologue_sizes_;
+
+  // Guards adding and removing slots and pool runs; never taken by Enable
+  // or Disable.
+  mutable std::mutex mutex_;
+  std::uint32_t slots_{0};
+  std::vector<std::uint32_t> free_slots_;
+  std::size_t live_{0};
+  std::size_t trampoline_bytes_{0};
+  std::unique_ptr<std::unique_ptr<std::uint8_t[]>[]> chunks_;
+  std::uint32_t pool_end_{0};
+  std::size_t pool_used_{0};
+  // Released runs by length.
+  std::array<std::vector<std::uint32_t>, (2 * Impl::HookPlan::kMaxPrologue) + 1>
+      free_runs_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_HOOK_REGISTRY_HPP
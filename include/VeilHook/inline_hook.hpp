@@ -4,29 +4,94 @@
 #include <VeilHook/allocator.hpp>
 #include <VeilHook/common.hpp>
 #include <VeilHook/error.hpp>
+#include <VeilHook/guard.hpp>
+#include <VeilHook/hook_plan.hpp>
 #include <VeilHook/utility.hpp>
-#include <array>
+#include <atomic>
 #include <expected>
 #include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
 
 namespace VeilHook
 {
+class PlanCache;
+
+struct HookTarget
+{
+  std::uintptr_t target;
+  std::uintptr_t destination;
+};
+
+struct HookOptions
+{
+  // Allocate the trampoline up front but only write it on the first Enable
+  // (or Call), so hooks that are never enabled cost no code writes.
+  bool lazy{false};
+  // Reuse plans decoded by an earlier run and record new ones. Must outlive
+  // the call; Save is left to the caller.
+  PlanCache* cache{nullptr};
+  // Worker threads for CreateMany, 0 for all hardware threads. Use 1 under
+  // the loader lock, where new threads cannot start.
+  std::size_t threads{0};
+  // Send calls the detour makes back into its own hook, and calls from
+  // threads inside a ScopedBypass, straight to the trampoline. Costs a TEB
+  // TLS slot per hook; see Impl::GuardStub.
+  bool guarded{false};
+  // Hook the body a chain of unconditional jumps leads to (import thunks,
+  // incremental linking stubs, `jmp` forwarders) instead of the first jump,
+  // which saves a hop on both the hooked and the original path. The hook's
+  // target() reports where the chain ended; see Impl::resolve_jumps.
+  bool follow_jumps{false};
+  // Call the original through a copy of the whole function instead of the
+  // trampoline: no jump back into the patched code, and branches back into
+  // the prologue stay in the copy; see Impl::plan_clone. Functions that
+  // cannot be cloned keep the trampoline (see cloned()). On x64 the copy
+  // gets the original's unwind data (see CodeMap) unless the function has an
+  // exception handler; exceptions must not propagate through those copies.
+  bool clone{false};
+};
+
 class VH_API InlineHook final : detail::NoCopy
 {
  public:
   static auto Create(const std::shared_ptr<Allocator>& allocator,
-                     std::uintptr_t target, std::uintptr_t destination)
+                     std::uintptr_t target, std::uintptr_t destination,
+                     HookOptions options = {})
       -> std::expected<InlineHook, Error>;
-  static auto Create(std::uintptr_t target, std::uintptr_t destination)
+  static auto Create(std::uintptr_t target, std::uintptr_t destination,
+                     HookOptions options = {})
       -> std::expected<InlineHook, Error>
   {
-    return Create(Allocator::Get(), target, destination);
+    return Create(Allocator::Get(), target, destination, options);
   }
-  static auto Create(void* target, void* destination)
+  static auto Create(void* target, void* destination, HookOptions options = {})
       -> std::expected<InlineHook, Error>
   {
     return Create(detail::address_cast<std::uintptr_t>(target),
-                  detail::address_cast<std::uintptr_t>(destination));
+                  detail::address_cast<std::uintptr_t>(destination), options);
+  }
+
+  // Hooks an exported function by name, e.g. ("kernel32.dll", "Sleep"),
+  // resolved through SymbolIndex::Get().
+  static auto Create(std::string_view module, std::string_view symbol,
+                     std::uintptr_t destination, HookOptions options = {})
+      -> std::expected<InlineHook, Error>;
+
+  // Creates one hook per entry, results in input order. Prologues are
+  // decoded in parallel and trampolines of nearby targets are carved from
+  // one allocation per window.
+  static auto CreateMany(const std::shared_ptr<Allocator>& allocator,
+                         std::span<const HookTarget> targets,
+                         HookOptions options = {})
+      -> std::vector<std::expected<InlineHook, Error>>;
+  static auto CreateMany(std::span<const HookTarget> targets,
+                         HookOptions options = {})
+      -> std::vector<std::expected<InlineHook, Error>>
+  {
+    return CreateMany(Allocator::Get(), targets, options);
   }
 
   InlineHook() noexcept = default;
@@ -36,39 +101,71 @@ class VH_API InlineHook final : detail::NoCopy
 
   auto Enable() -> std::expected<void, Error>;
   auto Disable() -> std::expected<void, Error>;
+  // Switches to another detour with one store to the trampoline's (or
+  // guard's) destination literal: the target is not written and calls are
+  // intercepted throughout. Hooks with a `jmp [rip]` patch (no trampoline
+  // memory in reach of the target) keep their destination in the patch and
+  // fail with UnsupportedInstruction.
+  auto Retarget(std::uintptr_t destination) -> std::expected<void, Error>;
+
+  // The patched address: the target passed to Create, or with
+  // `follow_jumps` the body its jumps lead to.
+  [[nodiscard]] auto target() const -> std::uintptr_t { return target_; }
+  // The patch Create planned: a `jmp rel32` (E9), or a `jmp [rip]` (FF)
+  // when the prologue or the allocator leaves no room for one.
+  [[nodiscard]] auto type() const -> Impl::HookType { return plan_.type; }
+  // Whether Call runs a clone of the function (HookOptions::clone).
+  [[nodiscard]] auto cloned() const -> bool { return clone_.has_value(); }
 
   template<typename Ret, class... Args>
   Ret Call(Args&&... args)
   {
-    return trampoline_->data<Ret(*)(Args...)>()(std::forward<Args>(args)...);
+    if (not materialized_.load(std::memory_order_acquire)) [[unlikely]]
+    {
+      (void)_materialize();
+    }
+    return _original().data<Ret(*)(Args...)>()(std::forward<Args>(args)...);
   }
 
 
  private:
-  enum class Type : std::uint8_t
-  {
-    None,
-    E9,
-    FF
-  };
+  // Takes over the trampoline and plan of materialized hooks.
+  friend class HookRegistry;
+  // Abandons hooks on modules unloaded while they were being armed.
+  friend class HookManager;
 
   auto _setup(const std::shared_ptr<Allocator>& allocator,
-              std::uintptr_t target, std::uintptr_t destination)
-      -> std::expected<void, Error>;
-  auto _e9_hook(const std::shared_ptr<Allocator>& allocator)
-      -> std::expected<void, Error>;
-  auto _ff_hook(const std::shared_ptr<Allocator>& allocator)
-      -> std::expected<void, Error>;
+              std::uintptr_t target, std::uintptr_t destination,
+              PlanCache* cache) -> std::expected<void, Error>;
+  void _assign(const Impl::HookPlan& plan, Allocation trampoline);
+  auto _guard(Allocator& allocator) -> std::expected<void, Error>;
+  // Leaves the hook on its trampoline if the target cannot be cloned.
+  void _clone(Allocator& allocator);
+  auto _materialize() -> std::expected<void, Error>;
+  // Where the patch and trampoline send callers: the guard or the detour.
+  [[nodiscard]] auto _entry() const -> std::uintptr_t
+  {
+    return guard_ ? guard_->address() : destination_;
+  }
+  // What Call and the guard's bypass run: the clone or the trampoline.
+  [[nodiscard]] auto _original() const -> const Allocation&
+  {
+    return clone_ ? *clone_ : *trampoline_;
+  }
 
+  // Forgets the patch without restoring it, for targets whose image has
+  // been unmapped.
+  void _abandon();
   void _destroy() noexcept;
 
   std::uintptr_t target_{0};
   std::uintptr_t destination_{0};
-  std::unique_ptr<Allocation> trampoline_{nullptr};
-  std::array<std::uint8_t, 0x40> original_bytes_{};
-  std::size_t original_bytes_size_{0};
-  Type type_{Type::None};
+  std::optional<Allocation> trampoline_;
+  std::optional<Allocation> clone_;
+  std::unique_ptr<Impl::GuardStub> guard_{nullptr};
+  Impl::HookPlan plan_{};
   bool enabled_{false};
+  std::atomic<bool> materialized_{false};
   std::recursive_mutex mutex_;
 };
 }  // namespace VeilHook
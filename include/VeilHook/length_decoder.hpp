@@ -0,0 +1,66 @@
+#ifndef VH_LENGTH_DECODER_HPP
+#define VH_LENGTH_DECODER_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+
+namespace VeilHook::Impl
+{
+enum class MachineMode : std::uint8_t
+{
+  Long64,
+  Legacy32
+};
+
+#if defined(VH_ARCH_X86_64)
+inline constexpr MachineMode kNativeMode = MachineMode::Long64;
+#elif defined(VH_ARCH_X86_32)
+inline constexpr MachineMode kNativeMode = MachineMode::Legacy32;
+#endif
+
+// What hook planning needs from an instruction: its length and where its
+// relative operand sits, if any. RIP-relative memory operands count as
+// relative with `branch` None.
+struct InstructionLength
+{
+  enum class Branch : std::uint8_t
+  {
+    None,
+    Jmp,
+    Jcc,
+    Call,
+    Loop,   // loop, loope, loopne, jcxz and friends
+    Other,  // e.g. xbegin
+  };
+
+  std::uint8_t length{};
+  std::uint8_t rel_offset{};  // within the instruction
+  std::uint8_t rel_size{};    // in bytes, 0 without a relative operand
+  Branch branch{Branch::None};
+
+  auto operator==(const InstructionLength&) const -> bool = default;
+};
+
+// Table-driven, no decoder state. Empty for what only a full decoder can
+// settle: VEX/EVEX/XOP, the 0F38/0F3A maps, 3DNow!, lock prefixes, system
+// opcode groups, 16-bit addressing, far pointers and 66-prefixed branches.
+// Lengths of encodings Zydis would reject are not checked.
+[[nodiscard]] auto decode_length_fast(std::span<const std::uint8_t> code,
+                                      MachineMode mode = kNativeMode)
+    -> std::optional<InstructionLength>;
+// The same through Zydis.
+[[nodiscard]] auto decode_length_full(std::span<const std::uint8_t> code,
+                                      MachineMode mode = kNativeMode)
+    -> std::expected<InstructionLength, Error>;
+// Fast path, then Zydis.
+[[nodiscard]] auto decode_length(std::span<const std::uint8_t> code,
+                                 MachineMode mode = kNativeMode)
+    -> std::expected<InstructionLength, Error>;
+}  // namespace VeilHook::Impl
+
+#endif  // VH_LENGTH_DECODER_HPP
@@ -0,0 +1,122 @@
+#ifndef VH_MASS_HOOK_HPP
+#define VH_MASS_HOOK_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace VeilHook
+{
+// Instruments thousands of functions through one generic callback, e.g. to
+// trace every export of a library.
+//
+// Nothing per target is C++: its patch jumps to a stub that pushes the
+// target's 32-bit id and jumps to a dispatcher shared by every target in
+// the same 1 GiB window. The dispatcher saves the volatile registers, calls
+// `on_enter(id, regs)` and continues into the target's relocated prologue,
+// which jumps back behind the patch. Stubs and relocated prologues are
+// packed back to back after their dispatcher in one allocation per window,
+// with no per-target epilogue, literal or padding.
+//
+// Ids are indices into the targets passed to Create. Targets that cannot
+// take a `jmp rel32` patch (see hooked()) are skipped rather than failing
+// the whole set, as are targets whose `follow_jumps` chain ends at a body
+// an earlier id already hooks.
+class VH_API MassHook final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // What the target was entered with. Argument registers written by the
+  // callback are what the target sees; the stack pointer is read only.
+  struct Registers
+  {
+#if defined(VH_ARCH_X86_64)
+    std::uintptr_t rcx;
+    std::uintptr_t rdx;
+    std::uintptr_t r8;
+    std::uintptr_t r9;
+    std::uintptr_t rax;
+    std::uintptr_t r10;
+    std::uintptr_t rsp;  // [rsp] is the return address, arguments follow
+#else
+    std::uintptr_t eax;
+    std::uintptr_t ecx;
+    std::uintptr_t edx;
+    std::uintptr_t esp;  // [esp] is the return address, arguments follow
+#endif
+  };
+  // Runs on the caller's thread before every hooked call, x64 xmm0-xmm5
+  // preserved around it. Calls it makes into hooked targets re-enter it.
+  using Callback = void (*)(std::uint32_t id, Registers& regs);
+
+  static auto Create(const std::shared_ptr<Allocator>& allocator,
+                     std::span<const std::uintptr_t> targets,
+                     Callback on_enter, HookOptions options = {})
+      -> std::expected<std::unique_ptr<MassHook>, Error>;
+  static auto Create(std::span<const std::uintptr_t> targets,
+                     Callback on_enter, HookOptions options = {})
+      -> std::expected<std::unique_ptr<MassHook>, Error>
+  {
+    return Create(Allocator::Get(), targets, on_enter, options);
+  }
+  // Restores every target.
+  ~MassHook();
+
+  // Patches or restores every hooked target in one pass.
+  auto Enable() -> std::expected<void, Error>;
+  auto Disable() -> std::expected<void, Error>;
+
+  [[nodiscard]] auto size() const -> std::size_t { return targets_.size(); }
+  [[nodiscard]] auto hooked() const -> std::size_t { return hooked_; }
+  [[nodiscard]] auto hooked(std::uint32_t id) const -> bool
+  {
+    return trampoline(id) != 0;
+  }
+  // Where the id's patch goes: its target, or what its jumps lead to.
+  [[nodiscard]] auto target(std::uint32_t id) const -> std::uintptr_t
+  {
+    return targets_[id];
+  }
+  // Calls the original function; 0 for targets that were skipped.
+  [[nodiscard]] auto trampoline(std::uint32_t id) const -> std::uintptr_t
+  {
+    return table_[id];
+  }
+  [[nodiscard]] auto memory() const -> HookMemory;
+
+ private:
+  struct Planned;
+
+  MassHook() = default;
+
+  // Writes the dispatcher and the stubs and relocated prologues of
+  // `planned`, one window's targets in address order, into `block`.
+  void _emit(Allocation& block, std::span<const Planned> planned,
+             Callback on_enter);
+  void _write(bool patch);
+
+  std::vector<std::uintptr_t> targets_;
+  // Where the dispatcher continues, by id. Shared with the code blocks it
+  // is read from, and freed with the last of them.
+  std::shared_ptr<std::uintptr_t[]> table_;
+  std::vector<std::uint32_t> order_;       // hooked ids by target address
+  std::vector<std::uint32_t> offsets_;     // into `bytes_`, by id
+  std::vector<std::uint8_t> prologue_sizes_;
+  std::vector<std::uint8_t> bytes_;        // original prologues
+  std::vector<Allocation> blocks_;         // dispatcher, then stubs
+  std::size_t code_bytes_{0};
+  std::size_t hooked_{0};
+  bool enabled_{false};
+  std::mutex mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_MASS_HOOK_HPP
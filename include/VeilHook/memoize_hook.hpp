@@ -0,0 +1,281 @@
+#ifndef VH_MEMOIZE_HOOK_HPP
+#define VH_MEMOIZE_HOOK_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/utility.hpp>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace VeilHook
+{
+struct MemoizeOptions
+{
+  // Results kept in all shards together, split evenly between them.
+  std::size_t capacity{4096};
+  // Independently locked parts of the cache, rounded up to a power of two.
+  std::size_t shards{16};
+  HookOptions hook{};
+};
+
+struct MemoizeStats
+{
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t evictions;
+  std::size_t size;
+};
+
+template <typename Signature, typename Key = std::uint64_t,
+          typename Tag = void>
+class MemoizeHook;
+
+// Hooks a pure function and answers repeated calls from a cache instead of
+// running it again.
+//
+// The key function maps the arguments to a `Key` that equal argument sets
+// share and different ones do not; `std::hash<Key>` picks the shard. Hits
+// take the shard's lock shared and only set the result's CLOCK reference
+// bit. Misses call the original outside the lock, then insert under it,
+// evicting the first result the clock hand finds unreferenced once the
+// shard is full. Results are copied out, so `Ret` must be copyable.
+//
+// The detour is a plain function of the given signature (x86: the default
+// calling convention), so each specialization has room for one live
+// instance at a time; hook functions of the same signature with different
+// `Tag`s. Like any detour, no call may still be inside it when the hook is
+// destroyed.
+template <typename Ret, typename... Args, typename Key, typename Tag>
+class MemoizeHook<Ret(Args...), Key, Tag> final : detail::NoCopy,
+                                                  detail::NoMove
+{
+  static_assert(std::is_copy_constructible_v<Ret> &&
+                    std::is_default_constructible_v<Ret>,
+                "results are copied in and out of the cache");
+
+ public:
+  using KeyFunction = Key (*)(const std::remove_reference_t<Args>&...);
+
+  // Fails with InvalidArgument without a key function or capacity, or
+  // while another instance of this specialization is alive.
+  static auto Create(std::uintptr_t target, KeyFunction key,
+                     MemoizeOptions options = {})
+      -> std::expected<std::unique_ptr<MemoizeHook>, Error>
+  {
+    if (key == nullptr || options.capacity == 0)
+    {
+      return std::unexpected(Error::InvalidArgument);
+    }
+    std::unique_ptr<MemoizeHook> memoize{new MemoizeHook(key, options)};
+    MemoizeHook* expected = nullptr;
+    if (not instance_.compare_exchange_strong(expected, memoize.get()))
+    {
+      return std::unexpected(Error::InvalidArgument);
+    }
+    auto hook = InlineHook::Create(target, detail::address_cast(&_detour),
+                                   options.hook);
+    if (not hook)
+    {
+      instance_.store(nullptr);
+      return std::unexpected(hook.error());
+    }
+    memoize->hook_ = std::move(*hook);
+    return memoize;
+  }
+  ~MemoizeHook()
+  {
+    hook_ = InlineHook{};
+    instance_.store(nullptr);
+  }
+
+  auto Enable() -> std::expected<void, Error> { return hook_.Enable(); }
+  auto Disable() -> std::expected<void, Error> { return hook_.Disable(); }
+
+  // While set, calls run the original without touching the cache or the
+  // counters; cached results are kept for when it is cleared.
+  void SetBypass(bool bypass)
+  {
+    bypass_.store(bypass, std::memory_order_relaxed);
+  }
+  [[nodiscard]] auto bypassed() const -> bool
+  {
+    return bypass_.load(std::memory_order_relaxed);
+  }
+
+  // Drops every cached result, e.g. once the function's inputs changed
+  // under it.
+  void Clear()
+  {
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+      auto& shard = shards_[i];
+      const std::unique_lock lock{shard.mutex};
+      shard.index.clear();
+      shard.used = 0;
+      shard.hand = 0;
+    }
+  }
+
+  [[nodiscard]] auto stats() const -> MemoizeStats
+  {
+    MemoizeStats stats{};
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+      auto& shard = shards_[i];
+      stats.hits += shard.hits.load(std::memory_order_relaxed);
+      stats.misses += shard.misses.load(std::memory_order_relaxed);
+      stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+      const std::shared_lock lock{shard.mutex};
+      stats.size += shard.index.size();
+    }
+    return stats;
+  }
+
+  // Runs the original, uncached.
+  auto Call(Args... args) -> Ret
+  {
+    return hook_.template Call<Ret, Args...>(std::forward<Args>(args)...);
+  }
+  [[nodiscard]] auto hook() -> InlineHook& { return hook_; }
+
+ private:
+  struct Slot
+  {
+    Key key{};
+    Ret value{};
+    std::atomic<bool> referenced{false};
+  };
+
+  // On its own cache lines, so threads on different shards do not share
+  // lock or counter writes.
+  struct alignas(64) Shard
+  {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<Key, std::uint32_t> index;  // slot by key
+    std::vector<Slot> slots;                       // the clock ring
+    std::size_t used{0};
+    std::size_t hand{0};
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> evictions{0};
+  };
+
+  MemoizeHook(KeyFunction key, const MemoizeOptions& options)
+      : key_(key),
+        mask_(std::bit_ceil(std::max<std::size_t>(options.shards, 1)) - 1),
+        shards_(std::make_unique<Shard[]>(mask_ + 1))
+  {
+    const auto per_shard = std::max<std::size_t>(
+        (options.capacity + mask_) / (mask_ + 1), 1);
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+      shards_[i].slots = std::vector<Slot>(per_shard);
+      shards_[i].index.reserve(per_shard);
+    }
+  }
+
+  static auto _detour(Args... args) -> Ret
+  {
+    return instance_.load(std::memory_order_acquire)
+        ->_call(std::forward<Args>(args)...);
+  }
+
+  auto _call(Args... args) -> Ret
+  {
+    if (bypass_.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+      return Call(std::forward<Args>(args)...);
+    }
+    const Key key = key_(args...);
+    auto& shard = _shard(key);
+    if (auto hit = _lookup(shard, key))
+    {
+      shard.hits.fetch_add(1, std::memory_order_relaxed);
+      return *std::move(hit);
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    Ret result = Call(std::forward<Args>(args)...);
+    _insert(shard, key, result);
+    return result;
+  }
+
+  // Fibonacci hashing, so identity hashes of small integers still spread.
+  auto _shard(const Key& key) -> Shard&
+  {
+    const auto hash = static_cast<std::uint64_t>(std::hash<Key>{}(key));
+    return shards_[static_cast<std::size_t>(
+                       (hash * 0x9E3779B97F4A7C15ULL) >> 32) &
+                   mask_];
+  }
+
+  static auto _lookup(Shard& shard, const Key& key) -> std::optional<Ret>
+  {
+    const std::shared_lock lock{shard.mutex};
+    const auto found = shard.index.find(key);
+    if (found == shard.index.end()) { return std::nullopt; }
+    auto& slot = shard.slots[found->second];
+    // Skip the store when set, which keeps hot lines shared between cores.
+    if (not slot.referenced.load(std::memory_order_relaxed))
+    {
+      slot.referenced.store(true, std::memory_order_relaxed);
+    }
+    return slot.value;
+  }
+
+  // A result another thread inserted meanwhile is replaced by the same
+  // value. New results start unreferenced: one sweep of the hand evicts
+  // them unless they were hit since.
+  static void _insert(Shard& shard, const Key& key, const Ret& value)
+  {
+    const std::unique_lock lock{shard.mutex};
+    if (const auto found = shard.index.find(key); found != shard.index.end())
+    {
+      shard.slots[found->second].value = value;
+      return;
+    }
+    std::size_t victim = shard.used;
+    if (shard.used < shard.slots.size()) { ++shard.used; }
+    else
+    {
+      while (shard.slots[shard.hand].referenced.exchange(
+          false, std::memory_order_relaxed))
+      {
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+      }
+      victim = shard.hand;
+      shard.hand = (shard.hand + 1) % shard.slots.size();
+      shard.index.erase(shard.slots[victim].key);
+      shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto& slot = shard.slots[victim];
+    slot.key = key;
+    slot.value = value;
+    slot.referenced.store(false, std::memory_order_relaxed);
+    shard.index.emplace(key, static_cast<std::uint32_t>(victim));
+  }
+
+  static inline std::atomic<MemoizeHook*> instance_{nullptr};
+
+  KeyFunction key_;
+  std::size_t mask_;
+  std::unique_ptr<Shard[]> shards_;
+  InlineHook hook_;
+  std::atomic<bool> bypass_{false};
+};
+}  // namespace VeilHook
+
+#endif  // VH_MEMOIZE_HOOK_HPP
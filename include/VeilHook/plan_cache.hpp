@@ -0,0 +1,101 @@
+#ifndef VH_PLAN_CACHE_HPP
+#define VH_PLAN_CACHE_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/hook_plan.hpp>
+#include <VeilHook/utility.hpp>
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+namespace VeilHook
+{
+namespace Impl
+{
+// On-disk layout: one header followed by `count` fixed-size records sorted by
+// (build_id, offset), so a mapped file is binary searched in place.
+struct PlanCacheHeader
+{
+  static constexpr std::array<char, 8> kMagic{'V', 'H', 'P', 'L',
+                                              'A', 'N', '\0', '\0'};
+
+  std::array<char, 8> magic{kMagic};
+  std::uint32_t version{};
+  std::uint16_t pointer_size{};
+  std::uint16_t record_size{};
+  std::uint64_t count{};
+};
+
+struct PlanCacheRecord
+{
+  // Plans with longer prologues are simply not cached.
+  static constexpr std::size_t kMaxPrologue = 32;
+  static constexpr std::size_t kMaxInstructions = 8;
+
+  std::uint64_t build_id{};
+  std::uint32_t offset{};  // of the target from the module base
+  HookType type{HookType::None};
+  std::uint8_t prologue_size{};
+  std::uint8_t instruction_count{};
+  std::uint8_t reserved{};
+  std::uint16_t trampoline_size{};
+  std::array<std::uint8_t, kMaxPrologue> original_bytes{};
+  std::array<PlannedInstruction, kMaxInstructions> instructions{};
+};
+}  // namespace Impl
+
+// Hook plans persisted across runs, keyed by module build id and the target's
+// offset in that module. The file is mapped read-only; plans recorded with
+// Insert reach the disk on Save.
+class VH_API PlanCache final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // 2: E9 trampolines keep their destination literal on its own line.
+  // 3: x86 E9 trampolines reach the destination through a literal too.
+  static constexpr std::uint32_t kVersion = 3;
+
+  // A missing, truncated or incompatible file yields an empty cache.
+  explicit PlanCache(std::filesystem::path path);
+  ~PlanCache();
+
+  // The cached plan for `target`, if its original bytes still match the live
+  // code.
+  [[nodiscard]] auto Find(std::uintptr_t target) -> std::optional<Impl::HookPlan>;
+  // Records a freshly decoded plan. Targets outside a loaded image are ignored.
+  void Insert(const Impl::HookPlan& plan);
+  // Merges the recorded plans with whatever the file holds now and replaces it
+  // atomically, so concurrent writers never leave a torn file behind.
+  auto Save() -> std::expected<void, Error>;
+
+  [[nodiscard]] auto size() const -> std::size_t;
+  [[nodiscard]] auto path() const -> const std::filesystem::path&
+  {
+    return path_;
+  }
+
+ private:
+  [[nodiscard]] auto _module(std::uintptr_t address)
+      -> std::optional<Impl::ModuleInfo>;
+  void _map();
+  void _unmap();
+
+  std::filesystem::path path_;
+  Impl::FileView view_{};
+  std::span<const Impl::PlanCacheRecord> records_;
+  // Loaded images seen so far, sorted by base.
+  std::vector<Impl::ModuleInfo> modules_;
+  mutable std::shared_mutex mutex_;
+
+  std::vector<Impl::PlanCacheRecord> pending_;
+  std::mutex pending_mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_PLAN_CACHE_HPP
@@ -0,0 +1,70 @@
+#ifndef VH_RECLAIMER_HPP
+#define VH_RECLAIMER_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/guard.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VeilHook
+{
+// Code that unhooked targets no longer jump to (trampolines, guard stubs,
+// syscall thunks), held until no thread can still be running it.
+//
+// A thread may have been sent into a trampoline just before its target was
+// restored, or sit in a detour that returns into a guard stub. Collect
+// first interrupts every processor (FlushProcessWriteBuffers), after which
+// no new thread can arrive, then suspends the other threads one at a time
+// and looks for their instruction pointer, or any word of their stack,
+// inside a retired range. Blocks nobody points into go back to their
+// allocator; the rest wait for the next Collect. The stack scan is
+// conservative: a stale word can hold a block back, never free one early.
+//
+// Pointers the caller kept to a trampoline (e.g. an original function
+// pointer) are not tracked: stop calling through them before the hook goes.
+class VH_API Reclaimer final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // Retire runs a Collect once this many bytes more than after the last one
+  // are waiting.
+  static constexpr std::size_t kCollectBytes = 0x10000;
+
+  static auto Get() -> Reclaimer&;
+
+  // Calls `release` once no thread is executing in, or will return into,
+  // [range.first, range.second).
+  void Retire(MemoryRange range, std::move_only_function<void()> release);
+  void Retire(Allocation code);
+  void Retire(std::unique_ptr<Impl::GuardStub> guard);
+
+  // Releases what has become safe and returns how many blocks that was. A
+  // Collect already running on another thread makes this return 0 at once.
+  auto Collect() -> std::size_t;
+
+  [[nodiscard]] auto pending() const -> std::size_t;
+  [[nodiscard]] auto pending_bytes() const -> std::size_t;
+
+ private:
+  struct Retired
+  {
+    MemoryRange range;
+    std::move_only_function<void()> release;
+  };
+
+  Reclaimer() = default;
+  ~Reclaimer() = default;
+
+  mutable std::mutex mutex_;
+  std::vector<Retired> retired_;
+  std::size_t bytes_{0};
+  std::size_t collect_at_{kCollectBytes};
+  std::mutex collect_mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_RECLAIMER_HPP
@@ -0,0 +1,66 @@
+#ifndef VH_REMOTE_PROCESS_HPP
+#define VH_REMOTE_PROCESS_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/hook_plan.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace VeilHook
+{
+// A hook RemoteProcess installed. Its addresses are in the other process.
+struct RemoteHook
+{
+  std::uintptr_t target{};
+  std::uintptr_t trampoline{};  // calls the original function
+  Impl::HookPlan plan{};
+};
+
+// Hooks functions in another process of the same architecture, e.g. a child
+// started suspended, with destinations that already live there.
+//
+// Install works on the stopped process in batches: it reads the targets'
+// prologues in as few coalesced reads as their addresses allow, plans every
+// hook from that snapshot, writes all trampolines of a 1 GiB window with one
+// write into one block allocated near them, moves threads stopped inside a
+// prologue to its relocated copy and writes the patches with one write per
+// run of nearby targets. The process is only resumed once every hook of the
+// batch is in place.
+class VH_API RemoteProcess final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // Fails with Io when the process cannot be opened for writing.
+  static auto Open(std::uint32_t pid)
+      -> std::expected<std::unique_ptr<RemoteProcess>, Error>;
+  ~RemoteProcess();
+
+  // One result per target, in order. Targets whose prologue overlaps an
+  // earlier target's fail with NotEnoughSpace.
+  auto Install(std::span<const HookTarget> targets)
+      -> std::vector<std::expected<RemoteHook, Error>>;
+  // Restores the original prologues. The trampolines stay mapped: the
+  // process may still be running in or returning into them.
+  auto Uninstall(std::span<const RemoteHook> hooks)
+      -> std::expected<void, Error>;
+
+  auto Read(std::uintptr_t address, std::span<std::uint8_t> out) const
+      -> std::expected<void, Error>;
+  [[nodiscard]] auto pid() const -> std::uint32_t { return pid_; }
+
+ private:
+  RemoteProcess() = default;
+
+  void* handle_{nullptr};
+  std::uint32_t pid_{};
+  std::mutex mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_REMOTE_PROCESS_HPP
@@ -0,0 +1,118 @@
+#ifndef VH_SCANNER_HPP
+#define VH_SCANNER_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace VeilHook
+{
+// Byte signature with per-nibble wildcards.
+class VH_API Pattern
+{
+ public:
+  // IDA style: "48 8B ?? ?? 4? E8", where `?` or `??` matches any byte and
+  // `4?` / `?8` match one nibble.
+  static auto Parse(std::string_view signature) -> std::expected<Pattern, Error>;
+  // Code style: raw bytes plus a mask where 'x' is exact and '?' is any.
+  static auto FromMask(std::span<const std::uint8_t> bytes,
+                       std::string_view mask) -> std::expected<Pattern, Error>;
+
+  [[nodiscard]] auto size() const -> std::size_t { return bytes_.size(); }
+  [[nodiscard]] auto bytes() const -> std::span<const std::uint8_t>
+  {
+    return bytes_;
+  }
+  [[nodiscard]] auto mask() const -> std::span<const std::uint8_t>
+  {
+    return mask_;
+  }
+  // Exact bytes the vector kernels search for before verifying the rest:
+  // `anchor_size` bytes starting at `anchor`. 0 when no byte is exact, in
+  // which case every position is verified.
+  [[nodiscard]] auto anchor() const -> std::size_t { return anchor_; }
+  [[nodiscard]] auto anchor_size() const -> std::size_t { return anchor_size_; }
+
+  [[nodiscard]] auto matches(const std::uint8_t* data) const -> bool
+  {
+    for (std::size_t i = 0; i < bytes_.size(); ++i)
+    {
+      if (((data[i] ^ bytes_[i]) & mask_[i]) != 0) { return false; }
+    }
+    return true;
+  }
+
+ private:
+  static auto _make(std::vector<std::uint8_t> bytes,
+                    std::vector<std::uint8_t> mask)
+      -> std::expected<Pattern, Error>;
+
+  std::vector<std::uint8_t> bytes_;
+  std::vector<std::uint8_t> mask_;  // 0xFF exact, 0x00 any, nibble otherwise
+  std::size_t anchor_{0};
+  std::size_t anchor_size_{1};
+};
+
+struct ScanMatch
+{
+  std::size_t pattern;  // index into the scanner's patterns
+  std::uintptr_t address;
+};
+
+// Searches memory for many patterns at once. Input is split into chunks that
+// are scanned in parallel; every pattern runs over a chunk while it is still
+// in cache, so memory is streamed once regardless of the pattern count.
+class VH_API Scanner
+{
+ public:
+  enum class Kernel : std::uint8_t
+  {
+    Scalar,
+    Sse2,
+    Avx2
+  };
+
+  explicit Scanner(std::vector<Pattern> patterns);
+
+  // The fastest kernel this CPU and OS support.
+  static auto detect() -> Kernel;
+  static auto supported(Kernel kernel) -> bool;
+
+  // Falls back to the best supported kernel below `kernel`.
+  void set_kernel(Kernel kernel);
+  [[nodiscard]] auto kernel() const -> Kernel { return kernel_; }
+  // 0 uses every hardware thread.
+  void set_concurrency(std::size_t threads) { threads_ = threads; }
+
+  // Every match in `memory`, ordered by pattern then address.
+  [[nodiscard]] auto Scan(std::span<const std::uint8_t> memory) const
+      -> std::vector<ScanMatch>;
+  // Every match in the executable sections of the image at `module`.
+  [[nodiscard]] auto ScanModule(std::uintptr_t module) const
+      -> std::expected<std::vector<ScanMatch>, Error>;
+  [[nodiscard]] auto ScanModule(std::string_view module) const
+      -> std::expected<std::vector<ScanMatch>, Error>;
+
+  // First match of one signature in a loaded module, ready for
+  // InlineHook::Create.
+  static auto Find(std::string_view module, std::string_view signature)
+      -> std::expected<std::uintptr_t, Error>;
+
+  [[nodiscard]] auto patterns() const -> std::span<const Pattern>
+  {
+    return patterns_;
+  }
+
+ private:
+  std::vector<Pattern> patterns_;
+  Kernel kernel_;
+  std::size_t threads_{0};
+};
+}  // namespace VeilHook
+
+#endif  // VH_SCANNER_HPP
@@ -0,0 +1,138 @@
+#ifndef VH_STATIC_HOOKS_HPP
+#define VH_STATIC_HOOKS_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <type_traits>
+
+// Hooks declared at namespace scope are collected in the `.vhook` section of
+// their module: the linker sorts `.vhook$a`, `$m` and `$z` by suffix, so the
+// entries land between the two markers below. Linker padding between object
+// files shows up as null entries.
+#if defined(_MSC_VER)
+#pragma section(".vhook$a", read)
+#pragma section(".vhook$m", read)
+#pragma section(".vhook$z", read)
+#if defined(VH_COMPILER_CLANG)
+#define VH_STATIC_HOOK_SECTION(part) \
+  __declspec(allocate(".vhook$" #part)) __attribute__((used))
+#else
+#define VH_STATIC_HOOK_SECTION(part) __declspec(allocate(".vhook$" #part))
+#endif
+#else
+#define VH_STATIC_HOOK_SECTION(part) \
+  __attribute__((section(".vhook$" #part), used))
+#endif
+
+namespace VeilHook
+{
+// Compile-time description of one hook; every field is a constant.
+struct StaticHook
+{
+  // Either `target` or a `module`/`symbol` pair for SymbolIndex.
+  std::uintptr_t (*target)();
+  const char* module;
+  const char* symbol;
+  std::uintptr_t (*destination)();
+  // Receives the trampoline once installed, 0 once uninstalled.
+  void (*publish)(std::uintptr_t trampoline);
+};
+
+namespace Impl
+{
+VH_STATIC_HOOK_SECTION(a)
+inline const StaticHook* const static_hooks_begin = nullptr;
+VH_STATIC_HOOK_SECTION(z)
+inline const StaticHook* const static_hooks_end = nullptr;
+
+// Null entries are skipped, as are hooks already installed.
+VH_API auto install_static_hooks(std::span<const StaticHook* const> hooks,
+                                 HookOptions options)
+    -> std::expected<std::size_t, Error>;
+VH_API void uninstall_static_hooks(std::span<const StaticHook* const> hooks);
+
+template <auto Function>
+auto static_address() -> std::uintptr_t
+{
+  return detail::address_cast(Function);
+}
+
+template <auto& Original>
+void static_publish(std::uintptr_t trampoline)
+{
+  Original =
+      detail::address_cast<std::remove_reference_t<decltype(Original)>>(
+          trampoline);
+}
+
+inline auto static_hooks() -> std::span<const StaticHook* const>
+{
+  return {&static_hooks_begin + 1, &static_hooks_end};
+}
+}  // namespace Impl
+
+// Resolves and installs every hook declared in the calling module in one
+// batch and publishes the trampolines to their VH_ORIGINAL pointers. Returns
+// how many were installed; if any failed, the first error instead, with the
+// others left installed. Hooks already installed are left alone.
+inline auto InstallStaticHooks(HookOptions options = {})
+    -> std::expected<std::size_t, Error>
+{
+  return Impl::install_static_hooks(Impl::static_hooks(), options);
+}
+
+// Disables and frees the calling module's static hooks, e.g. before it
+// unloads.
+inline void UninstallStaticHooks()
+{
+  Impl::uninstall_static_hooks(Impl::static_hooks());
+}
+}  // namespace VeilHook
+
+// Typed pointer to the original function of a hook's detour.
+#define VH_ORIGINAL(detour) detour##_original
+
+// Hooks `function` with `detour`, declaring `detour` with the function's
+// exact type, calling convention included; define it anywhere in the same
+// namespace. Use outside anonymous namespaces, whose entries the compiler may
+// drop as unreferenced.
+//
+//   VH_DECLARE_HOOK(MessageBoxW, hooked_message_box);
+//   auto WINAPI hooked_message_box(HWND w, LPCWSTR text, LPCWSTR caption,
+//                                  UINT type) -> int
+//   {
+//     return VH_ORIGINAL(hooked_message_box)(w, L"hooked", caption, type);
+//   }
+#define VH_DECLARE_HOOK(function, detour)                                 \
+  decltype(function) detour;                                              \
+  constinit decltype(&function) VH_ORIGINAL(detour) = nullptr;            \
+  constinit const ::VeilHook::StaticHook detour##_static_hook{            \
+      .target = &::VeilHook::Impl::static_address<&function>,             \
+      .module = nullptr,                                                  \
+      .symbol = nullptr,                                                  \
+      .destination = &::VeilHook::Impl::static_address<&detour>,          \
+      .publish = &::VeilHook::Impl::static_publish<VH_ORIGINAL(detour)>}; \
+  VH_STATIC_HOOK_ENTRY(detour)
+
+// Hooks `symbol_name` of `module_name`, looked up by name at install time,
+// with an already declared `detour` whose type the original pointer takes.
+#define VH_DECLARE_NAMED_HOOK(module_name, symbol_name, detour)           \
+  constinit decltype(&detour) VH_ORIGINAL(detour) = nullptr;              \
+  constinit const ::VeilHook::StaticHook detour##_static_hook{            \
+      .target = nullptr,                                                  \
+      .module = module_name,                                              \
+      .symbol = symbol_name,                                              \
+      .destination = &::VeilHook::Impl::static_address<&detour>,          \
+      .publish = &::VeilHook::Impl::static_publish<VH_ORIGINAL(detour)>}; \
+  VH_STATIC_HOOK_ENTRY(detour)
+
+// External linkage keeps the entry from being discarded as unreferenced.
+#define VH_STATIC_HOOK_ENTRY(detour)                                      \
+  extern VH_STATIC_HOOK_SECTION(m) const ::VeilHook::StaticHook* const    \
+      detour##_static_hook_entry = &detour##_static_hook
+
+#endif  // VH_STATIC_HOOKS_HPP
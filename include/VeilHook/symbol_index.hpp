@@ -0,0 +1,111 @@
+#ifndef VH_SYMBOL_INDEX_HPP
+#define VH_SYMBOL_INDEX_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/utility.hpp>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VeilHook
+{
+namespace Impl
+{
+// Qualified name of an MSVC-decorated symbol, "ns::Class::method" for
+// "?method@Class@ns@@QEAAXXZ". Empty for undecorated names and for what it
+// does not understand: operators, special members, templates, back
+// references.
+[[nodiscard]] auto undecorate(std::string_view name) -> std::string;
+}  // namespace Impl
+
+struct Symbol
+{
+  std::string_view module;
+  std::string_view name;
+  std::uintptr_t address;
+};
+
+// Exported symbols of loaded modules, sorted by name for binary search and
+// prefix scans. Names are copied out of the images, so lookups never touch
+// unloaded memory; addresses are absolute, forwarders already followed.
+// Symbols returned by FindPrefix stay valid until their module is removed.
+//
+// Get() drops modules as the loader unloads them. Other indexes go stale
+// instead: tell them with RemoveModule. AddModule re-indexes a base that now
+// holds a different build.
+//
+// An empty `module` argument searches every indexed module; otherwise it
+// matches a file name case-insensitively, with or without its extension.
+class VH_API SymbolIndex final : detail::NoCopy, detail::NoMove
+{
+ public:
+  SymbolIndex() = default;
+
+  // Process-wide index, filled with the modules loaded at first use and kept
+  // in step with unloads.
+  static auto Get() -> SymbolIndex&;
+
+  void AddLoadedModules();
+  auto AddModule(std::uintptr_t base) -> std::expected<void, Error>;
+  auto AddModule(std::string_view module) -> std::expected<void, Error>;
+  // Drops a module's symbols, e.g. before it is unloaded.
+  void RemoveModule(std::uintptr_t base);
+
+  [[nodiscard]] auto Find(std::string_view module, std::string_view name) const
+      -> std::expected<std::uintptr_t, Error>;
+  // By undecorated C++ name, e.g. "std::_Xlength_error".
+  [[nodiscard]] auto FindDemangled(std::string_view module,
+                                   std::string_view name) const
+      -> std::expected<std::uintptr_t, Error>;
+  [[nodiscard]] auto FindPrefix(std::string_view module,
+                                std::string_view prefix) const
+      -> std::vector<Symbol>;
+
+  // Exact, then undecorated name. A named module that was loaded after it
+  // was last indexed is indexed first.
+  auto Resolve(std::string_view module, std::string_view name)
+      -> std::expected<std::uintptr_t, Error>;
+
+  [[nodiscard]] auto size() const -> std::size_t;
+
+ private:
+  struct Module
+  {
+    std::uintptr_t base;
+    std::uint64_t build_id;
+    std::string name;
+    // Raw and undecorated names of its entries, back to back.
+    std::unique_ptr<char[]> names;
+  };
+  struct Entry
+  {
+    std::string_view name;
+    std::uint32_t module;
+    std::uintptr_t address;
+  };
+
+  static void _notify(Impl::ModuleEvent event, std::uintptr_t base,
+                      std::string_view name, void* context);
+  [[nodiscard]] auto _indexed(std::string_view module) const -> bool;
+  // Erases the module's entries and names; call with the lock held.
+  void _remove(std::uint32_t module);
+  [[nodiscard]] auto _find(const std::vector<Entry>& entries,
+                           std::string_view module,
+                           std::string_view name) const
+      -> std::expected<std::uintptr_t, Error>;
+
+  // A deque keeps module names stable while modules are added.
+  std::deque<Module> modules_;
+  std::vector<Entry> by_name_;
+  std::vector<Entry> by_undecorated_;
+  mutable std::shared_mutex mutex_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_SYMBOL_INDEX_HPP
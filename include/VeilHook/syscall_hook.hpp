@@ -0,0 +1,107 @@
+#ifndef VH_SYSCALL_HOOK_HPP
+#define VH_SYSCALL_HOOK_HPP
+
+#include <VeilHook/allocator.hpp>
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace VeilHook
+{
+// A system call stub exported by ntdll or win32u.
+struct Syscall
+{
+  std::string_view name;  // valid while the module stays loaded
+  std::uint32_t number;
+  std::uintptr_t address;      // stub entry
+  std::uintptr_t instruction;  // its syscall, sysenter or transition call
+};
+
+namespace Impl
+{
+// Every `Nt` export shaped like a system call stub, by number. Stubs are
+// recognised by their `mov eax, number` prologue (after `mov r10, rcx` on
+// x64) and the kernel transition that follows it before any return.
+[[nodiscard]] auto find_syscalls(std::uintptr_t base)
+    -> std::expected<std::vector<Syscall>, Error>;
+// Dispatch table slots for `syscalls`: one past the largest `number & mask`.
+// Fails with UnsupportedInstruction if two numbers share an index, since
+// the table could not tell them apart.
+[[nodiscard]] auto dispatch_slots(std::span<const Syscall> syscalls,
+                                  std::uint32_t mask)
+    -> std::expected<std::size_t, Error>;
+}  // namespace Impl
+
+// Routes every system call stub of a module through a per-number table, so
+// calls can be audited or answered in process at the cost of one indirect
+// jump instead of a trap. Each stub jumps to a thunk that branches through
+// its table slot; the slot holds either a handler or the stub's trampoline,
+// which issues the real system call.
+//
+// Handlers have the stub's own prototype, e.g.
+// NTSTATUS NTAPI(HANDLE) for NtClose, and reach the kernel through Call or
+// Original. Code that calls the instruction directly is not intercepted.
+class VH_API SyscallHook final : detail::NoCopy, detail::NoMove
+{
+ public:
+  // Table index bits of a system call number; win32u numbers carry 0x1000.
+  static constexpr std::uint32_t kIndexMask = 0xFFF;
+
+  // Hooks every stub of `module` with pass-through slots.
+  static auto Create(std::string_view module = "ntdll.dll",
+                     HookOptions options = {})
+      -> std::expected<std::unique_ptr<SyscallHook>, Error>;
+  // Restores every stub.
+  ~SyscallHook();
+
+  // Takes effect for calls entering the stub afterwards; 0 passes through.
+  auto SetHandler(std::uint32_t number, std::uintptr_t handler)
+      -> std::expected<void, Error>;
+  auto SetHandler(std::string_view name, std::uintptr_t handler)
+      -> std::expected<void, Error>;
+
+  [[nodiscard]] auto Number(std::string_view name) const
+      -> std::expected<std::uint32_t, Error>;
+  // Issues the system call itself, bypassing handlers; 0 for unknown
+  // numbers.
+  [[nodiscard]] auto Original(std::uint32_t number) const -> std::uintptr_t;
+
+  template <typename Ret, class... Args>
+  Ret Call(std::uint32_t number, Args&&... args) const
+  {
+    return detail::address_cast<Ret(VH_STDCALL*)(Args...)>(Original(number))(
+        std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] auto syscalls() const -> std::span<const Syscall>
+  {
+    return syscalls_;
+  }
+
+ private:
+  // `FF 25` jmp through the slot, padded with int3.
+  static constexpr std::size_t kThunkSize = 8;
+
+  SyscallHook() = default;
+
+  [[nodiscard]] auto _slot(std::uint32_t number) const -> std::uintptr_t*;
+
+  std::vector<Syscall> syscalls_;
+  // Slots, then one thunk per stub from the next cache line; next to the
+  // module so the stubs reach it with a rel32 jump.
+  std::unique_ptr<Allocation> dispatch_;
+  std::size_t slots_{0};
+  std::vector<std::uintptr_t> originals_;  // trampolines, by table index
+  std::unique_ptr<HookRegistry> registry_;
+  std::vector<HookHandle> handles_;
+};
+}  // namespace VeilHook
+
+#endif  // VH_SYSCALL_HOOK_HPP
@@ -0,0 +1,155 @@
+#ifndef VH_TRACE_HPP
+#define VH_TRACE_HPP
+
+#include <VeilHook/common.hpp>
+#include <VeilHook/error.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VeilHook
+{
+// Steps of installing a hook, in the order Create and Enable run them.
+enum class TracePhase : std::uint8_t
+{
+  Decode,    // prologue decoding into a HookPlan
+  Allocate,  // near-allocation search; `count` is its vm_query calls
+  Emit,      // trampoline and guard stub code
+  Protect,   // one page protection change
+  Write,     // patch bytes into the target
+  Veh,       // prologue guard registration
+};
+
+struct TraceEvent
+{
+  std::uint64_t start_ns{};  // since the tracer was enabled
+  std::uint64_t duration_ns{};
+  std::uintptr_t target{};
+  std::uint32_t thread{};  // filled in by Record
+  std::uint32_t count{};
+  TracePhase phase{};
+  Error result{};  // Success, or why the phase failed
+};
+
+// Opt-in record of install phases, compiled in only with the
+// VEIL_HOOK_TRACING CMake option; without it every trace point is an empty
+// inline object and the tracer stays empty. Even compiled in, nothing is
+// recorded until Enable.
+//
+// Events go into a fixed buffer claimed with one fetch_add per event; once
+// it is full further events are counted as dropped.
+class VH_API Tracer final : detail::NoCopy, detail::NoMove
+{
+ public:
+  static auto Get() -> Tracer&;
+
+  // Starts a fresh buffer. Not safe while another thread is recording.
+  void Enable(std::size_t capacity = std::size_t{1} << 16);
+  void Disable();
+  [[nodiscard]] auto enabled() const -> bool
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Completed events in claim order.
+  [[nodiscard]] auto Events() const -> std::vector<TraceEvent>;
+  [[nodiscard]] auto dropped() const -> std::size_t;
+
+  // Chrome trace event format ("X" events), loadable in chrome://tracing
+  // or Perfetto.
+  [[nodiscard]] static auto ToChromeTrace(
+      const std::vector<TraceEvent>& events) -> std::string;
+  auto WriteChromeTrace(const std::filesystem::path& path) const
+      -> std::expected<void, Error>;
+
+  void Record(TraceEvent event);
+  [[nodiscard]] auto now() const -> std::uint64_t;
+
+ private:
+  struct Slot;
+
+  Tracer();
+  ~Tracer();
+
+  std::atomic<bool> enabled_{false};
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t capacity_{0};
+  std::atomic<std::size_t> next_{0};
+  std::chrono::steady_clock::time_point epoch_;
+};
+
+[[nodiscard]] VH_API auto to_string(TracePhase phase) -> const char*;
+[[nodiscard]] VH_API auto to_string(Error error) -> const char*;
+
+namespace Impl
+{
+// vm_query calls made by the calling thread so far.
+VH_API auto trace_vm_queries() -> std::uint32_t&;
+
+// Times its own lifetime as one event, if the tracer is enabled when it is
+// constructed.
+class TraceScope final : detail::NoCopy, detail::NoMove
+{
+ public:
+  TraceScope(TracePhase phase, std::uintptr_t target)
+      : phase_(phase), target_(target)
+  {
+    if (not Tracer::Get().enabled()) { return; }
+    active_ = true;
+    start_ = Tracer::Get().now();
+    if (phase_ == TracePhase::Allocate) { queries_ = trace_vm_queries(); }
+  }
+  ~TraceScope()
+  {
+    if (not active_) { return; }
+    auto& tracer = Tracer::Get();
+    if (phase_ == TracePhase::Allocate)
+    {
+      count_ += trace_vm_queries() - queries_;
+    }
+    tracer.Record({.start_ns = start_,
+                   .duration_ns = tracer.now() - start_,
+                   .target = target_,
+                   .count = count_,
+                   .phase = phase_,
+                   .result = result_});
+  }
+
+  void fail(Error error) { result_ = error; }
+  void count(std::uint32_t count) { count_ += count; }
+
+ private:
+  TracePhase phase_;
+  std::uintptr_t target_;
+  bool active_{false};
+  Error result_{Error::Success};
+  std::uint32_t count_{0};
+  std::uint32_t queries_{0};
+  std::uint64_t start_{0};
+};
+
+class NullTraceScope final
+{
+ public:
+  NullTraceScope(TracePhase /*phase*/, std::uintptr_t /*target*/) {}
+  void fail(Error /*error*/) {}
+  void count(std::uint32_t /*count*/) {}
+};
+}  // namespace Impl
+
+#if defined(VEIL_HOOK_TRACING)
+#define VH_TRACE_SCOPE(name, phase, target) \
+  ::VeilHook::Impl::TraceScope name{::VeilHook::TracePhase::phase, target}
+#else
+#define VH_TRACE_SCOPE(name, phase, target) \
+  [[maybe_unused]] ::VeilHook::Impl::NullTraceScope name{ \
+      ::VeilHook::TracePhase::phase, target}
+#endif
+}  // namespace VeilHook
+
+#endif  // VH_TRACE_HPP
@@ -9,10 +9,18 @@
 #include <winnt.h>
 #endif
 
+#include <array>
+#include <atomic>
+#include <deque>
 #include <expected>
-#include <functional>
+#include <filesystem>
+#include <memory>
 #include <mutex>
-#include <unordered_set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 
 namespace VeilHook::Impl
@@ -40,11 +48,165 @@ namespace VeilHook::Impl
     };
 
 
+    // Image mapping that contains an address. `build_id` identifies the exact
+    // binary: its CodeView GUID and age when present, otherwise the PE
+    // timestamp, image size and checksum.
+    struct ModuleInfo
+    {
+        std::uintptr_t base;
+        std::size_t size;
+        std::uint64_t build_id;
+    };
+
+    struct SectionInfo
+    {
+        std::uintptr_t address;
+        std::size_t size;
+        bool executable;
+    };
+
+    // A named export; forwarders are already resolved to their final address.
+    struct ExportInfo
+    {
+        std::string_view name;
+        std::uintptr_t address;
+    };
+
+    enum class ModuleEvent : std::uint8_t
+    {
+        Loaded,
+        Unloaded
+    };
+    // Called with the lower-case file name. Runs under the loader lock: it
+    // must not load libraries or wait on threads that might.
+    using ModuleCallback = void (*)(ModuleEvent event, std::uintptr_t base, std::string_view name, void* context);
+
+    // A thread caught between two instructions: where it is and the words of
+    // its stack from the stack pointer up to the end of the committed part.
+    struct ThreadState
+    {
+        std::uintptr_t ip;
+        std::span<const std::uintptr_t> stack;
+    };
+    // Runs while the thread is suspended: it must not allocate or lock.
+    using ThreadVisitor = void (*)(const ThreadState& state, void* context);
+
+    // Code range of a function and its UNWIND_INFO.
+    struct FunctionEntry
+    {
+        std::uintptr_t begin;
+        std::uintptr_t end;
+        const std::uint8_t* unwind;
+    };
+
+    // Read-only view of a whole file.
+    struct FileView
+    {
+        const std::uint8_t* data;
+        std::size_t size;
+    };
+
     [[nodiscard]] auto get_system_info() -> SystemInfo;
     [[nodiscard]] auto vm_alloc(std::uintptr_t, std::size_t, VMAccess) -> std::expected<std::uintptr_t, Error>;
     auto vm_free(std::uintptr_t) -> void;
     auto vm_protect(std::uintptr_t, std::size_t, VMAccess, VMAccess&) -> bool;
     [[nodiscard]] auto vm_query(std::uintptr_t) -> std::expected<VMInfo, Error>;
+    [[nodiscard]] auto module_query(std::uintptr_t) -> std::expected<ModuleInfo, Error>;
+    // Base of an already loaded module; an empty name is the executable.
+    [[nodiscard]] auto module_find(std::string_view name) -> std::expected<std::uintptr_t, Error>;
+    [[nodiscard]] auto module_sections(std::uintptr_t base) -> std::expected<std::vector<SectionInfo>, Error>;
+    [[nodiscard]] auto module_list() -> std::vector<std::uintptr_t>;
+    // Lower-case file name, e.g. "kernel32.dll".
+    [[nodiscard]] auto module_name(std::uintptr_t base) -> std::string;
+    // Names point into the mapped image and live as long as it stays loaded.
+    [[nodiscard]] auto module_exports(std::uintptr_t base) -> std::expected<std::vector<ExportInfo>, Error>;
+    // Loads are reported after the image is mapped and its imports are
+    // resolved, before its entry point runs; unloads before it is unmapped.
+    [[nodiscard]] auto module_watch(ModuleCallback callback, void* context) -> std::expected<void*, Error>;
+    auto module_unwatch(void* watch) -> void;
+    [[nodiscard]] auto file_map(const std::filesystem::path&) -> std::expected<FileView, Error>;
+    auto file_unmap(FileView) -> void;
+    // Atomically replaces `to` with `from`.
+    [[nodiscard]] auto file_replace(const std::filesystem::path& from, const std::filesystem::path& to) -> bool;
+    [[nodiscard]] auto process_id() -> std::uint32_t;
+    [[nodiscard]] auto thread_id() -> std::uint32_t;
+    // Interrupts every processor running a thread of the process, so each has
+    // retired its in-flight instructions and sees every earlier store.
+    auto flush_write_buffers() -> void;
+    // Another process on this host, with the same architecture, opened for
+    // reading, writing, allocating in and suspending it; nullptr on failure.
+    [[nodiscard]] auto process_open(std::uint32_t pid) -> void*;
+    auto process_close(void* process) -> void;
+    [[nodiscard]] auto process_read(void* process, std::uintptr_t address, std::span<std::uint8_t> out) -> bool;
+    // Leaves page protections alone; see process_protect.
+    [[nodiscard]] auto process_write(void* process, std::uintptr_t address, std::span<const std::uint8_t> data) -> bool;
+    [[nodiscard]] auto process_alloc(void* process, std::uintptr_t address, std::size_t size, VMAccess access) -> std::expected<std::uintptr_t, Error>;
+    auto process_protect(void* process, std::uintptr_t address, std::size_t size, VMAccess access, VMAccess& old_access) -> bool;
+    [[nodiscard]] auto process_query(void* process, std::uintptr_t address) -> std::expected<VMInfo, Error>;
+    // Suspends and resumes every thread of the process at once.
+    [[nodiscard]] auto process_suspend(void* process) -> bool;
+    auto process_resume(void* process) -> void;
+    auto process_flush(void* process, std::uintptr_t address, std::size_t size) -> void;
+    // Returns where a thread stopped at `ip` has to continue instead, or `ip`.
+    using IpMove = std::uintptr_t (*)(std::uintptr_t ip, void* context);
+    // Moves the threads of the suspended process `pid` as `move` says. False
+    // if they could not be enumerated.
+    [[nodiscard]] auto process_move_threads(std::uint32_t pid, IpMove move, void* context) -> bool;
+    // Suspends the other threads of the process one at a time and visits each
+    // before resuming it. The calling thread is visited with ip 0 and its stack
+    // from `stack` up, which leaves the caller's own frame out. False if the
+    // threads could not be enumerated.
+    [[nodiscard]] auto visit_threads(std::uintptr_t stack, ThreadVisitor visit, void* context) -> bool;
+    // The exception directory entry of the function containing `address`
+    // (x64), or the one an earlier function_table_add registered.
+    [[nodiscard]] auto function_entry(std::uintptr_t address) -> std::expected<FunctionEntry, Error>;
+    // Registers the RUNTIME_FUNCTION at `table`, whose addresses are relative
+    // to `base`, for code outside any image; false on x86.
+    [[nodiscard]] auto function_table_add(std::uintptr_t table, std::uintptr_t base) -> bool;
+    auto function_table_remove(std::uintptr_t table) -> void;
+
+    inline auto ascii_lower(std::string_view text) -> std::string
+    {
+        std::string result{text};
+        for (auto& c : result)
+        {
+            if (c >= 'A' && c <= 'Z') { c = static_cast<char>(c - 'A' + 'a'); }
+        }
+        return result;
+    }
+
+    // Both lower case; "kernel32" also matches "kernel32.dll".
+    inline auto module_matches(std::string_view name, std::string_view wanted) -> bool
+    {
+        if (wanted.empty() || name == wanted) { return true; }
+        return name.size() > wanted.size() && name.starts_with(wanted) && name[wanted.size()] == '.' &&
+               name.find('.', wanted.size() + 1) == std::string_view::npos;
+    }
+
+    // Runs `fn(i)` for i in [0, count) on up to `workers` threads (hardware
+    // concurrency when 0), handing out `grain` indices at a time.
+    template <typename Fn>
+    void parallel_for(std::size_t count, Fn&& fn, std::size_t grain = 64, std::size_t workers = 0)
+    {
+        const auto chunks = (count + grain - 1) / grain;
+        if (workers == 0) { workers = std::max(1U, std::thread::hardware_concurrency()); }
+        workers = std::min(workers, chunks);
+        std::atomic<std::size_t> next{0};
+        const auto work = [&]
+        {
+            for (;;)
+            {
+                const auto begin = next.fetch_add(grain);
+                if (begin >= count) { return; }
+                const auto end = std::min(count, begin + grain);
+                for (auto i = begin; i < end; ++i) { fn(i); }
+            }
+        };
+
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 1; i < workers; ++i) { threads.emplace_back(work); }
+        work();
+    }
 
     class VMProtect
     {
@@ -67,48 +229,94 @@ namespace VeilHook::Impl
         bool status_ = false;
         VMAccess old_protect_ = 0;
     };
+    // RWX over the pages under each [first, second) range, sorted by address,
+    // until destroyed; one VirtualProtect per run of adjacent pages. Unlike
+    // patch_access, never drops execute rights: other threads keep running
+    // the rest of those pages while the ranges are written.
+    [[nodiscard]] auto protect_pages(std::span<const std::pair<std::uintptr_t, std::uintptr_t>> ranges) -> std::deque<VMProtect>;
     struct VehEntry
     {
-        using Callback = std::function<LONG(PEXCEPTION_POINTERS)>;
+        // A plain function so registering never allocates; `context` is the
+        // entry's own word of state, e.g. where a trapped call goes.
+        using Callback = LONG (*)(PEXCEPTION_POINTERS info, const VehEntry& entry);
         std::uintptr_t start_address;
         std::uintptr_t end_address;
         Callback callback;
-        auto operator==(const VehEntry& other) const
-        {
-            return start_address == other.start_address &&
-                   end_address == other.end_address;
-        }
-        auto operator()(const VehEntry& other) const -> std::size_t
-        {
-            return std::hash<std::uintptr_t>{}(other.start_address) ^ (std::hash<std::uintptr_t>{}(other.end_address) << 1);
-        }
+        std::uintptr_t context{};
+    };
+
+    // Snapshot of the registered ranges, sorted by start address. `max_end[i]`
+    // is the largest end address among entries [0, i], which lets the binary
+    // search step back over overlapping ranges and stop early.
+    struct VehTable
+    {
+        std::span<VehEntry> entries;
+        std::span<std::uintptr_t> max_end;
+        // Handlers inside this snapshot; it is only rewritten at zero.
+        mutable std::atomic<std::uint32_t> readers{0};
+
+        [[nodiscard]] auto find(std::uintptr_t address) const -> const VehEntry*;
     };
 
+    // Registered ranges live in two fixed tables mapped once: writers fill the
+    // one handlers are not reading and publish it, so Register and Unregister
+    // never touch the heap and can run where allocating is not allowed.
     class VehManager final
     {
         public:
+        // Entries that fit in each table; Register fails beyond it.
+        static constexpr std::size_t kCapacity = std::size_t{1} << 16;
+
         VehManager(const VehManager&) = delete;
         auto operator=(const VehManager&) -> VehManager& = delete;
         VehManager(VehManager&&) = delete;
         auto operator=(VehManager&&) -> VehManager& = delete;
 
         static auto instance() -> VehManager&;
-        void Register(std::uintptr_t start_address, std::uintptr_t end_address, VehEntry::Callback callback);
-        void Register(std::uintptr_t address, VehEntry::Callback  callback) { Register(address, address, std::move(callback)); }
+        // False if the table is full or could not be mapped.
+        [[nodiscard]] auto Register(std::uintptr_t start_address, std::uintptr_t end_address, VehEntry::Callback callback, std::uintptr_t context = 0) -> bool;
+        [[nodiscard]] auto Register(std::uintptr_t address, VehEntry::Callback callback, std::uintptr_t context = 0) -> bool { return Register(address, address, callback, context); }
+        [[nodiscard]] auto Register(std::span<const VehEntry> entries) -> bool;
         void Unregister(std::uintptr_t address);
+        void Unregister(std::span<const std::uintptr_t> addresses);
+
+        // Lock-free lookup used by the vectored handler; never blocks on
+        // Register/Unregister.
+        static auto Dispatch(PEXCEPTION_POINTERS info) -> LONG;
 
         private:
         VehManager();
         ~VehManager();
 
-
         static auto VH_STDCALL _handler(PEXCEPTION_POINTERS) -> LONG;
+        // Entries of the published table; only stable under `mutex_`.
+        static auto _published() -> std::span<const VehEntry>;
+        // The table handlers are not reading, once the last straggler has left
+        // it, with its storage at full capacity; empty if nothing is mapped.
+        static auto _spare() -> VehTable&;
+        // Publishes the first `size` entries of `table`.
+        static void _publish(VehTable& table, std::size_t size);
 
+        // Serialises writers only; handlers read `table_` without locking.
         static std::mutex mutex_;
-        static std::unordered_set<VehEntry> entries_;
+        static std::atomic<const VehTable*> table_;
+        static std::array<VehTable, 2> tables_;
+        static void* storage_;
         static void* handle_;
         
     };
+
+    // Protection to patch `target` under: RWX when dropping execute rights
+    // could pull the page from under running code, i.e. our own image or
+    // VirtualProtect itself; RW otherwise.
+    [[nodiscard]] auto patch_access(std::uintptr_t target) -> VMAccess;
+    // Sends a thread that faults one byte into the patched prologue starting
+    // at the entry's start address back to its start.
+    auto prologue_guard(PEXCEPTION_POINTERS info, const VehEntry& entry) -> LONG;
+    // Completes the call a thread traps on when it meets the int3 parked on
+    // the `call rel32` at the entry's start address: pushes the return address
+    // and enters the callee held in its context.
+    auto call_guard(PEXCEPTION_POINTERS info, const VehEntry& entry) -> LONG;
 }
 
 
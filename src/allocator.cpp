@@ -13,6 +13,10 @@ namespace VeilHook
 namespace
 {
 std::shared_ptr<Allocator> g_allocator = std::make_shared<Allocator>();
+
+// Spare block list nodes kept on hand after mapping a heap: enough to carve
+// that many blocks before the next heap without allocating.
+constexpr std::size_t kSpareNodes = 64;
 }
 
 struct Allocator::MemoryBlock
@@ -36,10 +40,18 @@ struct Allocator::Memory
 
 auto Allocator::Get() -> std::shared_ptr<Allocator> { return g_allocator; }
 
+Allocator::Allocator() = default;
+
+Allocator::~Allocator()
+{
+  for (const auto& heap : memory_) { Impl::vm_free(heap->address); }
+}
+
 auto Allocation::operator=(Allocation&& other) noexcept -> Allocation&
 {
   if (this != &other)
   {
+    free();
     allocator_ = std::move(other.allocator_);
     address_ = other.address_;
     size_ = other.size_;
@@ -53,16 +65,28 @@ void Allocation::free() noexcept
 { 
   if (allocator_ and address_ != 0 and size_ != 0)
   {
-    allocator_->_deallocate(address_);
+    {
+      std::scoped_lock lock{allocator_->mutex_};
+      allocator_->_deallocate(address_);
+    }
     address_ = 0;
     size_ = 0;
     allocator_.reset();
   }
 }
 
+auto Allocation::release() noexcept -> std::uintptr_t
+{
+  const auto address = address_;
+  address_ = 0;
+  size_ = 0;
+  allocator_.reset();
+  return address;
+}
+
 // clang-format off
 auto Allocator::_in_range(std::uintptr_t address,
-                          const std::vector<std::uintptr_t>& desired_addresses,
+                          std::span<const std::uintptr_t> desired_addresses,
                           std::size_t max_distance) -> bool
 {
   return std::ranges::all_of(desired_addresses, [&](std::uintptr_t desired_address)
@@ -79,20 +103,29 @@ auto Allocator::_make_memory(std::uintptr_t address, std::size_t size,
     auto ret = std::make_unique<Memory>();
     ret->address = result.value();
     ret->size = size;
-    ret->block = std::make_unique<MemoryBlock>();
+    ret->block = _node();
     ret->block->address = ret->address;
     ret->block->size = size;
     ret->block->free = true;
     Impl::VMProtect protect(ret->address, ret->size, Impl::VM_ACCESS_RWX);
     std::fill_n(detail::address_cast<char*>(ret->address), ret->size, 0xCC);
 
+    std::size_t spare = 0;
+    for (auto* node = spare_.get(); node != nullptr; node = node->next.get())
+    {
+      ++spare;
+    }
+    for (; spare < kSpareNodes; ++spare)
+    {
+      _recycle(std::make_unique<MemoryBlock>());
+    }
     return ret;
   }
   return nullptr;
 }
 
 auto Allocator::_allocate_memory(
-    const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
+    std::span<const std::uintptr_t> desired_addresses, std::size_t size,
     std::size_t max_distance) -> std::unique_ptr<Memory>
 {
   const auto si = Impl::get_system_info();
@@ -161,11 +194,10 @@ auto Allocator::_allocate_memory(
 
   return nullptr;
 }
-auto Allocator::_allocate_from_heap(
-    const std::vector<std::uintptr_t>& desired_addresses, std::size_t size,
-       std::size_t max_distance) -> std::optional<Allocation>
+auto Allocator::_carve(std::span<const std::uintptr_t> desired_addresses,
+                       std::size_t aligned_size, std::size_t max_distance)
+    -> MemoryBlock*
 {
-  const std::size_t aligned_size = detail::align_up(size, Memory::Aligment);
   for (auto& heap : memory_)
   {
     if (heap->size < aligned_size) { continue; }
@@ -182,7 +214,7 @@ auto Allocator::_allocate_from_heap(
 
       if (currentBlock->size - aligned_size > 0)
       {
-        auto new_free = std::make_unique<MemoryBlock>();
+        auto new_free = _node();
         new_free->address = currentBlock->address + aligned_size;
         new_free->size = currentBlock->size - aligned_size;
         new_free->free = true;
@@ -192,14 +224,90 @@ auto Allocator::_allocate_from_heap(
 
       currentBlock->size = aligned_size;
       currentBlock->free = false;
-
-      return Allocation(shared_from_this(), currentBlock->address, size);
+      return currentBlock;
     }
   }
+  return nullptr;
+}
+
+auto Allocator::_allocate_from_heap(
+    std::span<const std::uintptr_t> desired_addresses, std::size_t size,
+       std::size_t max_distance) -> std::optional<Allocation>
+{
+  const std::size_t aligned_size = detail::align_up(size, Memory::Aligment);
+  if (auto* block = _carve(desired_addresses, aligned_size, max_distance))
+  {
+    return Allocation(shared_from_this(), block->address, size);
+  }
   return std::nullopt;
 };
 
-auto Allocator::_allocate(const std::vector<std::uintptr_t>& desired_addresses,
+auto Allocator::AllocateMany(
+    std::span<const std::uintptr_t> desired_addresses,
+    std::span<const std::size_t> sizes, std::size_t max_distance)
+    -> std::vector<Allocation>
+{
+  std::vector<Allocation> result;
+  if (sizes.empty() or std::ranges::find(sizes, 0U) != sizes.end())
+  {
+    return result;
+  }
+  result.reserve(sizes.size());
+
+  {
+    std::scoped_lock lock{mutex_};
+    std::size_t total = 0;
+    for (const auto size : sizes)
+    {
+      total += detail::align_up(size, Memory::Aligment);
+    }
+
+    auto* run = _carve(desired_addresses, total, max_distance);
+    if (run == nullptr)
+    {
+      if (auto heap = _allocate_memory(desired_addresses, total, max_distance))
+      {
+        memory_.push_back(std::move(heap));
+        run = _carve(desired_addresses, total, max_distance);
+      }
+    }
+
+    if (run != nullptr)
+    {
+      // Split the run into consecutive used blocks, one per request.
+      for (std::size_t i = 0; i < sizes.size(); ++i)
+      {
+        const auto aligned_size = detail::align_up(sizes[i], Memory::Aligment);
+        if (i + 1 < sizes.size())
+        {
+          auto rest = _node();
+          rest->address = run->address + aligned_size;
+          rest->size = run->size - aligned_size;
+          rest->next = std::move(run->next);
+          run->next = std::move(rest);
+          run->size = aligned_size;
+        }
+        result.push_back(Allocation(shared_from_this(), run->address, sizes[i]));
+        run = run->next.get();
+      }
+    }
+    else
+    {
+      for (const auto size : sizes)
+      {
+        auto allocation = _allocate(desired_addresses, size, max_distance);
+        if (not allocation) { break; }
+        result.push_back(std::move(*allocation));
+      }
+    }
+  }
+
+  // Partial results are released outside the lock; `free` takes it again.
+  if (result.size() != sizes.size()) { result.clear(); }
+  return result;
+}
+
+auto Allocator::_allocate(std::span<const std::uintptr_t> desired_addresses,
                           std::size_t size, std::size_t max_distance)
     -> std::optional<Allocation>
 {
@@ -216,6 +324,20 @@ auto Allocator::_allocate(const std::vector<std::uintptr_t>& desired_addresses,
   return std::nullopt;
 }
 
+auto Allocator::_node() -> std::unique_ptr<MemoryBlock>
+{
+  if (not spare_) { return std::make_unique<MemoryBlock>(); }
+  auto node = std::move(spare_);
+  spare_ = std::move(node->next);
+  return node;
+}
+
+void Allocator::_recycle(std::unique_ptr<MemoryBlock> node)
+{
+  *node = MemoryBlock{.next = std::move(spare_)};
+  spare_ = std::move(node);
+}
+
 void Allocator::_deallocate(std::uintptr_t address)
 {
   for (const auto& heap : memory_)
@@ -235,15 +357,19 @@ void Allocator::_deallocate(std::uintptr_t address)
         // Try Merge free block
         while (currentBlock->next and currentBlock->next->free)
         {
-          currentBlock->size += currentBlock->next->size;
-          currentBlock->next = std::move(currentBlock->next->next);
+          auto merged = std::move(currentBlock->next);
+          currentBlock->size += merged->size;
+          currentBlock->next = std::move(merged->next);
+          _recycle(std::move(merged));
         }
 
         // Try merge with previous block
         if (previousBlock != nullptr and previousBlock->free)
         {
-          previousBlock->size += currentBlock->size;
-          previousBlock->next = std::move(currentBlock->next);
+          auto merged = std::move(previousBlock->next);
+          previousBlock->size += merged->size;
+          previousBlock->next = std::move(merged->next);
+          _recycle(std::move(merged));
         }
         return;
       }
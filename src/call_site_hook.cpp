@@ -0,0 +1,248 @@
+#include "VeilHook/call_site_hook.hpp"
+#include "VeilHook/code_map.hpp"
+
+#include "VeilHook/length_decoder.hpp"
+#include "VeilHook/reclaimer.hpp"
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+namespace VeilHook
+{
+
+namespace
+{
+constexpr std::uint8_t kCall = 0xE8;
+constexpr std::uint8_t kInt3 = 0xCC;
+constexpr std::size_t kCallSize = 5;
+
+auto reaches(std::uintptr_t from, std::uintptr_t to) -> bool
+{
+  // rel32 wraps around the whole address space on x86.
+  const auto delta =
+      static_cast<std::int64_t>(static_cast<std::intptr_t>(to - from));
+  return delta >= std::numeric_limits<std::int32_t>::min() &&
+         delta <= std::numeric_limits<std::int32_t>::max();
+}
+
+auto rel32(std::uintptr_t site, std::uintptr_t callee) -> std::int32_t
+{
+  return static_cast<std::int32_t>(
+      static_cast<std::intptr_t>(callee - (site + kCallSize)));
+}
+
+// The operand crosses a qword boundary: no single lock cmpxchg covers it.
+auto straddles(std::uintptr_t site) -> bool
+{
+  return (site + 1) % sizeof(std::uint64_t) > sizeof(std::uint64_t) - 4;
+}
+
+void swap_operand(std::uintptr_t site, std::int32_t value)
+{
+  const auto operand = site + 1;
+  const auto word = detail::align_down(operand, sizeof(std::uint64_t));
+  const auto shift = (operand - word) * 8;
+  const auto mask = std::uint64_t{0xFFFF'FFFF} << shift;
+  const auto bits = std::uint64_t{static_cast<std::uint32_t>(value)} << shift;
+  const std::atomic_ref<std::uint64_t> ref{
+      *detail::address_cast<std::uint64_t*>(word)};
+  auto current = ref.load(std::memory_order_relaxed);
+  while (not ref.compare_exchange_weak(current, (current & ~mask) | bits))
+  {
+  }
+}
+
+void store_opcode(std::uintptr_t site, std::uint8_t opcode)
+{
+  std::atomic_ref{*detail::address_cast<std::uint8_t*>(site)}.store(opcode);
+}
+}  // namespace
+
+namespace Impl
+{
+auto find_call_sites(std::span<const std::uint8_t> code,
+                     std::uintptr_t address, std::uintptr_t target)
+    -> std::vector<std::uintptr_t>
+{
+  std::vector<std::uintptr_t> sites;
+  for (std::size_t offset = 0; offset < code.size();)
+  {
+    const auto instruction = decode_length(code.subspan(offset));
+    if (not instruction)
+    {
+      ++offset;
+      continue;
+    }
+    if (instruction->branch == InstructionLength::Branch::Call &&
+        instruction->length == kCallSize && code[offset] == kCall)
+    {
+      std::int32_t rel = 0;
+      std::memcpy(&rel, code.data() + offset + 1, sizeof(rel));
+      const auto site = address + offset;
+      if (site + kCallSize + static_cast<std::uintptr_t>(rel) == target)
+      {
+        sites.push_back(site);
+      }
+    }
+    offset += instruction->length;
+  }
+  return sites;
+}
+}  // namespace Impl
+
+auto CallSiteHook::Create(const std::shared_ptr<Allocator>& allocator,
+                          std::uintptr_t module, std::uintptr_t target,
+                          std::uintptr_t destination)
+    -> std::expected<std::unique_ptr<CallSiteHook>, Error>
+{
+  auto sections = Impl::module_sections(module);
+  if (not sections) { return std::unexpected(sections.error()); }
+
+  std::unique_ptr<CallSiteHook> hook{new CallSiteHook};
+  hook->target_ = target;
+  hook->destination_ = destination;
+  {
+    VH_TRACE_SCOPE(trace, Decode, target);
+    for (const auto& section : *sections)
+    {
+      if (not section.executable) { continue; }
+      const auto found = Impl::find_call_sites(
+          {detail::address_cast<const std::uint8_t*>(section.address),
+           section.size},
+          section.address, target);
+      hook->sites_.insert(hook->sites_.end(), found.begin(), found.end());
+    }
+  }
+  auto& sites = hook->sites_;
+  if (sites.empty()) { return std::unexpected(Error::NotFound); }
+  std::ranges::sort(sites);
+
+  const auto in_reach = [&](std::uintptr_t site)
+  { return reaches(site + kCallSize, destination); };
+  if (not std::ranges::all_of(sites, in_reach))
+  {
+    VH_TRACE_SCOPE(trace, Allocate, target);
+    auto relay =
+        allocator->Allocate({sites.front(), sites.back()}, kRelaySize);
+    if (not relay)
+    {
+      trace.fail(Error::Allocate);
+      return std::unexpected(Error::Allocate);
+    }
+    const auto base = relay->address();
+    std::fill_n(relay->data<std::uint8_t*>(), relay->size(), kInt3);
+    // jmp [rip+0] on x64; x86 never gets here.
+    detail::store<std::uint16_t>(base, 0x25FF);
+    detail::store<std::int32_t>(base + 2, 0);
+    detail::store<std::uintptr_t>(base + 6, destination);
+    CodeMap::Get().Add(base, kRelaySize, target, "call site relay");
+    hook->relay_ = std::make_unique<Allocation>(std::move(*relay));
+  }
+
+  std::ranges::copy_if(sites, std::back_inserter(hook->straddling_),
+                       &straddles);
+  if (not hook->straddling_.empty())
+  {
+    VH_TRACE_SCOPE(trace, Veh, target);
+    std::vector<Impl::VehEntry> entries;
+    entries.reserve(hook->straddling_.size());
+    for (const auto site : hook->straddling_)
+    {
+      entries.push_back({.start_address = site,
+                         .end_address = site + 1,
+                         .callback = &Impl::call_guard,
+                         .context = target});
+    }
+    if (not Impl::VehManager::instance().Register(entries))
+    {
+      trace.fail(Error::Allocate);
+      return std::unexpected(Error::Allocate);
+    }
+  }
+  return hook;
+}
+
+auto CallSiteHook::Create(std::string_view module, std::uintptr_t target,
+                          std::uintptr_t destination)
+    -> std::expected<std::unique_ptr<CallSiteHook>, Error>
+{
+  const auto base = Impl::module_find(module);
+  if (not base) { return std::unexpected(base.error()); }
+  return Create(*base, target, destination);
+}
+
+CallSiteHook::~CallSiteHook()
+{
+  [[maybe_unused]] auto result = Disable();
+  for (const auto site : straddling_)
+  {
+    Impl::VehManager::instance().Unregister(site);
+  }
+  // Callers may still be on their way through the relay.
+  if (relay_) { Reclaimer::Get().Retire(std::move(*relay_)); }
+}
+
+auto CallSiteHook::Enable() -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (enabled_) { return {}; }
+  _write(true);
+  enabled_ = true;
+  return {};
+}
+
+auto CallSiteHook::Disable() -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (not enabled_) { return {}; }
+  _write(false);
+  enabled_ = false;
+  return {};
+}
+
+auto CallSiteHook::_callee(std::uintptr_t site, bool enable) const
+    -> std::uintptr_t
+{
+  if (not enable) { return target_; }
+  if (reaches(site + kCallSize, destination_)) { return destination_; }
+  return relay_->address();
+}
+
+void CallSiteHook::_write(bool enable)
+{
+  VH_TRACE_SCOPE(trace, Write, target_);
+  std::vector<std::pair<std::uintptr_t, std::uintptr_t>> ranges;
+  ranges.reserve(sites_.size());
+  for (const auto site : sites_)
+  {
+    ranges.emplace_back(site, site + kCallSize);
+  }
+  const auto protects = Impl::protect_pages(ranges);
+
+  for (const auto site : sites_)
+  {
+    if (straddles(site)) { continue; }
+    swap_operand(site, rel32(site, _callee(site, enable)));
+  }
+  if (straddling_.empty()) { return; }
+
+  // Park an int3 on each opcode, write the operands behind it, then put the
+  // opcodes back. Interrupting every processor between the steps retires
+  // whatever they fetched of the previous one.
+  for (const auto site : straddling_) { store_opcode(site, kInt3); }
+  Impl::flush_write_buffers();
+  for (const auto site : straddling_)
+  {
+    detail::store(site + 1, rel32(site, _callee(site, enable)));
+  }
+  Impl::flush_write_buffers();
+  for (const auto site : straddling_) { store_opcode(site, kCall); }
+  Impl::flush_write_buffers();
+}
+
+}  // namespace VeilHook
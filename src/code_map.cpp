@@ -0,0 +1,347 @@
+#include "VeilHook/code_map.hpp"
+
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+namespace VeilHook
+{
+
+namespace Impl
+{
+namespace
+{
+// UNWIND_INFO: version and flags, prologue size, code count, frame register
+// and offset, then two-byte code slots.
+constexpr std::size_t kHeaderSize = 4;
+constexpr std::uint8_t kHandlerFlags = 0x3;  // UNW_FLAG_EHANDLER | UHANDLER
+constexpr std::uint8_t kChainInfo = 0x4;
+
+enum UnwindOp : std::uint8_t
+{
+  kPushNonvol = 0,
+  kAllocLarge = 1,
+  kAllocSmall = 2,
+  kSetFpreg = 3,
+  kSaveNonvol = 4,
+  kSaveNonvolFar = 5,
+  kEpilog = 6,  // version 2 only, describes epilogues rather than the prologue
+  kSaveXmm128 = 8,
+  kSaveXmm128Far = 9,
+  kPushMachframe = 10,
+};
+
+// Slots a code takes, its own included; 0 for codes this does not know.
+auto code_slots(std::uint8_t op, std::uint8_t info) -> std::size_t
+{
+  switch (op)
+  {
+    case kPushNonvol:
+    case kAllocSmall:
+    case kSetFpreg:
+    case kPushMachframe: return 1;
+    case kAllocLarge: return info == 0 ? 2 : 3;
+    case kSaveNonvol:
+    case kSaveXmm128:
+    case kEpilog: return 2;
+    case kSaveNonvolFar:
+    case kSaveXmm128Far: return 3;
+    default: return 0;
+  }
+}
+
+// Rebuilds `info` as version 1 without handler: the codes of instructions
+// ending at most `limit` bytes into the function, their offsets mapped by
+// `move` (negative when an offset has no counterpart in the copy).
+template <typename Move>
+auto copy_codes(const std::uint8_t* info, std::size_t limit,
+                std::uint8_t prologue, Move move) -> std::vector<std::uint8_t>
+{
+  const auto version = info[0] & 0x7;
+  const auto flags = static_cast<std::uint8_t>(info[0] >> 3);
+  if ((version != 1 && version != 2) || (flags & kChainInfo) != 0)
+  {
+    return {};
+  }
+  const auto count = std::size_t{info[2]};
+  const auto* codes = info + kHeaderSize;
+
+  std::vector<std::uint8_t> result(kHeaderSize);
+  bool frame = false;
+  for (std::size_t i = 0; i < count;)
+  {
+    const auto offset = codes[2 * i];
+    const auto op = static_cast<std::uint8_t>(codes[(2 * i) + 1] & 0xF);
+    const auto slots =
+        code_slots(op, static_cast<std::uint8_t>(codes[(2 * i) + 1] >> 4));
+    if (slots == 0 || i + slots > count) { return {}; }
+    if (op != kEpilog && offset <= limit)
+    {
+      const std::int64_t moved = move(offset);
+      if (moved < 0 || moved > std::numeric_limits<std::uint8_t>::max())
+      {
+        return {};
+      }
+      result.push_back(static_cast<std::uint8_t>(moved));
+      std::copy(codes + (2 * i) + 1, codes + (2 * (i + slots)),
+                std::back_inserter(result));
+      frame = frame || op == kSetFpreg;
+    }
+    i += slots;
+  }
+
+  const auto slots = (result.size() - kHeaderSize) / 2;
+  if (slots == 0) { return {}; }
+  // The code array is padded to an even number of slots.
+  if (slots % 2 != 0) { result.insert(result.end(), 2, 0); }
+  result[0] = 1;
+  result[1] = prologue;
+  result[2] = static_cast<std::uint8_t>(slots);
+  result[3] = frame ? info[3] : 0;
+  return result;
+}
+}  // namespace
+
+auto trampoline_unwind(const HookPlan& plan, std::uintptr_t trampoline)
+    -> CopiedUnwind
+{
+  const auto entry = function_entry(plan.target);
+  if (not entry || entry->begin != plan.target) { return {}; }
+  const auto jump_back =
+      relocated_address(plan, trampoline, plan.target + plan.prologue_size);
+  if (jump_back == 0) { return {}; }
+
+  // A thread stops at the jump back at the latest, with every copied
+  // prologue instruction behind it. Keeping that inside the prologue makes
+  // the unwinder undo just the codes up to its offset, rather than take
+  // the jump out of the function for an epilogue.
+  const auto end = jump_back - trampoline + 1;
+  if (end > std::numeric_limits<std::uint8_t>::max()) { return {}; }
+  auto info = copy_codes(
+      entry->unwind, plan.prologue_size, static_cast<std::uint8_t>(end),
+      [&](std::size_t offset) -> std::int64_t
+      {
+        const auto moved =
+            relocated_address(plan, trampoline, plan.target + offset);
+        return moved == 0 ? -1 : static_cast<std::int64_t>(moved - trampoline);
+      });
+  if (info.empty()) { return {}; }
+  return {.info = std::move(info), .size = end};
+}
+
+auto clone_unwind(const ClonePlan& plan, std::uintptr_t clone)
+    -> CopiedUnwind
+{
+  const auto entry = function_entry(plan.entry);
+  if (not entry || entry->begin != plan.entry) { return {}; }
+  if (((entry->unwind[0] >> 3) & kHandlerFlags) != 0) { return {}; }
+  for (const auto& instruction : plan.instructions)
+  {
+    if (plan.entry + instruction.offset + instruction.length > entry->end)
+    {
+      return {};
+    }
+  }
+
+  const auto move = [&](std::size_t offset) -> std::int64_t
+  {
+    if (offset == 0) { return 0; }
+    const auto moved = cloned_address(plan, clone, plan.entry + offset);
+    return moved == 0 ? -1 : static_cast<std::int64_t>(moved - clone);
+  };
+  const auto prologue = move(entry->unwind[1]);
+  if (prologue < 0 || prologue > std::numeric_limits<std::uint8_t>::max())
+  {
+    return {};
+  }
+  auto info = copy_codes(entry->unwind, std::numeric_limits<std::size_t>::max(),
+                         static_cast<std::uint8_t>(prologue), move);
+  if (info.empty()) { return {}; }
+  // Jump tables follow the code and are not part of the function.
+  const auto size =
+      plan.tables.empty() ? plan.size : plan.tables.front().clone_offset;
+  return {.info = std::move(info), .size = size};
+}
+}  // namespace Impl
+
+auto CodeMap::Get() -> CodeMap&
+{
+  // Never destroyed, like the Reclaimer that removes entries during exit.
+  static auto* map = new CodeMap;
+  return *map;
+}
+
+auto CodeMap::Enable(CodeMapOptions options) -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  perf_map_.close();
+  if (options.write_perf_map)
+  {
+    auto path = options.perf_map;
+    if (path.empty())
+    {
+      std::error_code error;
+      path = std::filesystem::temp_directory_path(error) /
+             ("perf-" + std::to_string(Impl::process_id()) + ".map");
+      if (error) { return std::unexpected(Error::Io); }
+    }
+    perf_map_.open(path, std::ios::binary | std::ios::trunc);
+    if (not perf_map_) { return std::unexpected(Error::Io); }
+  }
+  unwind_.store(options.unwind, std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_relaxed);
+  return {};
+}
+
+void CodeMap::Disable()
+{
+  std::scoped_lock lock{mutex_};
+  enabled_.store(false, std::memory_order_relaxed);
+  unwind_.store(false, std::memory_order_relaxed);
+  perf_map_.close();
+}
+
+void CodeMap::Add(std::uintptr_t address, std::size_t size,
+                  std::uintptr_t target, std::string_view kind,
+                  const Impl::CopiedUnwind& unwind)
+{
+  const auto named = enabled();
+  if (not named && unwind.info.empty()) { return; }
+
+  Entry entry{.size = size, .name = {}, .unwind = std::nullopt};
+  if (not unwind.info.empty())
+  {
+    entry.unwind = _register(address, unwind);
+  }
+
+  std::scoped_lock lock{mutex_};
+  if (named)
+  {
+    entry.name = _name(target, kind);
+    if (perf_map_.is_open())
+    {
+      perf_map_ << std::hex << address << ' ' << size << std::dec << ' '
+                << entry.name << '\n'
+                << std::flush;
+    }
+  }
+  // Code freed without the Reclaimer leaves an entry behind for the next
+  // block at its address.
+  if (const auto stale = entries_.find(address);
+      stale != entries_.end() && stale->second.unwind)
+  {
+    Impl::function_table_remove(stale->second.unwind->address());
+  }
+  entries_.insert_or_assign(address, std::move(entry));
+  count_.store(entries_.size(), std::memory_order_relaxed);
+}
+
+void CodeMap::Remove(MemoryRange range)
+{
+  if (count_.load(std::memory_order_relaxed) == 0) { return; }
+  // Unwind blocks go back to their allocator outside the lock.
+  std::vector<Entry> removed;
+  {
+    std::scoped_lock lock{mutex_};
+    const auto first = entries_.lower_bound(range.first);
+    const auto last = entries_.lower_bound(range.second);
+    for (auto it = first; it != last; ++it)
+    {
+      removed.push_back(std::move(it->second));
+    }
+    entries_.erase(first, last);
+    count_.store(entries_.size(), std::memory_order_relaxed);
+  }
+  for (auto& entry : removed)
+  {
+    if (entry.unwind) { Impl::function_table_remove(entry.unwind->address()); }
+  }
+}
+
+auto CodeMap::Find(std::uintptr_t address) const -> std::string
+{
+  std::scoped_lock lock{mutex_};
+  auto it = entries_.upper_bound(address);
+  if (it == entries_.begin()) { return {}; }
+  --it;
+  if (address >= it->first + it->second.size) { return {}; }
+  return it->second.name;
+}
+
+auto CodeMap::size() const -> std::size_t
+{
+  std::scoped_lock lock{mutex_};
+  return entries_.size();
+}
+
+auto CodeMap::_name(std::uintptr_t target, std::string_view kind)
+    -> std::string
+{
+  std::ostringstream name;
+  name << "veilhook:";
+  if (target == 0) { return std::move(name).str() + std::string{kind}; }
+  if (const auto module = Impl::module_query(target); module)
+  {
+    auto& exports = exports_[module->base];
+    if (exports.module.empty() || exports.build_id != module->build_id)
+    {
+      exports = {.build_id = module->build_id,
+                 .module = Impl::module_name(module->base),
+                 .symbols = {}};
+      if (auto symbols = Impl::module_exports(module->base); symbols)
+      {
+        for (const auto& symbol : *symbols)
+        {
+          exports.symbols.emplace_back(symbol.address,
+                                       std::string{symbol.name});
+        }
+      }
+      std::ranges::sort(exports.symbols);
+    }
+    const auto it = std::ranges::lower_bound(
+        exports.symbols, target, {},
+        [](const auto& symbol) { return symbol.first; });
+    name << exports.module;
+    if (it != exports.symbols.end() && it->first == target)
+    {
+      name << '!' << it->second;
+    }
+    else { name << "+0x" << std::hex << target - module->base; }
+  }
+  else { name << "0x" << std::hex << target; }
+  if (not kind.empty()) { name << " [" << kind << ']'; }
+  return std::move(name).str();
+}
+
+auto CodeMap::_register(std::uintptr_t address,
+                        const Impl::CopiedUnwind& unwind)
+    -> std::optional<Allocation>
+{
+  // RUNTIME_FUNCTION holds 32-bit offsets from a common base: the unwind
+  // info lives within rel32 reach of the code it describes.
+  constexpr std::size_t kFunctionSize = 3 * sizeof(std::uint32_t);
+  auto block = Allocator::Get()->Allocate({address},
+                                          kFunctionSize + unwind.info.size());
+  if (not block) { return std::nullopt; }
+
+  const auto base = std::min(address, block->address());
+  const auto info = block->address() + kFunctionSize;
+  const std::array<std::uint32_t, 3> function{
+      static_cast<std::uint32_t>(address - base),
+      static_cast<std::uint32_t>(address + unwind.size - base),
+      static_cast<std::uint32_t>(info - base)};
+  std::memcpy(block->data<void*>(), function.data(), kFunctionSize);
+  std::memcpy(detail::address_cast<void*>(info), unwind.info.data(),
+              unwind.info.size());
+  if (not Impl::function_table_add(block->address(), base))
+  {
+    return std::nullopt;
+  }
+  return block;
+}
+}  // namespace VeilHook
@@ -0,0 +1,693 @@
+#include "VeilHook/function_clone.hpp"
+
+#include "VeilHook/hook_plan.hpp"
+#include "VeilHook/length_decoder.hpp"
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <Zydis/Zydis.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace VeilHook::Impl
+{
+
+namespace
+{
+using Instruction = ClonePlan::Instruction;
+using JumpTable = ClonePlan::JumpTable;
+
+constexpr std::size_t kMaxLength = 15;
+// Entries a recognized jump table may have.
+constexpr std::size_t kMaxTableEntries = 0x1000;
+// Instructions in front of an indirect jump searched for its table.
+constexpr std::size_t kTableWindow = 16;
+
+#if defined(VH_ARCH_X86_64)
+constexpr auto kZydisMode = ZYDIS_MACHINE_MODE_LONG_64;
+constexpr auto kZydisStackWidth = ZYDIS_STACK_WIDTH_64;
+#else
+constexpr auto kZydisMode = ZYDIS_MACHINE_MODE_LEGACY_32;
+constexpr auto kZydisStackWidth = ZYDIS_STACK_WIDTH_32;
+#endif
+
+auto emitted_length(const Instruction& instruction) -> std::size_t
+{
+  switch (instruction.kind)
+  {
+    case Instruction::Kind::ShortJcc: return 6;
+    case Instruction::Kind::ShortJmp: return 5;
+    // loop over; jmp short next; over: jmp rel32 target
+    case Instruction::Kind::Loop: return instruction.length + 2 + 5;
+    default: return instruction.length;
+  }
+}
+
+auto fits_int32(std::int64_t value) -> bool
+{
+  return value >= std::numeric_limits<std::int32_t>::min() &&
+         value <= std::numeric_limits<std::int32_t>::max();
+}
+
+auto rel32(std::uintptr_t from, std::uintptr_t to)
+    -> std::expected<std::int32_t, Error>
+{
+  const auto delta = static_cast<std::int64_t>(
+      static_cast<std::intptr_t>(to - from));
+  if (not fits_int32(delta))
+  {
+    return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+  }
+  return static_cast<std::int32_t>(delta);
+}
+
+// How control leaves an instruction without a relative operand.
+enum class Flow : std::uint8_t
+{
+  Next,
+  End,           // ret, int3, ud2, hlt, __fastfail, far jmp
+  IndirectJump,  // jmp r/m
+};
+
+auto flow_of(std::span<const std::uint8_t> code) -> Flow
+{
+  std::size_t i = 0;
+  for (; i < code.size(); ++i)
+  {
+    const auto byte = code[i];
+#if defined(VH_ARCH_X86_64)
+    if ((byte & 0xF0) == 0x40) { continue; }
+#endif
+    if (byte != 0x66 && byte != 0x67 && byte != 0xF0 && byte != 0xF2 &&
+        byte != 0xF3 && byte != 0x26 && byte != 0x2E && byte != 0x36 &&
+        byte != 0x3E && byte != 0x64 && byte != 0x65)
+    {
+      break;
+    }
+  }
+  if (i >= code.size()) { return Flow::Next; }
+  const auto next = i + 1 < code.size() ? code[i + 1] : std::uint8_t{0};
+  switch (code[i])
+  {
+    case 0xC2:
+    case 0xC3:
+    case 0xCA:
+    case 0xCB:
+    case 0xCC:
+    case 0xF4: return Flow::End;
+    case 0xCD: return next == 0x29 ? Flow::End : Flow::Next;
+    case 0x0F: return next == 0x0B ? Flow::End : Flow::Next;
+    case 0xFF:
+      switch ((next >> 3) & 7)
+      {
+        case 4: return Flow::IndirectJump;
+        case 5: return Flow::End;
+        default: return Flow::Next;
+      }
+    default: return Flow::Next;
+  }
+}
+
+struct Decoded
+{
+  std::uintptr_t address{};
+  ZydisDecodedInstruction ix{};
+  std::array<ZydisDecodedOperand, ZYDIS_MAX_OPERAND_COUNT> operands{};
+};
+
+auto decode_full(std::uintptr_t address, std::size_t length, Decoded& out)
+    -> bool
+{
+  static const auto decoder = []
+  {
+    ZydisDecoder result{};
+    ZydisDecoderInit(&result, kZydisMode, kZydisStackWidth);
+    return result;
+  }();
+  out.address = address;
+  return ZYAN_SUCCESS(ZydisDecoderDecodeFull(
+      &decoder, detail::address_cast<const void*>(address), length, &out.ix,
+      out.operands.data()));
+}
+
+auto widest(ZydisRegister reg) -> ZydisRegister
+{
+  return ZydisRegisterGetLargestEnclosing(kZydisMode, reg);
+}
+
+// Which memory around the function can be read, one vm_query per region.
+class Memory
+{
+ public:
+  // Bytes readable from `address` on, up to `size`.
+  auto available(std::uintptr_t address, std::size_t size) -> std::size_t
+  {
+    std::size_t result = 0;
+    while (result < size)
+    {
+      const auto end = _region_end(address + result);
+      if (end == 0) { break; }
+      result = std::min(size, end - address);
+    }
+    return result;
+  }
+  auto readable(std::uintptr_t address, std::size_t size) -> bool
+  {
+    return available(address, size) == size;
+  }
+
+ private:
+  // End of the readable region holding `address`; 0 if it cannot be read.
+  auto _region_end(std::uintptr_t address) -> std::uintptr_t
+  {
+    for (const auto& [begin, end] : regions_)
+    {
+      if (address >= begin && address < end) { return end; }
+    }
+    const auto info = vm_query(address);
+    if (not info || info->free || info->access == 0 ||
+        (info->access & (PAGE_NOACCESS | PAGE_GUARD)) != 0)
+    {
+      return 0;
+    }
+    regions_.emplace_back(info->address, info->address + info->size);
+    return regions_.back().second;
+  }
+
+  std::vector<std::pair<std::uintptr_t, std::uintptr_t>> regions_;
+};
+
+class Descent
+{
+ public:
+  explicit Descent(std::uintptr_t entry)
+      : entry_(entry), state_(kMaxCloneExtent, State::Unseen)
+  {
+    plan_.entry = entry;
+#if defined(VH_ARCH_X86_64)
+    if (const auto module = module_query(entry)) { image_base_ = module->base; }
+#endif
+  }
+
+  auto run() -> std::expected<ClonePlan, Error>
+  {
+    work_.push_back(entry_);
+    while (not work_.empty())
+    {
+      const auto address = work_.back();
+      work_.pop_back();
+      if (auto result = _block(address); not result)
+      {
+        return std::unexpected(result.error());
+      }
+    }
+    return _layout();
+  }
+
+ private:
+  enum class State : std::uint8_t
+  {
+    Unseen,
+    Start,
+    Inside,
+  };
+
+  // Whether a branch to `target` stays in the function.
+  auto _follows(std::uintptr_t target) -> bool
+  {
+    if (target < entry_ || target - entry_ >= kMaxCloneExtent) { return false; }
+    if (target - entry_ < HookPlan::kMaxPrologue) { return true; }
+    return memory_.readable(target - 1, 1) &&
+           *detail::address_cast<const std::uint8_t*>(target - 1) != 0xCC;
+  }
+
+  // Decodes straight on from `address` until control cannot fall through.
+  auto _block(std::uintptr_t address) -> std::expected<void, Error>
+  {
+    using Branch = InstructionLength::Branch;
+    using Kind = Instruction::Kind;
+    std::vector<std::size_t> run;
+    for (;;)
+    {
+      const auto offset = address - entry_;
+      // Falling through an instruction that ends right at the limit.
+      if (offset >= kMaxCloneExtent)
+      {
+        return std::unexpected(Error::NotEnoughSpace);
+      }
+      if (state_[offset] == State::Start) { return {}; }
+      if (state_[offset] == State::Inside)
+      {
+        return std::unexpected(Error::UnsupportedInstruction);
+      }
+      const auto code =
+          std::span{detail::address_cast<const std::uint8_t*>(address),
+                    memory_.available(address, kMaxLength)};
+      if (code.empty()) { return std::unexpected(Error::Query); }
+      const auto ix = decode_length(code);
+      if (not ix) { return std::unexpected(ix.error()); }
+      if (offset + ix->length > kMaxCloneExtent)
+      {
+        return std::unexpected(Error::NotEnoughSpace);
+      }
+      for (std::size_t i = 1; i < ix->length; ++i)
+      {
+        if (state_[offset + i] != State::Unseen)
+        {
+          return std::unexpected(Error::UnsupportedInstruction);
+        }
+        state_[offset + i] = State::Inside;
+      }
+      state_[offset] = State::Start;
+
+      Instruction instruction{.offset = static_cast<std::uint32_t>(offset),
+                              .length = ix->length,
+                              .operand_offset = ix->rel_offset};
+      bool ends = false;
+      if (ix->rel_size != 0)
+      {
+        if (ix->rel_size == 4) { instruction.kind = Kind::Rel32; }
+        else if (ix->rel_size == 1 && ix->branch == Branch::Jcc)
+        {
+          instruction.kind = Kind::ShortJcc;
+        }
+        else if (ix->rel_size == 1 && ix->branch == Branch::Jmp)
+        {
+          instruction.kind = Kind::ShortJmp;
+        }
+        else if (ix->rel_size == 1 && ix->branch == Branch::Loop)
+        {
+          instruction.kind = Kind::Loop;
+        }
+        else { return std::unexpected(Error::UnsupportedInstruction); }
+
+        if (ix->branch == Branch::Jmp || ix->branch == Branch::Jcc ||
+            ix->branch == Branch::Loop)
+        {
+          std::int32_t displacement = 0;
+          if (ix->rel_size == 4)
+          {
+            std::memcpy(&displacement, code.data() + ix->rel_offset,
+                        sizeof(displacement));
+          }
+          else
+          {
+            displacement = static_cast<std::int8_t>(code[ix->rel_offset]);
+          }
+          const auto target = address + ix->length +
+                              static_cast<std::uintptr_t>(
+                                  static_cast<std::intptr_t>(displacement));
+          if (_follows(target))
+          {
+            instruction.internal = true;
+            work_.push_back(target);
+          }
+          ends = ix->branch == Branch::Jmp;
+        }
+      }
+      run.push_back(plan_.instructions.size());
+      plan_.instructions.push_back(instruction);
+      if (ends) { return {}; }
+
+      const auto flow = ix->rel_size != 0 ? Flow::Next
+                                          : flow_of(code.first(ix->length));
+      if (flow == Flow::End) { return {}; }
+      if (flow == Flow::IndirectJump)
+      {
+        _jump_table(run);
+        return {};
+      }
+      address += ix->length;
+    }
+  }
+
+  // Records the table behind the indirect jump that ends `run` if it has one
+  // of the recognized forms. Anything else keeps jumping to the original.
+  void _jump_table(std::span<const std::size_t> run)
+  {
+    const auto first =
+        run.size() > kTableWindow ? run.size() - kTableWindow : 0;
+    std::vector<Decoded> window(run.size() - first);
+    for (std::size_t i = 0; i < window.size(); ++i)
+    {
+      const auto& instruction = plan_.instructions[run[first + i]];
+      if (not decode_full(entry_ + instruction.offset, instruction.length,
+                          window[i]))
+      {
+        return;
+      }
+    }
+
+    JumpTable table{};
+    std::size_t holder = 0;  // the window instruction that addresses it
+    const auto& jump = window.back().operands[0];
+#if defined(VH_ARCH_X86_64)
+    if (jump.type != ZYDIS_OPERAND_TYPE_REGISTER) { return; }
+    const auto jumped = widest(jump.reg.value);
+    // add jumped, base
+    auto add = window.size() - 1;
+    while (add-- > 0)
+    {
+      const auto& ops = window[add].operands;
+      if (window[add].ix.mnemonic == ZYDIS_MNEMONIC_ADD &&
+          ops[0].type == ZYDIS_OPERAND_TYPE_REGISTER &&
+          widest(ops[0].reg.value) == jumped &&
+          ops[1].type == ZYDIS_OPERAND_TYPE_REGISTER)
+      {
+        break;
+      }
+    }
+    if (add >= window.size()) { return; }
+    const auto base = widest(window[add].operands[1].reg.value);
+    // mov jumped32, [base+index*4+rva] or movsxd jumped, [base+index*4]
+    auto load = add;
+    while (load-- > 0)
+    {
+      const auto& ops = window[load].operands;
+      if (ops[0].type == ZYDIS_OPERAND_TYPE_REGISTER &&
+          widest(ops[0].reg.value) == jumped)
+      {
+        break;
+      }
+    }
+    if (load >= window.size()) { return; }
+    const auto& entry = window[load].operands[1];
+    if (entry.type != ZYDIS_OPERAND_TYPE_MEMORY ||
+        widest(entry.mem.base) != base || entry.mem.scale != 4)
+    {
+      return;
+    }
+    if (window[load].ix.mnemonic == ZYDIS_MNEMONIC_MOV &&
+        entry.mem.disp.value > 0 && image_base_ != 0)
+    {
+      table.base = JumpTable::Base::Image;
+      table.image_base = image_base_;
+      table.address =
+          image_base_ + static_cast<std::uintptr_t>(entry.mem.disp.value);
+      holder = load;
+    }
+    else if (window[load].ix.mnemonic == ZYDIS_MNEMONIC_MOVSXD &&
+             entry.mem.disp.value == 0)
+    {
+      // lea base, [rip+table]
+      holder = load;
+      while (holder-- > 0)
+      {
+        const auto& ops = window[holder].operands;
+        if (window[holder].ix.mnemonic == ZYDIS_MNEMONIC_LEA &&
+            widest(ops[0].reg.value) == base &&
+            ops[1].mem.base == ZYDIS_REGISTER_RIP)
+        {
+          break;
+        }
+      }
+      if (holder >= window.size()) { return; }
+      const auto& lea = window[holder];
+      table.base = JumpTable::Base::Table;
+      table.address = lea.address + lea.ix.length +
+                      static_cast<std::uintptr_t>(
+                          lea.operands[1].mem.disp.value);
+    }
+    else { return; }
+#else
+    if (jump.type != ZYDIS_OPERAND_TYPE_MEMORY ||
+        jump.mem.base != ZYDIS_REGISTER_NONE ||
+        jump.mem.index == ZYDIS_REGISTER_NONE || jump.mem.scale != 4)
+    {
+      return;
+    }
+    table.base = JumpTable::Base::Absolute;
+    table.address = static_cast<std::uintptr_t>(
+        static_cast<std::uint32_t>(jump.mem.disp.value));
+    holder = window.size() - 1;
+#endif
+
+    // cmp index, imm; ja default
+    std::size_t count = 0;
+    for (auto i = holder; i > 1 && count == 0; --i)
+    {
+      const auto mnemonic = window[i - 1].ix.mnemonic;
+      const auto& cmp = window[i - 2];
+      if ((mnemonic == ZYDIS_MNEMONIC_JNBE || mnemonic == ZYDIS_MNEMONIC_JNB) &&
+          cmp.ix.mnemonic == ZYDIS_MNEMONIC_CMP &&
+          cmp.operands[1].type == ZYDIS_OPERAND_TYPE_IMMEDIATE &&
+          cmp.operands[1].imm.value.u < kMaxTableEntries)
+      {
+        const auto limit =
+            static_cast<std::size_t>(cmp.operands[1].imm.value.u);
+        count = mnemonic == ZYDIS_MNEMONIC_JNBE ? limit + 1 : limit;
+      }
+    }
+    if (count == 0 ||
+        not memory_.readable(table.address, count * sizeof(std::uint32_t)))
+    {
+      return;
+    }
+
+    const auto* entries =
+        detail::address_cast<const std::uint32_t*>(table.address);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      std::uintptr_t target = entries[i];
+      if (table.base == JumpTable::Base::Image) { target += table.image_base; }
+      else if (table.base == JumpTable::Base::Table)
+      {
+        const auto delta = static_cast<std::int32_t>(entries[i]);
+        target = table.address +
+                 static_cast<std::uintptr_t>(static_cast<std::intptr_t>(delta));
+      }
+      if (not _follows(target)) { return; }
+      table.targets.push_back(target);
+    }
+
+    auto& instruction = plan_.instructions[run[first + holder]];
+    if (instruction.kind == Instruction::Kind::Copy)
+    {
+      instruction.operand_offset = window[holder].ix.raw.disp.offset;
+    }
+    instruction.table = static_cast<std::int16_t>(plan_.tables.size());
+    work_.insert(work_.end(), table.targets.begin(), table.targets.end());
+    plan_.tables.push_back(std::move(table));
+  }
+
+  auto _layout() -> std::expected<ClonePlan, Error>
+  {
+    auto& instructions = plan_.instructions;
+    std::ranges::sort(instructions, {}, &Instruction::offset);
+    std::size_t cursor = 0;
+    for (auto& instruction : instructions)
+    {
+      instruction.clone_offset = static_cast<std::uint32_t>(cursor);
+      cursor += emitted_length(instruction);
+    }
+    cursor = detail::align_up(cursor, sizeof(std::uint32_t));
+    for (auto& table : plan_.tables)
+    {
+      table.clone_offset = static_cast<std::uint32_t>(cursor);
+      cursor += table.targets.size() * sizeof(std::uint32_t);
+    }
+    plan_.size = cursor;
+
+    const auto& last = instructions.back();
+    const auto extent = std::size_t{last.offset} + last.length;
+    if (not memory_.readable(entry_, extent))
+    {
+      return std::unexpected(Error::Query);
+    }
+    plan_.bytes.resize(extent);
+    std::memcpy(plan_.bytes.data(),
+                detail::address_cast<const void*>(entry_), extent);
+    return std::move(plan_);
+  }
+
+  std::uintptr_t entry_;
+  std::uintptr_t image_base_{0};
+  std::vector<State> state_;  // by offset from the entry
+  std::vector<std::uintptr_t> work_;
+  Memory memory_;
+  ClonePlan plan_;
+};
+}  // namespace
+
+auto ClonePlan::branch_target(const Instruction& instruction) const
+    -> std::uintptr_t
+{
+  const auto next = entry + instruction.offset + instruction.length;
+  const auto* operand =
+      bytes.data() + instruction.offset + instruction.operand_offset;
+  std::intptr_t displacement = 0;
+  if (instruction.kind == Instruction::Kind::Rel32)
+  {
+    std::int32_t value = 0;
+    std::memcpy(&value, operand, sizeof(value));
+    displacement = value;
+  }
+  else { displacement = static_cast<std::int8_t>(*operand); }
+  return next + static_cast<std::uintptr_t>(displacement);
+}
+
+auto ClonePlan::reach() const -> std::vector<std::uintptr_t>
+{
+  std::vector<std::uintptr_t> result{entry};
+  for (const auto& instruction : instructions)
+  {
+    if (instruction.kind != Instruction::Kind::Copy &&
+        not instruction.internal && instruction.table < 0)
+    {
+      result.push_back(branch_target(instruction));
+    }
+  }
+  for (const auto& table : tables)
+  {
+    if (table.base == JumpTable::Base::Image)
+    {
+      result.push_back(table.image_base);
+    }
+  }
+  return result;
+}
+
+auto plan_clone(std::uintptr_t entry) -> std::expected<ClonePlan, Error>
+{
+  VH_TRACE_SCOPE(trace, Decode, entry);
+  auto plan = Descent{entry}.run();
+  if (not plan) { trace.fail(plan.error()); }
+  return plan;
+}
+
+auto cloned_address(const ClonePlan& plan, std::uintptr_t clone,
+                    std::uintptr_t address) -> std::uintptr_t
+{
+  if (address < plan.entry || address - plan.entry >= plan.bytes.size())
+  {
+    return 0;
+  }
+  const auto offset = static_cast<std::uint32_t>(address - plan.entry);
+  const auto it = std::ranges::lower_bound(plan.instructions, offset, {},
+                                           &Instruction::offset);
+  if (it == plan.instructions.end() || it->offset != offset) { return 0; }
+  return clone + it->clone_offset;
+}
+
+auto emit_clone(const ClonePlan& plan, std::span<std::uint8_t> out,
+                std::uintptr_t clone) -> std::expected<void, Error>
+{
+  using Kind = Instruction::Kind;
+  if (out.size() < plan.size) { return std::unexpected(Error::NotEnoughSpace); }
+  std::ranges::fill(out.first(plan.size), 0xCC);
+  const auto put = [&](std::size_t at, const auto& value)
+  { std::memcpy(out.data() + at, &value, sizeof(value)); };
+
+  for (const auto& instruction : plan.instructions)
+  {
+    const auto* bytes = plan.bytes.data() + instruction.offset;
+    const auto at = std::size_t{instruction.clone_offset};
+    const auto next = clone + at + emitted_length(instruction);
+    std::ranges::copy_n(bytes, instruction.length, out.begin() + at);
+
+    std::uintptr_t target = 0;
+    if (instruction.table >= 0)
+    {
+      const auto& table = plan.tables[instruction.table];
+      target = clone + table.clone_offset;
+      if (instruction.kind == Kind::Copy)
+      {
+        // The displacement of `mov r32, [base+index*4+rva]` or x86
+        // `jmp [index*4+table]`.
+        const auto value =
+            table.base == JumpTable::Base::Image
+                ? static_cast<std::int64_t>(target - table.image_base)
+                : static_cast<std::int64_t>(target);
+        if (table.base == JumpTable::Base::Image && not fits_int32(value))
+        {
+          return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+        }
+        put(at + instruction.operand_offset,
+            static_cast<std::uint32_t>(value));
+        continue;
+      }
+    }
+    else if (instruction.kind == Kind::Copy) { continue; }
+    else
+    {
+      target = plan.branch_target(instruction);
+      if (instruction.internal)
+      {
+        target = cloned_address(plan, clone, target);
+        if (target == 0)
+        {
+          return std::unexpected(Error::UnsupportedInstruction);
+        }
+      }
+    }
+
+    const auto displacement = rel32(next, target);
+    if (not displacement) { return std::unexpected(displacement.error()); }
+    switch (instruction.kind)
+    {
+      case Kind::Rel32:
+        put(at + instruction.operand_offset, *displacement);
+        break;
+      case Kind::ShortJcc:
+        out[at] = 0x0F;
+        out[at + 1] = 0x80 | (bytes[instruction.operand_offset - 1] & 0x0F);
+        put(at + 2, *displacement);
+        break;
+      case Kind::ShortJmp:
+        out[at] = 0xE9;
+        put(at + 1, *displacement);
+        break;
+      case Kind::Loop:
+      {
+        const auto tail = at + instruction.length;
+        out[at + instruction.operand_offset] = 2;
+        out[tail] = 0xEB;
+        out[tail + 1] = 5;
+        out[tail + 2] = 0xE9;
+        put(tail + 3, *displacement);
+        break;
+      }
+      default: break;
+    }
+  }
+
+  for (const auto& table : plan.tables)
+  {
+    const auto address = clone + table.clone_offset;
+    for (std::size_t i = 0; i < table.targets.size(); ++i)
+    {
+      const auto target = cloned_address(plan, clone, table.targets[i]);
+      if (target == 0)
+      {
+        return std::unexpected(Error::UnsupportedInstruction);
+      }
+      std::int64_t value = static_cast<std::int64_t>(target);
+      if (table.base == JumpTable::Base::Image)
+      {
+        value = static_cast<std::int64_t>(target) -
+                static_cast<std::int64_t>(table.image_base);
+        if (value < 0 || value > std::numeric_limits<std::uint32_t>::max())
+        {
+          return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+        }
+      }
+      else if (table.base == JumpTable::Base::Table)
+      {
+        value = static_cast<std::intptr_t>(target - address);
+        if (not fits_int32(value))
+        {
+          return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+        }
+      }
+      put(table.clone_offset + (i * sizeof(std::uint32_t)),
+          static_cast<std::uint32_t>(value));
+    }
+  }
+  return {};
+}
+
+}  // namespace VeilHook::Impl
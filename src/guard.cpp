@@ -0,0 +1,161 @@
+#include "VeilHook/guard.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <span>
+
+namespace VeilHook
+{
+
+namespace Impl
+{
+namespace
+{
+auto allocate_slot() -> std::uint32_t
+{
+  const auto slot = TlsAlloc();
+  if (slot == TLS_OUT_OF_INDEXES) { return kNoTlsSlot; }
+  if (slot >= kTlsSlots)
+  {
+    TlsFree(slot);
+    return kNoTlsSlot;
+  }
+  return slot;
+}
+
+template <typename T>
+void put(std::span<std::uint8_t> code, std::size_t offset, T value)
+{
+  std::memcpy(code.data() + offset, &value, sizeof(value));
+}
+
+#if defined(VH_ARCH_X86_64)
+// Byte offsets of the x64 stub below.
+constexpr std::size_t kLanding = 50;
+constexpr std::size_t kPassThrough = 75;
+constexpr std::size_t kDetourLiteral = 88;
+constexpr std::size_t kTrampolineLiteral = 96;
+
+void emit(std::span<std::uint8_t> code,
+          [[maybe_unused]] std::uintptr_t address, std::uint32_t bypass,
+          std::uint32_t flag, std::uintptr_t detour, std::uintptr_t trampoline)
+{
+  constexpr std::array<std::uint8_t, kTrampolineLiteral + 8> kTemplate{
+      0x65, 0x48, 0x8B, 0x04, 0x25, 0, 0, 0, 0,  // mov rax, gs:[bypass]
+      0x65, 0x48, 0x0B, 0x04, 0x25, 0, 0, 0, 0,  // or rax, gs:[flag]
+      0x75, kPassThrough - 20,                   // jnz pass_through
+      0x48, 0x8B, 0x04, 0x24,                    // mov rax, [rsp]
+      0x65, 0x48, 0x89, 0x04, 0x25, 0, 0, 0, 0,  // mov gs:[flag], rax
+      0x48, 0x8D, 0x05, kLanding - 40, 0, 0, 0,  // lea rax, [landing]
+      0x48, 0x89, 0x04, 0x24,                    // mov [rsp], rax
+      0xFF, 0x25, kDetourLiteral - 50, 0, 0, 0,  // jmp [detour]
+      // landing:
+      0x65, 0x4C, 0x8B, 0x1C, 0x25, 0, 0, 0, 0,  // mov r11, gs:[flag]
+      0x65, 0x48, 0xC7, 0x04, 0x25, 0, 0, 0, 0,  // mov qword gs:[flag], 0
+      0, 0, 0, 0,                                //   (imm32)
+      0x41, 0xFF, 0xE3,                          // jmp r11
+      // pass_through:
+      0xFF, 0x25, kTrampolineLiteral - 81, 0, 0, 0,  // jmp [trampoline]
+      0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+  };
+  std::ranges::copy(kTemplate, code.begin());
+  const auto bypass_offset = tls_offset(bypass);
+  const auto flag_offset = tls_offset(flag);
+  put(code, 5, bypass_offset);
+  put(code, 14, flag_offset);
+  put(code, 29, flag_offset);
+  put(code, 55, flag_offset);
+  put(code, 64, flag_offset);
+  put(code, kDetourLiteral, static_cast<std::uint64_t>(detour));
+  put(code, kTrampolineLiteral, static_cast<std::uint64_t>(trampoline));
+}
+#else
+// Byte offsets of the x86 stub below.
+constexpr std::size_t kDetourOperand = 32;
+constexpr std::size_t kLanding = 36;
+constexpr std::size_t kPassThrough = 56;
+constexpr std::size_t kEnd = 61;
+
+void emit(std::span<std::uint8_t> code, std::uintptr_t address,
+          std::uint32_t bypass, std::uint32_t flag, std::uintptr_t detour,
+          std::uintptr_t trampoline)
+{
+  constexpr std::array<std::uint8_t, kEnd> kTemplate{
+      0x64, 0xA1, 0, 0, 0, 0,                    // mov eax, fs:[bypass]
+      0x64, 0x0B, 0x05, 0, 0, 0, 0,              // or eax, fs:[flag]
+      0x75, kPassThrough - 15,                   // jnz pass_through
+      0x8B, 0x04, 0x24,                          // mov eax, [esp]
+      0x64, 0xA3, 0, 0, 0, 0,                    // mov fs:[flag], eax
+      0xC7, 0x04, 0x24, 0, 0, 0, 0,              // mov [esp], landing
+      0xE9, 0, 0, 0, 0,                          // jmp detour
+      // landing:
+      0x64, 0x8B, 0x0D, 0, 0, 0, 0,              // mov ecx, fs:[flag]
+      0x64, 0xC7, 0x05, 0, 0, 0, 0, 0, 0, 0, 0,  // mov fs:[flag], 0
+      0xFF, 0xE1,                                // jmp ecx
+      // pass_through:
+      0xE9, 0, 0, 0, 0,                          // jmp trampoline
+  };
+  std::ranges::copy(kTemplate, code.begin());
+  const auto flag_offset = tls_offset(flag);
+  put(code, 2, tls_offset(bypass));
+  put(code, 9, flag_offset);
+  put(code, 20, flag_offset);
+  put(code, 27, static_cast<std::uint32_t>(address + kLanding));
+  put(code, kDetourOperand,
+      static_cast<std::uint32_t>(detour - (address + kLanding)));
+  put(code, 39, flag_offset);
+  put(code, 46, flag_offset);
+  put(code, 57, static_cast<std::uint32_t>(trampoline - (address + kEnd)));
+}
+#endif
+}  // namespace
+
+auto bypass_slot() -> std::uint32_t
+{
+  static const auto slot = allocate_slot();
+  return slot;
+}
+
+auto GuardStub::Create(Allocator& allocator, std::uintptr_t detour,
+                       std::uintptr_t trampoline)
+    -> std::expected<std::unique_ptr<GuardStub>, Error>
+{
+  const auto bypass = bypass_slot();
+  if (bypass == kNoTlsSlot) { return std::unexpected(Error::NotEnoughSpace); }
+  auto code =
+      allocator.Allocate({}, kSize, std::numeric_limits<std::size_t>::max());
+  if (not code) { return std::unexpected(Error::Allocate); }
+  const auto flag = allocate_slot();
+  if (flag == kNoTlsSlot) { return std::unexpected(Error::NotEnoughSpace); }
+
+  emit({code->data<std::uint8_t*>(), code->size()}, code->address(), bypass,
+       flag, detour, trampoline);
+  return std::unique_ptr<GuardStub>{new GuardStub{flag, std::move(*code)}};
+}
+
+void GuardStub::Retarget(std::uintptr_t detour)
+{
+  const auto address = code_.address();
+#if defined(VH_ARCH_X86_64)
+  std::atomic_ref{*detail::address_cast<std::uint64_t*>(
+                      address + kDetourLiteral)}
+      .store(detour, std::memory_order_release);
+#else
+  // The rel32 of `jmp detour`, 4-byte aligned in the 16-byte aligned stub.
+  std::atomic_ref{*detail::address_cast<std::uint32_t*>(
+                      address + kDetourOperand)}
+      .store(static_cast<std::uint32_t>(detour - (address + kLanding)),
+             std::memory_order_release);
+#endif
+}
+
+GuardStub::~GuardStub()
+{
+  TlsFree(slot_);
+}
+}  // namespace Impl
+
+}  // namespace VeilHook
@@ -0,0 +1,243 @@
+#include "VeilHook/hook_manager.hpp"
+#include "VeilHook/scanner.hpp"
+#include "VeilHook/symbol_index.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace VeilHook
+{
+
+namespace
+{
+// Runs under the loader lock when a load triggers it, so everything stays on
+// this thread.
+auto resolve(const HookSpec& spec, std::uintptr_t base, std::string_view name)
+    -> std::expected<std::uintptr_t, Error>
+{
+  if (not spec.symbol.empty())
+  {
+    auto& index = SymbolIndex::Get();
+    if (auto result = index.AddModule(base); not result)
+    {
+      return std::unexpected(result.error());
+    }
+    return index.Resolve(name, spec.symbol);
+  }
+
+  auto pattern = Pattern::Parse(spec.signature);
+  if (not pattern) { return std::unexpected(pattern.error()); }
+  Scanner scanner{{std::move(*pattern)}};
+  scanner.set_concurrency(1);
+  const auto matches = scanner.ScanModule(base);
+  if (not matches) { return std::unexpected(matches.error()); }
+  if (matches->empty()) { return std::unexpected(Error::NotFound); }
+  return matches->front().address;
+}
+}  // namespace
+
+auto HookManager::Get() -> HookManager&
+{
+  static HookManager manager;
+  return manager;
+}
+
+HookManager::HookManager()
+{
+  // Without notifications specs still arm in Add for loaded modules.
+  if (auto watch = Impl::module_watch(&_notify, this)) { watch_ = *watch; }
+}
+
+HookManager::~HookManager()
+{
+  if (watch_ != nullptr) { Impl::module_unwatch(watch_); }
+}
+
+auto HookManager::Add(HookSpec spec) -> std::expected<Id, Error>
+{
+  if (spec.module.empty() || spec.destination == 0)
+  {
+    return std::unexpected(Error::InvalidArgument);
+  }
+  if (spec.symbol.empty())
+  {
+    // Bad signatures fail here rather than on some later load.
+    if (auto pattern = Pattern::Parse(spec.signature); not pattern)
+    {
+      return std::unexpected(pattern.error());
+    }
+  }
+
+  const auto module = Impl::ascii_lower(spec.module);
+  Id id{};
+  {
+    std::scoped_lock lock{mutex_};
+    id = next_++;
+    entries_.emplace(id, Entry{.spec = std::move(spec), .module = module});
+  }
+  // Looked up only once the entry is visible: a load in between arms it
+  // from the notification, and the Pending check keeps this from arming it
+  // twice.
+  if (const auto base = Impl::module_find(module))
+  {
+    _arm(*base, Impl::module_name(*base));
+  }
+  return id;
+}
+
+void HookManager::Remove(Id id)
+{
+  Entry entry;
+  {
+    std::scoped_lock lock{mutex_};
+    const auto it = entries_.find(id);
+    if (it == entries_.end()) { return; }
+    // An entry still arming is dropped by _arm once it finishes.
+    entry = std::move(it->second);
+    entries_.erase(it);
+  }
+  if (entry.hook)
+  {
+    if (entry.spec.on_disarmed) { entry.spec.on_disarmed(); }
+    entry.hook.reset();
+  }
+}
+
+auto HookManager::armed(Id id) const -> bool
+{
+  std::scoped_lock lock{mutex_};
+  const auto it = entries_.find(id);
+  return it != entries_.end() && it->second.state == State::Armed;
+}
+
+auto HookManager::pending() const -> std::size_t
+{
+  std::scoped_lock lock{mutex_};
+  return static_cast<std::size_t>(
+      std::ranges::count(entries_, State::Pending,
+                         [](const auto& pair) { return pair.second.state; }));
+}
+
+void HookManager::_notify(Impl::ModuleEvent event, std::uintptr_t base,
+                          std::string_view name, void* context)
+{
+  auto* manager = static_cast<HookManager*>(context);
+  if (event == Impl::ModuleEvent::Loaded) { manager->_arm(base, name); }
+  else { manager->_disarm(base); }
+}
+
+void HookManager::_arm(std::uintptr_t base, std::string_view name)
+{
+  struct Work
+  {
+    Id id;
+    HookSpec spec;
+  };
+  std::vector<Work> work;
+  {
+    std::scoped_lock lock{mutex_};
+    for (auto& [id, entry] : entries_)
+    {
+      if (entry.state == State::Pending &&
+          Impl::module_matches(name, entry.module))
+      {
+        entry.state = State::Arming;
+        entry.base = base;
+        work.push_back({.id = id, .spec = entry.spec});
+      }
+    }
+  }
+  if (work.empty()) { return; }
+
+  // Resolving and patching may call into the loader, which must not happen
+  // while mutex_ is held.
+  std::vector<HookTarget> targets;
+  std::vector<std::size_t> resolved;
+  std::vector<bool> ok(work.size(), false);
+  for (std::size_t i = 0; i < work.size(); ++i)
+  {
+    if (const auto target = resolve(work[i].spec, base, name))
+    {
+      targets.push_back(
+          {.target = *target, .destination = work[i].spec.destination});
+      resolved.push_back(i);
+    }
+  }
+  std::vector<std::unique_ptr<InlineHook>> hooks(work.size());
+  auto created = InlineHook::CreateMany(targets, {.threads = 1});
+  for (std::size_t i = 0; i < created.size(); ++i)
+  {
+    if (not created[i] || not created[i]->Enable()) { continue; }
+    const auto at = resolved[i];
+    hooks[at] = std::make_unique<InlineHook>(std::move(*created[i]));
+    if (work[at].spec.on_armed) { work[at].spec.on_armed(*hooks[at]); }
+    ok[at] = true;
+  }
+
+  {
+    std::scoped_lock lock{mutex_};
+    for (std::size_t i = 0; i < work.size(); ++i)
+    {
+      // Entries removed while arming keep their hook here and lose it below.
+      const auto it = entries_.find(work[i].id);
+      if (it == entries_.end()) { continue; }
+      if (it->second.unloaded)
+      {
+        // The module went away meanwhile; its image cannot be restored.
+        if (hooks[i]) { hooks[i]->_abandon(); }
+        it->second.unloaded = false;
+        it->second.state = State::Pending;
+        it->second.base = 0;
+        continue;
+      }
+      // Failed specs wait for the next load of their module.
+      it->second.state = ok[i] ? State::Armed : State::Pending;
+      it->second.base = ok[i] ? base : 0;
+      it->second.hook = std::move(hooks[i]);
+    }
+  }
+  for (std::size_t i = 0; i < work.size(); ++i)
+  {
+    if (not hooks[i]) { continue; }
+    if (work[i].spec.on_disarmed) { work[i].spec.on_disarmed(); }
+    hooks[i].reset();
+  }
+}
+
+void HookManager::_disarm(std::uintptr_t base)
+{
+  struct Teardown
+  {
+    std::function<void()> on_disarmed;
+    std::unique_ptr<InlineHook> hook;
+  };
+  std::vector<Teardown> teardown;
+  {
+    std::scoped_lock lock{mutex_};
+    for (auto& [id, entry] : entries_)
+    {
+      if (entry.base != base) { continue; }
+      if (entry.state == State::Arming)
+      {
+        // _arm drops what it made once it finishes.
+        entry.unloaded = true;
+        continue;
+      }
+      if (entry.state != State::Armed) { continue; }
+      teardown.push_back({.on_disarmed = entry.spec.on_disarmed,
+                          .hook = std::move(entry.hook)});
+      entry.state = State::Pending;
+      entry.base = 0;
+    }
+  }
+  // Restores the prologues and frees the trampolines before the image is
+  // unmapped.
+  for (auto& [on_disarmed, hook] : teardown)
+  {
+    if (on_disarmed) { on_disarmed(); }
+    hook.reset();
+  }
+  SymbolIndex::Get().RemoveModule(base);
+}
+
+}  // namespace VeilHook
@@ -0,0 +1,556 @@
+#include "VeilHook/hook_plan.hpp"
+#include "VeilHook/length_decoder.hpp"
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+namespace VeilHook
+{
+
+#if defined(VH_COMPILER_MSVC)
+#pragma pack(push, 1)
+#endif
+struct VH_PACKED JmpE9
+{
+  std::uint8_t opcode{0xE9};
+  std::int32_t offset{0};
+};
+// `jmp [rip+offset]` on x64, `jmp [offset]` on x86.
+struct VH_PACKED JmpFF
+{
+  std::uint8_t opcode{0xFF};
+  std::uint8_t opcode2{0x25};
+  std::int32_t offset{0};
+};
+#if defined(VH_ARCH_X86_64)
+struct TrampolineEpilogueFF
+{
+  JmpFF jmp_to_original{};
+  uint64_t original_address{};
+};
+#endif
+
+#if defined(VH_COMPILER_MSVC)
+#pragma pack(pop)
+#endif
+
+namespace Impl
+{
+
+namespace
+{
+#if defined(VH_ARCH_X86_64)
+// `jmp [rip+0]` followed by its 64-bit literal.
+constexpr std::size_t kPatchSizeFF = sizeof(JmpFF) + sizeof(std::uint64_t);
+#endif
+// Blocks from the Allocator start at this alignment.
+constexpr std::size_t kEntryAlignment = 0x10;
+
+// Where the pieces of an E9 trampoline's epilogue sit, given the emitted
+// length of the relocated prologue:
+//
+//   jmp resume               ; right behind the relocated prologue
+//   int3 ...
+//   jmp [destination]        ; what the patch jumps to, 16-byte aligned
+//   int3 ...
+//   dp destination           ; alone on its cache line
+//
+// The literal is what Retarget rewrites, and a store to a line that is
+// also being executed clears the pipeline of every core running it.
+struct EpilogueE9
+{
+  std::size_t jmp_to_original;
+  std::size_t jmp_to_destination;
+  std::size_t size;  // of the whole trampoline
+
+  explicit constexpr EpilogueE9(std::size_t code_length)
+      : jmp_to_original(code_length),
+        jmp_to_destination(
+            detail::align_up(code_length + sizeof(JmpE9), kEntryAlignment)),
+        // Room for the literal's line wherever the block starts.
+        size(detail::align_up(jmp_to_destination + sizeof(JmpFF),
+                              kEntryAlignment) +
+             (kCacheLine - kEntryAlignment) + kCacheLine)
+  {
+  }
+};
+
+auto emitted_length(const PlannedInstruction& instruction) -> std::size_t
+{
+  switch (instruction.kind)
+  {
+    case PlannedInstruction::Kind::ShortJcc: return 6;
+    case PlannedInstruction::Kind::ShortJmp: return sizeof(JmpE9);
+    default: return instruction.length;
+  }
+}
+
+auto code_length(const HookPlan& plan) -> std::size_t
+{
+  std::size_t length = 0;
+  for (std::size_t i = 0; i < plan.instruction_count; ++i)
+  {
+    length += emitted_length(plan.instructions[i]);
+  }
+  return length;
+}
+
+auto rel32(std::uintptr_t from, std::uintptr_t to)
+    -> std::expected<std::int32_t, Error>
+{
+  // Signed at pointer width first: on x86 a backward jump wraps to a large
+  // unsigned value.
+  const auto delta =
+      static_cast<std::int64_t>(static_cast<std::intptr_t>(to - from));
+  if (delta < std::numeric_limits<std::int32_t>::min() ||
+      delta > std::numeric_limits<std::int32_t>::max())
+  {
+    return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+  }
+  return static_cast<std::int32_t>(delta);
+}
+
+// Writes into `out`, which stands in for the memory at runtime address `base`.
+class Writer
+{
+ public:
+  Writer(std::span<std::uint8_t> out, std::uintptr_t base)
+      : out_(detail::address_cast<std::uintptr_t>(out.data())), base_(base)
+  {
+  }
+  template <typename T>
+  void store(std::uintptr_t address, const T& value) const
+  {
+    detail::store(out_ + (address - base_), value);
+  }
+  void copy(const std::uint8_t* src, std::uintptr_t address,
+            std::size_t size) const
+  {
+    detail::copy(detail::address_cast<std::uintptr_t>(src),
+                 out_ + (address - base_), size);
+  }
+  auto jmp_e9(std::uintptr_t src, std::uintptr_t dst) const
+      -> std::expected<void, Error>
+  {
+    auto offset = rel32(src + sizeof(JmpE9), dst);
+    if (not offset) { return std::unexpected(offset.error()); }
+    JmpE9 jmp{};
+    jmp.offset = *offset;
+    store(src, jmp);
+    return {};
+  }
+  auto jmp_ff(std::uintptr_t src, std::uintptr_t dst, std::uintptr_t data) const
+      -> std::expected<void, Error>
+  {
+    JmpFF jmp{};
+#if defined(VH_ARCH_X86_64)
+    auto offset = rel32(src + sizeof(JmpFF), data);
+    if (not offset) { return std::unexpected(offset.error()); }
+    jmp.offset = *offset;
+#else
+    jmp.offset = static_cast<std::int32_t>(data);  // absolute
+#endif
+    store(src, jmp);
+    store(data, dst);
+    return {};
+  }
+
+ private:
+  std::uintptr_t out_;
+  std::uintptr_t base_;
+};
+}  // namespace
+
+auto HookPlan::branch_target(const PlannedInstruction& instruction) const
+    -> std::uintptr_t
+{
+  const auto next = target + instruction.offset + instruction.length;
+  const auto* operand =
+      original_bytes.data() + instruction.offset + instruction.operand_offset;
+  std::intptr_t displacement = 0;
+  if (instruction.kind == PlannedInstruction::Kind::Rel32)
+  {
+    std::int32_t value = 0;
+    std::memcpy(&value, operand, sizeof(value));
+    displacement = value;
+  }
+  else { displacement = static_cast<std::int8_t>(*operand); }
+  return next + static_cast<std::uintptr_t>(displacement);
+}
+
+auto HookPlan::reach() const -> Reach
+{
+  Reach reach{};
+  reach.addresses[reach.count++] = target;
+  for (std::size_t i = 0; i < instruction_count; ++i)
+  {
+    if (instructions[i].kind != PlannedInstruction::Kind::Copy)
+    {
+      reach.addresses[reach.count++] = branch_target(instructions[i]);
+    }
+  }
+  return reach;
+}
+
+auto trampoline_size(const HookPlan& plan) -> std::size_t
+{
+#if defined(VH_ARCH_X86_64)
+  if (plan.type == HookType::FF)
+  {
+    return code_length(plan) + sizeof(TrampolineEpilogueFF);
+  }
+#endif
+  return EpilogueE9{code_length(plan)}.size;
+}
+
+auto plan_hook(std::span<const std::uint8_t> code, std::uintptr_t address,
+               HookType type) -> std::expected<HookPlan, Error>
+{
+  HookPlan plan{};
+  plan.target = address;
+  plan.type = type;
+
+  std::size_t required = sizeof(JmpE9);
+#if defined(VH_ARCH_X86_64)
+  if (type == HookType::FF) { required = kPatchSizeFF; }
+#else
+  if (type != HookType::E9) { return std::unexpected(Error::UnsupportedInstruction); }
+#endif
+
+  using Branch = InstructionLength::Branch;
+  std::size_t offset = 0;
+  while (offset < required)
+  {
+    if (plan.instruction_count == HookPlan::kMaxInstructions ||
+        offset >= code.size())
+    {
+      return std::unexpected(Error::NotEnoughSpace);
+    }
+    const auto ix = decode_length(code.subspan(offset));
+    if (not ix) { return std::unexpected(ix.error()); }
+    if (offset + ix->length > HookPlan::kMaxPrologue)
+    {
+      return std::unexpected(Error::NotEnoughSpace);
+    }
+
+    PlannedInstruction instruction{.offset = static_cast<std::uint8_t>(offset),
+                                   .length = ix->length,
+                                   .operand_offset = ix->rel_offset};
+    if (ix->rel_size != 0)
+    {
+      // A far-away trampoline cannot reach anything with a rel32.
+      if (type == HookType::FF)
+      {
+        return std::unexpected(Error::IpRelativeInstructionOutOfRange);
+      }
+      if (ix->rel_size == 4)
+      {
+        instruction.kind = PlannedInstruction::Kind::Rel32;
+      }
+      else if (ix->rel_size == 1 && ix->branch == Branch::Jcc)
+      {
+        instruction.kind = PlannedInstruction::Kind::ShortJcc;
+      }
+      else if (ix->rel_size == 1 && ix->branch == Branch::Jmp)
+      {
+        instruction.kind = PlannedInstruction::Kind::ShortJmp;
+      }
+      // jrcxz, loop and friends have no rel32 form.
+      else { return std::unexpected(Error::UnsupportedInstruction); }
+    }
+
+    std::copy_n(code.data() + offset, ix->length,
+                plan.original_bytes.data() + offset);
+    plan.instructions[plan.instruction_count++] = instruction;
+    offset += ix->length;
+  }
+
+  plan.prologue_size = static_cast<std::uint8_t>(offset);
+  plan.trampoline_size = static_cast<std::uint16_t>(trampoline_size(plan));
+  return plan;
+}
+
+auto plan_hook(std::uintptr_t address, HookType type)
+    -> std::expected<HookPlan, Error>
+{
+  VH_TRACE_SCOPE(trace, Decode, address);
+  // The decoder only reads as far as each instruction actually extends.
+  auto plan = plan_hook(
+      std::span{detail::address_cast<const std::uint8_t*>(address),
+                HookPlan::kMaxPrologue + 15},
+      address, type);
+  if (not plan) { trace.fail(plan.error()); }
+  return plan;
+}
+
+namespace
+{
+// Writes the relocated prologue at `trampoline` and returns its length.
+auto emit_prologue(const HookPlan& plan, const Writer& writer,
+                   std::uintptr_t trampoline)
+    -> std::expected<std::size_t, Error>
+{
+  using Kind = PlannedInstruction::Kind;
+  std::array<std::size_t, HookPlan::kMaxInstructions> offsets{};
+  std::size_t cursor = 0;
+  for (std::size_t i = 0; i < plan.instruction_count; ++i)
+  {
+    offsets[i] = cursor;
+    cursor += emitted_length(plan.instructions[i]);
+  }
+
+  // Branches back into the moved prologue have to follow it.
+  const auto relocate = [&](std::uintptr_t address) -> std::uintptr_t
+  {
+    if (address < plan.target || address >= plan.target + plan.prologue_size)
+    {
+      return address;
+    }
+    for (std::size_t i = 0; i < plan.instruction_count; ++i)
+    {
+      if (plan.target + plan.instructions[i].offset == address)
+      {
+        return trampoline + offsets[i];
+      }
+    }
+    return 0;
+  };
+
+  for (std::size_t i = 0; i < plan.instruction_count; ++i)
+  {
+    const auto& instruction = plan.instructions[i];
+    const auto* bytes = plan.original_bytes.data() + instruction.offset;
+    const auto ip = trampoline + offsets[i];
+    const auto next = ip + emitted_length(instruction);
+
+    if (instruction.kind == Kind::Copy)
+    {
+      writer.copy(bytes, ip, instruction.length);
+      continue;
+    }
+
+    const auto branch_target = relocate(plan.branch_target(instruction));
+    if (branch_target == 0)
+    {
+      return std::unexpected(Error::UnsupportedInstruction);
+    }
+    auto displacement = rel32(next, branch_target);
+    if (not displacement) { return std::unexpected(displacement.error()); }
+
+    switch (instruction.kind)
+    {
+      case Kind::Rel32:
+        writer.copy(bytes, ip, instruction.length);
+        writer.store(ip + instruction.operand_offset, *displacement);
+        break;
+      case Kind::ShortJcc:
+        writer.store<std::uint8_t>(ip, 0x0F);
+        writer.store<std::uint8_t>(ip + 1, 0x80 | (bytes[0] & 0x0F));
+        writer.store(ip + 2, *displacement);
+        break;
+      case Kind::ShortJmp:
+        writer.store<std::uint8_t>(ip, 0xE9);
+        writer.store(ip + 1, *displacement);
+        break;
+      default: break;
+    }
+  }
+
+  return cursor;
+}
+}  // namespace
+
+auto emit_trampoline(const HookPlan& plan, std::span<std::uint8_t> out,
+                     std::uintptr_t trampoline, std::uintptr_t destination)
+    -> std::expected<void, Error>
+{
+  if (out.size() < plan.trampoline_size)
+  {
+    return std::unexpected(Error::NotEnoughSpace);
+  }
+  const Writer writer{out, trampoline};
+  std::ranges::fill(out.first(plan.trampoline_size), 0xCC);
+  const auto cursor = emit_prologue(plan, writer, trampoline);
+  if (not cursor) { return std::unexpected(cursor.error()); }
+
+  const auto resume = plan.target + plan.prologue_size;
+  if (plan.type == HookType::E9)
+  {
+    const EpilogueE9 layout{*cursor};
+    if (auto result =
+            writer.jmp_e9(trampoline + layout.jmp_to_original, resume);
+        not result)
+    {
+      return result;
+    }
+    return writer.jmp_ff(trampoline + layout.jmp_to_destination, destination,
+                         destination_literal(plan, trampoline));
+  }
+#if defined(VH_ARCH_X86_64)
+  if (plan.type == HookType::FF)
+  {
+    const auto epilogue = trampoline + *cursor;
+    return writer.jmp_ff(
+        epilogue + offsetof(TrampolineEpilogueFF, jmp_to_original), resume,
+        epilogue + offsetof(TrampolineEpilogueFF, original_address));
+  }
+#endif
+  return std::unexpected(Error::UnsupportedInstruction);
+}
+
+auto relocated_size(const HookPlan& plan) -> std::size_t
+{
+  return code_length(plan) + sizeof(JmpE9);
+}
+
+auto emit_relocated(const HookPlan& plan, std::span<std::uint8_t> out,
+                    std::uintptr_t address) -> std::expected<void, Error>
+{
+  if (out.size() < relocated_size(plan))
+  {
+    return std::unexpected(Error::NotEnoughSpace);
+  }
+  const Writer writer{out, address};
+  const auto cursor = emit_prologue(plan, writer, address);
+  if (not cursor) { return std::unexpected(cursor.error()); }
+  return writer.jmp_e9(address + *cursor, plan.target + plan.prologue_size);
+}
+
+auto relocated_address(const HookPlan& plan, std::uintptr_t trampoline,
+                       std::uintptr_t address) -> std::uintptr_t
+{
+  std::size_t cursor = 0;
+  for (std::size_t i = 0; i < plan.instruction_count; ++i)
+  {
+    if (plan.target + plan.instructions[i].offset == address)
+    {
+      return trampoline + cursor;
+    }
+    cursor += emitted_length(plan.instructions[i]);
+  }
+  return address == plan.target + plan.prologue_size ? trampoline + cursor
+                                                      : 0;
+}
+
+auto destination_literal(const HookPlan& plan, std::uintptr_t trampoline)
+    -> std::uintptr_t
+{
+  if (plan.type != HookType::E9) { return 0; }
+  const EpilogueE9 layout{code_length(plan)};
+  return detail::align_up(
+      trampoline + layout.jmp_to_destination + sizeof(JmpFF), kCacheLine);
+}
+
+auto retarget_trampoline(const HookPlan& plan, std::uintptr_t trampoline,
+                         std::uintptr_t destination)
+    -> std::expected<void, Error>
+{
+  const auto literal = destination_literal(plan, trampoline);
+  if (literal == 0) { return std::unexpected(Error::UnsupportedInstruction); }
+  std::atomic_ref{*detail::address_cast<std::uintptr_t*>(literal)}.store(
+      destination, std::memory_order_release);
+  return {};
+}
+
+auto emit_patch(const HookPlan& plan, std::span<std::uint8_t> out,
+                std::uintptr_t trampoline, std::uintptr_t destination)
+    -> std::expected<void, Error>
+{
+  if (out.size() < plan.prologue_size)
+  {
+    return std::unexpected(Error::NotEnoughSpace);
+  }
+  const Writer writer{out, plan.target};
+  writer.copy(plan.original_bytes.data(), plan.target, plan.prologue_size);
+
+  if (plan.type == HookType::E9)
+  {
+    // Detour through the trampoline's jump to the destination.
+    return writer.jmp_e9(
+        plan.target,
+        trampoline + EpilogueE9{code_length(plan)}.jmp_to_destination);
+  }
+#if defined(VH_ARCH_X86_64)
+  if (plan.type == HookType::FF)
+  {
+    detail::fill<std::uint8_t>(
+        detail::address_cast<std::uintptr_t>(out.data()), plan.prologue_size,
+        0xCC);
+    return writer.jmp_ff(plan.target, destination,
+                         plan.target + sizeof(JmpFF));
+  }
+#endif
+  return std::unexpected(Error::UnsupportedInstruction);
+}
+
+namespace
+{
+// Whether the `size` bytes at `address` can be read without faulting.
+auto readable(std::uintptr_t address, std::size_t size) -> bool
+{
+  for (const auto at : {address, address + size - 1})
+  {
+    const auto info = vm_query(at);
+    if (not info || info->free || info->access == 0 ||
+        (info->access & (PAGE_NOACCESS | PAGE_GUARD)) != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+auto resolve_jumps(std::uintptr_t address) -> std::uintptr_t
+{
+  for (std::size_t hop = 0; hop < kMaxJumps; ++hop)
+  {
+    // Long enough for the longest form, `rex.w jmp [rip+disp32]`.
+    if (not readable(address, 7)) { break; }
+    const auto* code = detail::address_cast<const std::uint8_t*>(address);
+    std::uintptr_t next = 0;
+    if (code[0] == 0xE9)
+    {
+      std::int32_t offset = 0;
+      std::memcpy(&offset, code + 1, sizeof(offset));
+      next = address + sizeof(JmpE9) + static_cast<std::uintptr_t>(offset);
+    }
+    else if (code[0] == 0xEB)
+    {
+      next = address + 2 +
+             static_cast<std::uintptr_t>(static_cast<std::int8_t>(code[1]));
+    }
+    else
+    {
+#if defined(VH_ARCH_X86_64)
+      // Some import thunks carry a redundant REX.W.
+      const std::size_t rex = code[0] == 0x48 ? 1 : 0;
+#else
+      const std::size_t rex = 0;
+#endif
+      if (code[rex] != 0xFF || code[rex + 1] != 0x25) { break; }
+      std::int32_t offset = 0;
+      std::memcpy(&offset, code + rex + 2, sizeof(offset));
+#if defined(VH_ARCH_X86_64)
+      const auto slot = address + rex + sizeof(JmpFF) +
+                        static_cast<std::uintptr_t>(offset);
+#else
+      const auto slot = static_cast<std::uintptr_t>(
+          static_cast<std::uint32_t>(offset));
+#endif
+      if (not readable(slot, sizeof(next))) { break; }
+      std::memcpy(&next, detail::address_cast<const void*>(slot),
+                  sizeof(next));
+    }
+    if (next == 0 || next == address) { break; }
+    address = next;
+  }
+  return address;
+}
+
+}  // namespace Impl
+}  // namespace VeilHook
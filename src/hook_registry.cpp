@@ -0,0 +1,344 @@
+#include "VeilHook/hook_registry.hpp"
+#include "VeilHook/reclaimer.hpp"
+#include "VeilHook/trace.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace VeilHook
+{
+
+namespace
+{
+constexpr std::uint32_t kMaxGeneration =
+    (1U << (32 - HookHandle::kIndexBits)) - 1;
+constexpr std::size_t kSlotBytes =
+    sizeof(std::atomic<std::uint32_t>) + (2 * sizeof(std::uintptr_t)) +
+    sizeof(std::unique_ptr<Impl::GuardStub>) +
+    sizeof(std::optional<Allocation>) + sizeof(std::uint32_t) +
+    sizeof(std::uint16_t) + sizeof(std::uint8_t);
+
+auto pool_chunks(std::size_t capacity, std::size_t chunk_size) -> std::size_t
+{
+  return ((capacity * 2 * Impl::HookPlan::kMaxPrologue) + chunk_size - 1) /
+         chunk_size;
+}
+}  // namespace
+
+HookRegistry::HookRegistry(std::size_t capacity,
+                           std::shared_ptr<Allocator> allocator)
+    : allocator_(std::move(allocator)),
+      capacity_(std::min(capacity, kMaxCapacity)),
+      states_(std::make_unique<std::atomic<std::uint32_t>[]>(capacity_)),
+      targets_(std::make_unique_for_overwrite<std::uintptr_t[]>(capacity_)),
+      trampolines_(std::make_unique_for_overwrite<std::uintptr_t[]>(capacity_)),
+      guards_(std::make_unique<std::unique_ptr<Impl::GuardStub>[]>(capacity_)),
+      clones_(std::make_unique<std::optional<Allocation>[]>(capacity_)),
+      offsets_(std::make_unique_for_overwrite<std::uint32_t[]>(capacity_)),
+      trampoline_sizes_(
+          std::make_unique_for_overwrite<std::uint16_t[]>(capacity_)),
+      prologue_sizes_(
+          std::make_unique_for_overwrite<std::uint8_t[]>(capacity_)),
+      chunks_(std::make_unique<std::unique_ptr<std::uint8_t[]>[]>(
+          pool_chunks(capacity_, kChunkSize)))
+{
+}
+
+HookRegistry::~HookRegistry()
+{
+  for (std::uint32_t i = 0; i < slots_; ++i)
+  {
+    const auto state = states_[i].load(std::memory_order_acquire);
+    if ((state & kLive) == 0) { continue; }
+    if ((state & kEnabled) != 0) { (void)_write(i, false); }
+    _retire(i);
+  }
+}
+
+auto HookRegistry::Add(std::uintptr_t target, std::uintptr_t destination,
+                       HookOptions options) -> std::expected<HookHandle, Error>
+{
+  options.lazy = false;
+  auto hook = InlineHook::Create(allocator_, target, destination, options);
+  if (not hook) { return std::unexpected(hook.error()); }
+  return _adopt(*hook);
+}
+
+auto HookRegistry::AddMany(std::span<const HookTarget> targets,
+                           HookOptions options)
+    -> std::vector<std::expected<HookHandle, Error>>
+{
+  options.lazy = false;
+  auto hooks = InlineHook::CreateMany(allocator_, targets, options);
+  std::vector<std::expected<HookHandle, Error>> handles;
+  handles.reserve(hooks.size());
+  for (auto& hook : hooks)
+  {
+    if (hook) { handles.push_back(_adopt(*hook)); }
+    else { handles.push_back(std::unexpected(hook.error())); }
+  }
+  return handles;
+}
+
+auto HookRegistry::Remove(HookHandle handle) -> std::expected<void, Error>
+{
+  const auto previous = _claim(handle);
+  if (not previous) { return std::unexpected(previous.error()); }
+  const auto index = handle.index();
+  if ((*previous & kEnabled) != 0) { (void)_write(index, false); }
+
+  std::scoped_lock lock{mutex_};
+  if (clones_[index]) { trampoline_bytes_ -= clones_[index]->size(); }
+  _retire(index);
+  const auto run = 2 * prologue_sizes_[index];
+  free_runs_[run].push_back(offsets_[index]);
+  pool_used_ -= run;
+  trampoline_bytes_ -= trampoline_sizes_[index];
+  --live_;
+  // Bumping the generation is what invalidates outstanding handles.
+  const auto generation = (handle.generation() % kMaxGeneration) + 1;
+  states_[index].store(generation << kGenerationShift,
+                       std::memory_order_release);
+  free_slots_.push_back(index);
+  return {};
+}
+
+auto HookRegistry::Enable(HookHandle handle) -> std::expected<void, Error>
+{
+  const auto previous = _claim(handle);
+  if (not previous) { return std::unexpected(previous.error()); }
+  if ((*previous & kEnabled) == 0 && not _write(handle.index(), true))
+  {
+    states_[handle.index()].store(*previous & ~kBusy,
+                                  std::memory_order_release);
+    return std::unexpected(Error::Allocate);
+  }
+  states_[handle.index()].store((*previous & ~kBusy) | kEnabled,
+                                std::memory_order_release);
+  return {};
+}
+
+auto HookRegistry::Disable(HookHandle handle) -> std::expected<void, Error>
+{
+  const auto previous = _claim(handle);
+  if (not previous) { return std::unexpected(previous.error()); }
+  if ((*previous & kEnabled) != 0) { (void)_write(handle.index(), false); }
+  states_[handle.index()].store(*previous & ~(kBusy | kEnabled),
+                                std::memory_order_release);
+  return {};
+}
+
+auto HookRegistry::valid(HookHandle handle) const -> bool
+{
+  return _live(handle);
+}
+
+auto HookRegistry::enabled(HookHandle handle) const -> bool
+{
+  return _live(handle) &&
+         (states_[handle.index()].load(std::memory_order_acquire) &
+          kEnabled) != 0;
+}
+
+auto HookRegistry::target(HookHandle handle) const -> std::uintptr_t
+{
+  return _live(handle) ? targets_[handle.index()] : 0;
+}
+
+auto HookRegistry::trampoline(HookHandle handle) const -> std::uintptr_t
+{
+  if (not _live(handle)) { return 0; }
+  const auto& clone = clones_[handle.index()];
+  return clone ? clone->address() : trampolines_[handle.index()];
+}
+
+auto HookRegistry::size() const -> std::size_t
+{
+  std::scoped_lock lock{mutex_};
+  return live_;
+}
+
+auto HookRegistry::memory() const -> HookMemory
+{
+  std::scoped_lock lock{mutex_};
+  return {.hooks = live_,
+          .slots = live_ * kSlotBytes,
+          .bytes = pool_used_,
+          .trampolines = trampoline_bytes_};
+}
+
+auto HookRegistry::_adopt(InlineHook& hook) -> std::expected<HookHandle, Error>
+{
+  const auto& plan = hook.plan_;
+  const auto size = plan.prologue_size;
+  std::array<std::uint8_t, Impl::HookPlan::kMaxPrologue> patch{};
+  if (auto result = Impl::emit_patch(plan, patch, hook.trampoline_->address(),
+                                     hook._entry());
+      not result)
+  {
+    return std::unexpected(result.error());
+  }
+
+  std::scoped_lock lock{mutex_};
+  std::uint32_t index{};
+  if (not free_slots_.empty())
+  {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  else if (slots_ < capacity_) { index = slots_++; }
+  else { return std::unexpected(Error::NotEnoughSpace); }
+
+  const auto offset = _pool_allocate(2 * size);
+  if (not offset)
+  {
+    free_slots_.push_back(index);
+    return std::unexpected(offset.error());
+  }
+  std::ranges::copy_n(plan.original_bytes.begin(), size, _pool(*offset));
+  std::ranges::copy_n(patch.begin(), size, _pool(*offset + size));
+
+  // The registry owns the trampoline, guard and clone from here on; the
+  // emptied hook destroys as a no-op. A guard's pass-through runs the clone,
+  // so the two retire together.
+  targets_[index] = hook.target_;
+  trampoline_sizes_[index] = static_cast<std::uint16_t>(
+      hook.trampoline_->size() +
+      (hook.guard_ ? Impl::GuardStub::kSize : 0));
+  trampolines_[index] = hook.trampoline_->release();
+  guards_[index] = std::move(hook.guard_);
+  clones_[index] = std::move(hook.clone_);
+  hook.clone_.reset();
+  offsets_[index] = *offset;
+  prologue_sizes_[index] = size;
+  hook.trampoline_.reset();
+  hook.materialized_ = false;
+  ++live_;
+  trampoline_bytes_ += trampoline_sizes_[index];
+  if (clones_[index]) { trampoline_bytes_ += clones_[index]->size(); }
+
+  auto generation =
+      states_[index].load(std::memory_order_relaxed) >> kGenerationShift;
+  if (generation == 0) { generation = 1; }
+  states_[index].store((generation << kGenerationShift) | kLive,
+                       std::memory_order_release);
+  return HookHandle{(generation << HookHandle::kIndexBits) | index};
+}
+
+auto HookRegistry::_claim(HookHandle handle)
+    -> std::expected<std::uint32_t, Error>
+{
+  if (handle.index() >= capacity_) { return std::unexpected(Error::NotFound); }
+  auto& state = states_[handle.index()];
+  auto current = state.load(std::memory_order_acquire);
+  for (;;)
+  {
+    if ((current >> kGenerationShift) != handle.generation() ||
+        (current & kLive) == 0)
+    {
+      return std::unexpected(Error::NotFound);
+    }
+    if ((current & kBusy) != 0)
+    {
+      std::this_thread::yield();
+      current = state.load(std::memory_order_acquire);
+      continue;
+    }
+    if (state.compare_exchange_weak(current, current | kBusy,
+                                    std::memory_order_acquire))
+    {
+      return current;
+    }
+  }
+}
+
+void HookRegistry::_retire(std::uint32_t index)
+{
+  auto& reclaimer = Reclaimer::Get();
+  const auto trampoline = trampolines_[index];
+  const auto size = trampoline_sizes_[index] -
+                    (guards_[index] ? Impl::GuardStub::kSize : 0);
+  reclaimer.Retire({trampoline, trampoline + size},
+                   [allocator = allocator_, trampoline]
+                   { allocator->Free(trampoline); });
+  reclaimer.Retire(std::move(guards_[index]));
+  if (clones_[index])
+  {
+    reclaimer.Retire(std::move(*clones_[index]));
+    clones_[index].reset();
+  }
+}
+
+auto HookRegistry::_write(std::uint32_t index, bool patch) -> bool
+{
+  const auto target = targets_[index];
+  const auto size = prologue_sizes_[index];
+  const auto* bytes = _pool(offsets_[index] + (patch ? size : 0));
+  if (patch)
+  {
+    {
+      VH_TRACE_SCOPE(trace, Veh, target);
+      if (not Impl::VehManager::instance().Register(target, target + size,
+                                                    &Impl::prologue_guard))
+      {
+        trace.fail(Error::Allocate);
+        return false;
+      }
+    }
+    Impl::VMProtect protect_target(target, size, Impl::patch_access(target));
+    VH_TRACE_SCOPE(trace, Write, target);
+    detail::copy(detail::address_cast<std::uintptr_t>(bytes), target, size);
+    return true;
+  }
+  {
+    Impl::VMProtect protect_target(target, size, Impl::VM_ACCESS_RWX);
+    VH_TRACE_SCOPE(trace, Write, target);
+    detail::copy(detail::address_cast<std::uintptr_t>(bytes), target, size);
+  }
+  Impl::VehManager::instance().Unregister(target);
+  return true;
+}
+
+auto HookRegistry::_pool_allocate(std::size_t size)
+    -> std::expected<std::uint32_t, Error>
+{
+  pool_used_ += size;
+  if (auto& runs = free_runs_[size]; not runs.empty())
+  {
+    const auto offset = runs.back();
+    runs.pop_back();
+    return offset;
+  }
+  auto chunk = pool_end_ >> kChunkBits;
+  if ((pool_end_ & (kChunkSize - 1)) + size > kChunkSize)
+  {
+    pool_end_ = ++chunk << kChunkBits;
+  }
+  if (chunk >= pool_chunks(capacity_, kChunkSize))
+  {
+    pool_used_ -= size;
+    return std::unexpected(Error::NotEnoughSpace);
+  }
+  if (not chunks_[chunk])
+  {
+    chunks_[chunk] = std::make_unique_for_overwrite<std::uint8_t[]>(kChunkSize);
+  }
+  const auto offset = pool_end_;
+  pool_end_ += static_cast<std::uint32_t>(size);
+  return offset;
+}
+
+auto HookRegistry::_pool(std::uint32_t offset) const -> std::uint8_t*
+{
+  return chunks_[offset >> kChunkBits].get() + (offset & (kChunkSize - 1));
+}
+
+auto HookRegistry::_live(HookHandle handle) const -> bool
+{
+  if (handle.index() >= capacity_) { return false; }
+  const auto state = states_[handle.index()].load(std::memory_order_acquire);
+  return (state >> kGenerationShift) == handle.generation() &&
+         (state & kLive) != 0;
+}
+
+}  // namespace VeilHook
@@ -1,103 +1,54 @@
 #include "VeilHook/inline_hook.hpp"
+#include "VeilHook/code_map.hpp"
 #include "VeilHook/error.hpp"
-
-#include <Zydis/Zydis.h>
+#include "VeilHook/function_clone.hpp"
+#include "VeilHook/plan_cache.hpp"
+#include "VeilHook/reclaimer.hpp"
+#include "VeilHook/symbol_index.hpp"
+#include "VeilHook/trace.hpp"
+
+#include <algorithm>
+#include <array>
 #include <expected>
+#include <limits>
+#include <optional>
 
 namespace VeilHook
 {
 
-#if defined(VH_COMPILER_MSVC)
-#pragma pack(push, 1)
-#endif
-struct VH_PACKED JmpE9
-{
-  std::uint8_t opcode{0xE9};
-  std::int32_t offset{0};
-};
-#if defined(VH_ARCH_X86_64)
-struct VH_PACKED JmpFF
-{
-  std::uint8_t opcode{0xFF};
-  std::uint8_t opcode2{0x25};
-  std::int32_t offset{0};
-};
-struct TrampolineEpilogueE9
-{
-  JmpE9 jmp_to_original{};
-  JmpFF jmp_to_destination{};
-  uint64_t destination_address{};
-};
-struct TrampolineEpilogueFF
-{
-  JmpFF jmp_to_original{};
-  uint64_t original_address{};
-};
-#elif defined(VH_ARCH_X86_32)
-struct VH_PACKED TrampolineEpilogueE9
-{
-  JmpE9 jmp_to_original{};
-  JmpE9 jmp_to_destionation{};
-};
-#endif
-
-#if defined(VH_COMPILER_MSVC)
-#pragma pack(pop)
-#endif
-
-namespace Impl
-{
-
-auto make_jmp_e9(std::uintptr_t src, std::uintptr_t dest) -> JmpE9
-{
-  JmpE9 jmp{};
-  jmp.offset = static_cast<std::int32_t>(dest - src - sizeof(jmp));
-  return jmp;
-}
-
-auto make_jmp_ff(std::uintptr_t src, std::uintptr_t dest, std::uintptr_t data)
-    -> JmpFF
-{
-  JmpFF jmp{};
-  jmp.offset = static_cast<std::int32_t>(data - src - sizeof(jmp));
-  detail::store(data, dest); //NOLINT
-  return jmp;
-}
-
-auto emit_jmp_e9(std::uintptr_t src, std::uintptr_t dest,
-                 std::size_t size = sizeof(JmpE9)) -> std::expected<void, Error>
-{
-  if (size < sizeof(JmpE9)) { return std::unexpected(Error::NotEnoughSpace); }
-  if (size > sizeof(JmpE9)) { detail::fill(src, size, 0xCC); }
-  detail::store(src, make_jmp_e9(src, dest));
-  return {};
-}
-
-auto emit_jmp_ff(std::uintptr_t src, std::uintptr_t dest, std::uintptr_t data,
-                 std::size_t size = sizeof(JmpFF)) -> std::expected<void, Error>
+namespace
 {
-  if (size < sizeof(JmpFF)) { return std::unexpected(Error::NotEnoughSpace); }
-  if (size > sizeof(JmpFF)) { detail::fill(src, size, 0xCC); }
-  detail::store(src, make_jmp_ff(src, dest, data));
-  return {};
-}
+// Hooks whose trampolines may share one allocation: every reach address of
+// the group lies within this span, so some block is in rel32 range of all.
+constexpr std::uintptr_t kBatchWindow = 0x4000'0000;
+constexpr std::size_t kBatchBytes = 0x10000;
 
-auto decode(ZydisDecodedInstruction& ix, std::uintptr_t address) -> bool
+auto plan(std::uintptr_t target, PlanCache* cache)
+    -> std::expected<Impl::HookPlan, Error>
 {
-  ZydisDecoder decoder{};
+  if (cache != nullptr)
+  {
+    if (auto cached = cache->Find(target)) { return *cached; }
+  }
+  auto result = Impl::plan_hook(target, Impl::HookType::E9);
 #if defined(VH_ARCH_X86_64)
-  auto status = ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64,
-                                 ZYDIS_STACK_WIDTH_64);
-#elif defined(VH_ARCH_X86_32)
-  auto status = ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32,
-                                 ZYDIS_STACK_WIDTH_32);
+  if (not result) { result = Impl::plan_hook(target, Impl::HookType::FF); }
 #endif
-  if (ZYAN_FAILED(status)) { return false; }
-  return ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
-      &decoder, nullptr, detail::address_cast<void*>(address), 15, &ix));
+  if (result && cache != nullptr) { cache->Insert(*result); }
+  return result;
 }
 
-}  // namespace Impl
+auto allocate(Allocator& allocator, const Impl::HookPlan& plan)
+    -> std::optional<Allocation>
+{
+  VH_TRACE_SCOPE(trace, Allocate, plan.target);
+  auto allocation = plan.type == Impl::HookType::E9
+                        ? allocator.Allocate(plan.reach(), plan.trampoline_size)
+                        : allocator.Allocate(plan.trampoline_size);
+  if (not allocation) { trace.fail(Error::Allocate); }
+  return allocation;
+}
+}  // namespace
 
 InlineHook::InlineHook(InlineHook&& other) noexcept
 {
@@ -112,335 +63,347 @@ auto InlineHook::operator=(InlineHook&& other) noexcept -> InlineHook&
     target_ = other.target_;
     destination_ = other.destination_;
     trampoline_ = std::move(other.trampoline_);
-    original_bytes_ = other.original_bytes_;
-    original_bytes_size_ = other.original_bytes_size_;
-    type_ = other.type_;
+    clone_ = std::move(other.clone_);
+    guard_ = std::move(other.guard_);
+    plan_ = other.plan_;
     enabled_ = other.enabled_;
+    materialized_ = other.materialized_.load();
 
     other.target_ = 0;
     other.destination_ = 0;
-    other.trampoline_ = nullptr;
-    other.original_bytes_size_ = 0;
-    other.type_ = Type::None;
+    other.trampoline_.reset();
+    other.clone_.reset();
+    other.plan_ = {};
     other.enabled_ = false;
+    other.materialized_ = false;
   }
 
   return *this;
 }
 
 auto InlineHook::Create(const std::shared_ptr<Allocator>& allocator,
-                        std::uintptr_t target, std::uintptr_t destination)
+                        std::uintptr_t target, std::uintptr_t destination,
+                        HookOptions options)
     -> std::expected<InlineHook, Error>
 {
   if (not allocator) { return std::unexpected(Error::Allocate); }
+  if (options.follow_jumps) { target = Impl::resolve_jumps(target); }
   InlineHook hook{};
-  if (auto err = hook._setup(allocator, target, destination); not err)
+  if (auto err = hook._setup(allocator, target, destination, options.cache);
+      not err)
   {
     return std::unexpected(err.error());
   }
+  if (options.clone) { hook._clone(*allocator); }
+  if (options.guarded)
+  {
+    if (auto err = hook._guard(*allocator); not err)
+    {
+      return std::unexpected(err.error());
+    }
+  }
+  if (not options.lazy)
+  {
+    if (auto err = hook._materialize(); not err)
+    {
+      return std::unexpected(err.error());
+    }
+  }
   return hook;
 }
 
-auto InlineHook::_setup(const std::shared_ptr<Allocator>& allocator,
-                        std::uintptr_t target, std::uintptr_t destination)
-    -> std::expected<void, Error>
+auto InlineHook::Create(std::string_view module, std::string_view symbol,
+                        std::uintptr_t destination, HookOptions options)
+    -> std::expected<InlineHook, Error>
 {
-  target_ = target;
-  destination_ = destination;
-  if (auto e9_result = _e9_hook(allocator); not e9_result)
-  {
-#if defined(VH_ARCH_X86_64)
-    return _ff_hook(allocator);
-#elif defined(VH_ARCH_X86_32)
-    return e9_result;
-#endif
-  }
-
-  return {};
+  const auto target = SymbolIndex::Get().Resolve(module, symbol);
+  if (not target) { return std::unexpected(target.error()); }
+  return Create(*target, destination, options);
 }
 
-auto InlineHook::_e9_hook(const std::shared_ptr<Allocator>& allocator)
-    -> std::expected<void, Error>
+auto InlineHook::CreateMany(const std::shared_ptr<Allocator>& allocator,
+                            std::span<const HookTarget> targets,
+                            HookOptions options)
+    -> std::vector<std::expected<InlineHook, Error>>
 {
-  std::size_t trampoline_size = sizeof(TrampolineEpilogueE9);
-
-  std::vector<std::uintptr_t> desired_addresses{target_};
-  ZydisDecodedInstruction ix{};
-
-  for (auto ip = target_; ip < target_ + sizeof(JmpE9); ip += ix.length)
+  std::vector<std::expected<InlineHook, Error>> hooks(targets.size());
+  if (not allocator)
   {
-    if (not Impl::decode(ix, ip))
-    {
-      return std::unexpected(Error::FailedDecodeInstruction);
-    }
-
-    trampoline_size += ix.length;
-    std::copy_n(detail::address_cast<std::uint8_t*>(ip), ix.length,
-                original_bytes_.data() + original_bytes_size_);
-    original_bytes_size_ += ix.length;
+    std::ranges::fill(hooks, std::unexpected(Error::Allocate));
+    return hooks;
+  }
 
-    const auto is_rel = (ix.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
-    if (is_rel)
+  // Resolve and decode every prologue in parallel.
+  std::vector<std::uintptr_t> resolved(targets.size());
+  std::vector<std::expected<Impl::HookPlan, Error>> plans(targets.size());
+  Impl::parallel_for(
+      targets.size(),
+      [&](std::size_t i)
+      {
+        resolved[i] = options.follow_jumps
+                          ? Impl::resolve_jumps(targets[i].target)
+                          : targets[i].target;
+        plans[i] = plan(resolved[i], options.cache);
+      },
+      64, options.threads);
+
+  std::vector<std::size_t> order;
+  order.reserve(targets.size());
+  for (std::size_t i = 0; i < targets.size(); ++i)
+  {
+    if (plans[i]) { order.push_back(i); }
+    else { hooks[i] = std::unexpected(plans[i].error()); }
+  }
+  // E9 plans by address first, then FF plans which may live anywhere.
+  std::ranges::sort(order, [&](std::size_t lhs, std::size_t rhs)
+  {
+    const auto& a = *plans[lhs];
+    const auto& b = *plans[rhs];
+    return std::pair{a.type != Impl::HookType::E9, a.target} <
+           std::pair{b.type != Impl::HookType::E9, b.target};
+  });
+
+  // Allocate one run of trampolines per window under a single lock.
+  for (std::size_t first = 0; first < order.size();)
+  {
+    const auto& head = *plans[order[first]];
+    const auto near = head.type == Impl::HookType::E9;
+    auto low = head.target;
+    auto high = head.target;
+    std::size_t bytes = 0;
+    std::size_t last = first;
+    std::vector<std::size_t> sizes;
+    for (; last < order.size(); ++last)
     {
-      if (ix.raw.disp.size == 32)
+      const auto& current = *plans[order[last]];
+      const auto is_head = last == first;
+      if (not is_head && ((current.type == Impl::HookType::E9) != near ||
+                       bytes + current.trampoline_size > kBatchBytes))
       {
-        const auto target_address = ip + ix.length + ix.raw.disp.value;
-        desired_addresses.push_back(target_address);
+        break;
       }
-      else if (ix.raw.imm[0].size == 32)
+      if (near)
       {
-        const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-        desired_addresses.push_back(target_address);
+        const auto reach = current.reach();
+        const auto [min, max] = std::ranges::minmax(reach);
+        if (not is_head &&
+            std::max(high, max) - std::min(low, min) > kBatchWindow)
+        {
+          break;
+        }
+        low = std::min(low, min);
+        high = std::max(high, max);
       }
-      else if (ix.meta.category == ZYDIS_CATEGORY_COND_BR &&
-               ix.meta.branch_type == ZYDIS_BRANCH_TYPE_SHORT)
+      bytes += current.trampoline_size;
+      sizes.push_back(current.trampoline_size);
+    }
+
+    std::vector<Allocation> run;
+    {
+      VH_TRACE_SCOPE(trace, Allocate, resolved[order[first]]);
+      run = near ? allocator->AllocateMany({low, high}, sizes)
+                 : allocator->AllocateMany(
+                       {}, sizes, std::numeric_limits<std::size_t>::max());
+      if (run.size() != sizes.size()) { trace.fail(Error::Allocate); }
+    }
+    for (auto i = first; i < last; ++i)
+    {
+      const auto index = order[i];
+      if (run.size() != sizes.size())
       {
-        const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-        desired_addresses.push_back(target_address);
-        trampoline_size += 4;
+        // Fragmented window: fall back to the one-by-one path.
+        hooks[index] = Create(allocator, resolved[index],
+                              targets[index].destination,
+                              {.lazy = true,
+                               .cache = options.cache,
+                               .threads = options.threads,
+                               .guarded = options.guarded,
+                               .clone = options.clone});
+        continue;
       }
-      else if (ix.meta.category == ZYDIS_CATEGORY_UNCOND_BR and
-               ix.meta.branch_type == ZYDIS_BRANCH_TYPE_SHORT)
+      InlineHook hook{};
+      hook.target_ = resolved[index];
+      hook.destination_ = targets[index].destination;
+      hook._assign(*plans[index], std::move(run[i - first]));
+      if (options.clone) { hook._clone(*allocator); }
+      if (options.guarded)
       {
-        const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-        desired_addresses.push_back(target_address);
-        trampoline_size += 3;
+        if (auto err = hook._guard(*allocator); not err)
+        {
+          hooks[index] = std::unexpected(err.error());
+          continue;
+        }
       }
-      else { return std::unexpected(Error::UnsupportedInstruction); }
+      hooks[index] = std::move(hook);
     }
+    first = last;
   }
 
-  auto trampoline_allocation =
-      allocator->Allocate(desired_addresses, trampoline_size);
-  if (not trampoline_allocation)
+  if (not options.lazy)
   {
-    return std::unexpected(Error::BadAllocation);
+    Impl::parallel_for(
+        hooks.size(),
+        [&](std::size_t i)
+        {
+          if (not hooks[i]) { return; }
+          if (auto err = hooks[i]->_materialize(); not err)
+          {
+            hooks[i] = std::unexpected(err.error());
+          }
+        },
+        64, options.threads);
   }
-  trampoline_ = std::make_unique<Allocation>(std::move(*trampoline_allocation));
-
-  for (auto ip = target_, tramp_ip = trampoline_->address();
-       ip < target_ + original_bytes_size_; ip += ix.length)
-  {
-    if (not Impl::decode(ix, ip))
-    {
-      trampoline_ = nullptr;
-      return  std::unexpected( Error::FailedDecodeInstruction);
-    }
+  return hooks;
+}
 
-    const auto is_rel = (ix.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0;
+auto InlineHook::_setup(const std::shared_ptr<Allocator>& allocator,
+                        std::uintptr_t target, std::uintptr_t destination,
+                        PlanCache* cache) -> std::expected<void, Error>
+{
+  target_ = target;
+  destination_ = destination;
 
-    if (is_rel and ix.raw.disp.size == 32)
-    {
-      detail::copy(ip, tramp_ip, ix.length);
-      const auto target_address = ip + ix.length + ix.raw.disp.value;
-      const auto new_disp = target_address - (tramp_ip + ix.length);
-      detail::store(tramp_ip + ix.raw.imm[0].offset,
-                  static_cast<std::int32_t>(new_disp));
-      tramp_ip += ix.length;
-    }
-    else if (is_rel and ix.raw.imm[0].size == 32)
-    {
-      detail::copy(ip, tramp_ip, ix.length);
-      const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-      const auto new_disp = target_address - (tramp_ip + ix.length);
-      detail::store(tramp_ip + ix.raw.imm[0].offset,
-                  static_cast<std::int32_t>(new_disp));
-      tramp_ip += ix.length;
-    }
-    else if (ix.meta.category == ZYDIS_CATEGORY_COND_BR &&
-             ix.meta.branch_type == ZYDIS_BRANCH_TYPE_SHORT)
-    {
-      const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-      auto new_disp = target_address - (tramp_ip + ix.length);
-      if (target_address >= target_ &&
-          target_address < target_ + original_bytes_size_)
-      {
-        new_disp = ix.raw.imm[0].value.s;
-      }
-      detail::store<std::uint8_t>(tramp_ip, 0x0F);
-      detail::store<std::uint8_t>(tramp_ip + 1, 0x10 + ix.opcode);
-      detail::store<std::uint8_t>(tramp_ip + 2, static_cast<std::int8_t>(new_disp));
-      tramp_ip += 6;
-    }
-    else if (ix.meta.category == ZYDIS_CATEGORY_UNCOND_BR and
-             ix.meta.branch_type == ZYDIS_BRANCH_TYPE_SHORT)
+  // A cached plan skips decoding; if it can't be placed, replan from scratch.
+  if (cache != nullptr)
+  {
+    if (auto cached = cache->Find(target_))
     {
-      const auto target_address = ip + ix.length + ix.raw.imm[0].value.s;
-      auto new_disp = target_address - (tramp_ip + 5);
-      if (target_address >= target_ &&
-          target_address < target_ + original_bytes_size_)
+      if (auto allocation = allocate(*allocator, *cached))
       {
-        new_disp = ix.raw.imm[0].value.s;
+        _assign(*cached, std::move(*allocation));
+        return {};
       }
-      detail::store<std::uint8_t>(tramp_ip, 0xE9);
-      detail::store<std::uint8_t>(tramp_ip + 1, static_cast<std::int8_t>(new_disp));
-      tramp_ip += 5;
     }
-    else
+  }
+
+  auto e9_plan = Impl::plan_hook(target_, Impl::HookType::E9);
+  if (e9_plan)
+  {
+    if (auto allocation = allocate(*allocator, *e9_plan))
     {
-      detail::copy(ip, tramp_ip, ix.length);
-      tramp_ip += ix.length;
+      if (cache != nullptr) { cache->Insert(*e9_plan); }
+      _assign(*e9_plan, std::move(*allocation));
+      return {};
     }
+    e9_plan = std::unexpected(Error::BadAllocation);
   }
 
-  auto* trampoline_epilogue = detail::address_cast<TrampolineEpilogueE9*>(
-      trampoline_->address() + trampoline_size - sizeof(TrampolineEpilogueE9));
-
-  auto src = detail::address_cast<std::uintptr_t>(&trampoline_epilogue->jmp_to_original);
-  auto dst = target_ + original_bytes_size_;
-
-  if (auto result = Impl::emit_jmp_e9(src, dst); not result) { return result; }
-
-  src = detail::address_cast<std::uintptr_t>(&trampoline_epilogue->jmp_to_destination);
-  dst = destination_;
-
 #if defined(VH_ARCH_X86_64)
-  auto data = detail::address_cast<std::uintptr_t>(
-      &trampoline_epilogue->destination_address);
-
-  if (auto result = Impl::emit_jmp_ff(src, dst, data); not result) { return result; }
+  auto ff_plan = Impl::plan_hook(target_, Impl::HookType::FF);
+  if (not ff_plan) { return std::unexpected(ff_plan.error()); }
+  auto allocation = allocate(*allocator, *ff_plan);
+  if (not allocation) { return std::unexpected(Error::BadAllocation); }
+  if (cache != nullptr) { cache->Insert(*ff_plan); }
+  _assign(*ff_plan, std::move(*allocation));
+  return {};
 #elif defined(VH_ARCH_X86_32)
-  if (auto result = Impl::emit_jmp_e9(src, dst); result) { return result; }
+  return std::unexpected(e9_plan.error());
 #endif
-
-  type_ = Type::E9;
-  return {};
 }
 
-auto InlineHook::_ff_hook(const std::shared_ptr<Allocator>& allocator)
-    -> std::expected<void, Error>
+void InlineHook::_assign(const Impl::HookPlan& plan, Allocation trampoline)
 {
-  std::size_t trampoline_size = sizeof(TrampolineEpilogueFF);
-  ZydisDecodedInstruction ix{};
+  plan_ = plan;
+  trampoline_.emplace(std::move(trampoline));
+  materialized_ = false;
+}
 
-  for (auto ip = target_; ip < target_ + sizeof(JmpFF); ip += ix.length)
+auto InlineHook::_guard(Allocator& allocator) -> std::expected<void, Error>
+{
+  VH_TRACE_SCOPE(trace, Emit, target_);
+  auto guard = Impl::GuardStub::Create(allocator, destination_,
+                                       _original().address());
+  if (not guard)
   {
-    if (not Impl::decode(ix, ip))
-    {
-      return std::unexpected(Error::FailedDecodeInstruction);
-    }
-
-    if ((ix.attributes & ZYDIS_ATTRIB_IS_RELATIVE) != 0)
-    {
-      return std::unexpected(Error::IpRelativeInstructionOutOfRange);
-    }
-
-    detail::copy(ip, detail::address_cast<std::uintptr_t>(original_bytes_.data()),
-               ix.length);
-    original_bytes_size_ += ix.length;
-    trampoline_size += ix.length;
+    trace.fail(guard.error());
+    return std::unexpected(guard.error());
   }
+  guard_ = std::move(*guard);
+  CodeMap::Get().Add(guard_->address(), Impl::GuardStub::kSize, target_,
+                     "guard");
+  return {};
+}
 
-  auto trampoline_allocation = allocator->Allocate(trampoline_size);
-  if (!trampoline_allocation) { return std::unexpected(Error::BadAllocation); }
-  trampoline_ =
-      std::make_unique<Allocation>(std::move(trampoline_allocation.value()));
-
-  detail::copy(detail::address_cast<std::uintptr_t>(original_bytes_.data()),
-             trampoline_->address(), original_bytes_size_);
-
-  const auto* trampoline_epilogue = detail::address_cast<TrampolineEpilogueFF*>(
-      trampoline_->address() + trampoline_size - sizeof(TrampolineEpilogueFF));
-
-  auto src = detail::address_cast<std::uintptr_t>(
-      &trampoline_epilogue->jmp_to_original);
-  auto dst = target_ + original_bytes_size_;
-  auto data = detail::address_cast<std::uintptr_t>(
-      &trampoline_epilogue->original_address);
+void InlineHook::_clone(Allocator& allocator)
+{
+  auto plan = Impl::plan_clone(target_);
+  if (not plan) { return; }
+  VH_TRACE_SCOPE(trace, Emit, target_);
+  const auto reach = plan->reach();
+  auto clone = allocator.Allocate(reach, plan->size);
+  if (not clone)
+  {
+    trace.fail(Error::Allocate);
+    return;
+  }
+  if (auto result = Impl::emit_clone(
+          *plan, std::span{clone->data<std::uint8_t*>(), clone->size()},
+          clone->address());
+      not result)
+  {
+    trace.fail(result.error());
+    return;
+  }
+  CodeMap::Get().Add(clone->address(), clone->size(), target_, "clone",
+                     Impl::clone_unwind(*plan, clone->address()));
+  clone_.emplace(std::move(*clone));
+}
 
-  if (auto result = Impl::emit_jmp_ff(src, dst, data); result)
+auto InlineHook::_materialize() -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (materialized_) { return {}; }
+  if (not trampoline_) { return std::unexpected(Error::BadAllocation); }
+
+  VH_TRACE_SCOPE(trace, Emit, target_);
+  if (auto result = Impl::emit_trampoline(
+          plan_,
+          std::span{trampoline_->data<std::uint8_t*>(), trampoline_->size()},
+          trampoline_->address(), _entry());
+      not result)
   {
+    trace.fail(result.error());
     return result;
   }
-  type_ = Type::FF;
+  if (auto& map = CodeMap::Get(); map.enabled())
+  {
+    const auto address = trampoline_->address();
+    map.Add(address, trampoline_->size(), target_, {},
+            map.unwind() ? Impl::trampoline_unwind(plan_, address)
+                         : Impl::CopiedUnwind{});
+  }
+  materialized_.store(true, std::memory_order_release);
   return {};
 }
 
-__declspec(noinline) void find_me() noexcept { }
-
 auto InlineHook::Enable() -> std::expected<void, Error>
 {
   std::scoped_lock lock{mutex_};
   if (enabled_) { return {}; }
+  if (auto result = _materialize(); not result) { return result; }
 
-   Impl::VehManager::instance().Register(
-       target_, target_ + original_bytes_size_,
-       [target = target_, original_bytes_size = original_bytes_size_](
-           PEXCEPTION_POINTERS info) -> LONG
-       {
-         auto* ctx = info->ContextRecord;
- #if defined(VH_ARCH_X86_64)
-         auto& ip = ctx->Rip;
- #elif defined(VH_ARCH_X86_32)
-         auto& ip = ctx->Eip;
- #endif
-
-         for (int i{0}; i < original_bytes_size; ++i)
-         {
-           if (ip == target + 1)
-           {
-             ip = target;
-             return EXCEPTION_CONTINUE_EXECUTION;
-           }
-         }
-         return EXCEPTION_CONTINUE_SEARCH;
-       });
-
-   auto get_vm_access = [](std::uintptr_t target) -> Impl::VMAccess
-      {
-#if defined(VH_PLATFORM_WINDOWS)
-     MEMORY_BASIC_INFORMATION find_me_mbi{};
-     MEMORY_BASIC_INFORMATION target_mbi{};
-
-     VirtualQuery(detail::address_cast<void*>(find_me), &find_me_mbi,
-                  sizeof(find_me_mbi));
-     VirtualQuery(detail::address_cast<void*>(target), &target_mbi,
-                  sizeof(target_mbi));
-
-     auto result = Impl::VM_ACCESS_RW;
-
-     if (find_me_mbi.AllocationBase == target_mbi.AllocationBase)
-     {
-       result = Impl::VM_ACCESS_RWX;
-     }
-     else 
-     { 
-         auto si = Impl::get_system_info();
-         auto target_page_start = detail::align_down(target, si.page_size);
-         auto target_page_end = detail::align_up(target, si.page_size);
-         auto vp_start = detail::address_cast(&VirtualProtect);
-         auto vp_end = vp_start + 0x20;
-         if (target_page_end >= vp_start && vp_end >= target_page_start)
-         {
-           result = Impl::VM_ACCESS_RWX;
-         }
-     }
-     return result;
-           #else
-     return Impl::VM_ACCESS_RWX;
-           #endif
-      };
-
-  Impl::VMProtect protect_target(target_, original_bytes_size_, get_vm_access(target_));
-
-  if (type_ == Type::E9)
+  std::array<std::uint8_t, Impl::HookPlan::kMaxPrologue> patch{};
+  if (auto result = Impl::emit_patch(plan_, patch, trampoline_->address(),
+                                     _entry());
+      not result)
   {
-    auto* trampoline_epilogue = detail::address_cast<TrampolineEpilogueE9*>(
-        trampoline_->address() + trampoline_->size() - sizeof(TrampolineEpilogueE9));
-    if (auto result = Impl::emit_jmp_e9(target_, detail::address_cast<std::uintptr_t>(&trampoline_epilogue->jmp_to_destination)); not result)
-    {
-      return result;
-    }
+    return result;
   }
-  if (type_ == Type::FF)
+
   {
-    if (auto result =
-            Impl::emit_jmp_ff(target_, trampoline_->address(),
-                              target_ + sizeof(JmpFF), original_bytes_size_); not result)
+    VH_TRACE_SCOPE(trace, Veh, target_);
+    if (not Impl::VehManager::instance().Register(
+            target_, target_ + plan_.prologue_size, &Impl::prologue_guard))
     {
-      return result;
+      trace.fail(Error::Allocate);
+      return std::unexpected(Error::Allocate);
     }
   }
+  Impl::VMProtect protect_target(target_, plan_.prologue_size,
+                                 Impl::patch_access(target_));
+  VH_TRACE_SCOPE(trace, Write, target_);
+  detail::copy(detail::address_cast<std::uintptr_t>(patch.data()), target_,
+               plan_.prologue_size);
 
   enabled_ = true;
   return {};
@@ -452,25 +415,67 @@ auto InlineHook::Disable() -> std::expected<void, Error>
 
   if (!enabled_) { return {}; }
   enabled_ = false;
-  Impl::VMProtect protect_target(target_, original_bytes_size_,
-                                 Impl::VM_ACCESS_RWX);
-  detail::copy(detail::address_cast<std::uintptr_t>(original_bytes_.data()),
-             target_, original_bytes_size_);
+  {
+    Impl::VMProtect protect_target(target_, plan_.prologue_size,
+                                   Impl::VM_ACCESS_RWX);
+    VH_TRACE_SCOPE(trace, Write, target_);
+    detail::copy(
+        detail::address_cast<std::uintptr_t>(plan_.original_bytes.data()),
+        target_, plan_.prologue_size);
+  }
 
   Impl::VehManager::instance().Unregister(target_);
 
   return {};
 }
 
+auto InlineHook::Retarget(std::uintptr_t destination)
+    -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (not trampoline_) { return std::unexpected(Error::BadAllocation); }
+  if (plan_.type != Impl::HookType::E9)
+  {
+    return std::unexpected(Error::UnsupportedInstruction);
+  }
+
+  destination_ = destination;
+  if (guard_)
+  {
+    guard_->Retarget(destination);
+    return {};
+  }
+  // Lazy hooks pick the new destination up when they are emitted.
+  if (not materialized_) { return {}; }
+  return Impl::retarget_trampoline(plan_, trampoline_->address(), destination);
+}
+
 InlineHook::~InlineHook() { _destroy(); }
 
+void InlineHook::_abandon()
+{
+  std::scoped_lock lock{mutex_};
+  if (not enabled_) { return; }
+  enabled_ = false;
+  Impl::VehManager::instance().Unregister(target_);
+}
+
 void InlineHook::_destroy() noexcept
 {
     [[maybe_unused]] auto result = Disable();
     std::scoped_lock lock{mutex_};
 
+    // Threads may still be running the trampoline or returning into the
+    // guard.
+    Reclaimer::Get().Retire(std::move(guard_));
+    if (clone_)
+    {
+      Reclaimer::Get().Retire(std::move(*clone_));
+      clone_.reset();
+    }
     if (!trampoline_) { return; }
-    trampoline_->free();
+    Reclaimer::Get().Retire(std::move(*trampoline_));
+    trampoline_.reset();
 }
 
 };  // namespace VeilHook
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "VeilHook/length_decoder.hpp"
+
+#include <Zydis/Zydis.h>
+
+#include <algorithm>
+#include <array>
+
+namespace VeilHook::Impl
+{
+
+namespace
+{
+constexpr std::size_t kMaxLength = 15;
+
+// Per-opcode properties. Immediates add up, e.g. enter is kImm16 | kImm8.
+enum Flag : std::uint16_t
+{
+  kModRM = 1U << 0,
+  kImm8 = 1U << 1,
+  kImm16 = 1U << 2,
+  kImmZ = 1U << 3,   // 16 or 32 bits by operand size
+  kImmV = 1U << 4,   // 16, 32 or 64 bits by operand size
+  kMoffs = 1U << 5,  // address-sized offset
+  kRel8 = 1U << 6,
+  kRelZ = 1U << 7,
+  kGroup = 1U << 8,  // depends on ModRM.reg, see below
+  kRare = 1U << 9,   // left to Zydis
+};
+
+struct Tables
+{
+  std::array<std::uint16_t, 256> one{};
+  std::array<std::uint16_t, 256> two{};
+};
+
+constexpr auto make_tables(MachineMode mode) -> Tables
+{
+  const bool long_mode = mode == MachineMode::Long64;
+  Tables t{};
+  auto& one = t.one;
+  auto& two = t.two;
+
+  // ALU blocks: op r/m,r / op r,r/m / op al,ib / op eAX,iz.
+  for (std::size_t base = 0x00; base < 0x40; base += 0x08)
+  {
+    for (std::size_t i = 0; i < 4; ++i) { one[base + i] = kModRM; }
+    one[base + 4] = kImm8;
+    one[base + 5] = kImmZ;
+  }
+  // push/pop es/cs/ss/ds and the BCD adjusts do not exist in long mode.
+  for (const std::size_t op : {0x06, 0x07, 0x0E, 0x16, 0x17, 0x1E, 0x1F, 0x27,
+                               0x2F, 0x37, 0x3F, 0x60, 0x61, 0xCE})
+  {
+    one[op] = long_mode ? kRare : 0;
+  }
+  one[0xD4] = long_mode ? kRare : kImm8;
+  one[0xD5] = long_mode ? kRare : kImm8;
+  one[0x62] = kRare;  // bound or EVEX
+  one[0x63] = kModRM;
+  one[0x68] = kImmZ;
+  one[0x69] = kModRM | kImmZ;
+  one[0x6A] = kImm8;
+  one[0x6B] = kModRM | kImm8;
+  for (std::size_t op = 0x70; op < 0x80; ++op) { one[op] = kRel8; }
+  one[0x80] = kModRM | kImm8;
+  one[0x81] = kModRM | kImmZ;
+  one[0x82] = long_mode ? kRare : kModRM | kImm8;
+  one[0x83] = kModRM | kImm8;
+  for (std::size_t op = 0x84; op < 0x8F; ++op) { one[op] = kModRM; }
+  one[0x8F] = kModRM | kGroup;  // pop r/m or XOP
+  one[0x9A] = kRare;            // far call
+  for (std::size_t op = 0xA0; op < 0xA4; ++op) { one[op] = kMoffs; }
+  one[0xA8] = kImm8;
+  one[0xA9] = kImmZ;
+  for (std::size_t op = 0xB0; op < 0xB8; ++op) { one[op] = kImm8; }
+  for (std::size_t op = 0xB8; op < 0xC0; ++op) { one[op] = kImmV; }
+  one[0xC0] = kModRM | kImm8;
+  one[0xC1] = kModRM | kImm8;
+  one[0xC2] = kImm16;
+  one[0xC4] = kRare;  // les/lds or VEX
+  one[0xC5] = kRare;
+  one[0xC6] = kModRM | kGroup;  // mov r/m,ib or xabort
+  one[0xC7] = kModRM | kGroup;  // mov r/m,iz or xbegin
+  one[0xC8] = kImm16 | kImm8;
+  one[0xCA] = kImm16;
+  one[0xCD] = kImm8;
+  for (std::size_t op = 0xD0; op < 0xD4; ++op) { one[op] = kModRM; }
+  one[0xD6] = kRare;  // salc
+  for (std::size_t op = 0xD8; op < 0xE0; ++op) { one[op] = kModRM; }
+  for (std::size_t op = 0xE0; op < 0xE4; ++op) { one[op] = kRel8; }
+  for (std::size_t op = 0xE4; op < 0xE8; ++op) { one[op] = kImm8; }
+  one[0xE8] = kRelZ;
+  one[0xE9] = kRelZ;
+  one[0xEA] = kRare;  // far jmp
+  one[0xEB] = kRel8;
+  one[0xF6] = kModRM | kGroup;  // test r/m,ib under /0 and /1
+  one[0xF7] = kModRM | kGroup;
+  one[0xFE] = kModRM;
+  one[0xFF] = kModRM;
+
+  // Two-byte map: ModRM unless listed otherwise.
+  two.fill(kModRM);
+  for (const std::size_t op :
+       {0x00, 0x01, 0x04, 0x05, 0x07, 0x0A, 0x0C, 0x0E, 0x0F, 0x20, 0x21,
+        0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x36, 0x38, 0x39, 0x3A, 0x3B,
+        0x3C, 0x3D, 0x3E, 0x3F, 0x78, 0x79, 0x7A, 0x7B, 0xA6, 0xA7, 0xAE,
+        0xC7, 0xFF})
+  {
+    two[op] = kRare;
+  }
+  if (long_mode) { two[0x05] = 0; two[0x07] = 0; }  // syscall, sysret
+  for (const std::size_t op : {0x06, 0x08, 0x09, 0x0B, 0x30, 0x31, 0x32,
+                               0x33, 0x34, 0x35, 0x37, 0x77, 0xA0, 0xA1,
+                               0xA2, 0xA8, 0xA9, 0xAA})
+  {
+    two[op] = 0;
+  }
+  two[0x1A] = kRare;  // MPX
+  two[0x1B] = kRare;
+  for (std::size_t op = 0x70; op < 0x74; ++op) { two[op] = kModRM | kImm8; }
+  for (std::size_t op = 0x80; op < 0x90; ++op) { two[op] = kRelZ; }
+  for (const std::size_t op : {0xA4, 0xAC, 0xBA, 0xC2, 0xC4, 0xC5, 0xC6})
+  {
+    two[op] = kModRM | kImm8;
+  }
+  for (std::size_t op = 0xC8; op < 0xD0; ++op) { two[op] = 0; }
+  return t;
+}
+
+constexpr auto kTables64 = make_tables(MachineMode::Long64);
+constexpr auto kTables32 = make_tables(MachineMode::Legacy32);
+
+constexpr auto branch_of(bool two_byte, std::uint8_t opcode)
+    -> InstructionLength::Branch
+{
+  using Branch = InstructionLength::Branch;
+  if (two_byte) { return Branch::Jcc; }
+  if (opcode >= 0x70 && opcode < 0x80) { return Branch::Jcc; }
+  if (opcode >= 0xE0 && opcode < 0xE4) { return Branch::Loop; }
+  if (opcode == 0xE8) { return Branch::Call; }
+  return Branch::Jmp;
+}
+
+auto zydis_decoder(MachineMode mode) -> const ZydisDecoder*
+{
+  static const auto decoders = []
+  {
+    std::array<ZydisDecoder, 2> result{};
+    ZydisDecoderInit(&result[0], ZYDIS_MACHINE_MODE_LONG_64,
+                     ZYDIS_STACK_WIDTH_64);
+    ZydisDecoderInit(&result[1], ZYDIS_MACHINE_MODE_LEGACY_32,
+                     ZYDIS_STACK_WIDTH_32);
+    return result;
+  }();
+  return &decoders[mode == MachineMode::Long64 ? 0 : 1];
+}
+}  // namespace
+
+auto decode_length_fast(std::span<const std::uint8_t> code, MachineMode mode)
+    -> std::optional<InstructionLength>
+{
+  const bool long_mode = mode == MachineMode::Long64;
+  const auto& tables = long_mode ? kTables64 : kTables32;
+  const auto limit = std::min(code.size(), kMaxLength);
+
+  std::size_t i = 0;
+  bool operand_size = false;
+  bool address_size = false;
+  bool rex_w = false;
+  for (;; ++i)
+  {
+    if (i >= limit) { return std::nullopt; }
+    const auto byte = code[i];
+    // A REX prefix only counts right before the opcode.
+    if (long_mode && (byte & 0xF0) == 0x40)
+    {
+      rex_w = (byte & 0x08) != 0;
+      continue;
+    }
+    if (byte == 0x66) { operand_size = true; }
+    else if (byte == 0x67) { address_size = true; }
+    // Whether lock is legal needs the full operand decode.
+    else if (byte == 0xF0) { return std::nullopt; }
+    else if (byte != 0xF2 && byte != 0xF3 && byte != 0x26 && byte != 0x2E &&
+             byte != 0x36 && byte != 0x3E && byte != 0x64 && byte != 0x65)
+    {
+      break;
+    }
+    rex_w = false;
+  }
+
+  auto opcode = code[i++];
+  auto flags = tables.one[opcode];
+  const bool two_byte = opcode == 0x0F;
+  if (two_byte)
+  {
+    if (i >= limit) { return std::nullopt; }
+    opcode = code[i++];
+    flags = tables.two[opcode];
+  }
+  if ((flags & kRare) != 0) { return std::nullopt; }
+
+  InstructionLength result{};
+  const auto imm_z = std::size_t{operand_size && not rex_w ? 2U : 4U};
+  std::size_t imm = 0;
+  if ((flags & kModRM) != 0)
+  {
+    if (i >= limit) { return std::nullopt; }
+    const auto modrm = code[i++];
+    const auto mod = modrm >> 6;
+    const auto reg = (modrm >> 3) & 7;
+    const auto rm = modrm & 7;
+
+    if ((flags & kGroup) != 0)
+    {
+      switch (opcode)
+      {
+        case 0x8F:
+          if (reg != 0) { return std::nullopt; }
+          break;
+        case 0xC6:
+        case 0xC7:
+          if (reg != 0) { return std::nullopt; }
+          imm = opcode == 0xC6 ? 1 : imm_z;
+          break;
+        default:  // F6, F7
+          if (reg < 2) { imm = opcode == 0xF6 ? 1 : imm_z; }
+          break;
+      }
+    }
+
+    if (mod != 3)
+    {
+      if (address_size && not long_mode) { return std::nullopt; }
+      std::size_t displacement = mod == 1 ? 1 : (mod == 2 ? 4 : 0);
+      if (rm == 4)
+      {
+        if (i >= limit) { return std::nullopt; }
+        const auto sib = code[i++];
+        if (mod == 0 && (sib & 7) == 5) { displacement = 4; }
+      }
+      else if (mod == 0 && rm == 5)
+      {
+        displacement = 4;
+        if (long_mode)
+        {
+          result.rel_offset = static_cast<std::uint8_t>(i);
+          result.rel_size = 4;
+        }
+      }
+      i += displacement;
+    }
+  }
+
+  if ((flags & kImm8) != 0) { imm += 1; }
+  if ((flags & kImm16) != 0) { imm += 2; }
+  if ((flags & kImmZ) != 0) { imm += imm_z; }
+  if ((flags & kImmV) != 0) { imm += rex_w ? 8 : (operand_size ? 2 : 4); }
+  if ((flags & kMoffs) != 0)
+  {
+    imm += long_mode ? (address_size ? 4 : 8) : (address_size ? 2 : 4);
+  }
+  if ((flags & (kRel8 | kRelZ)) != 0)
+  {
+    // Operand-size overrides on near branches differ between vendors.
+    if (operand_size) { return std::nullopt; }
+    imm = (flags & kRel8) != 0 ? 1 : 4;
+    result.rel_offset = static_cast<std::uint8_t>(i);
+    result.rel_size = static_cast<std::uint8_t>(imm);
+    result.branch = branch_of(two_byte, opcode);
+  }
+  i += imm;
+
+  if (i > limit) { return std::nullopt; }
+  result.length = static_cast<std::uint8_t>(i);
+  return result;
+}
+
+auto decode_length_full(std::span<const std::uint8_t> code, MachineMode mode)
+    -> std::expected<InstructionLength, Error>
+{
+  using Branch = InstructionLength::Branch;
+  ZydisDecodedInstruction ix{};
+  if (ZYAN_FAILED(ZydisDecoderDecodeInstruction(
+          zydis_decoder(mode), nullptr, code.data(),
+          std::min(code.size(), kMaxLength), &ix)))
+  {
+    return std::unexpected(Error::FailedDecodeInstruction);
+  }
+
+  InstructionLength result{.length = ix.length};
+  if ((ix.attributes & ZYDIS_ATTRIB_IS_RELATIVE) == 0) { return result; }
+  if (ix.raw.disp.size != 0)
+  {
+    result.rel_offset = ix.raw.disp.offset;
+    result.rel_size = static_cast<std::uint8_t>(ix.raw.disp.size / 8);
+    return result;
+  }
+  result.rel_offset = ix.raw.imm[0].offset;
+  result.rel_size = static_cast<std::uint8_t>(ix.raw.imm[0].size / 8);
+  switch (ix.mnemonic)
+  {
+    case ZYDIS_MNEMONIC_LOOP:
+    case ZYDIS_MNEMONIC_LOOPE:
+    case ZYDIS_MNEMONIC_LOOPNE:
+    case ZYDIS_MNEMONIC_JCXZ:
+    case ZYDIS_MNEMONIC_JECXZ:
+    case ZYDIS_MNEMONIC_JRCXZ: result.branch = Branch::Loop; break;
+    default:
+      switch (ix.meta.category)
+      {
+        case ZYDIS_CATEGORY_CALL: result.branch = Branch::Call; break;
+        case ZYDIS_CATEGORY_UNCOND_BR: result.branch = Branch::Jmp; break;
+        case ZYDIS_CATEGORY_COND_BR: result.branch = Branch::Jcc; break;
+        default: result.branch = Branch::Other; break;
+      }
+  }
+  return result;
+}
+
+auto decode_length(std::span<const std::uint8_t> code, MachineMode mode)
+    -> std::expected<InstructionLength, Error>
+{
+  if (auto result = decode_length_fast(code, mode)) { return *result; }
+  return decode_length_full(code, mode);
+}
+
+}  // namespace VeilHook::Impl
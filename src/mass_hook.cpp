@@ -0,0 +1,393 @@
+#include "VeilHook/mass_hook.hpp"
+
+#include "VeilHook/code_map.hpp"
+#include "VeilHook/hook_plan.hpp"
+#include "VeilHook/reclaimer.hpp"
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <utility>
+
+namespace VeilHook
+{
+
+namespace
+{
+// Targets whose stubs share one block and dispatcher: every reach address
+// of the group lies within this span, so some block is in rel32 range of
+// all.
+constexpr std::uintptr_t kWindow = 0x4000'0000;
+
+// push id; jmp dispatcher
+constexpr std::size_t kStubSize = 10;
+
+template <typename T>
+void put(std::span<std::uint8_t> code, std::size_t offset, T value)
+{
+  std::memcpy(code.data() + offset, &value, sizeof(value));
+}
+
+#if defined(VH_ARCH_X86_64)
+// Byte offsets of the x64 dispatcher below.
+constexpr std::size_t kCallbackCall = 67;
+constexpr std::size_t kTableLoad = 110;
+constexpr std::size_t kCallbackLiteral = 160;
+constexpr std::size_t kTableLiteral = 168;
+constexpr std::size_t kDispatcherSize = kTableLiteral + 8;
+
+// Entered with the id on top of the stack and the return address below it;
+// rsp is 16-byte aligned at that point. Leaves for the trampoline through
+// r11, which no calling convention passes anything in.
+void emit_dispatcher(std::span<std::uint8_t> code,
+                     MassHook::Callback callback, const std::uintptr_t* table)
+{
+  constexpr std::array<std::uint8_t, kCallbackLiteral> kTemplate{
+      0x54,                                      // push rsp
+      0x48, 0x83, 0x04, 0x24, 0x08,              // add qword [rsp], 8
+      0x41, 0x52,                                // push r10
+      0x50,                                      // push rax
+      0x41, 0x51,                                // push r9
+      0x41, 0x50,                                // push r8
+      0x52,                                      // push rdx
+      0x51,                                      // push rcx
+      0x48, 0x81, 0xEC, 0x88, 0, 0, 0,           // sub rsp, 136
+      0x0F, 0x11, 0x44, 0x24, 0x20,              // movups [rsp+32], xmm0
+      0x0F, 0x11, 0x4C, 0x24, 0x30,              // movups [rsp+48], xmm1
+      0x0F, 0x11, 0x54, 0x24, 0x40,              // movups [rsp+64], xmm2
+      0x0F, 0x11, 0x5C, 0x24, 0x50,              // movups [rsp+80], xmm3
+      0x0F, 0x11, 0x64, 0x24, 0x60,              // movups [rsp+96], xmm4
+      0x0F, 0x11, 0x6C, 0x24, 0x70,              // movups [rsp+112], xmm5
+      0x8B, 0x8C, 0x24, 0xC0, 0, 0, 0,           // mov ecx, [rsp+192] (id)
+      0x48, 0x8D, 0x94, 0x24, 0x88, 0, 0, 0,     // lea rdx, [rsp+136] (regs)
+      0xFF, 0x15, 0, 0, 0, 0,                    // call [callback]
+      0x0F, 0x10, 0x44, 0x24, 0x20,              // movups xmm0, [rsp+32]
+      0x0F, 0x10, 0x4C, 0x24, 0x30,              // movups xmm1, [rsp+48]
+      0x0F, 0x10, 0x54, 0x24, 0x40,              // movups xmm2, [rsp+64]
+      0x0F, 0x10, 0x5C, 0x24, 0x50,              // movups xmm3, [rsp+80]
+      0x0F, 0x10, 0x64, 0x24, 0x60,              // movups xmm4, [rsp+96]
+      0x0F, 0x10, 0x6C, 0x24, 0x70,              // movups xmm5, [rsp+112]
+      0x8B, 0x84, 0x24, 0xC0, 0, 0, 0,           // mov eax, [rsp+192]
+      0x4C, 0x8B, 0x1D, 0, 0, 0, 0,              // mov r11, [table]
+      0x4D, 0x8B, 0x1C, 0xC3,                    // mov r11, [r11+rax*8]
+      0x4C, 0x89, 0x9C, 0x24, 0xC0, 0, 0, 0,     // mov [rsp+192], r11
+      0x48, 0x81, 0xC4, 0x88, 0, 0, 0,           // add rsp, 136
+      0x59,                                      // pop rcx
+      0x5A,                                      // pop rdx
+      0x41, 0x58,                                // pop r8
+      0x41, 0x59,                                // pop r9
+      0x58,                                      // pop rax
+      0x41, 0x5A,                                // pop r10
+      0x48, 0x83, 0xC4, 0x08,                    // add rsp, 8
+      0x41, 0x5B,                                // pop r11
+      0x41, 0xFF, 0xE3,                          // jmp r11
+      0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+  };
+  std::ranges::copy(kTemplate, code.begin());
+  put(code, kCallbackCall + 2,
+      static_cast<std::int32_t>(kCallbackLiteral - (kCallbackCall + 6)));
+  put(code, kTableLoad + 3,
+      static_cast<std::int32_t>(kTableLiteral - (kTableLoad + 7)));
+  put(code, kCallbackLiteral, detail::address_cast<std::uint64_t>(callback));
+  put(code, kTableLiteral, detail::address_cast<std::uint64_t>(table));
+}
+#else
+// Byte offsets of the x86 dispatcher below.
+constexpr std::size_t kCallbackCall = 15;
+constexpr std::size_t kTableLoad = 28;
+constexpr std::size_t kCallbackLiteral = 48;
+constexpr std::size_t kDispatcherSize = kCallbackLiteral + 4;
+
+// Entered with the id on top of the stack and the return address below it.
+// No register is free at a function's entry on x86 (thiscall, fastcall,
+// _chkstk), so the id's slot is overwritten with the trampoline and
+// returned into.
+void emit_dispatcher(std::span<std::uint8_t> code, std::uintptr_t address,
+                     MassHook::Callback callback, const std::uintptr_t* table)
+{
+  constexpr std::array<std::uint8_t, kCallbackLiteral> kTemplate{
+      0x54,                          // push esp
+      0x83, 0x04, 0x24, 0x04,        // add dword [esp], 4
+      0x52,                          // push edx
+      0x51,                          // push ecx
+      0x50,                          // push eax
+      0x8B, 0xC4,                    // mov eax, esp
+      0x50,                          // push eax (regs)
+      0xFF, 0x74, 0x24, 0x14,        // push dword [esp+20] (id)
+      0xFF, 0x15, 0, 0, 0, 0,        // call [callback]
+      0x83, 0xC4, 0x08,              // add esp, 8
+      0x8B, 0x44, 0x24, 0x10,        // mov eax, [esp+16]
+      0x8B, 0x04, 0x85, 0, 0, 0, 0,  // mov eax, [table+eax*4]
+      0x89, 0x44, 0x24, 0x10,        // mov [esp+16], eax
+      0x58,                          // pop eax
+      0x59,                          // pop ecx
+      0x5A,                          // pop edx
+      0x83, 0xC4, 0x04,              // add esp, 4
+      0xC3,                          // ret
+      0xCC, 0xCC,
+  };
+  std::ranges::copy(kTemplate, code.begin());
+  put(code, kCallbackCall + 2,
+      static_cast<std::uint32_t>(address + kCallbackLiteral));
+  put(code, kTableLoad + 3, detail::address_cast<std::uint32_t>(table));
+  put(code, kCallbackLiteral, detail::address_cast<std::uint32_t>(callback));
+}
+#endif
+
+void emit_stub(std::span<std::uint8_t> code, std::uintptr_t address,
+               std::uint32_t id, std::uintptr_t dispatcher)
+{
+  code[0] = 0x68;  // push imm32
+  put(code, 1, id);
+  code[5] = 0xE9;  // jmp rel32
+  put(code, 6,
+      static_cast<std::int32_t>(static_cast<std::intptr_t>(
+          dispatcher - (address + kStubSize))));
+}
+}  // namespace
+
+struct MassHook::Planned
+{
+  std::uint32_t id;
+  std::uintptr_t low;  // of the plan's reach
+  std::uintptr_t high;
+  Impl::HookPlan plan;
+};
+
+auto MassHook::Create(const std::shared_ptr<Allocator>& allocator,
+                      std::span<const std::uintptr_t> targets,
+                      Callback on_enter, HookOptions options)
+    -> std::expected<std::unique_ptr<MassHook>, Error>
+{
+  if (on_enter == nullptr ||
+      targets.size() > std::numeric_limits<std::int32_t>::max())
+  {
+    return std::unexpected(Error::InvalidArgument);
+  }
+
+  std::unique_ptr<MassHook> hook{new MassHook};
+  hook->targets_.assign(targets.begin(), targets.end());
+  hook->table_ = std::make_shared<std::uintptr_t[]>(targets.size());
+  hook->offsets_.resize(targets.size());
+  hook->prologue_sizes_.resize(targets.size());
+
+  std::vector<std::optional<Planned>> plans(targets.size());
+  Impl::parallel_for(
+      targets.size(),
+      [&](std::size_t i)
+      {
+        auto& target = hook->targets_[i];
+        if (options.follow_jumps) { target = Impl::resolve_jumps(target); }
+        auto plan = Impl::plan_hook(target, Impl::HookType::E9);
+        if (not plan) { return; }
+        const auto reach = plan->reach();
+        const auto [low, high] = std::ranges::minmax(reach);
+        plans[i] = Planned{.id = static_cast<std::uint32_t>(i),
+                           .low = low,
+                           .high = high,
+                           .plan = *plan};
+      },
+      64, options.threads);
+
+  std::vector<Planned> planned;
+  for (auto& plan : plans)
+  {
+    if (plan) { planned.push_back(std::move(*plan)); }
+  }
+  plans = {};
+  std::ranges::sort(planned, {}, [](const Planned& entry)
+                    { return std::pair{entry.plan.target, entry.id}; });
+  // Thunks that lead to the same body leave it to the lowest id.
+  const auto duplicates = std::ranges::unique(
+      planned, {}, [](const Planned& entry) { return entry.plan.target; });
+  planned.erase(duplicates.begin(), duplicates.end());
+
+  for (std::size_t first = 0; first < planned.size();)
+  {
+    auto low = planned[first].low;
+    auto high = planned[first].high;
+    auto size = detail::align_up(kDispatcherSize, 16) + kStubSize +
+                Impl::relocated_size(planned[first].plan);
+    auto last = first + 1;
+    for (; last < planned.size(); ++last)
+    {
+      const auto& entry = planned[last];
+      const auto next_low = std::min(low, entry.low);
+      const auto next_high = std::max(high, entry.high);
+      if (next_high - next_low > kWindow) { break; }
+      low = next_low;
+      high = next_high;
+      size += kStubSize + Impl::relocated_size(entry.plan);
+    }
+
+    std::optional<Allocation> block;
+    {
+      VH_TRACE_SCOPE(trace, Allocate, planned[first].plan.target);
+      block = allocator->Allocate({low, high}, size);
+      if (not block) { trace.fail(Error::Allocate); }
+    }
+    if (block)
+    {
+      hook->_emit(*block, std::span{planned}.subspan(first, last - first),
+                  on_enter);
+      hook->code_bytes_ += block->size();
+      hook->blocks_.push_back(std::move(*block));
+    }
+    first = last;
+  }
+
+  for (const auto& entry : planned)
+  {
+    if (hook->table_[entry.id] != 0) { hook->order_.push_back(entry.id); }
+  }
+  hook->hooked_ = hook->order_.size();
+  if (hook->hooked_ == 0) { return std::unexpected(Error::NotFound); }
+  return hook;
+}
+
+MassHook::~MassHook()
+{
+  [[maybe_unused]] auto result = Disable();
+  // Threads may still be in a stub, the dispatcher or a relocated prologue,
+  // and the dispatcher reads the table until the last block goes.
+  for (auto& block : blocks_)
+  {
+    const MemoryRange range{block.address(), block.address() + block.size()};
+    Reclaimer::Get().Retire(range,
+                            [block = std::move(block), table = table_]() mutable
+                            {
+                              block.free();
+                              table.reset();
+                            });
+  }
+}
+
+auto MassHook::Enable() -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (enabled_) { return {}; }
+  {
+    VH_TRACE_SCOPE(trace, Veh, 0);
+    std::vector<Impl::VehEntry> entries;
+    entries.reserve(order_.size());
+    for (const auto id : order_)
+    {
+      const auto target = targets_[id];
+      entries.push_back({.start_address = target,
+                         .end_address = target + prologue_sizes_[id],
+                         .callback = &Impl::prologue_guard});
+    }
+    if (not Impl::VehManager::instance().Register(entries))
+    {
+      trace.fail(Error::Allocate);
+      return std::unexpected(Error::Allocate);
+    }
+  }
+  _write(true);
+  enabled_ = true;
+  return {};
+}
+
+auto MassHook::Disable() -> std::expected<void, Error>
+{
+  std::scoped_lock lock{mutex_};
+  if (not enabled_) { return {}; }
+  enabled_ = false;
+  _write(false);
+
+  std::vector<std::uintptr_t> addresses;
+  addresses.reserve(order_.size());
+  for (const auto id : order_) { addresses.push_back(targets_[id]); }
+  Impl::VehManager::instance().Unregister(addresses);
+  return {};
+}
+
+auto MassHook::memory() const -> HookMemory
+{
+  const auto per_target = sizeof(std::uintptr_t) * 2 + sizeof(std::uint32_t) +
+                          sizeof(std::uint8_t);
+  return {.hooks = hooked_,
+          .slots = (targets_.size() * per_target) +
+                   (order_.size() * sizeof(std::uint32_t)),
+          .bytes = bytes_.size(),
+          .trampolines = code_bytes_};
+}
+
+void MassHook::_emit(Allocation& block, std::span<const Planned> planned,
+                     Callback on_enter)
+{
+  const auto base = block.address();
+  const std::span code{block.data<std::uint8_t*>(), block.size()};
+  std::ranges::fill(code, 0xCC);
+#if defined(VH_ARCH_X86_64)
+  emit_dispatcher(code, on_enter, table_.get());
+#else
+  emit_dispatcher(code, base, on_enter, table_.get());
+#endif
+  CodeMap::Get().Add(base, kDispatcherSize, 0, "MassHook dispatcher");
+
+  auto offset = detail::align_up(kDispatcherSize, 16);
+  for (const auto& entry : planned)
+  {
+    const auto& plan = entry.plan;
+    const auto stub = base + offset;
+    const auto relocated = Impl::relocated_size(plan);
+    offset += kStubSize + relocated;
+    if (not Impl::emit_relocated(
+            plan, code.subspan(stub + kStubSize - base, relocated),
+            stub + kStubSize))
+    {
+      continue;
+    }
+    emit_stub(code.subspan(stub - base, kStubSize), stub, entry.id, base);
+    if (auto& map = CodeMap::Get(); map.enabled())
+    {
+      map.Add(stub, kStubSize, plan.target, "stub");
+      map.Add(stub + kStubSize, relocated, plan.target, {},
+              map.unwind() ? Impl::trampoline_unwind(plan, stub + kStubSize)
+                           : Impl::CopiedUnwind{});
+    }
+
+    offsets_[entry.id] = static_cast<std::uint32_t>(bytes_.size());
+    prologue_sizes_[entry.id] = plan.prologue_size;
+    bytes_.insert(bytes_.end(), plan.original_bytes.begin(),
+                  plan.original_bytes.begin() + plan.prologue_size);
+    table_[entry.id] = stub + kStubSize;
+  }
+}
+
+void MassHook::_write(bool patch)
+{
+  VH_TRACE_SCOPE(trace, Write, 0);
+  std::vector<std::pair<std::uintptr_t, std::uintptr_t>> ranges;
+  ranges.reserve(order_.size());
+  for (const auto id : order_)
+  {
+    ranges.emplace_back(targets_[id], targets_[id] + prologue_sizes_[id]);
+  }
+  const auto protects = Impl::protect_pages(ranges);
+
+  std::array<std::uint8_t, Impl::HookPlan::kMaxPrologue> bytes{};
+  for (const auto id : order_)
+  {
+    const auto target = targets_[id];
+    const auto size = prologue_sizes_[id];
+    std::copy_n(bytes_.begin() + offsets_[id], size, bytes.begin());
+    if (patch)
+    {
+      const auto stub = table_[id] - kStubSize;
+      bytes[0] = 0xE9;
+      const auto rel = static_cast<std::int32_t>(
+          static_cast<std::intptr_t>(stub - (target + 5)));
+      std::memcpy(bytes.data() + 1, &rel, sizeof(rel));
+    }
+    detail::copy(detail::address_cast<std::uintptr_t>(bytes.data()), target,
+                 size);
+  }
+}
+
+}  // namespace VeilHook
@@ -0,0 +1,296 @@
+#include "VeilHook/plan_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace VeilHook
+{
+
+namespace
+{
+using Impl::PlanCacheHeader;
+using Impl::PlanCacheRecord;
+
+static_assert(std::is_trivially_copyable_v<PlanCacheHeader>);
+static_assert(std::is_trivially_copyable_v<PlanCacheRecord>);
+
+auto record_less(const PlanCacheRecord& lhs, const PlanCacheRecord& rhs)
+    -> bool
+{
+  return std::pair{lhs.build_id, lhs.offset} <
+         std::pair{rhs.build_id, rhs.offset};
+}
+
+auto record_equal(const PlanCacheRecord& lhs, const PlanCacheRecord& rhs)
+    -> bool
+{
+  return lhs.build_id == rhs.build_id && lhs.offset == rhs.offset;
+}
+
+// The records of `view`, or nothing if it was written by another version, for
+// another architecture or is truncated.
+auto parse(const Impl::FileView& view) -> std::span<const PlanCacheRecord>
+{
+  if (view.data == nullptr || view.size < sizeof(PlanCacheHeader)) { return {}; }
+  PlanCacheHeader header{};
+  std::memcpy(&header, view.data, sizeof(header));
+  if (header.magic != PlanCacheHeader::kMagic ||
+      header.version != PlanCache::kVersion ||
+      header.pointer_size != sizeof(void*) ||
+      header.record_size != sizeof(PlanCacheRecord) ||
+      header.count > (view.size - sizeof(header)) / sizeof(PlanCacheRecord))
+  {
+    return {};
+  }
+  return {detail::address_cast<const PlanCacheRecord*>(view.data +
+                                                       sizeof(header)),
+          static_cast<std::size_t>(header.count)};
+}
+
+// Whether a record read from disk describes a prologue emit_trampoline can
+// relocate: instructions back to back from offset 0 to prologue_size, each
+// displacement inside its instruction.
+auto valid(const PlanCacheRecord& record) -> bool
+{
+  using Kind = Impl::PlannedInstruction::Kind;
+  if ((record.type != Impl::HookType::E9 &&
+       record.type != Impl::HookType::FF) ||
+      record.prologue_size == 0 ||
+      record.prologue_size > PlanCacheRecord::kMaxPrologue ||
+      record.instruction_count == 0 ||
+      record.instruction_count > PlanCacheRecord::kMaxInstructions)
+  {
+    return false;
+  }
+  std::size_t offset = 0;
+  for (std::size_t i = 0; i < record.instruction_count; ++i)
+  {
+    const auto& instruction = record.instructions[i];
+    if (instruction.offset != offset || instruction.length == 0)
+    {
+      return false;
+    }
+    offset += instruction.length;
+    if (offset > record.prologue_size) { return false; }
+
+    std::size_t operand = 0;
+    switch (instruction.kind)
+    {
+      case Kind::Copy: continue;
+      case Kind::Rel32: operand = sizeof(std::int32_t); break;
+      case Kind::ShortJcc:
+      case Kind::ShortJmp: operand = sizeof(std::int8_t); break;
+      default: return false;
+    }
+    if (std::size_t{instruction.operand_offset} + operand >
+        instruction.length)
+    {
+      return false;
+    }
+  }
+  return offset == record.prologue_size;
+}
+
+auto write(const std::filesystem::path& path,
+           std::span<const PlanCacheRecord> records) -> bool
+{
+  PlanCacheHeader header{};
+  header.version = PlanCache::kVersion;
+  header.pointer_size = sizeof(void*);
+  header.record_size = sizeof(PlanCacheRecord);
+  header.count = records.size();
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(detail::address_cast<const char*>(&header), sizeof(header));
+  out.write(detail::address_cast<const char*>(records.data()),
+            static_cast<std::streamsize>(records.size_bytes()));
+  out.close();
+  return not out.fail();
+}
+}  // namespace
+
+PlanCache::PlanCache(std::filesystem::path path) : path_(std::move(path))
+{
+  _map();
+}
+
+PlanCache::~PlanCache() { _unmap(); }
+
+auto PlanCache::size() const -> std::size_t
+{
+  std::shared_lock lock{mutex_};
+  return records_.size();
+}
+
+auto PlanCache::Find(std::uintptr_t target) -> std::optional<Impl::HookPlan>
+{
+  const auto module = _module(target);
+  if (not module) { return std::nullopt; }
+  PlanCacheRecord key{};
+  key.build_id = module->build_id;
+  key.offset = static_cast<std::uint32_t>(target - module->base);
+
+  std::shared_lock lock{mutex_};
+  const auto it = std::ranges::lower_bound(records_, key, record_less);
+  if (it == records_.end() || not record_equal(*it, key) || not valid(*it))
+  {
+    return std::nullopt;
+  }
+
+  // The image may have been patched since the plan was written.
+  const auto* live = detail::address_cast<const std::uint8_t*>(target);
+  if (not std::equal(it->original_bytes.begin(),
+                     it->original_bytes.begin() + it->prologue_size, live))
+  {
+    return std::nullopt;
+  }
+
+  Impl::HookPlan plan{};
+  plan.target = target;
+  plan.type = it->type;
+  plan.prologue_size = it->prologue_size;
+  plan.instruction_count = it->instruction_count;
+  std::ranges::copy_n(it->original_bytes.begin(), it->prologue_size,
+                      plan.original_bytes.begin());
+  std::ranges::copy_n(it->instructions.begin(), it->instruction_count,
+                      plan.instructions.begin());
+  // Derived rather than trusted: emit_trampoline writes this many bytes.
+  plan.trampoline_size =
+      static_cast<std::uint16_t>(Impl::trampoline_size(plan));
+  return plan;
+}
+
+void PlanCache::Insert(const Impl::HookPlan& plan)
+{
+  if (plan.prologue_size > PlanCacheRecord::kMaxPrologue ||
+      plan.instruction_count > PlanCacheRecord::kMaxInstructions)
+  {
+    return;
+  }
+  const auto module = _module(plan.target);
+  if (not module) { return; }
+
+  PlanCacheRecord record{};
+  record.build_id = module->build_id;
+  record.offset = static_cast<std::uint32_t>(plan.target - module->base);
+  record.type = plan.type;
+  record.prologue_size = plan.prologue_size;
+  record.instruction_count = plan.instruction_count;
+  record.trampoline_size = plan.trampoline_size;
+  std::ranges::copy_n(plan.original_bytes.begin(), plan.prologue_size,
+                      record.original_bytes.begin());
+  std::ranges::copy_n(plan.instructions.begin(), plan.instruction_count,
+                      record.instructions.begin());
+
+  std::scoped_lock lock{pending_mutex_};
+  pending_.push_back(record);
+}
+
+auto PlanCache::Save() -> std::expected<void, Error>
+{
+  std::vector<PlanCacheRecord> inserted;
+  {
+    std::scoped_lock lock{pending_mutex_};
+    inserted.swap(pending_);
+  }
+  if (inserted.empty()) { return {}; }
+  const auto fail = [&]
+  {
+    std::scoped_lock lock{pending_mutex_};
+    pending_.insert(pending_.end(), inserted.begin(), inserted.end());
+    return std::unexpected(Error::Io);
+  };
+
+  // Merge with the file as it is now, not as it was mapped: another process
+  // may have replaced it since. Stable sort keeps our records ahead of the
+  // ones on disk for the same key.
+  auto records = inserted;
+  if (auto current = Impl::file_map(path_))
+  {
+    const auto existing = parse(*current);
+    records.insert(records.end(), existing.begin(), existing.end());
+    Impl::file_unmap(*current);
+  }
+  std::ranges::stable_sort(records, record_less);
+  const auto duplicates = std::ranges::unique(records, record_equal);
+  records.erase(duplicates.begin(), duplicates.end());
+
+  auto temporary = path_;
+  temporary += "." + std::to_string(Impl::process_id()) + "." +
+               std::to_string(detail::address_cast(this)) + ".tmp";
+  std::error_code ec;
+  if (not write(temporary, records))
+  {
+    std::filesystem::remove(temporary, ec);
+    return fail();
+  }
+
+  std::scoped_lock lock{mutex_};
+  _unmap();
+  const auto replaced = Impl::file_replace(temporary, path_);
+  _map();
+  if (not replaced)
+  {
+    // Another process may still have the old file open without
+    // FILE_SHARE_DELETE; keep the records for a later Save.
+    std::filesystem::remove(temporary, ec);
+    return fail();
+  }
+  return {};
+}
+
+auto PlanCache::_module(std::uintptr_t address)
+    -> std::optional<Impl::ModuleInfo>
+{
+  const auto contains = [&](const Impl::ModuleInfo& module)
+  {
+    return address >= module.base && address - module.base < module.size;
+  };
+  {
+    std::shared_lock lock{mutex_};
+    const auto it = std::ranges::upper_bound(modules_, address, {},
+                                             &Impl::ModuleInfo::base);
+    if (it != modules_.begin() && contains(*std::prev(it)))
+    {
+      return *std::prev(it);
+    }
+  }
+
+  auto module = Impl::module_query(address);
+  if (not module ||
+      module->size > std::numeric_limits<std::uint32_t>::max())
+  {
+    return std::nullopt;
+  }
+  std::scoped_lock lock{mutex_};
+  const auto it = std::ranges::lower_bound(modules_, module->base, {},
+                                           &Impl::ModuleInfo::base);
+  if (it == modules_.end() || it->base != module->base)
+  {
+    modules_.insert(it, *module);
+  }
+  return *module;
+}
+
+void PlanCache::_map()
+{
+  if (auto view = Impl::file_map(path_))
+  {
+    view_ = *view;
+    records_ = parse(view_);
+  }
+}
+
+void PlanCache::_unmap()
+{
+  Impl::file_unmap(view_);
+  view_ = {};
+  records_ = {};
+}
+
+}  // namespace VeilHook
@@ -0,0 +1,151 @@
+#include "VeilHook/reclaimer.hpp"
+
+#include "VeilHook/code_map.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+
+#include <intrin.h>
+
+namespace VeilHook
+{
+
+namespace
+{
+// Only heap pointers: the scan reads the stack this lives on.
+struct Scan
+{
+  std::span<const MemoryRange> ranges;  // sorted, disjoint
+  std::span<std::uint8_t> busy;
+
+  void mark(std::uintptr_t address) const
+  {
+    const auto it = std::ranges::upper_bound(ranges, address, {},
+                                             &MemoryRange::first);
+    if (it == ranges.begin()) { return; }
+    const auto index = static_cast<std::size_t>(it - ranges.begin()) - 1;
+    if (address < ranges[index].second) { busy[index] = 1; }
+  }
+};
+
+void visit(const Impl::ThreadState& state, void* context)
+{
+  const auto& scan = *static_cast<const Scan*>(context);
+  scan.mark(state.ip);
+  for (const auto word : state.stack) { scan.mark(word); }
+}
+}  // namespace
+
+auto Reclaimer::Get() -> Reclaimer&
+{
+  // Never destroyed: hooks with static storage retire their code during
+  // exit, possibly after a function-local static would be gone.
+  static auto* reclaimer = new Reclaimer;
+  return *reclaimer;
+}
+
+void Reclaimer::Retire(MemoryRange range,
+                       std::move_only_function<void()> release)
+{
+  bool collect = false;
+  {
+    std::scoped_lock lock{mutex_};
+    bytes_ += range.second - range.first;
+    retired_.push_back({.range = range, .release = std::move(release)});
+    collect = bytes_ >= collect_at_;
+  }
+  if (collect) { Collect(); }
+}
+
+void Reclaimer::Retire(Allocation code)
+{
+  if (not code) { return; }
+  const MemoryRange range{code.address(), code.address() + code.size()};
+  Retire(range, [code = std::move(code)]() mutable { code.free(); });
+}
+
+void Reclaimer::Retire(std::unique_ptr<Impl::GuardStub> guard)
+{
+  if (not guard) { return; }
+  const MemoryRange range{guard->address(),
+                          guard->address() + Impl::GuardStub::kSize};
+  Retire(range, [guard = std::move(guard)]() mutable { guard.reset(); });
+}
+
+auto Reclaimer::Collect() -> std::size_t
+{
+  std::unique_lock collecting{collect_mutex_, std::try_to_lock};
+  if (not collecting) { return 0; }
+
+  std::vector<Retired> batch;
+  {
+    std::scoped_lock lock{mutex_};
+    batch.swap(retired_);
+  }
+  if (batch.empty()) { return 0; }
+
+  // Everything the scan touches is allocated before the first thread is
+  // suspended.
+  std::ranges::sort(batch, {}, [](const Retired& retired)
+                    { return retired.range.first; });
+  std::vector<MemoryRange> ranges;
+  ranges.reserve(batch.size());
+  for (const auto& retired : batch) { ranges.push_back(retired.range); }
+  std::vector<std::uint8_t> busy(batch.size(), 0);
+  Scan scan{.ranges = ranges, .busy = busy};
+
+  // This frame is left out of the scan: it holds retired addresses of its
+  // own. The callers' frames are scanned like any other stack.
+#if defined(VH_COMPILER_MSVC)
+  const auto caller = detail::address_cast<std::uintptr_t>(
+      _AddressOfReturnAddress());
+#else
+  const auto caller =
+      detail::address_cast<std::uintptr_t>(__builtin_frame_address(0));
+#endif
+
+  // Targets were restored before their code was retired; once every
+  // processor has been interrupted none can still be on its way in.
+  Impl::flush_write_buffers();
+  if (not Impl::visit_threads(caller, &visit, &scan))
+  {
+    std::ranges::fill(busy, 1);
+  }
+
+  std::size_t released = 0;
+  std::size_t released_bytes = 0;
+  std::vector<Retired> kept;
+  for (std::size_t i = 0; i < batch.size(); ++i)
+  {
+    if (busy[i] != 0)
+    {
+      kept.push_back(std::move(batch[i]));
+      continue;
+    }
+    CodeMap::Get().Remove(batch[i].range);
+    batch[i].release();
+    released_bytes += batch[i].range.second - batch[i].range.first;
+    ++released;
+  }
+
+  std::scoped_lock lock{mutex_};
+  bytes_ -= released_bytes;
+  // Blocks a thread keeps busy for long do not make every Retire rescan.
+  collect_at_ = bytes_ + kCollectBytes;
+  std::ranges::move(kept, std::back_inserter(retired_));
+  return released;
+}
+
+auto Reclaimer::pending() const -> std::size_t
+{
+  std::scoped_lock lock{mutex_};
+  return retired_.size();
+}
+
+auto Reclaimer::pending_bytes() const -> std::size_t
+{
+  std::scoped_lock lock{mutex_};
+  return bytes_;
+}
+}  // namespace VeilHook
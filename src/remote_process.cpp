@@ -0,0 +1,528 @@
+#include "VeilHook/remote_process.hpp"
+
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace VeilHook
+{
+
+namespace
+{
+// Trampolines of one block, like InlineHook::CreateMany's batches.
+constexpr std::uintptr_t kBatchWindow = 0x4000'0000;
+constexpr std::size_t kBatchBytes = 0x10000;
+constexpr std::size_t kTrampolineAlignment = 16;
+// What a block and everything it relocates may span to stay in rel32 reach.
+constexpr std::uintptr_t kReach = 0x7FFF'0000;
+// Bytes read per target: the longest prologue and one more instruction.
+constexpr std::size_t kReadSize = Impl::HookPlan::kMaxPrologue + 15;
+// Targets closer than this share one read or write; no run grows past
+// kMaxRun bytes.
+constexpr std::size_t kMaxGap = 0x1000;
+constexpr std::size_t kMaxRun = 0x10000;
+
+// Keeps the process stopped for the lifetime of the guard.
+class Suspended
+{
+ public:
+  explicit Suspended(void* process)
+      : process_(process), ok_(Impl::process_suspend(process))
+  {
+  }
+  ~Suspended()
+  {
+    if (ok_) { Impl::process_resume(process_); }
+  }
+  Suspended(const Suspended&) = delete;
+  auto operator=(const Suspended&) -> Suspended& = delete;
+
+  explicit operator bool() const { return ok_; }
+
+ private:
+  void* process_;
+  bool ok_;
+};
+
+// Bytes of the other process starting at `address`.
+struct Snapshot
+{
+  std::uintptr_t address{};
+  std::vector<std::uint8_t> bytes;
+  std::size_t dirty_begin{std::numeric_limits<std::size_t>::max()};
+  std::size_t dirty_end{};
+};
+
+// Writes code over pages that may not be writable, one write for all of
+// `bytes` between changing and restoring the protection of each region.
+auto write_code(void* process, std::uintptr_t address,
+                std::span<const std::uint8_t> bytes)
+    -> std::expected<void, Error>
+{
+  struct Region
+  {
+    std::uintptr_t address;
+    std::size_t size;
+    Impl::VMAccess access;
+  };
+  std::vector<Region> regions;
+  const auto end = address + bytes.size();
+  auto restore = [&]
+  {
+    for (const auto& region : regions)
+    {
+      Impl::VMAccess ignored{};
+      Impl::process_protect(process, region.address, region.size,
+                            region.access, ignored);
+    }
+  };
+  for (auto p = address; p < end;)
+  {
+    const auto info = Impl::process_query(process, p);
+    if (not info || info->free)
+    {
+      restore();
+      return std::unexpected{Error::Query};
+    }
+    const auto size = std::min(end, info->address + info->size) - p;
+    Impl::VMAccess old{};
+    if (not Impl::process_protect(process, p, size, Impl::VM_ACCESS_RWX, old))
+    {
+      restore();
+      return std::unexpected{Error::Protect};
+    }
+    regions.push_back({p, size, old});
+    p += size;
+  }
+  const auto written = Impl::process_write(process, address, bytes);
+  restore();
+  Impl::process_flush(process, address, bytes.size());
+  if (not written) { return std::unexpected{Error::Io}; }
+  return {};
+}
+
+// Maps a block near [low, high] so that it and everything in that span stay
+// within rel32 reach of each other, walking the free regions outwards like
+// Allocator does in this process.
+auto allocate_near(void* process, std::uintptr_t low, std::uintptr_t high,
+                   std::size_t size) -> std::expected<std::uintptr_t, Error>
+{
+  const auto si = Impl::get_system_info();
+  size = detail::align_up(size, si.granularity);
+  auto fits = [&](std::uintptr_t p)
+  { return std::max(high, p + size) - std::min(low, p) <= kReach; };
+
+  Impl::VMInfo info{};
+  for (auto p = detail::align_down(low, si.granularity);
+       p > si.min_address && fits(p);
+       p = detail::align_down(info.address - 1, si.granularity))
+  {
+    auto query = Impl::process_query(process, p);
+    if (not query) { break; }
+    info = *query;
+    if (not info.free) { continue; }
+    if (auto block =
+            Impl::process_alloc(process, p, size, Impl::VM_ACCESS_RWX))
+    {
+      return block;
+    }
+  }
+  for (auto p = detail::align_up(high, si.granularity);
+       p < si.max_address && fits(p);
+       p = detail::align_up(info.address + info.size, si.granularity))
+  {
+    auto query = Impl::process_query(process, p);
+    if (not query) { break; }
+    info = *query;
+    if (not info.free) { continue; }
+    if (auto block =
+            Impl::process_alloc(process, p, size, Impl::VM_ACCESS_RWX))
+    {
+      return block;
+    }
+  }
+  return std::unexpected{Error::Allocate};
+}
+
+// Threads stopped inside a prologue about to be patched continue at the
+// same instruction in its trampoline; `restore` moves them back out again.
+struct ThreadMove
+{
+  std::span<const RemoteHook* const> hooks;  // by target
+  bool restore{false};
+};
+
+auto move_ip(std::uintptr_t ip, void* context) -> std::uintptr_t
+{
+  const auto& move = *static_cast<const ThreadMove*>(context);
+  if (not move.restore)
+  {
+    // The last hook starting before `ip`; prologues do not overlap.
+    const auto it = std::ranges::upper_bound(move.hooks, ip, {},
+                                             [](const RemoteHook* hook)
+                                             { return hook->target; });
+    if (it == move.hooks.begin()) { return ip; }
+    const auto& hook = **std::prev(it);
+    if (ip == hook.target || ip >= hook.target + hook.plan.prologue_size)
+    {
+      return ip;
+    }
+    const auto moved =
+        Impl::relocated_address(hook.plan, hook.trampoline, ip);
+    return moved != 0 ? moved : ip;
+  }
+  for (const auto* hook : move.hooks)
+  {
+    for (std::size_t i = 0; i < hook->plan.instruction_count; ++i)
+    {
+      const auto original = hook->target + hook->plan.instructions[i].offset;
+      if (Impl::relocated_address(hook->plan, hook->trampoline, original) ==
+          ip)
+      {
+        return original;
+      }
+    }
+  }
+  return ip;
+}
+
+// Groups sorted addresses into runs that one read or write covers.
+template <typename Address>
+auto runs(std::size_t count, Address address, std::size_t size)
+    -> std::vector<std::pair<std::size_t, std::size_t>>
+{
+  std::vector<std::pair<std::size_t, std::size_t>> result;
+  for (std::size_t first = 0; first < count;)
+  {
+    auto last = first + 1;
+    while (last < count &&
+           address(last) <= address(last - 1) + size + kMaxGap &&
+           address(last) + size - address(first) <= kMaxRun)
+    {
+      ++last;
+    }
+    result.emplace_back(first, last);
+    first = last;
+  }
+  return result;
+}
+}  // namespace
+
+auto RemoteProcess::Open(std::uint32_t pid)
+    -> std::expected<std::unique_ptr<RemoteProcess>, Error>
+{
+  auto* handle = Impl::process_open(pid);
+  if (handle == nullptr) { return std::unexpected{Error::Io}; }
+  std::unique_ptr<RemoteProcess> process{new RemoteProcess};
+  process->handle_ = handle;
+  process->pid_ = pid;
+  return process;
+}
+
+RemoteProcess::~RemoteProcess()
+{
+  if (handle_ != nullptr) { Impl::process_close(handle_); }
+}
+
+auto RemoteProcess::Read(std::uintptr_t address,
+                         std::span<std::uint8_t> out) const
+    -> std::expected<void, Error>
+{
+  if (not Impl::process_read(handle_, address, out))
+  {
+    return std::unexpected{Error::Io};
+  }
+  return {};
+}
+
+auto RemoteProcess::Install(std::span<const HookTarget> targets)
+    -> std::vector<std::expected<RemoteHook, Error>>
+{
+  std::scoped_lock lock(mutex_);
+  std::vector<std::expected<RemoteHook, Error>> hooks(
+      targets.size(), std::unexpected{Error::Io});
+  const Suspended suspended{handle_};
+  if (not suspended) { return hooks; }
+
+  std::vector<std::size_t> order(targets.size());
+  for (std::size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+  std::ranges::sort(order, {},
+                    [&](std::size_t i) { return targets[i].target; });
+
+  // One read per run of nearby prologues, one per target if a run crosses
+  // into memory that cannot be read.
+  std::vector<Snapshot> snapshots;
+  constexpr auto kUnread = std::numeric_limits<std::size_t>::max();
+  std::vector<std::size_t> snapshot_of(targets.size(), kUnread);
+  {
+    VH_TRACE_SCOPE(trace, Decode, targets.empty() ? 0 : targets[0].target);
+    const auto target = [&](std::size_t i) { return targets[order[i]].target; };
+    for (const auto& [first, last] : runs(order.size(), target, kReadSize))
+    {
+      Snapshot run{.address = target(first), .bytes = {}};
+      run.bytes.resize(target(last - 1) + kReadSize - run.address);
+      if (Impl::process_read(handle_, run.address, run.bytes))
+      {
+        for (auto i = first; i < last; ++i)
+        {
+          snapshot_of[order[i]] = snapshots.size();
+        }
+        snapshots.push_back(std::move(run));
+        continue;
+      }
+      for (auto i = first; i < last; ++i)
+      {
+        Snapshot single{.address = target(i), .bytes = {}};
+        single.bytes.resize(kReadSize);
+        if (not Impl::process_read(handle_, single.address, single.bytes))
+        {
+          // A prologue right before the end of its region.
+          const auto page_end = detail::align_up(single.address + 1,
+                                                 std::uintptr_t{0x1000});
+          single.bytes.resize(page_end - single.address);
+          if (not Impl::process_read(handle_, single.address, single.bytes))
+          {
+            continue;
+          }
+        }
+        snapshot_of[order[i]] = snapshots.size();
+        snapshots.push_back(std::move(single));
+      }
+    }
+  }
+
+  // Plan from the snapshot, E9 first as InlineHook does.
+  std::vector<RemoteHook> planned(targets.size());
+  std::vector<std::size_t> ready;
+  std::uintptr_t prologue_end = 0;
+  for (const auto index : order)
+  {
+    const auto target = targets[index].target;
+    if (snapshot_of[index] == kUnread) { continue; }
+    if (target < prologue_end)
+    {
+      hooks[index] = std::unexpected{Error::NotEnoughSpace};
+      continue;
+    }
+    const auto& snapshot = snapshots[snapshot_of[index]];
+    const auto code = std::span<const std::uint8_t>{snapshot.bytes}.subspan(
+        target - snapshot.address);
+    auto plan = Impl::plan_hook(code, target, Impl::HookType::E9);
+#if defined(VH_ARCH_X86_64)
+    if (not plan) { plan = Impl::plan_hook(code, target, Impl::HookType::FF); }
+#endif
+    if (not plan)
+    {
+      hooks[index] = std::unexpected{plan.error()};
+      continue;
+    }
+    planned[index] = {.target = target, .plan = *plan};
+    prologue_end = target + plan->prologue_size;
+    ready.push_back(index);
+  }
+
+  // E9 plans by address first, then FF plans which may live anywhere.
+  std::ranges::sort(ready, [&](std::size_t lhs, std::size_t rhs)
+  {
+    const auto& a = planned[lhs].plan;
+    const auto& b = planned[rhs].plan;
+    return std::pair{a.type != Impl::HookType::E9, a.target} <
+           std::pair{b.type != Impl::HookType::E9, b.target};
+  });
+
+  // One block and one write per window of trampolines.
+  std::vector<std::size_t> written;
+  std::vector<std::uint8_t> code;
+  for (std::size_t first = 0; first < ready.size();)
+  {
+    const auto& head = planned[ready[first]].plan;
+    const auto near = head.type == Impl::HookType::E9;
+    auto low = head.target;
+    auto high = head.target;
+    std::size_t bytes = 0;
+    auto last = first;
+    for (; last < ready.size(); ++last)
+    {
+      auto& current = planned[ready[last]];
+      const auto is_head = last == first;
+      const auto size =
+          detail::align_up(current.plan.trampoline_size, kTrampolineAlignment);
+      if (not is_head &&
+          ((current.plan.type == Impl::HookType::E9) != near ||
+           bytes + size > kBatchBytes))
+      {
+        break;
+      }
+      if (near)
+      {
+        const auto [min, max] = std::ranges::minmax(current.plan.reach());
+        if (not is_head &&
+            std::max(high, max) - std::min(low, min) > kBatchWindow)
+        {
+          break;
+        }
+        low = std::min(low, min);
+        high = std::max(high, max);
+      }
+      current.trampoline = bytes;  // offset until the block is mapped
+      bytes += size;
+    }
+
+    std::expected<std::uintptr_t, Error> block{};
+    {
+      VH_TRACE_SCOPE(trace, Allocate, head.target);
+      block = near ? allocate_near(handle_, low, high, bytes)
+                   : Impl::process_alloc(handle_, 0, bytes,
+                                         Impl::VM_ACCESS_RWX);
+      if (not block) { trace.fail(block.error()); }
+    }
+    code.assign(bytes, 0xCC);
+    std::vector<std::size_t> emitted;
+    for (auto i = first; i < last && block; ++i)
+    {
+      const auto index = ready[i];
+      auto& hook = planned[index];
+      hook.trampoline += *block;
+      auto out = std::span{code}.subspan(hook.trampoline - *block,
+                                         hook.plan.trampoline_size);
+      if (auto result = Impl::emit_trampoline(
+              hook.plan, out, hook.trampoline, targets[index].destination);
+          not result)
+      {
+        hooks[index] = std::unexpected{result.error()};
+        continue;
+      }
+      emitted.push_back(index);
+    }
+    if (not block)
+    {
+      for (auto i = first; i < last; ++i)
+      {
+        hooks[ready[i]] = std::unexpected{block.error()};
+      }
+    }
+    else if (not Impl::process_write(handle_, *block, code))
+    {
+      for (const auto index : emitted)
+      {
+        hooks[index] = std::unexpected{Error::Io};
+      }
+    }
+    else
+    {
+      Impl::process_flush(handle_, *block, code.size());
+      written.insert(written.end(), emitted.begin(), emitted.end());
+    }
+    first = last;
+  }
+
+  // Patch the snapshot, then move threads out of the prologues it replaces.
+  std::vector<const RemoteHook*> patched;
+  for (const auto index : written)
+  {
+    const auto& hook = planned[index];
+    auto& snapshot = snapshots[snapshot_of[index]];
+    const auto offset = hook.target - snapshot.address;
+    auto out = std::span{snapshot.bytes}.subspan(offset,
+                                                 hook.plan.prologue_size);
+    if (auto result = Impl::emit_patch(hook.plan, out, hook.trampoline,
+                                       targets[index].destination);
+        not result)
+    {
+      std::ranges::copy(
+          std::span{hook.plan.original_bytes}.first(out.size()), out.begin());
+      hooks[index] = std::unexpected{result.error()};
+      continue;
+    }
+    snapshot.dirty_begin = std::min(snapshot.dirty_begin, offset);
+    snapshot.dirty_end = std::max(snapshot.dirty_end, offset + out.size());
+    patched.push_back(&hook);
+  }
+  std::ranges::sort(patched, {},
+                    [](const RemoteHook* hook) { return hook->target; });
+  ThreadMove move{.hooks = patched};
+  if (not Impl::process_move_threads(pid_, &move_ip, &move))
+  {
+    for (const auto* hook : patched)
+    {
+      hooks[static_cast<std::size_t>(hook - planned.data())] =
+          std::unexpected{Error::Io};
+    }
+    return hooks;
+  }
+
+  for (const auto& snapshot : snapshots)
+  {
+    if (snapshot.dirty_begin >= snapshot.dirty_end) { continue; }
+    VH_TRACE_SCOPE(trace, Write, snapshot.address + snapshot.dirty_begin);
+    const auto result = write_code(
+        handle_, snapshot.address + snapshot.dirty_begin,
+        std::span{snapshot.bytes}.subspan(
+            snapshot.dirty_begin, snapshot.dirty_end - snapshot.dirty_begin));
+    if (not result) { trace.fail(result.error()); }
+    const auto begin = snapshot.address + snapshot.dirty_begin;
+    const auto end = snapshot.address + snapshot.dirty_end;
+    for (const auto* hook : patched)
+    {
+      if (hook->target < begin || hook->target >= end) { continue; }
+      const auto index = static_cast<std::size_t>(hook - planned.data());
+      if (result) { hooks[index] = *hook; }
+      else { hooks[index] = std::unexpected{result.error()}; }
+    }
+  }
+  return hooks;
+}
+
+auto RemoteProcess::Uninstall(std::span<const RemoteHook> hooks)
+    -> std::expected<void, Error>
+{
+  std::scoped_lock lock(mutex_);
+  const Suspended suspended{handle_};
+  if (not suspended) { return std::unexpected{Error::Io}; }
+
+  std::vector<const RemoteHook*> sorted(hooks.size());
+  for (std::size_t i = 0; i < hooks.size(); ++i) { sorted[i] = &hooks[i]; }
+  std::ranges::sort(sorted, {},
+                    [](const RemoteHook* hook) { return hook->target; });
+  ThreadMove move{.hooks = sorted, .restore = true};
+  if (not Impl::process_move_threads(pid_, &move_ip, &move))
+  {
+    return std::unexpected{Error::Io};
+  }
+
+  std::expected<void, Error> result{};
+  std::vector<std::uint8_t> bytes;
+  const auto target = [&](std::size_t i) { return sorted[i]->target; };
+  for (const auto& [first, last] :
+       runs(sorted.size(), target, Impl::HookPlan::kMaxPrologue))
+  {
+    const auto& tail = *sorted[last - 1];
+    const auto address = target(first);
+    bytes.resize(tail.target + tail.plan.prologue_size - address);
+    // Bytes between the prologues are whatever the process holds now.
+    if (last - first > 1 && not Impl::process_read(handle_, address, bytes))
+    {
+      result = std::unexpected{Error::Io};
+      continue;
+    }
+    for (auto i = first; i < last; ++i)
+    {
+      const auto& plan = sorted[i]->plan;
+      std::memcpy(bytes.data() + (sorted[i]->target - address),
+                  plan.original_bytes.data(), plan.prologue_size);
+    }
+    VH_TRACE_SCOPE(trace, Write, address);
+    if (auto written = write_code(handle_, address, bytes); not written)
+    {
+      trace.fail(written.error());
+      result = written;
+    }
+  }
+  return result;
+}
+
+}  // namespace VeilHook
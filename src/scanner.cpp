@@ -0,0 +1,425 @@
+#include "VeilHook/scanner.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+
+#if defined(VH_COMPILER_MSVC)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace VeilHook
+{
+
+namespace
+{
+using Matches = std::vector<ScanMatch>;
+
+// Small enough that a chunk stays in L2 while every pattern runs over it.
+constexpr std::size_t kChunkSize = 0x40000;
+
+// Bytes that are everywhere in x86 code make poor anchors: REX prefixes,
+// mov/lea/call opcodes, common ModRM bytes, padding.
+constexpr auto kCommonBytes = []
+{
+  std::array<bool, 256> common{};
+  for (const std::uint8_t byte :
+       {0x00, 0x01, 0x08, 0x0F, 0x10, 0x20, 0x24, 0x40, 0x41, 0x44, 0x45, 0x48,
+        0x49, 0x4C, 0x4D, 0x74, 0x75, 0x83, 0x85, 0x89, 0x8B, 0x8D, 0x90, 0xC0,
+        0xC3, 0xCC, 0xE8, 0xFF})
+  {
+    common[byte] = true;
+  }
+  return common;
+}();
+
+auto hex_digit(char c) -> std::optional<std::uint8_t>
+{
+  if (c >= '0' && c <= '9') { return static_cast<std::uint8_t>(c - '0'); }
+  if (c >= 'a' && c <= 'f') { return static_cast<std::uint8_t>(c - 'a' + 10); }
+  if (c >= 'A' && c <= 'F') { return static_cast<std::uint8_t>(c - 'A' + 10); }
+  return std::nullopt;
+}
+
+struct CpuFeatures
+{
+  bool sse2{false};
+  bool avx2{false};
+};
+
+VH_TARGET("xsave") auto xcr0() -> std::uint64_t { return _xgetbv(0); }
+
+void cpuid(std::array<int, 4>& registers, int leaf)
+{
+#if defined(VH_COMPILER_MSVC)
+  __cpuidex(registers.data(), leaf, 0);
+#else
+  std::array<unsigned, 4> values{};
+  __cpuid_count(leaf, 0, values[0], values[1], values[2], values[3]);
+  std::ranges::transform(values, registers.begin(),
+                         [](unsigned value) { return static_cast<int>(value); });
+#endif
+}
+
+auto cpu_features() -> CpuFeatures
+{
+  static const auto features = []
+  {
+    CpuFeatures result{};
+    std::array<int, 4> registers{};
+    cpuid(registers, 0);
+    const auto max_leaf = registers[0];
+    cpuid(registers, 1);
+    result.sse2 = (registers[3] & (1 << 26)) != 0;
+    // AVX2 also needs the OS to save YMM state across context switches.
+    const auto osxsave = (registers[2] & (1 << 27)) != 0;
+    if (max_leaf >= 7 && osxsave && (xcr0() & 0x6) == 0x6)
+    {
+      cpuid(registers, 7);
+      result.avx2 = (registers[1] & (1 << 5)) != 0;
+    }
+    return result;
+  }();
+  return features;
+}
+
+void verify(const Pattern& pattern, std::size_t index,
+            const std::uint8_t* data, std::size_t position, Matches& out)
+{
+  if (pattern.matches(data + position))
+  {
+    out.push_back({.pattern = index,
+                   .address = detail::address_cast(data + position)});
+  }
+}
+
+// Kernels test every start position in [begin, end); the caller guarantees
+// the whole pattern fits at each of them.
+void scan_scalar(const Pattern& pattern, std::size_t index,
+                 const std::uint8_t* data, std::size_t begin, std::size_t end,
+                 Matches& out)
+{
+  const auto anchor = pattern.anchor();
+  const auto first = pattern.bytes()[anchor];
+  const auto anchored = pattern.anchor_size() != 0;
+  for (auto position = begin; position < end; ++position)
+  {
+    if (anchored && data[position + anchor] != first) { continue; }
+    verify(pattern, index, data, position, out);
+  }
+}
+
+VH_TARGET("sse2")
+void scan_sse2(const Pattern& pattern, std::size_t index,
+               const std::uint8_t* data, std::size_t begin, std::size_t end,
+               Matches& out)
+{
+  if (pattern.anchor_size() == 0)
+  {
+    scan_scalar(pattern, index, data, begin, end, out);
+    return;
+  }
+  const auto anchor = pattern.anchor();
+  const auto pair = pattern.anchor_size() == 2;
+  const auto first =
+      _mm_set1_epi8(static_cast<char>(pattern.bytes()[anchor]));
+  const auto second = _mm_set1_epi8(
+      static_cast<char>(pattern.bytes()[anchor + (pair ? 1 : 0)]));
+
+  auto position = begin;
+  for (; position + 16 <= end; position += 16)
+  {
+    const auto* at = data + position + anchor;
+    auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128(detail::address_cast<const __m128i*>(at)), first)));
+    if (pair && bits != 0)
+    {
+      bits &= static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+          _mm_loadu_si128(detail::address_cast<const __m128i*>(at + 1)),
+          second)));
+    }
+    for (; bits != 0; bits &= bits - 1)
+    {
+      verify(pattern, index, data, position + std::countr_zero(bits), out);
+    }
+  }
+  scan_scalar(pattern, index, data, position, end, out);
+}
+
+VH_TARGET("avx2")
+void scan_avx2(const Pattern& pattern, std::size_t index,
+               const std::uint8_t* data, std::size_t begin, std::size_t end,
+               Matches& out)
+{
+  if (pattern.anchor_size() == 0)
+  {
+    scan_scalar(pattern, index, data, begin, end, out);
+    return;
+  }
+  const auto anchor = pattern.anchor();
+  const auto pair = pattern.anchor_size() == 2;
+  const auto first =
+      _mm256_set1_epi8(static_cast<char>(pattern.bytes()[anchor]));
+  const auto second = _mm256_set1_epi8(
+      static_cast<char>(pattern.bytes()[anchor + (pair ? 1 : 0)]));
+
+  auto position = begin;
+  for (; position + 32 <= end; position += 32)
+  {
+    const auto* at = data + position + anchor;
+    auto bits = static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256(detail::address_cast<const __m256i*>(at)),
+            first)));
+    if (pair && bits != 0)
+    {
+      bits &= static_cast<std::uint32_t>(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+              _mm256_loadu_si256(
+                  detail::address_cast<const __m256i*>(at + 1)),
+              second)));
+    }
+    for (; bits != 0; bits &= bits - 1)
+    {
+      verify(pattern, index, data, position + std::countr_zero(bits), out);
+    }
+  }
+  scan_scalar(pattern, index, data, position, end, out);
+}
+
+void scan(Scanner::Kernel kernel, const Pattern& pattern, std::size_t index,
+          const std::uint8_t* data, std::size_t begin, std::size_t end,
+          Matches& out)
+{
+  switch (kernel)
+  {
+    case Scanner::Kernel::Avx2:
+      scan_avx2(pattern, index, data, begin, end, out);
+      break;
+    case Scanner::Kernel::Sse2:
+      scan_sse2(pattern, index, data, begin, end, out);
+      break;
+    default: scan_scalar(pattern, index, data, begin, end, out); break;
+  }
+}
+
+auto match_less(const ScanMatch& lhs, const ScanMatch& rhs) -> bool
+{
+  return std::pair{lhs.pattern, lhs.address} <
+         std::pair{rhs.pattern, rhs.address};
+}
+}  // namespace
+
+auto Pattern::Parse(std::string_view signature)
+    -> std::expected<Pattern, Error>
+{
+  std::vector<std::uint8_t> bytes;
+  std::vector<std::uint8_t> mask;
+  std::size_t i = 0;
+  while (i < signature.size())
+  {
+    if (signature[i] == ' ' || signature[i] == '\t')
+    {
+      ++i;
+      continue;
+    }
+    auto end = signature.find_first_of(" \t", i);
+    if (end == std::string_view::npos) { end = signature.size(); }
+    const auto token = signature.substr(i, end - i);
+    i = end;
+
+    if (token == "?" || token == "??")
+    {
+      bytes.push_back(0);
+      mask.push_back(0);
+      continue;
+    }
+    if (token.size() != 2) { return std::unexpected(Error::InvalidPattern); }
+    std::uint8_t value = 0;
+    std::uint8_t nibbles = 0;
+    for (const auto c : token)
+    {
+      value = static_cast<std::uint8_t>(value << 4);
+      nibbles = static_cast<std::uint8_t>(nibbles << 4);
+      if (c == '?') { continue; }
+      const auto digit = hex_digit(c);
+      if (not digit) { return std::unexpected(Error::InvalidPattern); }
+      value |= *digit;
+      nibbles |= 0x0F;
+    }
+    bytes.push_back(value);
+    mask.push_back(nibbles);
+  }
+  return _make(std::move(bytes), std::move(mask));
+}
+
+auto Pattern::FromMask(std::span<const std::uint8_t> bytes,
+                       std::string_view mask) -> std::expected<Pattern, Error>
+{
+  if (bytes.size() != mask.size())
+  {
+    return std::unexpected(Error::InvalidPattern);
+  }
+  std::vector<std::uint8_t> values;
+  std::vector<std::uint8_t> masks;
+  for (std::size_t i = 0; i < bytes.size(); ++i)
+  {
+    if (mask[i] != 'x' && mask[i] != '?')
+    {
+      return std::unexpected(Error::InvalidPattern);
+    }
+    const auto exact = mask[i] == 'x';
+    values.push_back(exact ? bytes[i] : 0);
+    masks.push_back(exact ? 0xFF : 0x00);
+  }
+  return _make(std::move(values), std::move(masks));
+}
+
+auto Pattern::_make(std::vector<std::uint8_t> bytes,
+                    std::vector<std::uint8_t> mask)
+    -> std::expected<Pattern, Error>
+{
+  if (std::ranges::all_of(mask, [](std::uint8_t m) { return m == 0; }))
+  {
+    return std::unexpected(Error::InvalidPattern);
+  }
+
+  Pattern pattern{};
+  pattern.bytes_ = std::move(bytes);
+  pattern.mask_ = std::move(mask);
+  pattern.anchor_size_ = 0;
+
+  // Prefer two adjacent exact bytes, the rarer the better.
+  const auto exact = [&](std::size_t i) { return pattern.mask_[i] == 0xFF; };
+  const auto cost = [&](std::size_t i)
+  {
+    return kCommonBytes[pattern.bytes_[i]] ? 1 : 0;
+  };
+  auto best = 3;
+  for (std::size_t i = 0; i < pattern.size(); ++i)
+  {
+    if (not exact(i)) { continue; }
+    const auto pair = i + 1 < pattern.size() && exact(i + 1);
+    // A pair is always better than a single byte.
+    const auto score = pair ? cost(i) + cost(i + 1) - 1 : cost(i) + 1;
+    if (score < best ||
+        (score == best && pair && pattern.anchor_size_ != 2))
+    {
+      best = score;
+      pattern.anchor_ = i;
+      pattern.anchor_size_ = pair ? 2 : 1;
+    }
+  }
+  return pattern;
+}
+
+Scanner::Scanner(std::vector<Pattern> patterns)
+    : patterns_(std::move(patterns)), kernel_(detect())
+{
+}
+
+auto Scanner::detect() -> Kernel
+{
+  const auto features = cpu_features();
+  if (features.avx2) { return Kernel::Avx2; }
+  if (features.sse2) { return Kernel::Sse2; }
+  return Kernel::Scalar;
+}
+
+auto Scanner::supported(Kernel kernel) -> bool
+{
+  switch (kernel)
+  {
+    case Kernel::Avx2: return cpu_features().avx2;
+    case Kernel::Sse2: return cpu_features().sse2;
+    default: return true;
+  }
+}
+
+void Scanner::set_kernel(Kernel kernel)
+{
+  while (not supported(kernel))
+  {
+    kernel = static_cast<Kernel>(static_cast<std::uint8_t>(kernel) - 1);
+  }
+  kernel_ = kernel;
+}
+
+auto Scanner::Scan(std::span<const std::uint8_t> memory) const
+    -> std::vector<ScanMatch>
+{
+  const auto chunks = (memory.size() + kChunkSize - 1) / kChunkSize;
+  std::vector<Matches> found(chunks);
+  Impl::parallel_for(
+      chunks,
+      [&](std::size_t chunk)
+      {
+        const auto begin = chunk * kChunkSize;
+        const auto end = std::min(memory.size(), begin + kChunkSize);
+        for (std::size_t i = 0; i < patterns_.size(); ++i)
+        {
+          const auto& pattern = patterns_[i];
+          if (pattern.size() > memory.size()) { continue; }
+          // Matches may run past the chunk, but not past the input.
+          const auto last =
+              std::min(end, memory.size() - pattern.size() + 1);
+          if (begin >= last) { continue; }
+          scan(kernel_, pattern, i, memory.data(), begin, last, found[chunk]);
+        }
+      },
+      1, threads_);
+
+  std::vector<ScanMatch> matches;
+  for (const auto& chunk : found)
+  {
+    matches.insert(matches.end(), chunk.begin(), chunk.end());
+  }
+  std::ranges::sort(matches, match_less);
+  return matches;
+}
+
+auto Scanner::ScanModule(std::uintptr_t module) const
+    -> std::expected<std::vector<ScanMatch>, Error>
+{
+  auto sections = Impl::module_sections(module);
+  if (not sections) { return std::unexpected(sections.error()); }
+
+  std::vector<ScanMatch> matches;
+  for (const auto& section : *sections)
+  {
+    if (not section.executable) { continue; }
+    const auto found = Scan(
+        {detail::address_cast<const std::uint8_t*>(section.address),
+         section.size});
+    matches.insert(matches.end(), found.begin(), found.end());
+  }
+  std::ranges::sort(matches, match_less);
+  return matches;
+}
+
+auto Scanner::ScanModule(std::string_view module) const
+    -> std::expected<std::vector<ScanMatch>, Error>
+{
+  const auto base = Impl::module_find(module);
+  if (not base) { return std::unexpected(base.error()); }
+  return ScanModule(*base);
+}
+
+auto Scanner::Find(std::string_view module, std::string_view signature)
+    -> std::expected<std::uintptr_t, Error>
+{
+  auto pattern = Pattern::Parse(signature);
+  if (not pattern) { return std::unexpected(pattern.error()); }
+  const Scanner scanner{{std::move(*pattern)}};
+  const auto matches = scanner.ScanModule(module);
+  if (not matches) { return std::unexpected(matches.error()); }
+  if (matches->empty()) { return std::unexpected(Error::NotFound); }
+  return matches->front().address;
+}
+
+}  // namespace VeilHook
@@ -0,0 +1,141 @@
+#include "VeilHook/static_hooks.hpp"
+
+#include "VeilHook/hook_registry.hpp"
+#include "VeilHook/symbol_index.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace VeilHook
+{
+
+namespace
+{
+struct Installed
+{
+  HookRegistry* registry;
+  HookHandle handle;
+};
+
+// Shared by every module linking against us; each install batch gets a
+// registry sized to it.
+struct State
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<HookRegistry>> registries;
+  std::unordered_map<const StaticHook*, Installed> hooks;
+};
+
+auto state() -> State&
+{
+  static State state;
+  return state;
+}
+
+auto resolve(const StaticHook& hook) -> std::expected<std::uintptr_t, Error>
+{
+  if (hook.target != nullptr) { return hook.target(); }
+  if (hook.module == nullptr || hook.symbol == nullptr)
+  {
+    return std::unexpected(Error::InvalidArgument);
+  }
+  return SymbolIndex::Get().Resolve(hook.module, hook.symbol);
+}
+
+void drop_empty(State& state)
+{
+  std::erase_if(state.registries,
+                [](const auto& registry) { return registry->size() == 0; });
+}
+}  // namespace
+
+namespace Impl
+{
+auto install_static_hooks(std::span<const StaticHook* const> hooks,
+                          HookOptions options)
+    -> std::expected<std::size_t, Error>
+{
+  auto& state = VeilHook::state();
+  std::scoped_lock lock{state.mutex};
+
+  std::optional<Error> failure;
+  auto fail = [&failure](Error error)
+  {
+    if (not failure) { failure = error; }
+  };
+
+  std::vector<const StaticHook*> pending;
+  std::vector<HookTarget> targets;
+  for (const auto* hook : hooks)
+  {
+    if (hook == nullptr || state.hooks.contains(hook) ||
+        std::ranges::find(pending, hook) != pending.end())
+    {
+      continue;
+    }
+    auto target = resolve(*hook);
+    if (not target)
+    {
+      fail(target.error());
+      continue;
+    }
+    pending.push_back(hook);
+    targets.push_back({.target = *target, .destination = hook->destination()});
+  }
+  if (pending.empty())
+  {
+    if (failure) { return std::unexpected(*failure); }
+    return 0;
+  }
+
+  auto& registry = *state.registries.emplace_back(
+      std::make_unique<HookRegistry>(pending.size()));
+  auto handles = registry.AddMany(targets, options);
+  std::size_t installed = 0;
+  for (std::size_t i = 0; i < pending.size(); ++i)
+  {
+    if (not handles[i])
+    {
+      fail(handles[i].error());
+      continue;
+    }
+    // Published first so the detour can call through from its first hit.
+    pending[i]->publish(registry.trampoline(*handles[i]));
+    if (auto result = registry.Enable(*handles[i]); not result)
+    {
+      pending[i]->publish(0);
+      (void)registry.Remove(*handles[i]);
+      fail(result.error());
+      continue;
+    }
+    state.hooks.emplace(
+        pending[i], Installed{.registry = &registry, .handle = *handles[i]});
+    ++installed;
+  }
+  drop_empty(state);
+
+  if (failure) { return std::unexpected(*failure); }
+  return installed;
+}
+
+void uninstall_static_hooks(std::span<const StaticHook* const> hooks)
+{
+  auto& state = VeilHook::state();
+  std::scoped_lock lock{state.mutex};
+  for (const auto* hook : hooks)
+  {
+    const auto it = state.hooks.find(hook);
+    if (it == state.hooks.end()) { continue; }
+    (void)it->second.registry->Remove(it->second.handle);
+    hook->publish(0);
+    state.hooks.erase(it);
+  }
+  drop_empty(state);
+}
+}  // namespace Impl
+
+}  // namespace VeilHook
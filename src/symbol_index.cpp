@@ -0,0 +1,275 @@
+#include "VeilHook/symbol_index.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <ranges>
+
+namespace VeilHook
+{
+
+namespace Impl
+{
+auto undecorate(std::string_view name) -> std::string
+{
+  // "??" starts operators, special members and templates.
+  if (name.size() < 2 || name[0] != '?' || name[1] == '?') { return {}; }
+  const auto end = name.find("@@", 1);
+  if (end == std::string_view::npos) { return {}; }
+
+  std::vector<std::string_view> parts;
+  for (std::size_t i = 1; i < end;)
+  {
+    const auto at = name.find('@', i);
+    const auto part = name.substr(i, at - i);
+    // Back references, nested names and template arguments.
+    if (part.empty() || part[0] == '?' || part[0] == '$' ||
+        (part[0] >= '0' && part[0] <= '9'))
+    {
+      return {};
+    }
+    parts.push_back(part);
+    i = at + 1;
+  }
+
+  std::string qualified;
+  for (const auto part : parts | std::views::reverse)
+  {
+    if (not qualified.empty()) { qualified += "::"; }
+    qualified += part;
+  }
+  return qualified;
+}
+}  // namespace Impl
+
+auto SymbolIndex::Get() -> SymbolIndex&
+{
+  // Never destroyed: the unload notification may outlive static
+  // destructors.
+  static auto* index = new SymbolIndex;
+  static std::once_flag once;
+  std::call_once(once, []
+  {
+    // Watch first, so nothing unloads unnoticed between listing and
+    // watching.
+    (void)Impl::module_watch(&_notify, index);
+    index->AddLoadedModules();
+  });
+  return *index;
+}
+
+void SymbolIndex::AddLoadedModules()
+{
+  for (const auto base : Impl::module_list()) { (void)AddModule(base); }
+}
+
+auto SymbolIndex::AddModule(std::string_view module)
+    -> std::expected<void, Error>
+{
+  const auto base = Impl::module_find(module);
+  if (not base) { return std::unexpected(base.error()); }
+  return AddModule(*base);
+}
+
+auto SymbolIndex::AddModule(std::uintptr_t base) -> std::expected<void, Error>
+{
+  const auto info = Impl::module_query(base);
+  if (not info) { return std::unexpected(info.error()); }
+  const auto indexed = [&]
+  {
+    return std::ranges::any_of(modules_, [&](const Module& module)
+    {
+      return module.base == base && module.build_id == info->build_id;
+    });
+  };
+  {
+    std::shared_lock lock{mutex_};
+    if (indexed()) { return {}; }
+  }
+
+  // Parse and copy the names outside the lock, lookups keep running
+  // meanwhile.
+  const auto exports = Impl::module_exports(base);
+  if (not exports) { return std::unexpected(exports.error()); }
+  auto name = Impl::module_name(base);
+  std::vector<std::string> qualified;
+  qualified.reserve(exports->size());
+  std::size_t bytes = 0;
+  for (const auto& symbol : *exports)
+  {
+    qualified.push_back(Impl::undecorate(symbol.name));
+    bytes += symbol.name.size() + qualified.back().size();
+  }
+  auto names = std::make_unique_for_overwrite<char[]>(bytes);
+  auto* cursor = names.get();
+  const auto intern = [&](std::string_view text)
+  {
+    const std::string_view stored{cursor, text.size()};
+    cursor = std::ranges::copy(text, cursor).out;
+    return stored;
+  };
+
+  std::scoped_lock lock{mutex_};
+  if (indexed()) { return {}; }
+  // Whatever was indexed at this base before has been unloaded.
+  for (std::size_t i = 0; i < modules_.size(); ++i)
+  {
+    if (modules_[i].base == base) { _remove(static_cast<std::uint32_t>(i)); }
+  }
+  const auto module = static_cast<std::uint32_t>(modules_.size());
+
+  const auto by_name = by_name_.size();
+  const auto by_undecorated = by_undecorated_.size();
+  for (std::size_t i = 0; i < exports->size(); ++i)
+  {
+    const auto address = (*exports)[i].address;
+    by_name_.push_back({.name = intern((*exports)[i].name),
+                        .module = module,
+                        .address = address});
+    if (not qualified[i].empty())
+    {
+      by_undecorated_.push_back(
+          {.name = intern(qualified[i]), .module = module, .address = address});
+    }
+  }
+  modules_.push_back({.base = base,
+                      .build_id = info->build_id,
+                      .name = std::move(name),
+                      .names = std::move(names)});
+
+  // Sort the new run and merge it in; modules are numbered in insertion
+  // order, so (name, module) stays a total order.
+  const auto merge = [](std::vector<Entry>& entries, std::size_t first)
+  {
+    const auto less = [](const Entry& lhs, const Entry& rhs)
+    {
+      return std::pair{lhs.name, lhs.module} <
+             std::pair{rhs.name, rhs.module};
+    };
+    const auto middle = entries.begin() + static_cast<std::ptrdiff_t>(first);
+    std::ranges::sort(middle, entries.end(), less);
+    std::ranges::inplace_merge(entries, middle, less);
+  };
+  merge(by_name_, by_name);
+  merge(by_undecorated_, by_undecorated);
+  return {};
+}
+
+void SymbolIndex::RemoveModule(std::uintptr_t base)
+{
+  std::scoped_lock lock{mutex_};
+  const auto it = std::ranges::find(modules_, base, &Module::base);
+  if (it != modules_.end())
+  {
+    _remove(static_cast<std::uint32_t>(it - modules_.begin()));
+  }
+}
+
+auto SymbolIndex::Find(std::string_view module, std::string_view name) const
+    -> std::expected<std::uintptr_t, Error>
+{
+  std::shared_lock lock{mutex_};
+  return _find(by_name_, module, name);
+}
+
+auto SymbolIndex::FindDemangled(std::string_view module,
+                                std::string_view name) const
+    -> std::expected<std::uintptr_t, Error>
+{
+  std::shared_lock lock{mutex_};
+  return _find(by_undecorated_, module, name);
+}
+
+auto SymbolIndex::FindPrefix(std::string_view module,
+                             std::string_view prefix) const
+    -> std::vector<Symbol>
+{
+  const auto wanted = Impl::ascii_lower(module);
+  std::shared_lock lock{mutex_};
+  std::vector<Symbol> symbols;
+  for (auto it = std::ranges::lower_bound(by_name_, prefix, {}, &Entry::name);
+       it != by_name_.end() && it->name.starts_with(prefix); ++it)
+  {
+    const auto& owner = modules_[it->module];
+    if (Impl::module_matches(owner.name, wanted))
+    {
+      symbols.push_back(
+          {.module = owner.name, .name = it->name, .address = it->address});
+    }
+  }
+  return symbols;
+}
+
+auto SymbolIndex::Resolve(std::string_view module, std::string_view name)
+    -> std::expected<std::uintptr_t, Error>
+{
+  if (not module.empty() && not _indexed(module))
+  {
+    if (auto result = AddModule(module); not result)
+    {
+      return std::unexpected(result.error());
+    }
+  }
+  if (auto address = Find(module, name)) { return address; }
+  return FindDemangled(module, name);
+}
+
+auto SymbolIndex::size() const -> std::size_t
+{
+  std::shared_lock lock{mutex_};
+  return by_name_.size();
+}
+
+void SymbolIndex::_notify(Impl::ModuleEvent event, std::uintptr_t base,
+                          [[maybe_unused]] std::string_view name,
+                          void* context)
+{
+  // Loads are indexed on demand by Resolve.
+  if (event != Impl::ModuleEvent::Unloaded) { return; }
+  static_cast<SymbolIndex*>(context)->RemoveModule(base);
+}
+
+auto SymbolIndex::_indexed(std::string_view module) const -> bool
+{
+  const auto wanted = Impl::ascii_lower(module);
+  std::shared_lock lock{mutex_};
+  return std::ranges::any_of(modules_, [&](const Module& indexed)
+  {
+    return indexed.base != 0 && Impl::module_matches(indexed.name, wanted);
+  });
+}
+
+void SymbolIndex::_remove(std::uint32_t module)
+{
+  const auto from = [&](const Entry& entry)
+  {
+    return entry.module == module;
+  };
+  std::erase_if(by_name_, from);
+  std::erase_if(by_undecorated_, from);
+  // The slot stays so later module numbers remain valid.
+  auto& slot = modules_[module];
+  slot.base = 0;
+  slot.build_id = 0;
+  slot.name.clear();
+  slot.names.reset();
+}
+
+auto SymbolIndex::_find(const std::vector<Entry>& entries,
+                        std::string_view module, std::string_view name) const
+    -> std::expected<std::uintptr_t, Error>
+{
+  const auto wanted = Impl::ascii_lower(module);
+  const auto [first, last] =
+      std::ranges::equal_range(entries, name, {}, &Entry::name);
+  for (const auto& entry : std::ranges::subrange(first, last))
+  {
+    if (Impl::module_matches(modules_[entry.module].name, wanted))
+    {
+      return entry.address;
+    }
+  }
+  return std::unexpected(Error::NotFound);
+}
+
+}  // namespace VeilHook
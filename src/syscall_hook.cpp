@@ -0,0 +1,247 @@
+#include "VeilHook/syscall_hook.hpp"
+
+#include "VeilHook/code_map.hpp"
+#include "VeilHook/length_decoder.hpp"
+#include "VeilHook/reclaimer.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <optional>
+
+namespace VeilHook
+{
+
+namespace
+{
+// Longest stub prologue-to-transition stretch we walk.
+constexpr std::size_t kMaxStub = 32;
+
+auto read_u32(std::span<const std::uint8_t> code, std::size_t offset)
+    -> std::uint32_t
+{
+  std::uint32_t value{};
+  std::copy_n(code.begin() + static_cast<std::ptrdiff_t>(offset),
+              sizeof(value), reinterpret_cast<std::uint8_t*>(&value));
+  return value;
+}
+
+// x64:  mov r10, rcx; mov eax, n; ...; syscall
+// x86:  mov eax, n; ...; call edx / call [edx] / sysenter / int 2Eh
+auto parse_stub(std::string_view name, std::uintptr_t address)
+    -> std::optional<Syscall>
+{
+  const std::span code{detail::address_cast<const std::uint8_t*>(address),
+                       kMaxStub};
+#if defined(VH_ARCH_X86_64)
+  constexpr std::array<std::uint8_t, 4> kPrologue{0x4C, 0x8B, 0xD1, 0xB8};
+#else
+  constexpr std::array<std::uint8_t, 1> kPrologue{0xB8};
+#endif
+  if (not std::ranges::equal(code.first(kPrologue.size()), kPrologue))
+  {
+    return std::nullopt;
+  }
+  const auto number = read_u32(code, kPrologue.size());
+
+  auto offset = kPrologue.size() + sizeof(number);
+  while (offset < code.size())
+  {
+    const auto rest = code.subspan(offset);
+    const auto instruction = Impl::decode_length(rest);
+    if (not instruction || offset + instruction->length > code.size())
+    {
+      return std::nullopt;
+    }
+    // A one-byte instruction may end the window.
+    const auto opcode = (rest[0] << 8) | (rest.size() > 1 ? rest[1] : 0);
+    const bool transition =
+#if defined(VH_ARCH_X86_64)
+        opcode == 0x0F05;
+#else
+        opcode == 0x0F34 || opcode == 0xCD2E || opcode == 0xFFD2 ||
+        opcode == 0xFF12 ||
+        instruction->branch == Impl::InstructionLength::Branch::Call;
+#endif
+    if (transition)
+    {
+      return Syscall{.name = name,
+                     .number = number,
+                     .address = address,
+                     .instruction = address + offset};
+    }
+    if (rest[0] == 0xC3 || rest[0] == 0xC2) { return std::nullopt; }
+    offset += instruction->length;
+  }
+  return std::nullopt;
+}
+}  // namespace
+
+namespace Impl
+{
+auto find_syscalls(std::uintptr_t base)
+    -> std::expected<std::vector<Syscall>, Error>
+{
+  const auto exports = module_exports(base);
+  if (not exports) { return std::unexpected(exports.error()); }
+
+  std::vector<Syscall> syscalls;
+  for (const auto& entry : *exports)
+  {
+    if (not entry.name.starts_with("Nt")) { continue; }
+    if (auto syscall = parse_stub(entry.name, entry.address))
+    {
+      syscalls.push_back(*syscall);
+    }
+  }
+  std::ranges::sort(syscalls, {}, &Syscall::number);
+  // Aliases share a stub.
+  const auto aliases = std::ranges::unique(syscalls, {}, &Syscall::number);
+  syscalls.erase(aliases.begin(), aliases.end());
+  return syscalls;
+}
+
+auto dispatch_slots(std::span<const Syscall> syscalls, std::uint32_t mask)
+    -> std::expected<std::size_t, Error>
+{
+  // Sorted by full number, the last stub need not have the largest index:
+  // WoW64 stubs carry bits above it.
+  std::vector<std::uint32_t> indices;
+  indices.reserve(syscalls.size());
+  for (const auto& syscall : syscalls)
+  {
+    indices.push_back(syscall.number & mask);
+  }
+  if (indices.empty()) { return std::unexpected(Error::NotFound); }
+  std::ranges::sort(indices);
+  if (std::ranges::adjacent_find(indices) != indices.end())
+  {
+    return std::unexpected(Error::UnsupportedInstruction);
+  }
+  return std::size_t{indices.back()} + 1;
+}
+}  // namespace Impl
+
+auto SyscallHook::Create(std::string_view module, HookOptions options)
+    -> std::expected<std::unique_ptr<SyscallHook>, Error>
+{
+  const auto base = Impl::module_find(module);
+  if (not base) { return std::unexpected(base.error()); }
+  auto syscalls = Impl::find_syscalls(*base);
+  if (not syscalls) { return std::unexpected(syscalls.error()); }
+  if (syscalls->empty()) { return std::unexpected(Error::NotFound); }
+
+  std::unique_ptr<SyscallHook> hook{new SyscallHook};
+  hook->syscalls_ = std::move(*syscalls);
+  const auto& stubs = hook->syscalls_;
+  const auto slot_count = Impl::dispatch_slots(stubs, kIndexMask);
+  if (not slot_count) { return std::unexpected(slot_count.error()); }
+  hook->slots_ = *slot_count;
+  hook->originals_.resize(hook->slots_);
+
+  const auto slot_bytes = hook->slots_ * sizeof(std::uintptr_t);
+  auto dispatch = Allocator::Get()->Allocate(
+      {*base}, alignof(std::uintptr_t) + slot_bytes + Impl::kCacheLine +
+                   (stubs.size() * kThunkSize));
+  if (not dispatch) { return std::unexpected(Error::Allocate); }
+  hook->dispatch_ = std::make_unique<Allocation>(std::move(*dispatch));
+  auto* slots = hook->_slot(0);
+  std::fill_n(slots, hook->slots_, 0);
+
+  std::vector<HookTarget> targets;
+  targets.reserve(stubs.size());
+  // SetHandler stores into the slots while other threads run the thunks;
+  // keep the two off each other's cache lines.
+  auto thunk = detail::align_up(detail::address_cast(slots + hook->slots_),
+                                Impl::kCacheLine);
+  for (const auto& stub : stubs)
+  {
+    const auto slot = detail::address_cast(hook->_slot(stub.number));
+#if defined(VH_ARCH_X86_64)
+    const auto operand =
+        static_cast<std::uint32_t>(slot - (thunk + 6));  // rip-relative
+#else
+    const auto operand = static_cast<std::uint32_t>(slot);
+#endif
+    detail::store<std::uint8_t>(thunk, 0xFF);
+    detail::store<std::uint8_t>(thunk + 1, 0x25);
+    detail::store<std::uint32_t>(thunk + 2, operand);
+    detail::fill<std::uint8_t>(thunk + 6, kThunkSize - 6, 0xCC);
+    targets.push_back({.target = stub.address, .destination = thunk});
+    CodeMap::Get().Add(thunk, kThunkSize, stub.address, "syscall thunk");
+    thunk += kThunkSize;
+  }
+
+  hook->registry_ = std::make_unique<HookRegistry>(stubs.size());
+  auto handles = hook->registry_->AddMany(targets, options);
+  for (std::size_t i = 0; i < stubs.size(); ++i)
+  {
+    if (not handles[i]) { return std::unexpected(handles[i].error()); }
+    const auto original = hook->registry_->trampoline(*handles[i]);
+    hook->originals_[stubs[i].number & kIndexMask] = original;
+    *hook->_slot(stubs[i].number) = original;
+    hook->handles_.push_back(*handles[i]);
+  }
+  // Every slot passes through before the first stub is patched, since
+  // patching itself goes through NtProtectVirtualMemory.
+  for (const auto handle : hook->handles_)
+  {
+    if (auto result = hook->registry_->Enable(handle); not result)
+    {
+      return std::unexpected(result.error());
+    }
+  }
+  return hook;
+}
+
+SyscallHook::~SyscallHook()
+{
+  // Stubs first; the thunks must outlive them.
+  registry_.reset();
+  if (dispatch_) { Reclaimer::Get().Retire(std::move(*dispatch_)); }
+}
+
+auto SyscallHook::SetHandler(std::uint32_t number, std::uintptr_t handler)
+    -> std::expected<void, Error>
+{
+  const auto original = Original(number);
+  if (original == 0) { return std::unexpected(Error::NotFound); }
+  std::atomic_ref{*_slot(number)}.store(handler != 0 ? handler : original,
+                                        std::memory_order_release);
+  return {};
+}
+
+auto SyscallHook::SetHandler(std::string_view name, std::uintptr_t handler)
+    -> std::expected<void, Error>
+{
+  const auto number = Number(name);
+  if (not number) { return std::unexpected(number.error()); }
+  return SetHandler(*number, handler);
+}
+
+auto SyscallHook::Number(std::string_view name) const
+    -> std::expected<std::uint32_t, Error>
+{
+  const auto it = std::ranges::find(syscalls_, name, &Syscall::name);
+  if (it == syscalls_.end()) { return std::unexpected(Error::NotFound); }
+  return it->number;
+}
+
+auto SyscallHook::Original(std::uint32_t number) const -> std::uintptr_t
+{
+  if (not std::ranges::binary_search(syscalls_, number, {}, &Syscall::number))
+  {
+    return 0;
+  }
+  return originals_[number & kIndexMask];
+}
+
+auto SyscallHook::_slot(std::uint32_t number) const -> std::uintptr_t*
+{
+  return detail::align_up(dispatch_->data<std::uintptr_t*>(),
+                          alignof(std::uintptr_t)) +
+         (number & kIndexMask);
+}
+
+}  // namespace VeilHook
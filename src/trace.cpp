@@ -0,0 +1,152 @@
+#include "VeilHook/trace.hpp"
+#include "VeilHook/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace VeilHook
+{
+
+struct Tracer::Slot
+{
+  TraceEvent event;
+  std::atomic<bool> ready{false};
+};
+
+auto Tracer::Get() -> Tracer&
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer() : epoch_(std::chrono::steady_clock::now()) {}
+
+Tracer::~Tracer() = default;
+
+void Tracer::Enable(std::size_t capacity)
+{
+  enabled_.store(false);
+  slots_ = std::make_unique<Slot[]>(capacity);
+  capacity_ = capacity;
+  next_.store(0);
+  epoch_ = std::chrono::steady_clock::now();
+  enabled_.store(true);
+}
+
+void Tracer::Disable()
+{
+  enabled_.store(false);
+}
+
+auto Tracer::Events() const -> std::vector<TraceEvent>
+{
+  std::vector<TraceEvent> events;
+  const auto claimed = std::min(next_.load(std::memory_order_acquire),
+                                capacity_);
+  events.reserve(claimed);
+  for (std::size_t i = 0; i < claimed; ++i)
+  {
+    if (slots_[i].ready.load(std::memory_order_acquire))
+    {
+      events.push_back(slots_[i].event);
+    }
+  }
+  return events;
+}
+
+auto Tracer::dropped() const -> std::size_t
+{
+  const auto claimed = next_.load(std::memory_order_relaxed);
+  return claimed > capacity_ ? claimed - capacity_ : 0;
+}
+
+void Tracer::Record(TraceEvent event)
+{
+  const auto index = next_.fetch_add(1, std::memory_order_relaxed);
+  if (index >= capacity_) { return; }
+  event.thread = Impl::thread_id();
+  slots_[index].event = event;
+  slots_[index].ready.store(true, std::memory_order_release);
+}
+
+auto Tracer::now() const -> std::uint64_t
+{
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - epoch_)
+          .count());
+}
+
+auto Tracer::ToChromeTrace(const std::vector<TraceEvent>& events)
+    -> std::string
+{
+  const auto pid = Impl::process_id();
+  std::ostringstream out;
+  // Timestamps are in microseconds.
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  for (std::size_t i = 0; i < events.size(); ++i)
+  {
+    const auto& event = events[i];
+    out << (i == 0 ? "" : ",") << "{\"name\":\"" << to_string(event.phase)
+        << "\",\"cat\":\"VeilHook\",\"ph\":\"X\",\"ts\":"
+        << static_cast<double>(event.start_ns) / 1e3
+        << ",\"dur\":" << static_cast<double>(event.duration_ns) / 1e3
+        << ",\"pid\":" << pid << ",\"tid\":" << event.thread
+        << ",\"args\":{\"target\":\"0x" << std::hex << event.target
+        << std::dec << "\",\"result\":\"" << to_string(event.result)
+        << "\",\"count\":" << event.count << "}}";
+  }
+  out << "],\"displayTimeUnit\":\"ns\"}";
+  return std::move(out).str();
+}
+
+auto Tracer::WriteChromeTrace(const std::filesystem::path& path) const
+    -> std::expected<void, Error>
+{
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  if (not out) { return std::unexpected(Error::Io); }
+  out << ToChromeTrace(Events());
+  if (not out) { return std::unexpected(Error::Io); }
+  return {};
+}
+
+auto to_string(TracePhase phase) -> const char*
+{
+  constexpr std::array kNames{"decode", "allocate", "emit",
+                              "protect", "write", "veh"};
+  const auto index = static_cast<std::size_t>(phase);
+  return index < kNames.size() ? kNames[index] : "unknown";
+}
+
+auto to_string(Error error) -> const char*
+{
+  constexpr std::array kNames{"Success",
+                              "Allocate",
+                              "Protect",
+                              "Query",
+                              "BadAllocation",
+                              "FailedDecodeInstruction",
+                              "UnsupportedInstruction",
+                              "NotEnoughSpace",
+                              "IpRelativeInstructionOutOfRange",
+                              "Io",
+                              "NotFound",
+                              "InvalidPattern",
+                              "InvalidArgument"};
+  const auto index = static_cast<std::size_t>(error);
+  return index < kNames.size() ? kNames[index] : "Unknown";
+}
+
+namespace Impl
+{
+auto trace_vm_queries() -> std::uint32_t&
+{
+  thread_local std::uint32_t queries = 0;
+  return queries;
+}
+}  // namespace Impl
+
+}  // namespace VeilHook
@@ -1,27 +1,172 @@
+#include <VeilHook/trace.hpp>
 #include <VeilHook/utility.hpp>
+#include <Psapi.h>
+#include <TlHelp32.h>
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <mutex>
+#include <string>
 
-namespace std
+namespace VeilHook::Impl
+{
+
+namespace
+{
+auto entry_less(const VehEntry& lhs, const VehEntry& rhs) -> bool
+{
+  return lhs.start_address < rhs.start_address ||
+         (lhs.start_address == rhs.start_address &&
+          lhs.end_address < rhs.end_address);
+}
+
+auto entry_equal(const VehEntry& lhs, const VehEntry& rhs) -> bool
+{
+  return lhs.start_address == rhs.start_address &&
+         lhs.end_address == rhs.end_address;
+}
+
+// Both tables' entries, then both tables' running maxima, in one mapping.
+constexpr std::size_t kVehTables = 2;
+constexpr std::size_t kVehStorage =
+    kVehTables * VehManager::kCapacity *
+    (sizeof(VehEntry) + sizeof(std::uintptr_t));
+
+auto veh_entries(void* storage, std::size_t table) -> std::span<VehEntry>
 {
-template <>
-struct hash<VeilHook::Impl::VehEntry>
+  return {static_cast<VehEntry*>(storage) + (table * VehManager::kCapacity),
+          VehManager::kCapacity};
+}
+
+auto veh_max_end(void* storage, std::size_t table)
+    -> std::span<std::uintptr_t>
 {
-  auto operator()(const VeilHook::Impl::VehEntry& entry) const
-      -> std::size_t
+  auto* base = detail::address_cast<std::uintptr_t*>(
+      detail::address_cast(storage) +
+      (kVehTables * VehManager::kCapacity * sizeof(VehEntry)));
+  return {base + (table * VehManager::kCapacity), VehManager::kCapacity};
+}
+
+// FNV-1a, only used to fold module identities into 64 bits.
+auto fnv1a(std::uint64_t hash, const void* data, std::size_t size)
+    -> std::uint64_t
+{
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  for (std::size_t i = 0; i < size; ++i)
   {
-    return std::hash<std::uintptr_t>{}(entry.start_address) ^
-           (std::hash<std::uintptr_t>{}(entry.end_address) << 1);
+    hash = (hash ^ bytes[i]) * 0x100'0000'01B3;
   }
+  return hash;
+}
+constexpr std::uint64_t kFnvBasis = 0xCBF2'9CE4'8422'2325;
+
+auto nt_headers(std::uintptr_t base) -> const IMAGE_NT_HEADERS*
+{
+  const auto* dos = detail::address_cast<const IMAGE_DOS_HEADER*>(base);
+  if (dos->e_magic != IMAGE_DOS_SIGNATURE) { return nullptr; }
+  const auto* nt =
+      detail::address_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+  return nt->Signature == IMAGE_NT_SIGNATURE ? nt : nullptr;
+}
+
+auto narrow_lower(std::wstring_view text) -> std::string
+{
+  std::string result;
+  result.reserve(text.size());
+  for (const auto c : text)
+  {
+    if (c >= L'A' && c <= L'Z')
+    {
+      result.push_back(static_cast<char>(c - L'A' + 'a'));
+    }
+    else { result.push_back(c < 0x80 ? static_cast<char>(c) : '?'); }
+  }
+  return result;
+}
+
+// ntdll's loader notifications, documented but absent from the SDK headers.
+struct LdrUnicodeString
+{
+  USHORT Length;  // in bytes
+  USHORT MaximumLength;
+  PWSTR Buffer;
+};
+struct LdrDllNotificationData
+{
+  ULONG Flags;
+  const LdrUnicodeString* FullDllName;
+  const LdrUnicodeString* BaseDllName;
+  PVOID DllBase;
+  ULONG SizeOfImage;
 };
-}  // namespace std
+using LdrDllNotification = void(VH_STDCALL*)(ULONG reason,
+                                             const LdrDllNotificationData* data,
+                                             PVOID context);
+using LdrRegisterDllNotification = NTSTATUS(VH_STDCALL*)(
+    ULONG flags, LdrDllNotification callback, PVOID context, PVOID* cookie);
+using LdrUnregisterDllNotification = NTSTATUS(VH_STDCALL*)(PVOID cookie);
+constexpr ULONG kLdrDllLoaded = 1;
+constexpr ULONG kLdrDllUnloaded = 2;
 
-namespace VeilHook::Impl
+struct ModuleWatch
+{
+  ModuleCallback callback;
+  void* context;
+  PVOID cookie;
+};
+
+void VH_STDCALL on_dll_notification(ULONG reason,
+                                    const LdrDllNotificationData* data,
+                                    PVOID context)
 {
+  const auto* watch = static_cast<const ModuleWatch*>(context);
+  if (reason != kLdrDllLoaded && reason != kLdrDllUnloaded) { return; }
+  const auto* name = data->BaseDllName;
+  watch->callback(
+      reason == kLdrDllLoaded ? ModuleEvent::Loaded : ModuleEvent::Unloaded,
+      detail::address_cast<std::uintptr_t>(data->DllBase),
+      narrow_lower({name->Buffer, name->Length / sizeof(WCHAR)}),
+      watch->context);
+}
+
+template <typename T>
+auto ntdll_export(const char* name) -> T
+{
+  return detail::address_cast<T>(
+      GetProcAddress(GetModuleHandleW(L"ntdll.dll"), name));
+}
+
+struct FileHandle
+{
+  HANDLE handle;
+  ~FileHandle()
+  {
+    if (handle != nullptr && handle != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(handle);
+    }
+  }
+};
+}  // namespace
 
 void* VehManager::handle_ = nullptr;
+void* VehManager::storage_ = nullptr;
 std::mutex VehManager::mutex_;
-std::unordered_set<VehEntry> VehManager::entries_;
+std::atomic<const VehTable*> VehManager::table_{nullptr};
+std::array<VehTable, 2> VehManager::tables_{};
+
+auto VehTable::find(std::uintptr_t address) const -> const VehEntry*
+{
+  // Only entries starting at or before `address` can contain it.
+  const auto it =
+      std::ranges::upper_bound(entries, address, {}, &VehEntry::start_address);
+  for (auto i = static_cast<std::size_t>(it - entries.begin()); i-- > 0;)
+  {
+    if (max_end[i] < address) { break; }
+    if (entries[i].end_address >= address) { return &entries[i]; }
+  }
+  return nullptr;
+}
 
 auto VehManager::instance() -> VehManager&
 {
@@ -33,6 +178,10 @@ VehManager::VehManager()
 {
   std::scoped_lock lock(VehManager::mutex_);
   if (handle_ != nullptr) { return; }
+  if (auto storage = vm_alloc(0, kVehStorage, VM_ACCESS_RW))
+  {
+    storage_ = detail::address_cast<void*>(*storage);
+  }
   handle_ = AddVectoredExceptionHandler(1, _handler);
 }
 
@@ -41,29 +190,141 @@ VehManager::~VehManager()
   std::scoped_lock lock(VehManager::mutex_);
   if (handle_ == nullptr) { return; }
   RemoveVectoredExceptionHandler(handle_);
+  handle_ = nullptr;
+  table_ = nullptr;
+  if (storage_ != nullptr)
+  {
+    vm_free(detail::address_cast(storage_));
+    storage_ = nullptr;
+  }
+}
+
+auto VehManager::_published() -> std::span<const VehEntry>
+{
+  const auto* table = table_.load();
+  return table != nullptr ? std::span<const VehEntry>{table->entries}
+                          : std::span<const VehEntry>{};
 }
 
-void VehManager::Register(std::uintptr_t start_address,
+auto VehManager::_spare() -> VehTable&
+{
+  auto& spare = table_.load() == tables_.data() ? tables_[1] : tables_[0];
+  // Handlers still inside it loaded it before the last publish and are on
+  // their way out; later ones see it is not published and back off.
+  while (spare.readers.load() != 0) { std::this_thread::yield(); }
+  if (storage_ == nullptr) { return spare; }
+  const auto index = static_cast<std::size_t>(&spare - tables_.data());
+  spare.entries = veh_entries(storage_, index);
+  spare.max_end = veh_max_end(storage_, index);
+  return spare;
+}
+
+void VehManager::_publish(VehTable& table, std::size_t size)
+{
+  table.entries = table.entries.first(size);
+  table.max_end = table.max_end.first(size);
+  std::uintptr_t max_end = 0;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    max_end = std::max(max_end, table.entries[i].end_address);
+    table.max_end[i] = max_end;
+  }
+  table_.store(&table);
+}
+
+auto VehManager::Register(std::uintptr_t start_address,
                           std::uintptr_t end_address,
-                          VehEntry::Callback callback)
+                          VehEntry::Callback callback, std::uintptr_t context)
+    -> bool
+{
+  std::scoped_lock lock(mutex_);
+  const VehEntry entry{.start_address = start_address,
+                       .end_address = end_address,
+                       .callback = callback,
+                       .context = context};
+  const auto current = _published();
+  const auto it = std::ranges::lower_bound(current, entry, entry_less);
+  if (it != current.end() && entry_equal(*it, entry)) { return true; }
+  auto& spare = _spare();
+  if (current.size() + 1 > spare.entries.size()) { return false; }
+  auto out = std::ranges::copy(current.begin(), it, spare.entries.begin()).out;
+  *out++ = entry;
+  std::ranges::copy(it, current.end(), out);
+  _publish(spare, current.size() + 1);
+  return true;
+}
+
+auto VehManager::Register(std::span<const VehEntry> entries) -> bool
 {
+  if (entries.empty()) { return true; }
   std::scoped_lock lock(mutex_);
-  VehEntry entry{.start_address = start_address,
-                 .end_address = end_address,
-                 .callback = std::move(callback)};
-  entries_.emplace(std::move(entry));
+  const auto current = _published();
+  auto& spare = _spare();
+  if (current.size() + entries.size() > spare.entries.size()) { return false; }
+
+  // Sort the new entries at the far end of the spare table and merge both
+  // runs forward into it: the write position never passes the read one.
+  const auto incoming = spare.entries.last(entries.size());
+  std::ranges::copy(entries, incoming.begin());
+  std::ranges::sort(incoming, entry_less);
+  std::size_t size = 0;
+  const auto append = [&](const VehEntry& entry)
+  {
+    if (size != 0 && entry_equal(spare.entries[size - 1], entry)) { return; }
+    spare.entries[size++] = entry;
+  };
+  auto old_it = current.begin();
+  auto new_it = incoming.begin();
+  while (old_it != current.end() || new_it != incoming.end())
+  {
+    // Already registered entries win over duplicates.
+    if (new_it == incoming.end() ||
+        (old_it != current.end() && not entry_less(*new_it, *old_it)))
+    {
+      append(*old_it++);
+    }
+    else { append(*new_it++); }
+  }
+  _publish(spare, size);
+  return true;
 }
+
 void VehManager::Unregister(std::uintptr_t address)
 {
   std::scoped_lock lock(mutex_);
-  auto it = std::ranges::find_if(entries_, [&](const VehEntry& entry)
-                                 { return entry.start_address == address; });
-  if (it != entries_.end()) { entries_.erase(it); }
+  const auto current = _published();
+  const auto it = std::ranges::lower_bound(current, address, {},
+                                           &VehEntry::start_address);
+  if (it == current.end() || it->start_address != address) { return; }
+  auto& spare = _spare();
+  auto out = std::ranges::copy(current.begin(), it, spare.entries.begin()).out;
+  std::ranges::copy(it + 1, current.end(), out);
+  _publish(spare, current.size() - 1);
+}
+
+void VehManager::Unregister(std::span<const std::uintptr_t> addresses)
+{
+  if (addresses.empty()) { return; }
+  std::scoped_lock lock(mutex_);
+  std::vector<std::uintptr_t> sorted{addresses.begin(), addresses.end()};
+  std::ranges::sort(sorted);
+  const auto current = _published();
+  auto& spare = _spare();
+  const auto kept = std::ranges::copy_if(
+      current, spare.entries.begin(),
+      [&](const VehEntry& entry)
+      { return not std::ranges::binary_search(sorted, entry.start_address); });
+  _publish(spare,
+           static_cast<std::size_t>(kept.out - spare.entries.begin()));
 }
 
 auto VehManager::_handler(PEXCEPTION_POINTERS info) -> LONG
 {
-  std::scoped_lock<std::mutex> lock(VehManager::mutex_);
+  return Dispatch(info);
+}
+
+auto VehManager::Dispatch(PEXCEPTION_POINTERS info) -> LONG
+{
   DWORD code = info->ExceptionRecord->ExceptionCode;
 #if defined(VH_ARCH_X86_64)
   std::uintptr_t ip = info->ContextRecord->Rip;
@@ -79,14 +340,25 @@ auto VehManager::_handler(PEXCEPTION_POINTERS info) -> LONG
     case EXCEPTION_BREAKPOINT:
     case EXCEPTION_SINGLE_STEP:
     {
-      for (const auto& entry : entries_)
+      // Pin the snapshot, then check it is still the published one: writers
+      // only refill a table nobody has pinned.
+      const auto* table = table_.load();
+      while (table != nullptr)
       {
-        if ((entry.start_address <= ip) && (entry.end_address >= ip))
-        {
-          return entry.callback(info);
-        }
+        table->readers.fetch_add(1);
+        const auto* current = table_.load();
+        if (current == table) { break; }
+        table->readers.fetch_sub(1);
+        table = current;
       }
-      break;
+      if (table == nullptr) { return EXCEPTION_CONTINUE_SEARCH; }
+      LONG result = EXCEPTION_CONTINUE_SEARCH;
+      if (const auto* entry = table->find(ip); entry != nullptr)
+      {
+        result = entry->callback(info, *entry);
+      }
+      table->readers.fetch_sub(1);
+      return result;
     }
     default: break;
   }
@@ -94,6 +366,78 @@ auto VehManager::_handler(PEXCEPTION_POINTERS info) -> LONG
   return EXCEPTION_CONTINUE_SEARCH;
 }
 
+auto patch_access(std::uintptr_t target) -> VMAccess
+{
+  MEMORY_BASIC_INFORMATION self{};
+  MEMORY_BASIC_INFORMATION patched{};
+  VirtualQuery(detail::address_cast<void*>(&patch_access), &self,
+               sizeof(self));
+  VirtualQuery(detail::address_cast<void*>(target), &patched,
+               sizeof(patched));
+  if (self.AllocationBase == patched.AllocationBase) { return VM_ACCESS_RWX; }
+
+  const auto si = get_system_info();
+  const auto page_start = detail::align_down(target, si.page_size);
+  const auto page_end = detail::align_up(target, si.page_size);
+  const auto vp_start = detail::address_cast(&VirtualProtect);
+  const auto vp_end = vp_start + 0x20;
+  if (page_end >= vp_start && vp_end >= page_start) { return VM_ACCESS_RWX; }
+  return VM_ACCESS_RW;
+}
+
+auto prologue_guard(PEXCEPTION_POINTERS info, const VehEntry& entry) -> LONG
+{
+#if defined(VH_ARCH_X86_64)
+  auto& ip = info->ContextRecord->Rip;
+#elif defined(VH_ARCH_X86_32)
+  auto& ip = info->ContextRecord->Eip;
+#endif
+  if (ip != entry.start_address + 1) { return EXCEPTION_CONTINUE_SEARCH; }
+  ip = entry.start_address;
+  return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+auto call_guard(PEXCEPTION_POINTERS info, const VehEntry& entry) -> LONG
+{
+  if (info->ExceptionRecord->ExceptionCode != EXCEPTION_BREAKPOINT)
+  {
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
+#if defined(VH_ARCH_X86_64)
+  auto& ip = info->ContextRecord->Rip;
+  auto& sp = info->ContextRecord->Rsp;
+#elif defined(VH_ARCH_X86_32)
+  auto& ip = info->ContextRecord->Eip;
+  auto& sp = info->ContextRecord->Esp;
+#endif
+  const auto site = entry.start_address;
+  // Windows reports the int3 itself; the trap leaves ip one byte past it.
+  if (ip != site && ip != site + 1) { return EXCEPTION_CONTINUE_SEARCH; }
+  sp -= sizeof(std::uintptr_t);
+  detail::store<std::uintptr_t>(sp, site + 5);
+  ip = entry.context;
+  return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+auto protect_pages(
+    std::span<const std::pair<std::uintptr_t, std::uintptr_t>> ranges)
+    -> std::deque<VMProtect>
+{
+  const auto page = get_system_info().page_size;
+  std::deque<VMProtect> protects;
+  for (std::size_t i = 0; i < ranges.size();)
+  {
+    const auto first = detail::align_down(ranges[i].first, page);
+    auto last = detail::align_up(ranges[i].second, page);
+    for (++i; i < ranges.size() && ranges[i].first < last; ++i)
+    {
+      last = std::max(last, detail::align_up(ranges[i].second, page));
+    }
+    protects.emplace_back(first, last - first, VM_ACCESS_RWX);
+  }
+  return protects;
+}
+
 auto get_system_info() -> SystemInfo
 {
   SYSTEM_INFO info;
@@ -125,12 +469,18 @@ auto vm_free(std::uintptr_t address) -> void
 auto vm_protect(std::uintptr_t address, std::size_t size, VMAccess access,
                 VMAccess& old_access) -> bool
 {
-  return static_cast<bool>(VirtualProtect(detail::address_cast<LPVOID>(address),
-                                          size, access, &old_access));
+  VH_TRACE_SCOPE(trace, Protect, address);
+  const auto ok = static_cast<bool>(VirtualProtect(
+      detail::address_cast<LPVOID>(address), size, access, &old_access));
+  if (not ok) { trace.fail(Error::Protect); }
+  return ok;
 }
 
 auto vm_query(std::uintptr_t address) -> std::expected<VMInfo, Error>
 {
+#if defined(VEIL_HOOK_TRACING)
+  ++trace_vm_queries();
+#endif
   MEMORY_BASIC_INFORMATION mbi;
   if (VirtualQuery(detail::address_cast<LPVOID>(address), &mbi, sizeof(mbi)) ==
       0)
@@ -148,4 +498,469 @@ auto vm_query(std::uintptr_t address) -> std::expected<VMInfo, Error>
   return ret;
 }
 
-}  // namespace VeilHook::Impl
\ No newline at end of file
+auto module_query(std::uintptr_t address) -> std::expected<ModuleInfo, Error>
+{
+  MEMORY_BASIC_INFORMATION mbi;
+  if (VirtualQuery(detail::address_cast<LPVOID>(address), &mbi, sizeof(mbi)) ==
+          0 ||
+      mbi.Type != MEM_IMAGE)
+  {
+    return std::unexpected{Error::Query};
+  }
+
+  const auto base = detail::address_cast<std::uintptr_t>(mbi.AllocationBase);
+  const auto* nt = nt_headers(base);
+  if (nt == nullptr) { return std::unexpected{Error::Query}; }
+
+  const auto& optional = nt->OptionalHeader;
+  const std::array<DWORD, 3> fallback{nt->FileHeader.TimeDateStamp,
+                                      optional.SizeOfImage, optional.CheckSum};
+  auto build_id = fnv1a(kFnvBasis, fallback.data(), sizeof(fallback));
+
+  // Prefer the PDB signature (RSDS, GUID, age): it changes with every link.
+  const auto& debug = optional.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+  const auto* entries =
+      detail::address_cast<const IMAGE_DEBUG_DIRECTORY*>(base + debug.VirtualAddress);
+  const auto count = debug.VirtualAddress != 0
+                         ? debug.Size / sizeof(IMAGE_DEBUG_DIRECTORY)
+                         : 0;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    constexpr DWORD kRsds = 0x5344'5352;
+    constexpr std::size_t kSignatureSize = sizeof(DWORD) + 16 + sizeof(DWORD);
+    const auto& entry = entries[i];
+    if (entry.Type != IMAGE_DEBUG_TYPE_CODEVIEW ||
+        entry.AddressOfRawData == 0 || entry.SizeOfData < kSignatureSize)
+    {
+      continue;
+    }
+    const auto* codeview =
+        detail::address_cast<const std::uint8_t*>(base + entry.AddressOfRawData);
+    DWORD magic = 0;
+    std::memcpy(&magic, codeview, sizeof(magic));
+    if (magic != kRsds) { continue; }
+    build_id = fnv1a(build_id, codeview + sizeof(DWORD),
+                     kSignatureSize - sizeof(DWORD));
+    break;
+  }
+
+  return ModuleInfo{.base = base,
+                    .size = optional.SizeOfImage,
+                    .build_id = build_id};
+}
+
+auto module_find(std::string_view name) -> std::expected<std::uintptr_t, Error>
+{
+  const std::string terminated{name};
+  auto* module =
+      GetModuleHandleA(name.empty() ? nullptr : terminated.c_str());
+  if (module == nullptr) { return std::unexpected{Error::NotFound}; }
+  return detail::address_cast<std::uintptr_t>(module);
+}
+
+auto module_sections(std::uintptr_t base)
+    -> std::expected<std::vector<SectionInfo>, Error>
+{
+  const auto* nt = nt_headers(base);
+  if (nt == nullptr) { return std::unexpected{Error::Query}; }
+
+  std::vector<SectionInfo> sections;
+  const auto* section = IMAGE_FIRST_SECTION(nt);
+  for (WORD i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section)
+  {
+    sections.push_back(
+        {.address = base + section->VirtualAddress,
+         .size = section->Misc.VirtualSize,
+         .executable = (section->Characteristics & IMAGE_SCN_MEM_EXECUTE) != 0});
+  }
+  return sections;
+}
+
+auto module_list() -> std::vector<std::uintptr_t>
+{
+  std::vector<HMODULE> modules(256);
+  for (;;)
+  {
+    DWORD needed = 0;
+    const auto capacity = static_cast<DWORD>(modules.size() * sizeof(HMODULE));
+    if (EnumProcessModules(GetCurrentProcess(), modules.data(), capacity,
+                           &needed) == 0)
+    {
+      return {};
+    }
+    if (needed <= capacity)
+    {
+      modules.resize(needed / sizeof(HMODULE));
+      break;
+    }
+    modules.resize(needed / sizeof(HMODULE));
+  }
+
+  std::vector<std::uintptr_t> bases;
+  bases.reserve(modules.size());
+  for (auto* module : modules)
+  {
+    bases.push_back(detail::address_cast<std::uintptr_t>(module));
+  }
+  return bases;
+}
+
+auto module_name(std::uintptr_t base) -> std::string
+{
+  std::array<WCHAR, MAX_PATH> path{};
+  const auto length =
+      GetModuleFileNameW(detail::address_cast<HMODULE>(base), path.data(),
+                         static_cast<DWORD>(path.size()));
+  const std::wstring_view full{path.data(), length};
+  const auto slash = full.find_last_of(L"\\/");
+  const auto file =
+      slash == std::wstring_view::npos ? full : full.substr(slash + 1);
+
+  return narrow_lower(file);
+}
+
+auto module_exports(std::uintptr_t base)
+    -> std::expected<std::vector<ExportInfo>, Error>
+{
+  const auto* nt = nt_headers(base);
+  if (nt == nullptr) { return std::unexpected{Error::Query}; }
+  const auto& directory =
+      nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+  std::vector<ExportInfo> exports;
+  if (directory.VirtualAddress == 0 || directory.Size == 0) { return exports; }
+
+  const auto* table = detail::address_cast<const IMAGE_EXPORT_DIRECTORY*>(
+      base + directory.VirtualAddress);
+  const auto* names =
+      detail::address_cast<const DWORD*>(base + table->AddressOfNames);
+  const auto* ordinals =
+      detail::address_cast<const WORD*>(base + table->AddressOfNameOrdinals);
+  const auto* functions =
+      detail::address_cast<const DWORD*>(base + table->AddressOfFunctions);
+
+  exports.reserve(table->NumberOfNames);
+  for (DWORD i = 0; i < table->NumberOfNames; ++i)
+  {
+    const auto* name = detail::address_cast<const char*>(base + names[i]);
+    if (ordinals[i] >= table->NumberOfFunctions) { continue; }
+    const auto rva = functions[ordinals[i]];
+    auto address = base + rva;
+    // An RVA inside the export directory is a "module.function" forwarder;
+    // the loader knows how to follow those, including API sets.
+    if (rva >= directory.VirtualAddress &&
+        rva < directory.VirtualAddress + directory.Size)
+    {
+      address = detail::address_cast<std::uintptr_t>(
+          GetProcAddress(detail::address_cast<HMODULE>(base), name));
+      if (address == 0) { continue; }
+    }
+    exports.push_back({.name = name, .address = address});
+  }
+  return exports;
+}
+
+auto module_watch(ModuleCallback callback, void* context)
+    -> std::expected<void*, Error>
+{
+  const auto register_notification =
+      ntdll_export<LdrRegisterDllNotification>("LdrRegisterDllNotification");
+  if (register_notification == nullptr)
+  {
+    return std::unexpected{Error::NotFound};
+  }
+
+  auto watch = std::make_unique<ModuleWatch>(
+      ModuleWatch{.callback = callback, .context = context, .cookie = nullptr});
+  if (register_notification(0, on_dll_notification, watch.get(),
+                            &watch->cookie) != 0)
+  {
+    return std::unexpected{Error::Query};
+  }
+  return watch.release();
+}
+
+auto module_unwatch(void* handle) -> void
+{
+  const std::unique_ptr<ModuleWatch> watch{static_cast<ModuleWatch*>(handle)};
+  if (not watch) { return; }
+  if (const auto unregister = ntdll_export<LdrUnregisterDllNotification>(
+          "LdrUnregisterDllNotification"))
+  {
+    unregister(watch->cookie);
+  }
+}
+
+auto file_map(const std::filesystem::path& path)
+    -> std::expected<FileView, Error>
+{
+  // FILE_SHARE_DELETE lets writers rename a new version over a mapped file.
+  const FileHandle file{CreateFileW(path.c_str(), GENERIC_READ,
+                                    FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr)};
+  if (file.handle == INVALID_HANDLE_VALUE) { return std::unexpected{Error::Io}; }
+
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file.handle, &size) == 0 || size.QuadPart <= 0)
+  {
+    return std::unexpected{Error::Io};
+  }
+  const FileHandle mapping{CreateFileMappingW(file.handle, nullptr,
+                                              PAGE_READONLY, 0, 0, nullptr)};
+  if (mapping.handle == nullptr) { return std::unexpected{Error::Io}; }
+
+  // The view keeps the section alive after both handles are closed.
+  const auto* data = MapViewOfFile(mapping.handle, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) { return std::unexpected{Error::Io}; }
+
+  return FileView{.data = static_cast<const std::uint8_t*>(data),
+                  .size = static_cast<std::size_t>(size.QuadPart)};
+}
+
+auto file_unmap(FileView view) -> void
+{
+  if (view.data != nullptr) { UnmapViewOfFile(view.data); }
+}
+
+auto file_replace(const std::filesystem::path& from,
+                  const std::filesystem::path& to) -> bool
+{
+  return MoveFileExW(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+auto process_open(std::uint32_t pid) -> void*
+{
+  return OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_READ |
+                         PROCESS_VM_WRITE | PROCESS_QUERY_INFORMATION |
+                         PROCESS_SUSPEND_RESUME,
+                     FALSE, pid);
+}
+
+auto process_close(void* process) -> void { CloseHandle(process); }
+
+auto process_read(void* process, std::uintptr_t address,
+                  std::span<std::uint8_t> out) -> bool
+{
+  SIZE_T read = 0;
+  return ReadProcessMemory(process, detail::address_cast<LPCVOID>(address),
+                           out.data(), out.size(), &read) != FALSE &&
+         read == out.size();
+}
+
+auto process_write(void* process, std::uintptr_t address,
+                   std::span<const std::uint8_t> data) -> bool
+{
+  VH_TRACE_SCOPE(trace, Write, address);
+  SIZE_T written = 0;
+  const auto ok =
+      WriteProcessMemory(process, detail::address_cast<LPVOID>(address),
+                         data.data(), data.size(), &written) != FALSE &&
+      written == data.size();
+  if (not ok) { trace.fail(Error::Io); }
+  return ok;
+}
+
+auto process_alloc(void* process, std::uintptr_t address, std::size_t size,
+                   VMAccess access) -> std::expected<std::uintptr_t, Error>
+{
+  auto* result =
+      VirtualAllocEx(process, detail::address_cast<LPVOID>(address), size,
+                     MEM_COMMIT | MEM_RESERVE, access);
+  if (result == nullptr) { return std::unexpected{Error::Allocate}; }
+  return detail::address_cast<std::uintptr_t>(result);
+}
+
+auto process_protect(void* process, std::uintptr_t address, std::size_t size,
+                     VMAccess access, VMAccess& old_access) -> bool
+{
+  VH_TRACE_SCOPE(trace, Protect, address);
+  const auto ok = static_cast<bool>(
+      VirtualProtectEx(process, detail::address_cast<LPVOID>(address), size,
+                       access, &old_access));
+  if (not ok) { trace.fail(Error::Protect); }
+  return ok;
+}
+
+auto process_query(void* process, std::uintptr_t address)
+    -> std::expected<VMInfo, Error>
+{
+  MEMORY_BASIC_INFORMATION mbi;
+  if (VirtualQueryEx(process, detail::address_cast<LPCVOID>(address), &mbi,
+                     sizeof(mbi)) == 0)
+  {
+    return std::unexpected{Error::Query};
+  }
+  return VMInfo{
+      .address = detail::address_cast<std::uintptr_t>(mbi.BaseAddress),
+      .size = mbi.RegionSize,
+      .access = mbi.Protect,
+      .free = mbi.State == MEM_FREE,
+  };
+}
+
+auto process_suspend(void* process) -> bool
+{
+  using NtSuspendProcess = NTSTATUS(VH_STDCALL*)(HANDLE process);
+  static const auto suspend =
+      ntdll_export<NtSuspendProcess>("NtSuspendProcess");
+  return suspend != nullptr && suspend(process) >= 0;
+}
+
+auto process_resume(void* process) -> void
+{
+  using NtResumeProcess = NTSTATUS(VH_STDCALL*)(HANDLE process);
+  static const auto resume = ntdll_export<NtResumeProcess>("NtResumeProcess");
+  if (resume != nullptr) { resume(process); }
+}
+
+auto process_flush(void* process, std::uintptr_t address, std::size_t size)
+    -> void
+{
+  FlushInstructionCache(process, detail::address_cast<LPCVOID>(address),
+                        size);
+}
+
+auto process_move_threads(std::uint32_t pid, IpMove move, void* context)
+    -> bool
+{
+  const FileHandle snapshot{CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0)};
+  if (snapshot.handle == INVALID_HANDLE_VALUE) { return false; }
+  THREADENTRY32 entry{};
+  entry.dwSize = sizeof(entry);
+  for (auto more = Thread32First(snapshot.handle, &entry); more != FALSE;
+       more = Thread32Next(snapshot.handle, &entry))
+  {
+    if (entry.th32OwnerProcessID != pid) { continue; }
+    const FileHandle thread{OpenThread(
+        THREAD_GET_CONTEXT | THREAD_SET_CONTEXT, FALSE, entry.th32ThreadID)};
+    if (thread.handle == nullptr) { continue; }
+    alignas(16) CONTEXT state{};
+    state.ContextFlags = CONTEXT_CONTROL;
+    if (GetThreadContext(thread.handle, &state) == FALSE) { continue; }
+#if defined(VH_ARCH_X86_64)
+    auto& ip = state.Rip;
+#else
+    auto& ip = state.Eip;
+#endif
+    const auto target = move(ip, context);
+    if (target == ip) { continue; }
+    ip = static_cast<std::remove_reference_t<decltype(ip)>>(target);
+    SetThreadContext(thread.handle, &state);
+  }
+  return true;
+}
+
+auto process_id() -> std::uint32_t { return GetCurrentProcessId(); }
+
+auto thread_id() -> std::uint32_t { return GetCurrentThreadId(); }
+
+auto flush_write_buffers() -> void { FlushProcessWriteBuffers(); }
+
+auto visit_threads(std::uintptr_t stack, ThreadVisitor visit, void* context)
+    -> bool
+{
+  const FileHandle snapshot{CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0)};
+  if (snapshot.handle == INVALID_HANDLE_VALUE) { return false; }
+
+  // The committed stack of `sp`'s region, from `sp` up.
+  const auto stack_from = [](std::uintptr_t sp)
+  {
+    const auto region = vm_query(sp);
+    if (not region || region->free)
+    {
+      return std::span<const std::uintptr_t>{};
+    }
+    const auto begin = detail::align_up(sp, sizeof(std::uintptr_t));
+    const auto end = region->address + region->size;
+    return std::span{detail::address_cast<const std::uintptr_t*>(begin),
+                     (end - begin) / sizeof(std::uintptr_t)};
+  };
+
+  ULONG_PTR low = 0;
+  ULONG_PTR high = 0;
+  GetCurrentThreadStackLimits(&low, &high);
+  if (stack >= low && stack < high)
+  {
+    const auto begin = detail::align_up(stack, sizeof(std::uintptr_t));
+    visit({.ip = 0,
+           .stack = {detail::address_cast<const std::uintptr_t*>(begin),
+                     (high - begin) / sizeof(std::uintptr_t)}},
+          context);
+  }
+
+  const auto process = GetCurrentProcessId();
+  const auto self = GetCurrentThreadId();
+  THREADENTRY32 entry{};
+  entry.dwSize = sizeof(entry);
+  for (auto more = Thread32First(snapshot.handle, &entry); more != FALSE;
+       more = Thread32Next(snapshot.handle, &entry))
+  {
+    if (entry.th32OwnerProcessID != process || entry.th32ThreadID == self)
+    {
+      continue;
+    }
+    const FileHandle thread{OpenThread(THREAD_SUSPEND_RESUME |
+                                           THREAD_GET_CONTEXT |
+                                           THREAD_QUERY_INFORMATION,
+                                       FALSE, entry.th32ThreadID)};
+    // Exited since the snapshot.
+    if (thread.handle == nullptr) { continue; }
+    if (SuspendThread(thread.handle) == static_cast<DWORD>(-1)) { continue; }
+
+    // GetThreadContext also waits for the suspension to take effect.
+    alignas(16) CONTEXT state{};
+    state.ContextFlags = CONTEXT_CONTROL;
+    if (GetThreadContext(thread.handle, &state) != FALSE)
+    {
+#if defined(VH_ARCH_X86_64)
+      visit({.ip = state.Rip, .stack = stack_from(state.Rsp)}, context);
+#else
+      visit({.ip = state.Eip, .stack = stack_from(state.Esp)}, context);
+#endif
+    }
+    ResumeThread(thread.handle);
+  }
+  return true;
+}
+
+auto function_entry(std::uintptr_t address)
+    -> std::expected<FunctionEntry, Error>
+{
+#if defined(VH_ARCH_X86_64)
+  DWORD64 base = 0;
+  const auto* function = RtlLookupFunctionEntry(address, &base, nullptr);
+  if (function == nullptr) { return std::unexpected{Error::NotFound}; }
+  return FunctionEntry{
+      .begin = static_cast<std::uintptr_t>(base + function->BeginAddress),
+      .end = static_cast<std::uintptr_t>(base + function->EndAddress),
+      .unwind = detail::address_cast<const std::uint8_t*>(
+          base + function->UnwindData)};
+#else
+  (void)address;
+  return std::unexpected{Error::NotFound};
+#endif
+}
+
+auto function_table_add(std::uintptr_t table, std::uintptr_t base) -> bool
+{
+#if defined(VH_ARCH_X86_64)
+  return RtlAddFunctionTable(detail::address_cast<PRUNTIME_FUNCTION>(table),
+                             1, base) != FALSE;
+#else
+  (void)table;
+  (void)base;
+  return false;
+#endif
+}
+
+auto function_table_remove(std::uintptr_t table) -> void
+{
+#if defined(VH_ARCH_X86_64)
+  RtlDeleteFunctionTable(detail::address_cast<PRUNTIME_FUNCTION>(table));
+#else
+  (void)table;
+#endif
+}
+
+}  // namespace VeilHook::Impl
@@ -0,0 +1,125 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/call_site_hook.hpp>
+#include <VeilHook/utility.hpp>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+// Calls through a pointer: a direct call from here would be redirected too.
+auto (*volatile g_sum)(int, int) -> int = &sum;
+
+__declspec(noinline) auto sum_detour(int x, int y) -> int
+{
+    return g_sum(x, y) * 10;
+}
+
+// Not a tail call, so the call to `sum` stays a `call rel32`.
+__declspec(noinline) auto call_sum(int x, int y) -> int
+{
+    return sum(x, y) + 1;
+}
+
+using VeilHook::detail::address_cast;
+
+namespace
+{
+auto module_of(std::uintptr_t address) -> std::uintptr_t
+{
+  const auto module = VeilHook::Impl::module_query(address);
+  return module ? module->base : 0;
+}
+
+void put_rel32(std::vector<std::uint8_t>& code, std::size_t offset,
+               std::uintptr_t from, std::uintptr_t to)
+{
+  const auto rel = static_cast<std::int32_t>(to - from);
+  std::memcpy(code.data() + offset, &rel, sizeof(rel));
+}
+}  // namespace
+
+TEST_CASE("Call sites found by the sweep", "[CallSiteHook]")  // NOLINT
+{
+  constexpr std::uintptr_t kBase = 0x10000;
+  constexpr std::uintptr_t kTarget = kBase + 0x1000;
+  std::vector<std::uint8_t> code{
+      // mov dword [disp32], imm32 hiding E8 and a rel32 to the target
+      0xC7, 0x05, 0xE8, 0, 0, 0, 0, 0, 0, 0,
+      0xE8, 0, 0, 0, 0,  // call target
+      0xE8, 0, 0, 0, 0,  // call elsewhere
+      0xC3};
+  put_rel32(code, 3, kBase + 7, kTarget);
+  put_rel32(code, 11, kBase + 15, kTarget);
+  put_rel32(code, 16, kBase + 20, kTarget + 1);
+
+  const auto sites = VeilHook::Impl::find_call_sites(code, kBase, kTarget);
+  REQUIRE(sites.size() == 1);
+  REQUIRE(sites[0] == kBase + 10);
+}
+
+TEST_CASE("Direct callers are redirected", "[CallSiteHook]")  // NOLINT
+{
+  const auto target = address_cast<std::uintptr_t>(&sum);
+  auto hook = VeilHook::CallSiteHook::Create(
+      module_of(target), target, address_cast<std::uintptr_t>(&sum_detour));
+  REQUIRE(hook.has_value());
+  REQUIRE(not (*hook)->sites().empty());
+
+  REQUIRE((*hook)->Enable().has_value());
+  REQUIRE(call_sum(1, 2) == 31);
+  REQUIRE(g_sum(1, 2) == 3);
+
+  REQUIRE((*hook)->Disable().has_value());
+  REQUIRE(call_sum(1, 2) == 4);
+
+  REQUIRE((*hook)->Enable().has_value());
+  hook->reset();
+  REQUIRE(call_sum(1, 2) == 4);
+}
+
+TEST_CASE("Call sites flip under concurrent calls", "[CallSiteHook]")  // NOLINT
+{
+  const auto target = address_cast<std::uintptr_t>(&sum);
+  auto hook = VeilHook::CallSiteHook::Create(
+      module_of(target), target, address_cast<std::uintptr_t>(&sum_detour));
+  REQUIRE(hook.has_value());
+
+  std::atomic<bool> done{false};
+  std::atomic<bool> torn{false};
+  std::array<std::thread, 3> callers;
+  for (auto& caller : callers)
+  {
+    caller = std::thread([&]
+    {
+      while (not done)
+      {
+        const auto result = call_sum(1, 2);
+        if (result != 4 && result != 31) { torn = true; }
+      }
+    });
+  }
+  for (int i = 0; i < 1'000; ++i)
+  {
+    REQUIRE((*hook)->Enable().has_value());
+    REQUIRE((*hook)->Disable().has_value());
+  }
+  done = true;
+  for (auto& caller : callers) { caller.join(); }
+  REQUIRE(not torn);
+}
+
+TEST_CASE("Modules without callers", "[CallSiteHook]")  // NOLINT
+{
+  const auto target = address_cast<std::uintptr_t>(&sum);
+  auto hook = VeilHook::CallSiteHook::Create(
+      "ntdll.dll", target, address_cast<std::uintptr_t>(&sum_detour));
+  REQUIRE(not hook.has_value());
+  REQUIRE(hook.error() == VeilHook::Error::NotFound);
+}
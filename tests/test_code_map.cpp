@@ -0,0 +1,119 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/code_map.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto hooked_sum([[maybe_unused]] int x,
+                                     [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+__declspec(noinline) auto may_throw(int x) -> int
+{
+    if (x < 0) { throw std::runtime_error{"negative"}; }
+    return x + 1;
+}
+
+// A frame of its own (a nonvolatile register kept across calls), without an
+// exception handler.
+__declspec(noinline) auto call_twice(int x) -> int
+{
+    const int scaled = x * 3;
+    const int first = may_throw(x);
+    return scaled + first + may_throw(scaled);
+}
+
+using VeilHook::detail::address_cast;
+
+namespace
+{
+// Where the `jmp rel32` patch at `target` leads.
+auto jump_destination(std::uintptr_t target) -> std::uintptr_t
+{
+  std::int32_t rel = 0;
+  std::memcpy(&rel, address_cast<const void*>(target + 1), sizeof(rel));
+  return target + 5 +
+         static_cast<std::uintptr_t>(static_cast<std::intptr_t>(rel));
+}
+}  // namespace
+
+TEST_CASE("Trampolines are named after their target", "[CodeMap]")  // NOLINT
+{
+  auto& map = VeilHook::CodeMap::Get();
+  const auto path =
+      std::filesystem::temp_directory_path() / "veilhook_test.map";
+  REQUIRE(map.Enable({.perf_map = path}).has_value());
+
+  const auto target = address_cast<std::uintptr_t>(&sum);
+  auto hook = VeilHook::InlineHook::Create(
+      target, address_cast<std::uintptr_t>(&hooked_sum));
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(*address_cast<const std::uint8_t*>(target) == 0xE9);
+
+  const auto module = VeilHook::Impl::module_query(target);
+  REQUIRE(module.has_value());
+  std::ostringstream expected;
+  expected << "veilhook:" << VeilHook::Impl::module_name(module->base)
+           << "+0x" << std::hex << target - module->base;
+  REQUIRE(map.Find(jump_destination(target)) == expected.str());
+  REQUIRE(hook->Disable().has_value());
+  map.Disable();
+
+  std::ifstream in{path};
+  const std::string lines{std::istreambuf_iterator<char>{in}, {}};
+  REQUIRE(lines.find(" " + expected.str() + "\n") != std::string::npos);
+}
+
+TEST_CASE("Entries go with their code", "[CodeMap]")  // NOLINT
+{
+  auto& map = VeilHook::CodeMap::Get();
+  REQUIRE(map.Enable({.write_perf_map = false}).has_value());
+  static std::array<std::uint8_t, 64> code{};
+  const auto address = address_cast<std::uintptr_t>(code.data());
+  map.Add(address, code.size(), 0, "test");
+  map.Disable();
+
+  REQUIRE(map.Find(address + 63) == "veilhook:test");
+  REQUIRE(map.Find(address + 64).empty());
+  map.Remove({address, address + code.size()});
+  REQUIRE(map.Find(address).empty());
+}
+
+#if defined(VH_ARCH_X86_64)
+TEST_CASE("Exceptions unwind through clones", "[CodeMap]")  // NOLINT
+{
+  auto hook = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&call_twice),
+      address_cast<std::uintptr_t>(&hooked_sum), {.clone = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->cloned());
+  REQUIRE(hook->Enable().has_value());
+
+  REQUIRE(hook->Call<int>(1) == 3 + 2 + 4);
+  bool caught = false;
+  try
+  {
+    (void)hook->Call<int>(-1);
+  }
+  catch (const std::runtime_error&)
+  {
+    caught = true;
+  }
+  REQUIRE(caught);
+}
+#endif
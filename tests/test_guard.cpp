@@ -0,0 +1,85 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/guard.hpp>
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <atomic>
+#include <thread>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+std::atomic<int> g_entries{0};
+
+// Calls back into its own hook, which only the guard keeps from recursing.
+__declspec(noinline) auto reentrant_sum(int x, int y) -> int
+{
+    ++g_entries;
+    return sum(x, y) + 1000;
+}
+
+using VeilHook::detail::address_cast;
+
+TEST_CASE("Nested calls reach the trampoline", "[Guard]")  // NOLINT
+{
+  auto hook = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&sum),
+      address_cast<std::uintptr_t>(&reentrant_sum), {.guarded = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+
+  g_entries = 0;
+  REQUIRE(sum(1, 1) == 1002);
+  REQUIRE(g_entries == 1);
+  // The flag is cleared on the way out.
+  REQUIRE(sum(2, 2) == 1004);
+  REQUIRE(g_entries == 2);
+  REQUIRE(hook->Call<int>(1, 1) == 2);
+
+  std::thread other([] { REQUIRE(sum(3, 3) == 1006); });
+  other.join();
+  REQUIRE(g_entries == 3);
+
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(sum(1, 1) == 2);
+}
+
+TEST_CASE("ScopedBypass", "[Guard]")  // NOLINT
+{
+  auto hook = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&sum),
+      address_cast<std::uintptr_t>(&reentrant_sum), {.guarded = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+
+  {
+    const VeilHook::ScopedBypass bypass;
+    REQUIRE(sum(1, 1) == 2);
+    {
+      const VeilHook::ScopedBypass nested;
+      REQUIRE(sum(1, 1) == 2);
+    }
+    REQUIRE(sum(1, 1) == 2);
+
+    // Other threads are unaffected.
+    std::thread other([] { REQUIRE(sum(1, 1) == 1002); });
+    other.join();
+  }
+  REQUIRE(sum(1, 1) == 1002);
+}
+
+TEST_CASE("Guarded registry hooks", "[Guard]")  // NOLINT
+{
+  VeilHook::HookRegistry registry{4};
+  const auto handle =
+      registry.Add(address_cast<std::uintptr_t>(&sum),
+                   address_cast<std::uintptr_t>(&reentrant_sum),
+                   {.guarded = true});
+  REQUIRE(handle.has_value());
+  REQUIRE(registry.Enable(*handle).has_value());
+  REQUIRE(sum(1, 1) == 1002);
+  REQUIRE(registry.Remove(*handle).has_value());
+  REQUIRE(sum(1, 1) == 2);
+}
@@ -0,0 +1,64 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<std::size_t> g_allocations{0};
+}  // namespace
+
+// Counts every allocation of the test executable, the library included.
+auto operator new(std::size_t size) -> void*
+{
+  ++g_allocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) { return p; }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t /*size*/) noexcept { std::free(p); }
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto product(int x, int y) -> int
+{
+    return x * y;
+}
+
+__declspec(noinline) auto hooked([[maybe_unused]] int x,
+                                 [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+TEST_CASE("Create and Enable do not allocate", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  // The first hook maps the trampoline memory next to this module, its
+  // spare block nodes and the VEH tables.
+  auto warm = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&sum),
+      address_cast<std::uintptr_t>(&hooked));
+  REQUIRE(warm.has_value());
+  REQUIRE(warm->Enable().has_value());
+
+  const auto before = g_allocations.load();
+  auto hook = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&product),
+      address_cast<std::uintptr_t>(&hooked));
+  const auto enabled = hook.has_value() && hook->Enable().has_value();
+  const auto allocations = g_allocations.load() - before;
+
+  REQUIRE(enabled);
+  REQUIRE(allocations == 0);
+  REQUIRE(product(2, 3) == 1337);
+  REQUIRE(hook->Call<int>(2, 3) == 6);
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(product(2, 3) == 6);
+}
@@ -0,0 +1,102 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/hook_manager.hpp>
+
+namespace
+{
+using GetFileVersionInfoSizeW_t = DWORD(VH_STDCALL*)(LPCWSTR, DWORD*);
+
+auto VH_STDCALL hooked_size([[maybe_unused]] LPCWSTR file,
+                            [[maybe_unused]] DWORD* handle) -> DWORD
+{
+  return 1337;
+}
+
+auto version_size() -> DWORD
+{
+  auto* module = GetModuleHandleA("version.dll");
+  if (module == nullptr) { return 0; }
+  const auto function =
+      VeilHook::detail::address_cast<GetFileVersionInfoSizeW_t>(
+          GetProcAddress(module, "GetFileVersionInfoSizeW"));
+  DWORD handle{};
+  return function(L"kernel32.dll", &handle);
+}
+}  // namespace
+
+TEST_CASE("Invalid specs", "[HookManager]")  // NOLINT
+{
+  auto& manager = VeilHook::HookManager::Get();
+  REQUIRE(manager.Add({.module = "", .symbol = "Sleep", .destination = 1})
+              .error() == VeilHook::Error::InvalidArgument);
+  REQUIRE(manager.Add({.module = "kernel32.dll", .symbol = "Sleep"}).error() ==
+          VeilHook::Error::InvalidArgument);
+  REQUIRE(manager.Add({.module = "kernel32.dll", .signature = "4G ??",
+                       .destination = 1})
+              .error() == VeilHook::Error::InvalidPattern);
+}
+
+TEST_CASE("Armed on load, disarmed on unload", "[HookManager]")  // NOLINT
+{
+  auto& manager = VeilHook::HookManager::Get();
+  REQUIRE(GetModuleHandleA("version.dll") == nullptr);
+
+  int armed = 0;
+  int disarmed = 0;
+  const auto id = manager.Add({
+      .module = "VERSION",
+      .symbol = "GetFileVersionInfoSizeW",
+      .destination = VeilHook::detail::address_cast(&hooked_size),
+      .on_armed = [&](VeilHook::InlineHook&) { ++armed; },
+      .on_disarmed = [&] { ++disarmed; },
+  });
+  REQUIRE(id.has_value());
+  REQUIRE_FALSE(manager.armed(*id));
+  REQUIRE(manager.pending() == 1);
+
+  auto* module = LoadLibraryA("version.dll");
+  REQUIRE(module != nullptr);
+  REQUIRE(manager.armed(*id));
+  REQUIRE(armed == 1);
+  REQUIRE(version_size() == 1337);
+
+  FreeLibrary(module);
+  // Something else may pin the module; only a real unload disarms.
+  if (GetModuleHandleA("version.dll") == nullptr)
+  {
+    REQUIRE_FALSE(manager.armed(*id));
+    REQUIRE(disarmed == 1);
+
+    module = LoadLibraryA("version.dll");
+    REQUIRE(manager.armed(*id));
+    REQUIRE(armed == 2);
+    REQUIRE(version_size() == 1337);
+    FreeLibrary(module);
+  }
+
+  manager.Remove(*id);
+  REQUIRE(manager.pending() == 0);
+  if (GetModuleHandleA("version.dll") != nullptr)
+  {
+    REQUIRE(version_size() != 1337);
+  }
+}
+
+TEST_CASE("Loaded modules arm on Add", "[HookManager]")  // NOLINT
+{
+  auto& manager = VeilHook::HookManager::Get();
+  auto* module = LoadLibraryA("version.dll");
+  REQUIRE(module != nullptr);
+
+  const auto id = manager.Add(
+      {.module = "version.dll",
+       .symbol = "GetFileVersionInfoSizeW",
+       .destination = VeilHook::detail::address_cast(&hooked_size)});
+  REQUIRE(id.has_value());
+  REQUIRE(manager.armed(*id));
+  REQUIRE(version_size() == 1337);
+
+  manager.Remove(*id);
+  REQUIRE(version_size() != 1337);
+  FreeLibrary(module);
+}
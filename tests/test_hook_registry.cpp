@@ -0,0 +1,148 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/hook_registry.hpp>
+#include <VeilHook/reclaimer.hpp>
+#include <array>
+#include <thread>
+#include <vector>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto hooked_sum([[maybe_unused]] int x, [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+__declspec(noinline) auto product(int x, int y) -> int
+{
+    return x * y;
+}
+
+__declspec(noinline) auto hooked_product([[maybe_unused]] int x, [[maybe_unused]] int y) -> int
+{
+    return 7331;
+}
+
+__declspec(noinline) auto nested_sum(int x, int y) -> int
+{
+    return sum(x, y) + 100;
+}
+
+using VeilHook::detail::address_cast;
+
+TEST_CASE("Registry hooks", "[HookRegistry]")  // NOLINT
+{
+  VeilHook::HookRegistry registry{16};
+  auto handle = registry.Add(address_cast<std::uintptr_t>(&sum),
+                             address_cast<std::uintptr_t>(&hooked_sum));
+  REQUIRE(handle.has_value());
+  REQUIRE(registry.valid(*handle));
+  REQUIRE(registry.size() == 1);
+
+  REQUIRE(sum(1, 1) == 2);
+  REQUIRE(registry.Enable(*handle).has_value());
+  REQUIRE(registry.enabled(*handle));
+  REQUIRE(sum(1, 1) == 1337);
+  REQUIRE(registry.Call<int>(*handle, 1, 1) == 2);
+  REQUIRE(registry.Disable(*handle).has_value());
+  REQUIRE(sum(1, 1) == 2);
+
+  // Removing an enabled hook restores the target.
+  REQUIRE(registry.Enable(*handle).has_value());
+  REQUIRE(registry.Remove(*handle).has_value());
+  REQUIRE(sum(1, 1) == 2);
+  REQUIRE(registry.size() == 0);
+}
+
+TEST_CASE("Stale handles", "[HookRegistry]")  // NOLINT
+{
+  VeilHook::HookRegistry registry{1};
+  const auto first = registry.Add(address_cast<std::uintptr_t>(&sum),
+                                  address_cast<std::uintptr_t>(&hooked_sum));
+  REQUIRE(first.has_value());
+  REQUIRE(registry.Remove(*first).has_value());
+  REQUIRE_FALSE(registry.valid(*first));
+  REQUIRE(registry.Remove(*first).error() == VeilHook::Error::NotFound);
+
+  // The slot is reused under a new generation.
+  const auto second =
+      registry.Add(address_cast<std::uintptr_t>(&product),
+                   address_cast<std::uintptr_t>(&hooked_product));
+  REQUIRE(second.has_value());
+  REQUIRE(second->index() == first->index());
+  REQUIRE(second->generation() != first->generation());
+  REQUIRE(registry.Enable(*first).error() == VeilHook::Error::NotFound);
+  REQUIRE(registry.trampoline(*first) == 0);
+  REQUIRE(product(2, 3) == 6);
+
+  REQUIRE(registry.Add(address_cast<std::uintptr_t>(&sum),
+                       address_cast<std::uintptr_t>(&hooked_sum))
+              .error() == VeilHook::Error::NotEnoughSpace);
+}
+
+TEST_CASE("Batched registry and memory", "[HookRegistry]")  // NOLINT
+{
+  VeilHook::HookRegistry registry{16};
+  const std::array targets{
+      VeilHook::HookTarget{.target = address_cast<std::uintptr_t>(&sum),
+                           .destination = address_cast<std::uintptr_t>(&hooked_sum)},
+      VeilHook::HookTarget{.target = address_cast<std::uintptr_t>(&product),
+                           .destination = address_cast<std::uintptr_t>(&hooked_product)},
+  };
+  const auto handles = registry.AddMany(targets);
+  REQUIRE(handles.size() == 2);
+  REQUIRE(handles[0].has_value());
+  REQUIRE(handles[1].has_value());
+  REQUIRE(registry.target(*handles[1]) == targets[1].target);
+
+  const auto memory = registry.memory();
+  REQUIRE(memory.hooks == 2);
+  REQUIRE(memory.bytes > 0);
+  REQUIRE(memory.trampolines > 0);
+  // Trampolines aside, a fraction of one InlineHook object.
+  REQUIRE((memory.slots + memory.bytes) / memory.hooks <
+          sizeof(VeilHook::InlineHook));
+
+  // Different hooks never wait on each other.
+  std::vector<std::jthread> threads;
+  for (const auto& handle : handles)
+  {
+    threads.emplace_back([&registry, handle = *handle]
+    {
+      for (int i = 0; i < 1000; ++i)
+      {
+        REQUIRE(registry.Enable(handle).has_value());
+        REQUIRE(registry.Disable(handle).has_value());
+      }
+    });
+  }
+  threads.clear();
+  REQUIRE(sum(2, 3) == 5);
+  REQUIRE(product(2, 3) == 6);
+}
+
+TEST_CASE("Guarded clones stay with the registry", "[HookRegistry]")  // NOLINT
+{
+  VeilHook::HookRegistry registry{1};
+  const auto handle =
+      registry.Add(address_cast<std::uintptr_t>(&sum),
+                   address_cast<std::uintptr_t>(&nested_sum),
+                   {.guarded = true, .clone = true});
+  REQUIRE(handle.has_value());
+  // The hook Add created is gone; nothing it held may be released.
+  VeilHook::Reclaimer::Get().Collect();
+
+  REQUIRE(registry.Enable(*handle).has_value());
+  // The nested call goes through the guard's pass-through to the clone.
+  REQUIRE(sum(1, 1) == 102);
+  {
+    VeilHook::ScopedBypass bypass;
+    REQUIRE(sum(1, 1) == 2);
+  }
+  REQUIRE(registry.Call<int>(*handle, 1, 1) == 2);
+  REQUIRE(registry.Remove(*handle).has_value());
+  REQUIRE(sum(1, 1) == 2);
+}
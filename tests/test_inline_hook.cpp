@@ -1,7 +1,12 @@
 #define SNITCH_IMPLEMENTATION
 #include <snitch/snitch.hpp>
+#include <VeilHook/function_clone.hpp>
 #include <VeilHook/inline_hook.hpp>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <thread>
+#include <vector>
 
 __declspec(noinline) auto sum(int x, int y) -> int 
 { 
@@ -53,4 +58,318 @@ TEST_CASE("Multithread", "[InlineHook]")  // NOLINT
   while (idx != 3) { Sleep(1); }
 
   t.join();
-}
\ No newline at end of file
+}
+__declspec(noinline) auto product(int x, int y) -> int
+{
+    return x * y;
+}
+
+__declspec(noinline) auto hooked_product([[maybe_unused]]int x, [[maybe_unused]]int y) -> int
+{
+    return 7331;
+}
+
+TEST_CASE("CreateMany", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  const std::array targets{
+      VeilHook::HookTarget{.target = address_cast<std::uintptr_t>(&sum),
+                           .destination = address_cast<std::uintptr_t>(&hooked_sum)},
+      VeilHook::HookTarget{.target = address_cast<std::uintptr_t>(&product),
+                           .destination = address_cast<std::uintptr_t>(&hooked_product)},
+  };
+
+  for (const auto lazy : {false, true})
+  {
+    auto hooks = VeilHook::InlineHook::CreateMany(targets, {.lazy = lazy});
+    REQUIRE(hooks.size() == 2);
+    REQUIRE(hooks[0].has_value());
+    REQUIRE(hooks[1].has_value());
+    REQUIRE(hooks[1]->Call<int>(2, 3) == 6);
+    REQUIRE(hooks[0]->Enable().has_value());
+    REQUIRE(hooks[1]->Enable().has_value());
+    REQUIRE(sum(1, 1) == 1337);
+    REQUIRE(product(2, 3) == 7331);
+    REQUIRE(hooks[0]->Call<int>(1, 1) == 2);
+    REQUIRE(hooks[1]->Call<int>(2, 3) == 6);
+    REQUIRE(hooks[0]->Disable().has_value());
+    REQUIRE(hooks[1]->Disable().has_value());
+    REQUIRE(sum(1, 1) == 2);
+    REQUIRE(product(2, 3) == 6);
+  }
+}
+
+TEST_CASE("E9 trampoline layout", "[InlineHook]")  // NOLINT
+{
+  using namespace VeilHook::Impl;
+  // push rbp; mov rbp, rsp; sub rsp, 0x20 (push ebp; dec eax; ... on x86,
+  // still eight bytes of position independent code).
+  constexpr std::array<std::uint8_t, 0x50> kCode{0x55, 0x48, 0x89, 0xE5,
+                                                 0x48, 0x83, 0xEC, 0x20};
+  constexpr std::uintptr_t kTarget = 0x10'0000;
+  constexpr std::uintptr_t kDestination = 0x20'0000;
+  auto plan = plan_hook(kCode, kTarget, HookType::E9);
+  REQUIRE(plan.has_value());
+
+  // Every start the allocator can hand out within one cache line.
+  constexpr std::uintptr_t kBlock = 0x30'0000;
+  for (auto trampoline = kBlock; trampoline < kBlock + kCacheLine;
+       trampoline += 0x10)
+  {
+    std::vector<std::uint8_t> code(plan->trampoline_size);
+    REQUIRE(emit_trampoline(*plan, code, trampoline, kDestination).has_value());
+    std::array<std::uint8_t, HookPlan::kMaxPrologue> patch{};
+    REQUIRE(emit_patch(*plan, patch, trampoline, kDestination).has_value());
+
+    // The patch lands on an aligned entry inside the trampoline.
+    std::int32_t rel = 0;
+    std::memcpy(&rel, patch.data() + 1, sizeof(rel));
+    const auto entry = kTarget + 5 + static_cast<std::uintptr_t>(rel);
+    REQUIRE(entry % 0x10 == 0);
+    REQUIRE(entry > trampoline);
+    REQUIRE(entry < trampoline + code.size());
+
+    const auto literal = destination_literal(*plan, trampoline);
+    REQUIRE(literal % kCacheLine == 0);
+    REQUIRE(literal >= entry + 6);
+    REQUIRE(literal + kCacheLine <= trampoline + code.size());
+    std::uintptr_t value = 0;
+    std::memcpy(&value, code.data() + (literal - trampoline), sizeof(value));
+    REQUIRE(value == kDestination);
+  }
+}
+
+TEST_CASE("E9 trampolines below their target", "[InlineHook]")  // NOLINT
+{
+  using namespace VeilHook::Impl;
+  constexpr std::array<std::uint8_t, 0x50> kCode{0x55, 0x48, 0x89, 0xE5,
+                                                 0x48, 0x83, 0xEC, 0x20};
+  constexpr std::uintptr_t kTarget = 0x30'0000;
+  constexpr std::uintptr_t kDestination = 0x20'0000;
+  constexpr std::uintptr_t kTrampoline = 0x10'0000;
+  auto plan = plan_hook(kCode, kTarget, HookType::E9);
+  REQUIRE(plan.has_value());
+
+  // The patch jumps backwards, the trampoline forwards again.
+  std::vector<std::uint8_t> code(plan->trampoline_size);
+  REQUIRE(emit_trampoline(*plan, code, kTrampoline, kDestination).has_value());
+  std::array<std::uint8_t, HookPlan::kMaxPrologue> patch{};
+  REQUIRE(emit_patch(*plan, patch, kTrampoline, kDestination).has_value());
+
+  std::int32_t rel = 0;
+  std::memcpy(&rel, patch.data() + 1, sizeof(rel));
+  REQUIRE(rel < 0);
+  const auto entry = kTarget + 5 + static_cast<std::uintptr_t>(
+                                       static_cast<std::intptr_t>(rel));
+  REQUIRE(entry > kTrampoline);
+  REQUIRE(entry < kTrampoline + code.size());
+  REQUIRE(relocated_address(*plan, kTrampoline,
+                            kTarget + plan->prologue_size) != 0);
+}
+
+__declspec(noinline) auto retargeted_sum([[maybe_unused]] int x,
+                                         [[maybe_unused]] int y) -> int
+{
+    return 4242;
+}
+
+TEST_CASE("Retarget under concurrent calls", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  constexpr std::size_t kRetargets = 1'000'000;
+  const std::array destinations{address_cast<std::uintptr_t>(&hooked_sum),
+                                address_cast<std::uintptr_t>(&retargeted_sum)};
+
+  for (const auto guarded : {false, true})
+  {
+    auto hook = VeilHook::InlineHook::Create(
+        address_cast<std::uintptr_t>(&sum), destinations[0],
+        {.guarded = guarded});
+    REQUIRE(hook.has_value());
+    REQUIRE(hook->Enable().has_value());
+
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> unexpected{0};
+    std::array<std::atomic<std::size_t>, 2> seen{};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 3; ++t)
+    {
+      callers.emplace_back([&]
+      {
+        while (not done.load(std::memory_order_relaxed))
+        {
+          const auto result = sum(1, 1);
+          if (result == 1337) { ++seen[0]; }
+          else if (result == 4242) { ++seen[1]; }
+          else { ++unexpected; }
+        }
+      });
+    }
+    for (std::size_t i = 0; i < kRetargets; ++i)
+    {
+      REQUIRE(hook->Retarget(destinations[(i + 1) % 2]).has_value());
+    }
+    done = true;
+    for (auto& caller : callers) { caller.join(); }
+
+    // No call ever slipped past the hook.
+    REQUIRE(unexpected == 0);
+    REQUIRE(seen[0] + seen[1] > 0);
+    REQUIRE(sum(1, 1) == 1337);
+    REQUIRE(hook->Call<int>(1, 1) == 2);
+    REQUIRE(hook->Disable().has_value());
+    REQUIRE(sum(1, 1) == 2);
+  }
+
+  // Before the first Enable of a lazy hook there is nothing emitted yet.
+  auto lazy = VeilHook::InlineHook::Create(
+      address_cast<std::uintptr_t>(&sum), destinations[0], {.lazy = true});
+  REQUIRE(lazy.has_value());
+  REQUIRE(lazy->Retarget(destinations[1]).has_value());
+  REQUIRE(lazy->Enable().has_value());
+  REQUIRE(sum(1, 1) == 4242);
+}
+
+__declspec(noinline) auto difference(int x, int y) -> int
+{
+    return x - y;
+}
+
+TEST_CASE("follow_jumps hooks the end of a chain", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  using VeilHook::detail::store;
+  const auto body = address_cast<std::uintptr_t>(&difference);
+  // jmp rel8 -> jmp rel32 -> jmp [literal] -> difference
+  auto thunk = VeilHook::Allocator::Get()->Allocate(64);
+  REQUIRE(thunk.has_value());
+  const auto base = thunk->address();
+  store<std::uint16_t>(base, 0x0EEB);
+  store<std::uint8_t>(base + 16, 0xE9);
+  store(base + 17, static_cast<std::int32_t>(32 - 21));
+  store<std::uint16_t>(base + 32, 0x25FF);
+#if defined(VH_ARCH_X86_64)
+  store(base + 34, static_cast<std::int32_t>(48 - 38));
+#else
+  store(base + 34, static_cast<std::uint32_t>(base + 48));
+#endif
+  store(base + 48, body);
+
+  // `body` may itself be an incremental linking stub.
+  const auto resolved = VeilHook::Impl::resolve_jumps(body);
+  REQUIRE(VeilHook::Impl::resolve_jumps(base) == resolved);
+
+  auto hook = VeilHook::InlineHook::Create(
+      base, address_cast<std::uintptr_t>(&hooked_sum),
+      {.follow_jumps = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->target() == resolved);
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(address_cast<int (*)(int, int)>(base)(5, 3) == 1337);
+  REQUIRE(difference(5, 3) == 1337);
+  REQUIRE(hook->Call<int>(5, 3) == 2);
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(difference(5, 3) == 2);
+}
+
+#if defined(VH_ARCH_X86_64)
+TEST_CASE("Clones keep loops out of the patch", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  // int count(int n, int acc): acc + n, looping back to its first byte.
+  static constexpr std::array<std::uint8_t, 12> kCount{
+      0xFF, 0xC2,        // inc edx
+      0x90, 0x90, 0x90,  // nop x3
+      0xFF, 0xC9,        // dec ecx
+      0x75, 0xF7,        // jnz entry
+      0x89, 0xD0,        // mov eax, edx
+      0xC3};             // ret
+  auto code = VeilHook::Allocator::Get()->Allocate(64);
+  REQUIRE(code.has_value());
+  std::memcpy(code->data<void*>(), kCount.data(), kCount.size());
+  const auto count = code->address();
+  const auto detour = address_cast<std::uintptr_t>(&hooked_sum);
+
+  {
+    // The trampoline jumps back behind the patch and the loop runs into it.
+    auto hook = VeilHook::InlineHook::Create(count, detour);
+    REQUIRE(hook.has_value());
+    REQUIRE(not hook->cloned());
+    REQUIRE(hook->Enable().has_value());
+    REQUIRE(hook->Call<int>(1, 10) == 11);
+    REQUIRE(hook->Call<int>(3, 10) == 1337);
+  }
+
+  const auto plan = VeilHook::Impl::plan_clone(count);
+  REQUIRE(plan.has_value());
+  REQUIRE(plan->instructions.size() == 8);
+  REQUIRE(plan->bytes.size() == kCount.size());
+
+  auto hook = VeilHook::InlineHook::Create(count, detour, {.clone = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->cloned());
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(address_cast<int (*)(int, int)>(count)(3, 10) == 1337);
+  REQUIRE(hook->Call<int>(3, 10) == 13);
+}
+#endif
+
+__declspec(noinline) auto classify(int x) -> int
+{
+    switch (x)
+    {
+        case 0: return x * 7 + 1;
+        case 1: return x ^ 0x55;
+        case 2: return x << 3;
+        case 3: return x / 3 + 9;
+        case 4: return x - 100;
+        case 5: return ~x;
+        case 6: return x * x;
+        case 7: return x | 0x1000;
+        default: return -x;
+    }
+}
+
+__declspec(noinline) auto hooked_classify([[maybe_unused]] int x) -> int
+{
+    return 1337;
+}
+
+TEST_CASE("Clones relocate jump tables", "[InlineHook]")  // NOLINT
+{
+  using VeilHook::detail::address_cast;
+  const auto body =
+      VeilHook::Impl::resolve_jumps(address_cast<std::uintptr_t>(&classify));
+  const auto plan = VeilHook::Impl::plan_clone(body);
+  REQUIRE(plan.has_value());
+  REQUIRE(plan->tables.size() == 1);
+  REQUIRE(plan->tables[0].targets.size() == 8);
+
+  std::array<int, 10> expected{};
+  for (int x = -1; x < 9; ++x) { expected[x + 1] = classify(x); }
+
+  auto hook = VeilHook::InlineHook::Create(
+      body, address_cast<std::uintptr_t>(&hooked_classify), {.clone = true});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->cloned());
+  REQUIRE(hook->Enable().has_value());
+  for (int x = -1; x < 9; ++x)
+  {
+    REQUIRE(classify(x) == 1337);
+    REQUIRE(hook->Call<int>(x) == expected[x + 1]);
+  }
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(classify(5) == ~5);
+}
+
+TEST_CASE("Clones stop at the extent limit", "[InlineHook]")  // NOLINT
+{
+  // Nothing but nops up to the limit and past it: the last one falls
+  // through to the first offset the clone cannot hold.
+  constexpr auto kSize = VeilHook::Impl::kMaxCloneExtent + 0x1000;
+  auto code = VeilHook::Allocator::Get()->Allocate(kSize);
+  REQUIRE(code.has_value());
+  std::memset(code->data<void*>(), 0x90, kSize);
+  REQUIRE(VeilHook::Impl::plan_clone(code->address()).error() ==
+          VeilHook::Error::NotEnoughSpace);
+}
@@ -0,0 +1,135 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/length_decoder.hpp>
+#include <VeilHook/utility.hpp>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace
+{
+using VeilHook::Impl::InstructionLength;
+using VeilHook::Impl::MachineMode;
+using Branch = InstructionLength::Branch;
+
+struct Corpus
+{
+  std::size_t instructions{0};
+  std::size_t fast{0};
+};
+
+// Linear sweep over every executable section, stepping by Zydis's length;
+// wherever Zydis decodes, the fast path must agree or decline.
+auto sweep(std::span<const std::uint8_t> code, MachineMode mode) -> Corpus
+{
+  Corpus corpus;
+  for (std::size_t offset = 0; offset < code.size();)
+  {
+    const auto rest = code.subspan(offset);
+    const auto full = VeilHook::Impl::decode_length_full(rest, mode);
+    if (not full)
+    {
+      ++offset;
+      continue;
+    }
+    ++corpus.instructions;
+    if (const auto fast = VeilHook::Impl::decode_length_fast(rest, mode))
+    {
+      ++corpus.fast;
+      REQUIRE(*fast == *full);
+    }
+    REQUIRE(VeilHook::Impl::decode_length(rest, mode) == full);
+    offset += full->length;
+  }
+  return corpus;
+}
+
+auto code_of(const char* module) -> std::vector<std::span<const std::uint8_t>>
+{
+  std::vector<std::span<const std::uint8_t>> result;
+  const auto base = VeilHook::Impl::module_find(module);
+  REQUIRE(base.has_value());
+  const auto sections = VeilHook::Impl::module_sections(*base);
+  REQUIRE(sections.has_value());
+  for (const auto& section : *sections)
+  {
+    if (not section.executable) { continue; }
+    result.emplace_back(
+        VeilHook::detail::address_cast<const std::uint8_t*>(section.address),
+        section.size);
+  }
+  return result;
+}
+}  // namespace
+
+TEST_CASE("Known encodings", "[LengthDecoder]")  // NOLINT
+{
+  const auto fast = [](std::span<const std::uint8_t> code, MachineMode mode)
+  {
+    return VeilHook::Impl::decode_length_fast(code, mode);
+  };
+  constexpr auto k64 = MachineMode::Long64;
+  constexpr auto k32 = MachineMode::Legacy32;
+
+  // mov rax, [rip+0x10]
+  constexpr std::array<std::uint8_t, 7> rip{0x48, 0x8B, 0x05, 0x10, 0, 0, 0};
+  REQUIRE(fast(rip, k64) == InstructionLength{.length = 7,
+                                              .rel_offset = 3,
+                                              .rel_size = 4});
+  // The same bytes are absolute addressing in 32-bit mode: dec eax; mov.
+  REQUIRE(fast(rip, k32) == InstructionLength{.length = 1});
+  // mov rax, imm64
+  constexpr std::array<std::uint8_t, 10> imm64{0x48, 0xB8, 1, 2, 3,
+                                               4,    5,    6, 7, 8};
+  REQUIRE(fast(imm64, k64)->length == 10);
+  // mov ax, imm16
+  constexpr std::array<std::uint8_t, 4> imm16{0x66, 0xB8, 1, 2};
+  REQUIRE(fast(imm16, k32)->length == 4);
+  // jne rel8, jmp rel32, call rel32, jrcxz
+  constexpr std::array<std::uint8_t, 2> jne{0x75, 0x10};
+  REQUIRE(fast(jne, k64) == InstructionLength{.length = 2,
+                                              .rel_offset = 1,
+                                              .rel_size = 1,
+                                              .branch = Branch::Jcc});
+  constexpr std::array<std::uint8_t, 6> jcc32{0x0F, 0x84, 1, 0, 0, 0};
+  REQUIRE(fast(jcc32, k32)->branch == Branch::Jcc);
+  constexpr std::array<std::uint8_t, 5> call{0xE8, 1, 0, 0, 0};
+  REQUIRE(fast(call, k64)->branch == Branch::Call);
+  constexpr std::array<std::uint8_t, 2> jrcxz{0xE3, 0x10};
+  REQUIRE(fast(jrcxz, k64)->branch == Branch::Loop);
+  // test dword [rsp+8], imm32; endbr64
+  constexpr std::array<std::uint8_t, 8> test{0xF7, 0x44, 0x24, 0x08,
+                                             1,    2,    3,    4};
+  REQUIRE(fast(test, k64)->length == 8);
+  constexpr std::array<std::uint8_t, 4> endbr{0xF3, 0x0F, 0x1E, 0xFA};
+  REQUIRE(fast(endbr, k64)->length == 4);
+
+  // Left to Zydis: VEX, lock, truncated input.
+  constexpr std::array<std::uint8_t, 3> vzeroupper{0xC5, 0xF8, 0x77};
+  REQUIRE_FALSE(fast(vzeroupper, k64).has_value());
+  constexpr std::array<std::uint8_t, 4> lock{0xF0, 0x0F, 0xC1, 0x01};
+  REQUIRE_FALSE(fast(lock, k64).has_value());
+  REQUIRE_FALSE(fast(std::span{call}.first(3), k64).has_value());
+}
+
+TEST_CASE("Matches Zydis on system code", "[LengthDecoder]")  // NOLINT
+{
+  Corpus total;
+  for (const auto* module : {"ntdll.dll", "kernelbase.dll", "ucrtbase.dll"})
+  {
+    if (not VeilHook::Impl::module_find(module)) { LoadLibraryA(module); }
+    for (const auto code : code_of(module))
+    {
+      for (const auto mode : {MachineMode::Long64, MachineMode::Legacy32})
+      {
+        const auto corpus = sweep(code, mode);
+        total.instructions += corpus.instructions;
+        total.fast += corpus.fast;
+      }
+    }
+  }
+  REQUIRE(total.instructions > 100'000);
+  // Vector and system code aside, nearly everything takes the table path.
+  REQUIRE(total.fast * 10 > total.instructions * 9);
+}
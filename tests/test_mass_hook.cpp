@@ -0,0 +1,119 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/mass_hook.hpp>
+#include <array>
+#include <atomic>
+#include <vector>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto product(int x, int y) -> int
+{
+    return x * y;
+}
+
+__declspec(noinline) auto difference(int x, int y) -> int
+{
+    return x - y;
+}
+
+using VeilHook::detail::address_cast;
+
+namespace
+{
+std::array<std::atomic<int>, 3> g_entered{};
+std::atomic<bool> g_rewrite{false};
+
+void on_enter(std::uint32_t id, VeilHook::MassHook::Registers& regs)
+{
+  ++g_entered[id];
+  if (not g_rewrite) { return; }
+  // Doubles the first argument.
+#if defined(VH_ARCH_X86_64)
+  regs.rcx *= 2;
+#else
+  auto* first = address_cast<int*>(regs.esp + sizeof(std::uintptr_t));
+  *first *= 2;
+#endif
+}
+
+auto targets() -> std::vector<std::uintptr_t>
+{
+  return {address_cast<std::uintptr_t>(&sum),
+          address_cast<std::uintptr_t>(&product),
+          address_cast<std::uintptr_t>(&difference)};
+}
+}  // namespace
+
+TEST_CASE("Targets reach the callback with their id", "[MassHook]")  // NOLINT
+{
+  const auto addresses = targets();
+  auto hook = VeilHook::MassHook::Create(addresses, &on_enter);
+  REQUIRE(hook.has_value());
+  REQUIRE((*hook)->hooked() == 3);
+  for (auto& entered : g_entered) { entered = 0; }
+
+  REQUIRE((*hook)->Enable().has_value());
+  REQUIRE(sum(2, 3) == 5);
+  REQUIRE(product(2, 3) == 6);
+  REQUIRE(product(4, 5) == 20);
+  REQUIRE(difference(2, 3) == -1);
+  REQUIRE(g_entered[0] == 1);
+  REQUIRE(g_entered[1] == 2);
+  REQUIRE(g_entered[2] == 1);
+
+  // The trampoline runs the original without entering the callback.
+  const auto original =
+      address_cast<int (*)(int, int)>((*hook)->trampoline(1));
+  REQUIRE(original(6, 7) == 42);
+  REQUIRE(g_entered[1] == 2);
+
+  REQUIRE((*hook)->Disable().has_value());
+  REQUIRE(sum(2, 3) == 5);
+  REQUIRE(g_entered[0] == 1);
+}
+
+TEST_CASE("The callback can rewrite arguments", "[MassHook]")  // NOLINT
+{
+  const auto addresses = targets();
+  auto hook = VeilHook::MassHook::Create(addresses, &on_enter);
+  REQUIRE(hook.has_value());
+  REQUIRE((*hook)->Enable().has_value());
+
+  g_rewrite = true;
+  REQUIRE(sum(2, 3) == 7);
+  REQUIRE(difference(5, 1) == 9);
+  g_rewrite = false;
+  REQUIRE(sum(2, 3) == 5);
+
+  hook->reset();
+  g_rewrite = true;
+  REQUIRE(sum(2, 3) == 5);
+  g_rewrite = false;
+}
+
+TEST_CASE("Unhookable targets are skipped", "[MassHook]")  // NOLINT
+{
+  // jrcxz has no rel32 form to relocate into.
+  static constexpr std::array<std::uint8_t, 8> kJrcxz{0xE3, 0x00, 0xC3};
+  std::vector<std::uintptr_t> addresses{
+      address_cast<std::uintptr_t>(&sum),
+      address_cast<std::uintptr_t>(kJrcxz.data())};
+  auto hook = VeilHook::MassHook::Create(addresses, &on_enter);
+  REQUIRE(hook.has_value());
+  REQUIRE((*hook)->size() == 2);
+  REQUIRE((*hook)->hooked() == 1);
+  REQUIRE((*hook)->hooked(0));
+  REQUIRE(not (*hook)->hooked(1));
+
+  const auto memory = (*hook)->memory();
+  REQUIRE(memory.hooks == 1);
+  REQUIRE(memory.bytes > 0);
+  REQUIRE(memory.trampolines > 0);
+
+  REQUIRE(VeilHook::MassHook::Create(addresses, nullptr).error() ==
+          VeilHook::Error::InvalidArgument);
+}
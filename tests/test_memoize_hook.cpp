@@ -0,0 +1,96 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/memoize_hook.hpp>
+#include <atomic>
+#include <cstdint>
+
+std::atomic<int> g_calls{0};
+
+__declspec(noinline) auto mix(int x, int y) -> int
+{
+    ++g_calls;
+    return x * 31 + y;
+}
+
+using VeilHook::detail::address_cast;
+
+namespace
+{
+auto mix_key(const int& x, const int& y) -> std::uint64_t
+{
+  return (std::uint64_t{static_cast<std::uint32_t>(x)} << 32) |
+         static_cast<std::uint32_t>(y);
+}
+
+struct Small;
+using MixHook = VeilHook::MemoizeHook<int(int, int)>;
+using SmallMixHook =
+    VeilHook::MemoizeHook<int(int, int), std::uint64_t, Small>;
+}  // namespace
+
+TEST_CASE("Repeated arguments hit the cache", "[MemoizeHook]")  // NOLINT
+{
+  auto memoize = MixHook::Create(address_cast(&mix), &mix_key);
+  REQUIRE(memoize.has_value());
+  auto& hook = **memoize;
+  REQUIRE(hook.Enable().has_value());
+
+  g_calls = 0;
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(mix(2, 1) == 63);
+  REQUIRE(g_calls == 2);
+  auto stats = hook.stats();
+  REQUIRE(stats.hits == 2);
+  REQUIRE(stats.misses == 2);
+  REQUIRE(stats.size == 2);
+
+  hook.SetBypass(true);
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(g_calls == 3);
+  REQUIRE(hook.stats().hits == 2);
+  hook.SetBypass(false);
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(g_calls == 3);
+
+  REQUIRE(hook.Call(1, 2) == 33);
+  REQUIRE(g_calls == 4);
+  hook.Clear();
+  REQUIRE(hook.stats().size == 0);
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(g_calls == 5);
+
+  // One live instance per specialization.
+  REQUIRE(MixHook::Create(address_cast(&mix), &mix_key).error() ==
+          VeilHook::Error::InvalidArgument);
+  REQUIRE(hook.Disable().has_value());
+  REQUIRE(mix(1, 2) == 33);
+  REQUIRE(g_calls == 6);
+}
+
+TEST_CASE("The clock evicts unreferenced results", "[MemoizeHook]")  // NOLINT
+{
+  REQUIRE(SmallMixHook::Create(address_cast(&mix), nullptr).error() ==
+          VeilHook::Error::InvalidArgument);
+  auto memoize = SmallMixHook::Create(address_cast(&mix), &mix_key,
+                                      {.capacity = 4, .shards = 1});
+  REQUIRE(memoize.has_value());
+  auto& hook = **memoize;
+  REQUIRE(hook.Enable().has_value());
+
+  for (int i = 0; i < 4; ++i) { REQUIRE(mix(i, 0) == i * 31); }
+  // Referenced, so the hand passes over it once.
+  REQUIRE(mix(0, 0) == 0);
+  REQUIRE(mix(4, 0) == 124);
+  auto stats = hook.stats();
+  REQUIRE(stats.size == 4);
+  REQUIRE(stats.evictions == 1);
+
+  g_calls = 0;
+  REQUIRE(mix(0, 0) == 0);
+  REQUIRE(mix(4, 0) == 124);
+  REQUIRE(g_calls == 0);
+  REQUIRE(mix(1, 0) == 31);
+  REQUIRE(g_calls == 1);
+}
@@ -0,0 +1,138 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/plan_cache.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+__declspec(noinline) auto difference(int x, int y) -> int
+{
+    return x - y;
+}
+
+__declspec(noinline) auto hooked_difference([[maybe_unused]] int x, [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+namespace
+{
+auto cache_path() -> std::filesystem::path
+{
+  auto path = std::filesystem::temp_directory_path() / "veilhook_test.plans";
+  std::filesystem::remove(path);
+  return path;
+}
+}  // namespace
+
+TEST_CASE("PlanCache round trip", "[PlanCache]")  // NOLINT
+{
+  const auto path = cache_path();
+  const auto target = VeilHook::detail::address_cast(&difference);
+  const auto destination = VeilHook::detail::address_cast(&hooked_difference);
+  {
+    VeilHook::PlanCache cache{path};
+    REQUIRE(cache.size() == 0);
+    REQUIRE_FALSE(cache.Find(target).has_value());
+    auto hook = VeilHook::InlineHook::Create(target, destination,
+                                             {.cache = &cache});
+    REQUIRE(hook.has_value());
+    REQUIRE(cache.Save().has_value());
+    REQUIRE(cache.size() == 1);
+  }
+
+  VeilHook::PlanCache cache{path};
+  REQUIRE(cache.size() == 1);
+  const auto cached = cache.Find(target);
+  REQUIRE(cached.has_value());
+  auto decoded = VeilHook::Impl::plan_hook(target, cached->type);
+  REQUIRE(decoded.has_value());
+  REQUIRE(cached->prologue_size == decoded->prologue_size);
+  REQUIRE(cached->trampoline_size == decoded->trampoline_size);
+  REQUIRE(cached->original_bytes == decoded->original_bytes);
+
+  auto hook = VeilHook::InlineHook::Create(target, destination,
+                                           {.cache = &cache});
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(difference(3, 1) == 1337);
+  REQUIRE(hook->Call<int>(3, 1) == 2);
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(difference(3, 1) == 2);
+}
+
+TEST_CASE("PlanCache rejects foreign files", "[PlanCache]")  // NOLINT
+{
+  const auto path = cache_path();
+  {
+    VeilHook::PlanCache cache{path};
+    auto hook = VeilHook::InlineHook::Create(
+        VeilHook::detail::address_cast(&difference),
+        VeilHook::detail::address_cast(&hooked_difference), {.cache = &cache});
+    REQUIRE(hook.has_value());
+    REQUIRE(cache.Save().has_value());
+  }
+
+  // Same layout, next format version.
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    const auto version = VeilHook::PlanCache::kVersion + 1;
+    file.seekp(offsetof(VeilHook::Impl::PlanCacheHeader, version));
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+  REQUIRE(VeilHook::PlanCache{path}.size() == 0);
+
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "not a plan cache";
+  }
+  VeilHook::PlanCache cache{path};
+  REQUIRE(cache.size() == 0);
+  auto hook = VeilHook::InlineHook::Create(
+      VeilHook::detail::address_cast(&difference),
+      VeilHook::detail::address_cast(&hooked_difference), {.cache = &cache});
+  REQUIRE(hook.has_value());
+  REQUIRE(cache.Save().has_value());
+  REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("PlanCache checks records it reads", "[PlanCache]")  // NOLINT
+{
+  using VeilHook::Impl::PlanCacheHeader;
+  using VeilHook::Impl::PlanCacheRecord;
+  const auto path = cache_path();
+  const auto target = VeilHook::detail::address_cast(&difference);
+  {
+    VeilHook::PlanCache cache{path};
+    auto hook = VeilHook::InlineHook::Create(
+        target, VeilHook::detail::address_cast(&hooked_difference),
+        {.cache = &cache});
+    REQUIRE(hook.has_value());
+    REQUIRE(cache.Save().has_value());
+  }
+  const auto patch = [&](std::size_t offset, std::uint8_t value)
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(sizeof(PlanCacheHeader) + offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+
+  // The stored trampoline size is ignored.
+  patch(offsetof(PlanCacheRecord, trampoline_size), 1);
+  {
+    VeilHook::PlanCache cache{path};
+    const auto cached = cache.Find(target);
+    REQUIRE(cached.has_value());
+    REQUIRE(cached->trampoline_size ==
+            VeilHook::Impl::trampoline_size(*cached));
+    REQUIRE(cached->trampoline_size > 1);
+  }
+
+  // An instruction running past the prologue drops the record.
+  patch(offsetof(PlanCacheRecord, instructions) +
+            offsetof(VeilHook::Impl::PlannedInstruction, length),
+        PlanCacheRecord::kMaxPrologue);
+  VeilHook::PlanCache cache{path};
+  REQUIRE_FALSE(cache.Find(target).has_value());
+}
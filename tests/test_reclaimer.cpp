@@ -0,0 +1,106 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/reclaimer.hpp>
+#include <atomic>
+#include <thread>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto hooked_sum([[maybe_unused]] int x,
+                                     [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+using VeilHook::detail::address_cast;
+
+namespace
+{
+volatile std::uint8_t g_stop = 0;
+std::atomic<bool> g_released{false};
+void (*g_spin)() = nullptr;
+
+// Emits `pause; cmp byte [g_stop], 0; je pause; ret` and retires it, keeping
+// its address off the test's own stack.
+__declspec(noinline) auto retire_spin_loop() -> bool
+{
+  const auto stop = address_cast<std::uintptr_t>(&g_stop);
+  auto code = VeilHook::Allocator::Get()->Allocate({stop}, 16);
+  if (not code) { return false; }
+  const auto base = code->address();
+  VeilHook::detail::store<std::uint16_t>(base, 0x90F3);
+  VeilHook::detail::store<std::uint16_t>(base + 2, 0x3D80);
+#if defined(VH_ARCH_X86_64)
+  VeilHook::detail::store(base + 4,
+                          static_cast<std::int32_t>(stop - (base + 9)));
+#else
+  VeilHook::detail::store(base + 4, static_cast<std::uint32_t>(stop));
+#endif
+  VeilHook::detail::store<std::uint8_t>(base + 8, 0x00);
+  VeilHook::detail::store<std::uint16_t>(base + 9, 0xF574);
+  VeilHook::detail::store<std::uint8_t>(base + 11, 0xC3);
+  g_spin = code->data<void (*)()>();
+
+  VeilHook::Reclaimer::Get().Retire(
+      {base, base + code->size()},
+      [code = std::move(*code)]() mutable
+      {
+        code.free();
+        g_released = true;
+      });
+  return true;
+}
+}  // namespace
+
+TEST_CASE("Threads inside retired code hold it back", "[Reclaimer]")  // NOLINT
+{
+  auto& reclaimer = VeilHook::Reclaimer::Get();
+  reclaimer.Collect();
+  const auto pending = reclaimer.pending();
+
+  g_stop = 0;
+  REQUIRE(retire_spin_loop());
+  std::atomic<bool> running{false};
+  std::thread spinner([&]
+  {
+    running = true;
+    g_spin();
+  });
+  while (not running) { std::this_thread::yield(); }
+  Sleep(10);
+
+  // Like a thread that was sent into a trampoline just before the unhook.
+  for (int i = 0; i < 10; ++i) { reclaimer.Collect(); }
+  REQUIRE(not g_released);
+  REQUIRE(reclaimer.pending() >= pending + 1);
+
+  g_stop = 1;
+  spinner.join();
+  reclaimer.Collect();
+  REQUIRE(g_released);
+}
+
+TEST_CASE("Destroyed hooks retire their trampoline", "[Reclaimer]")  // NOLINT
+{
+  auto& reclaimer = VeilHook::Reclaimer::Get();
+  reclaimer.Collect();
+  const auto bytes = reclaimer.pending_bytes();
+  {
+    auto hook = VeilHook::InlineHook::Create(
+        address_cast<std::uintptr_t>(&sum),
+        address_cast<std::uintptr_t>(&hooked_sum), {.guarded = true});
+    REQUIRE(hook.has_value());
+    REQUIRE(hook->Enable().has_value());
+    REQUIRE(sum(1, 1) == 1337);
+  }
+  REQUIRE(sum(1, 1) == 2);
+  REQUIRE(reclaimer.pending_bytes() > bytes);
+
+  // Nothing runs the trampoline or the guard any more.
+  REQUIRE(reclaimer.Collect() >= 2);
+  REQUIRE(reclaimer.pending_bytes() <= bytes);
+}
@@ -0,0 +1,136 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/remote_process.hpp>
+#include <VeilHook/utility.hpp>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace
+{
+using VeilHook::detail::address_cast;
+
+// A copy of this executable that never runs past its creation. ntdll is
+// mapped at the same address in every process, so its exports make targets
+// and destinations that are valid in both.
+class Child final
+{
+ public:
+  Child()
+  {
+    std::array<WCHAR, MAX_PATH> path{};
+    GetModuleFileNameW(nullptr, path.data(), MAX_PATH);
+    STARTUPINFOW startup{};
+    startup.cb = sizeof(startup);
+    if (CreateProcessW(path.data(), nullptr, nullptr, nullptr, FALSE,
+                       CREATE_SUSPENDED, nullptr, nullptr, &startup,
+                       &info_) == FALSE)
+    {
+      info_ = {};
+    }
+  }
+  ~Child()
+  {
+    if (info_.hProcess == nullptr) { return; }
+    TerminateProcess(info_.hProcess, 0);
+    CloseHandle(info_.hThread);
+    CloseHandle(info_.hProcess);
+  }
+  Child(const Child&) = delete;
+  auto operator=(const Child&) -> Child& = delete;
+
+  [[nodiscard]] auto pid() const -> std::uint32_t
+  {
+    return info_.dwProcessId;
+  }
+
+ private:
+  PROCESS_INFORMATION info_{};
+};
+
+auto ntdll_export(const char* name) -> std::uintptr_t
+{
+  return address_cast(GetProcAddress(GetModuleHandleA("ntdll.dll"), name));
+}
+
+auto read(VeilHook::RemoteProcess& process, std::uintptr_t address,
+          std::size_t size) -> std::vector<std::uint8_t>
+{
+  std::vector<std::uint8_t> bytes(size);
+  if (not process.Read(address, bytes)) { bytes.clear(); }
+  return bytes;
+}
+}  // namespace
+
+TEST_CASE("Hooks are written into the child", "[RemoteProcess]")  // NOLINT
+{
+  const Child child;
+  REQUIRE(child.pid() != 0);
+  auto process = VeilHook::RemoteProcess::Open(child.pid());
+  REQUIRE(process.has_value());
+
+  const auto destination = ntdll_export("NtYieldExecution");
+  const std::array targets{
+      VeilHook::HookTarget{ntdll_export("NtClose"), destination},
+      VeilHook::HookTarget{ntdll_export("NtQueryInformationProcess"),
+                           destination},
+  };
+  const auto hooks = (*process)->Install(targets);
+  REQUIRE(hooks.size() == targets.size());
+  for (std::size_t i = 0; i < hooks.size(); ++i)
+  {
+    REQUIRE(hooks[i].has_value());
+    const auto& hook = *hooks[i];
+    const auto& plan = hook.plan;
+    REQUIRE(hook.target == targets[i].target);
+    // Planned from the child's bytes, which are this process's.
+    REQUIRE(std::ranges::equal(
+        std::span{plan.original_bytes}.first(plan.prologue_size),
+        std::span{address_cast<const std::uint8_t*>(hook.target),
+                  plan.prologue_size}));
+
+    std::vector<std::uint8_t> patch(plan.prologue_size);
+    REQUIRE(VeilHook::Impl::emit_patch(plan, patch, hook.trampoline,
+                                       destination)
+                .has_value());
+    REQUIRE(read(**process, hook.target, patch.size()) == patch);
+
+    std::vector<std::uint8_t> trampoline(plan.trampoline_size);
+    REQUIRE(VeilHook::Impl::emit_trampoline(plan, trampoline,
+                                            hook.trampoline, destination)
+                .has_value());
+    REQUIRE(read(**process, hook.trampoline, trampoline.size()) ==
+            trampoline);
+  }
+
+  std::vector<VeilHook::RemoteHook> installed;
+  for (const auto& hook : hooks) { installed.push_back(*hook); }
+  REQUIRE((*process)->Uninstall(installed).has_value());
+  for (const auto& hook : installed)
+  {
+    const auto& plan = hook.plan;
+    REQUIRE(std::ranges::equal(
+        read(**process, hook.target, plan.prologue_size),
+        std::span{plan.original_bytes}.first(plan.prologue_size)));
+  }
+}
+
+TEST_CASE("Overlapping targets are refused", "[RemoteProcess]")  // NOLINT
+{
+  const Child child;
+  REQUIRE(child.pid() != 0);
+  auto process = VeilHook::RemoteProcess::Open(child.pid());
+  REQUIRE(process.has_value());
+
+  const auto close = ntdll_export("NtClose");
+  const auto destination = ntdll_export("NtYieldExecution");
+  const std::array targets{
+      VeilHook::HookTarget{close + 1, destination},
+      VeilHook::HookTarget{close, destination},
+  };
+  const auto hooks = (*process)->Install(targets);
+  REQUIRE(hooks[1].has_value());
+  REQUIRE(hooks[0].error() == VeilHook::Error::NotEnoughSpace);
+
+  REQUIRE(VeilHook::RemoteProcess::Open(0).error() == VeilHook::Error::Io);
+}
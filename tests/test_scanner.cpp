@@ -0,0 +1,130 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/scanner.hpp>
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+__declspec(noinline) auto quotient(int x, int y) -> int
+{
+    return x / y;
+}
+
+__declspec(noinline) auto hooked_quotient([[maybe_unused]] int x, [[maybe_unused]] int y) -> int
+{
+    return 1337;
+}
+
+namespace
+{
+constexpr std::array<VeilHook::Scanner::Kernel, 3> kKernels{
+    VeilHook::Scanner::Kernel::Scalar, VeilHook::Scanner::Kernel::Sse2,
+    VeilHook::Scanner::Kernel::Avx2};
+
+auto random_bytes(std::size_t size) -> std::vector<std::uint8_t>
+{
+  std::vector<std::uint8_t> bytes(size);
+  std::minstd_rand rng{42};
+  for (auto& byte : bytes) { byte = static_cast<std::uint8_t>(rng()); }
+  return bytes;
+}
+}  // namespace
+
+TEST_CASE("Pattern parsing", "[Scanner]")  // NOLINT
+{
+  auto pattern = VeilHook::Pattern::Parse("48 8B ? ?? 4? ?8");
+  REQUIRE(pattern.has_value());
+  REQUIRE(pattern->size() == 6);
+  REQUIRE(pattern->mask()[0] == 0xFF);
+  REQUIRE(pattern->mask()[2] == 0x00);
+  REQUIRE(pattern->mask()[3] == 0x00);
+  REQUIRE(pattern->mask()[4] == 0xF0);
+  REQUIRE(pattern->mask()[5] == 0x0F);
+
+  const std::array<std::uint8_t, 4> bytes{0x48, 0x8B, 0x05, 0x40};
+  REQUIRE(pattern->matches(std::array<std::uint8_t, 6>{0x48, 0x8B, 0x01, 0x02,
+                                                       0x4F, 0x38}
+                               .data()));
+  REQUIRE_FALSE(pattern->matches(std::array<std::uint8_t, 6>{
+      0x48, 0x8B, 0x01, 0x02, 0x5F, 0x38}
+                                     .data()));
+  REQUIRE(VeilHook::Pattern::FromMask(bytes, "xx?x").has_value());
+
+  REQUIRE_FALSE(VeilHook::Pattern::Parse("").has_value());
+  REQUIRE_FALSE(VeilHook::Pattern::Parse("?? ??").has_value());
+  REQUIRE_FALSE(VeilHook::Pattern::Parse("4G").has_value());
+  REQUIRE_FALSE(VeilHook::Pattern::Parse("488B").has_value());
+  REQUIRE_FALSE(VeilHook::Pattern::FromMask(bytes, "xx").has_value());
+}
+
+TEST_CASE("Scanner kernels agree", "[Scanner]")  // NOLINT
+{
+  auto memory = random_bytes(3'000'001);
+  // On chunk boundaries, straddling them and at the very end.
+  const std::array<std::uint8_t, 4> marker{0xDE, 0xAD, 0xBE, 0xEF};
+  for (const std::size_t at : {std::size_t{0}, std::size_t{0x3FFFE},
+                               std::size_t{0x7FFFF}, memory.size() - 4})
+  {
+    std::memcpy(memory.data() + at, marker.data(), marker.size());
+  }
+
+  std::vector<VeilHook::Pattern> patterns;
+  for (const auto* signature : {"DE AD BE EF", "48 8B ?? 24 4? E8", "?? 13 37"})
+  {
+    patterns.push_back(*VeilHook::Pattern::Parse(signature));
+  }
+  std::size_t expected = 0;
+  for (const auto& pattern : patterns)
+  {
+    for (std::size_t i = 0; i + pattern.size() <= memory.size(); ++i)
+    {
+      expected += pattern.matches(memory.data() + i) ? 1 : 0;
+    }
+  }
+
+  VeilHook::Scanner scanner{patterns};
+  const auto reference = scanner.Scan(memory);
+  REQUIRE(reference.size() == expected);
+  REQUIRE(std::ranges::count_if(reference, [](const auto& match)
+                                { return match.pattern == 0; }) == 4);
+  for (const auto kernel : kKernels)
+  {
+    scanner.set_kernel(kernel);
+    const auto matches = scanner.Scan(memory);
+    REQUIRE(matches.size() == reference.size());
+    for (std::size_t i = 0; i < matches.size(); ++i)
+    {
+      REQUIRE(matches[i].pattern == reference[i].pattern);
+      REQUIRE(matches[i].address == reference[i].address);
+    }
+  }
+}
+
+TEST_CASE("Scanner finds hook targets", "[Scanner]")  // NOLINT
+{
+  const auto target = VeilHook::detail::address_cast(&quotient);
+  const auto* code = VeilHook::detail::address_cast<const std::uint8_t*>(target);
+  const std::vector<std::uint8_t> prologue(code, code + 12);
+
+  const VeilHook::Scanner scanner{
+      {*VeilHook::Pattern::FromMask(prologue, "xxxxxxxxxxxx")}};
+  const auto matches = scanner.ScanModule("");
+  REQUIRE(matches.has_value());
+  REQUIRE(std::ranges::any_of(*matches, [&](const auto& match)
+                              { return match.address == target; }));
+
+  auto hook = VeilHook::InlineHook::Create(
+      target, VeilHook::detail::address_cast(&hooked_quotient));
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(quotient(6, 3) == 1337);
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(quotient(6, 3) == 2);
+
+  REQUIRE(VeilHook::Scanner::Find("", "DE AD ?? EF 13 37 ?? ?? 42 42 42 42")
+              .error() == VeilHook::Error::NotFound);
+  REQUIRE(VeilHook::Scanner::Find("no_such_module.dll", "C3").error() ==
+          VeilHook::Error::NotFound);
+}
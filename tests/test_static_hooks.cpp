@@ -0,0 +1,72 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/static_hooks.hpp>
+
+VH_NOINLINE auto sum(int x, int y) -> int
+{
+  return x + y;
+}
+
+VH_DECLARE_HOOK(sum, hooked_sum);
+auto hooked_sum(int x, int y) -> int
+{
+  return VH_ORIGINAL(hooked_sum)(x, y) + 1000;
+}
+
+auto VH_STDCALL hooked_size(LPCWSTR file, DWORD* handle) -> DWORD;
+VH_DECLARE_NAMED_HOOK("version.dll", "GetFileVersionInfoSizeW", hooked_size);
+auto VH_STDCALL hooked_size(LPCWSTR file, DWORD* handle) -> DWORD
+{
+  return VH_ORIGINAL(hooked_size)(file, handle) == 0 ? 0 : 1337;
+}
+
+namespace
+{
+auto version_size() -> DWORD
+{
+  using GetFileVersionInfoSizeW_t = DWORD(VH_STDCALL*)(LPCWSTR, DWORD*);
+  const auto function =
+      VeilHook::detail::address_cast<GetFileVersionInfoSizeW_t>(GetProcAddress(
+          GetModuleHandleA("version.dll"), "GetFileVersionInfoSizeW"));
+  DWORD handle{};
+  return function(L"kernel32.dll", &handle);
+}
+}  // namespace
+
+TEST_CASE("Declarations are collected", "[StaticHooks]")  // NOLINT
+{
+  std::size_t count = 0;
+  for (const auto* hook : VeilHook::Impl::static_hooks())
+  {
+    if (hook != nullptr) { ++count; }
+  }
+  REQUIRE(count == 2);
+  REQUIRE(VH_ORIGINAL(hooked_sum) == nullptr);
+}
+
+TEST_CASE("Install and uninstall", "[StaticHooks]")  // NOLINT
+{
+  REQUIRE(LoadLibraryA("version.dll") != nullptr);
+  const auto size = version_size();
+  REQUIRE(size != 0);
+
+  const auto installed = VeilHook::InstallStaticHooks();
+  REQUIRE(installed.has_value());
+  REQUIRE(*installed == 2);
+  REQUIRE(sum(1, 1) == 1002);
+  REQUIRE(VH_ORIGINAL(hooked_sum)(1, 1) == 2);
+  REQUIRE(version_size() == 1337);
+
+  // Installed hooks are skipped.
+  REQUIRE(VeilHook::InstallStaticHooks() == 0);
+
+  VeilHook::UninstallStaticHooks();
+  REQUIRE(VH_ORIGINAL(hooked_sum) == nullptr);
+  REQUIRE(sum(1, 1) == 2);
+  REQUIRE(version_size() == size);
+
+  REQUIRE(VeilHook::InstallStaticHooks() == 2);
+  REQUIRE(sum(1, 1) == 1002);
+  VeilHook::UninstallStaticHooks();
+  REQUIRE(sum(1, 1) == 2);
+}
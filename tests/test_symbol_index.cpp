@@ -0,0 +1,123 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/symbol_index.hpp>
+#include <VeilHook/utility.hpp>
+#include <string>
+
+extern "C" __declspec(dllexport) __declspec(noinline) auto veilhook_exported(int x) -> int
+{
+    return x + 1;
+}
+
+namespace veil_test
+{
+__declspec(dllexport) __declspec(noinline) auto scaled(int x) -> int
+{
+    return x * 3;
+}
+}  // namespace veil_test
+
+__declspec(noinline) auto hooked_exported([[maybe_unused]] int x) -> int
+{
+    return 1337;
+}
+
+namespace
+{
+auto executable() -> std::string
+{
+  return VeilHook::Impl::module_name(*VeilHook::Impl::module_find(""));
+}
+}  // namespace
+
+TEST_CASE("Undecorate", "[SymbolIndex]")  // NOLINT
+{
+  using VeilHook::Impl::undecorate;
+  REQUIRE(undecorate("?foo@@YAHH@Z") == "foo");
+  REQUIRE(undecorate("?method@Class@ns@@QEAAXXZ") == "ns::Class::method");
+  REQUIRE(undecorate("?_Xlength_error@std@@YAXPEBD@Z") == "std::_Xlength_error");
+  REQUIRE(undecorate("CreateFileW").empty());
+  REQUIRE(undecorate("??0Foo@@QEAA@XZ").empty());
+  REQUIRE(undecorate("?bar@0@@YAXXZ").empty());
+}
+
+TEST_CASE("SymbolIndex lookups", "[SymbolIndex]")  // NOLINT
+{
+  VeilHook::SymbolIndex index;
+  index.AddLoadedModules();
+  REQUIRE(index.size() > 0);
+
+  // Forwarded (kernel32 -> kernelbase/ntdll) and direct exports alike.
+  auto* kernel32 = GetModuleHandleA("kernel32.dll");
+  for (const auto* name : {"GetProcAddress", "Sleep", "HeapAlloc"})
+  {
+    const auto address = index.Find("KERNEL32", name);
+    REQUIRE(address.has_value());
+    REQUIRE(*address == VeilHook::detail::address_cast<std::uintptr_t>(
+                            GetProcAddress(kernel32, name)));
+  }
+  REQUIRE(index.Find("", "NtClose").has_value());
+  REQUIRE(index.Find("kernel32.dll", "NoSuchExport").error() ==
+          VeilHook::Error::NotFound);
+  REQUIRE(index.Find("no_such_module.dll", "Sleep").error() ==
+          VeilHook::Error::NotFound);
+
+  const auto symbols = index.FindPrefix("ntdll.dll", "NtQuery");
+  REQUIRE(symbols.size() > 1);
+  for (const auto& symbol : symbols)
+  {
+    REQUIRE(symbol.name.starts_with("NtQuery"));
+    REQUIRE(symbol.module == "ntdll.dll");
+  }
+
+  const auto module = executable();
+  auto exported = index.Find(module, "veilhook_exported");
+  REQUIRE(exported.has_value());
+  REQUIRE(VeilHook::detail::address_cast<int (*)(int)>(*exported)(1) == 2);
+  auto scaled = index.FindDemangled(module, "veil_test::scaled");
+  REQUIRE(scaled.has_value());
+  REQUIRE(VeilHook::detail::address_cast<int (*)(int)>(*scaled)(2) == 6);
+  REQUIRE(index.Resolve(module, "veil_test::scaled") == scaled);
+
+  index.RemoveModule(VeilHook::detail::address_cast<std::uintptr_t>(kernel32));
+  REQUIRE_FALSE(index.Find("kernel32.dll", "Sleep").has_value());
+}
+
+TEST_CASE("Create by symbol name", "[SymbolIndex]")  // NOLINT
+{
+  auto hook = VeilHook::InlineHook::Create(
+      executable(), "veilhook_exported",
+      VeilHook::detail::address_cast(&hooked_exported));
+  REQUIRE(hook.has_value());
+  REQUIRE(hook->Enable().has_value());
+  REQUIRE(veilhook_exported(1) == 1337);
+  REQUIRE(hook->Call<int>(1) == 2);
+  REQUIRE(hook->Disable().has_value());
+  REQUIRE(veilhook_exported(1) == 2);
+
+  REQUIRE(VeilHook::InlineHook::Create("no_such_module.dll", "Sleep", 0)
+              .error() == VeilHook::Error::NotFound);
+}
+
+TEST_CASE("Unloaded modules leave the index", "[SymbolIndex]")  // NOLINT
+{
+  auto& index = VeilHook::SymbolIndex::Get();
+  auto* module = LoadLibraryA("version.dll");
+  REQUIRE(module != nullptr);
+  REQUIRE(index.Resolve("version.dll", "GetFileVersionInfoSizeW")
+              .has_value());
+
+  REQUIRE(FreeLibrary(module));
+  REQUIRE(GetModuleHandleA("version.dll") == nullptr);
+  REQUIRE(index.Find("version.dll", "GetFileVersionInfoSizeW").error() ==
+          VeilHook::Error::NotFound);
+
+  // Loaded again, possibly elsewhere: indexed afresh.
+  module = LoadLibraryA("version.dll");
+  REQUIRE(module != nullptr);
+  REQUIRE(index.Resolve("version.dll", "GetFileVersionInfoSizeW") ==
+          VeilHook::detail::address_cast<std::uintptr_t>(
+              GetProcAddress(module, "GetFileVersionInfoSizeW")));
+  REQUIRE(FreeLibrary(module));
+}
@@ -0,0 +1,105 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/syscall_hook.hpp>
+#include <VeilHook/utility.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+namespace
+{
+VeilHook::SyscallHook* g_hook = nullptr;
+std::uint32_t g_close = 0;
+std::atomic<int> g_closes{0};
+
+auto VH_STDCALL hooked_close(HANDLE handle) -> LONG
+{
+  ++g_closes;
+  return g_hook->Call<LONG>(g_close, handle);
+}
+
+auto close_event() -> bool
+{
+  auto* event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  return event != nullptr && CloseHandle(event) != FALSE;
+}
+}  // namespace
+
+TEST_CASE("Stubs are found", "[SyscallHook]")  // NOLINT
+{
+  const auto ntdll = VeilHook::Impl::module_find("ntdll.dll");
+  REQUIRE(ntdll.has_value());
+  const auto syscalls = VeilHook::Impl::find_syscalls(*ntdll);
+  REQUIRE(syscalls.has_value());
+  REQUIRE(syscalls->size() > 100);
+  REQUIRE(std::ranges::is_sorted(*syscalls, std::ranges::less{},
+                                 &VeilHook::Syscall::number));
+  REQUIRE(std::ranges::adjacent_find(*syscalls, {},
+                                     &VeilHook::Syscall::number) ==
+          syscalls->end());
+
+  const auto close =
+      std::ranges::find(*syscalls, "NtClose", &VeilHook::Syscall::name);
+  REQUIRE(close != syscalls->end());
+  REQUIRE(close->instruction > close->address);
+  REQUIRE(close->instruction < close->address + 32);
+}
+
+TEST_CASE("Dispatch tables fit every index", "[SyscallHook]")  // NOLINT
+{
+  using VeilHook::Impl::dispatch_slots;
+  constexpr auto kMask = VeilHook::SyscallHook::kIndexMask;
+  const auto stub = [](std::uint32_t number)
+  {
+    return VeilHook::Syscall{
+        .name = {}, .number = number, .address = 0, .instruction = 0};
+  };
+  // Sorted by full number, the largest index comes first.
+  const std::array high{stub(0x0020), stub(0x3005)};
+  REQUIRE(dispatch_slots(high, kMask) == 0x21);
+
+  const std::array shared{stub(0x0005), stub(0x3005)};
+  REQUIRE(dispatch_slots(shared, kMask).error() ==
+          VeilHook::Error::UnsupportedInstruction);
+}
+
+TEST_CASE("Handlers by number", "[SyscallHook]")  // NOLINT
+{
+  const auto ntdll = VeilHook::Impl::module_find("ntdll.dll");
+  REQUIRE(ntdll.has_value());
+  const auto close = VeilHook::detail::address_cast<const std::uint8_t*>(
+      GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtClose"));
+  std::array<std::uint8_t, 16> original{};
+  std::copy_n(close, original.size(), original.begin());
+
+  {
+    auto hook = VeilHook::SyscallHook::Create();
+    REQUIRE(hook.has_value());
+    g_hook = hook->get();
+    // Every stub passes through until a handler is set.
+    REQUIRE(not std::ranges::equal(original, std::span{close, 16}));
+    REQUIRE(close_event());
+
+    const auto number = g_hook->Number("NtClose");
+    REQUIRE(number.has_value());
+    g_close = *number;
+    REQUIRE(g_hook->Original(g_close) != 0);
+    REQUIRE(g_hook->SetHandler("NtClose", VeilHook::detail::address_cast(
+                                              &hooked_close))
+                .has_value());
+    REQUIRE(close_event());
+    REQUIRE(g_closes == 1);
+
+    REQUIRE(g_hook->SetHandler(g_close, 0).has_value());
+    REQUIRE(close_event());
+    REQUIRE(g_closes == 1);
+
+    REQUIRE(g_hook->SetHandler("NtNotASyscall", 1).error() ==
+            VeilHook::Error::NotFound);
+    REQUIRE(g_hook->SetHandler(0xFFFF'FFFF, 1).error() ==
+            VeilHook::Error::NotFound);
+  }
+  g_hook = nullptr;
+  REQUIRE(std::ranges::equal(original, std::span{close, 16}));
+  REQUIRE(close_event());
+}
@@ -0,0 +1,116 @@
+#define SNITCH_IMPLEMENTATION
+#include <snitch/snitch.hpp>
+#include <VeilHook/inline_hook.hpp>
+#include <VeilHook/trace.hpp>
+#include <algorithm>
+#include <string>
+
+__declspec(noinline) auto sum(int x, int y) -> int
+{
+    return x + y;
+}
+
+__declspec(noinline) auto sum_detour(int x, int y) -> int
+{
+    return x * y;
+}
+
+using VeilHook::detail::address_cast;
+
+TEST_CASE("Chrome trace of synthetic events", "[Trace]")  // NOLINT
+{
+  const std::vector<VeilHook::TraceEvent> events{
+      {.start_ns = 1500,
+       .duration_ns = 250,
+       .target = 0x1000,
+       .thread = 7,
+       .count = 3,
+       .phase = VeilHook::TracePhase::Allocate},
+      {.start_ns = 2000,
+       .duration_ns = 1000,
+       .target = 0xABC,
+       .thread = 7,
+       .phase = VeilHook::TracePhase::Protect,
+       .result = VeilHook::Error::Protect},
+  };
+  const auto json = VeilHook::Tracer::ToChromeTrace(events);
+
+  REQUIRE(json.starts_with("{\"traceEvents\":[{\"name\":\"allocate\""));
+  REQUIRE(json.find("\"ts\":1.500,\"dur\":0.250") != std::string::npos);
+  REQUIRE(json.find("\"tid\":7") != std::string::npos);
+  REQUIRE(json.find("\"target\":\"0x1000\"") != std::string::npos);
+  REQUIRE(json.find("\"count\":3") != std::string::npos);
+  REQUIRE(json.find("\"name\":\"protect\"") != std::string::npos);
+  REQUIRE(json.find("\"target\":\"0xabc\"") != std::string::npos);
+  REQUIRE(json.find("\"ts\":2.000,\"dur\":1.000") != std::string::npos);
+  REQUIRE(json.ends_with("}],\"displayTimeUnit\":\"ns\"}"));
+  REQUIRE(VeilHook::Tracer::ToChromeTrace({}) ==
+          "{\"traceEvents\":[],\"displayTimeUnit\":\"ns\"}");
+}
+
+TEST_CASE("Phase names", "[Trace]")  // NOLINT
+{
+  REQUIRE(std::string{VeilHook::to_string(VeilHook::TracePhase::Decode)} ==
+          "decode");
+  REQUIRE(std::string{VeilHook::to_string(VeilHook::TracePhase::Veh)} ==
+          "veh");
+  REQUIRE(std::string{VeilHook::to_string(VeilHook::Error::Success)} ==
+          "Success");
+}
+
+TEST_CASE("Buffer overflow is counted as dropped", "[Trace]")  // NOLINT
+{
+  auto& tracer = VeilHook::Tracer::Get();
+  tracer.Enable(2);
+  for (std::uint32_t i = 0; i < 5; ++i)
+  {
+    tracer.Record({.count = i, .phase = VeilHook::TracePhase::Write});
+  }
+  tracer.Disable();
+
+  const auto events = tracer.Events();
+  REQUIRE(events.size() == 2);
+  REQUIRE(events[0].count == 0);
+  REQUIRE(events[1].count == 1);
+  REQUIRE(events[0].thread != 0);
+  REQUIRE(tracer.dropped() == 3);
+}
+
+TEST_CASE("Hook install records its phases", "[Trace]")  // NOLINT
+{
+  auto& tracer = VeilHook::Tracer::Get();
+  tracer.Enable();
+  {
+    auto hook = VeilHook::InlineHook::Create(
+        address_cast<std::uintptr_t>(&sum),
+        address_cast<std::uintptr_t>(&sum_detour));
+    REQUIRE(hook.has_value());
+    REQUIRE(hook->Enable().has_value());
+    REQUIRE(sum(3, 4) == 12);
+  }
+  tracer.Disable();
+
+  const auto events = tracer.Events();
+#if defined(VEIL_HOOK_TRACING)
+  const auto target = address_cast<std::uintptr_t>(&sum);
+  const auto has = [&](VeilHook::TracePhase phase)
+  {
+    return std::ranges::any_of(events,
+                               [&](const VeilHook::TraceEvent& event)
+                               {
+                                 return event.phase == phase &&
+                                        event.target == target &&
+                                        event.result ==
+                                            VeilHook::Error::Success;
+                               });
+  };
+  REQUIRE(has(VeilHook::TracePhase::Decode));
+  REQUIRE(has(VeilHook::TracePhase::Allocate));
+  REQUIRE(has(VeilHook::TracePhase::Emit));
+  REQUIRE(has(VeilHook::TracePhase::Write));
+  REQUIRE(has(VeilHook::TracePhase::Veh));
+#else
+  // Trace points compile to nothing without the option.
+  REQUIRE(events.empty());
+#endif
+}
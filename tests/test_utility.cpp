@@ -2,6 +2,7 @@
 #include <snitch/snitch.hpp>
 
 #include <VeilHook/utility.hpp>
+#include <array>
 
 TEST_CASE("Utility") // NOLINT
 {
@@ -15,4 +16,24 @@ TEST_CASE("Utility") // NOLINT
     REQUIRE((query.value().access == VeilHook::Impl::VM_ACCESS_RWX));
 
     VeilHook::Impl::vm_free(result.value());
-}
\ No newline at end of file
+}
+
+TEST_CASE("VehTable lookup") // NOLINT
+{
+    using VeilHook::Impl::VehEntry;
+    std::array entries{
+        VehEntry{.start_address = 0x1000, .end_address = 0x1FFF, .callback = {}},
+        VehEntry{.start_address = 0x1100, .end_address = 0x110F, .callback = {}},
+        VehEntry{.start_address = 0x3000, .end_address = 0x3000, .callback = {}},
+    };
+    std::array<std::uintptr_t, 3> max_end{0x1FFF, 0x1FFF, 0x3000};
+    const VeilHook::Impl::VehTable table{.entries = entries, .max_end = max_end};
+
+    REQUIRE((table.find(0x0FFF) == nullptr));
+    REQUIRE((table.find(0x1000) == &entries[0]));
+    REQUIRE((table.find(0x1108) == &entries[1]));
+    REQUIRE((table.find(0x1200) == &entries[0]));
+    REQUIRE((table.find(0x2000) == nullptr));
+    REQUIRE((table.find(0x3000) == &entries[2]));
+    REQUIRE((table.find(0x3001) == nullptr));
+}